@@ -1,7 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#include "paramsys.h"
+#include "paramsys_generated.h"
 
 
 int main() {
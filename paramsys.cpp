@@ -2,6 +2,7 @@
 // Licence: pick one - public domain / UNLICENCE (https://www.unlicense.org) / MIT (https://opensource.org/licenses/MIT).
 
 //  * when values are added to any type (for example 5 * u16), the init code will make room by copying the values forward (shift everything starting from count_32 by 5*2=10 bytes).
+//    done by paramsys_migrate, with the layout descriptor that is stored together with the values snapshot.
 //  * TODO: a flag that shows whether we should copy the param to eeprom on every update, or change it only in RAM.
 //  * you can't remove params or change param types.
 //  * you can change/add/remove limits (every param value is re-validated on every bootup), defaults and param names.
@@ -19,9 +20,21 @@
 #include <string.h> // memcpy
 #include <assert.h> // assert
 #include <stdio.h> // printf
+#include <stdlib.h> // malloc
+#include <stdarg.h> // va_list
 #include <inttypes.h> // PRIu64, ..
+#include <time.h> // time
+#include <math.h> // isfinite
+#include <new> // placement new
+#include <algorithm> // std::sort
+#ifdef PARAMS_CONCURRENT
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#endif
 
 #include "paramsys_impl_generated.h"
+#include "paramsys_store.h"
 
 #include "helpers.h"
 
@@ -55,68 +68,13 @@ union conv_t {
 	u8  u128v[16];
 	u8  padding[16*3];
 };
-
-
-// Memory layout in EEPROM.
-// But there's always a RAM mirror of the whole parameters struct.
-struct paramsys_valuemem_t {
-	u8 component;
-	u8 packet_type;
-	u8 packet_version;
-	//u32 some_magic_code..
-	u8 reserved1;
-	u8 reserved2;
-	u8 reserved3;
-	u32 values_bytes_capacity;
-	u32 values_bytes_used;
-	u16 count_8;  // num of values by type length in "values" array. i8, u8, flags8.
-	u16 count_16; // i16, u16, flags16. address: values + count_8 * sizeof(i8)
-	u16 count_32; // i32, u32, flags32. address: values + count_8 * sizeof(i8) + count_16 * sizeof(i16)
-	u16 count_64; // ..
-	u16 count_128; // ..
-	u16 count_str; // TODO: need this? maybe.
-	u32 len_str;
-
-
-	// this has to be the last entry!
-	// also, this HAS to be aligned at 4 bytes in relation to the struct start.
-	u8  values[PARAMS_VALUES_CAPACITY_BYTES];
-
-	// strings: [maxlen, len, ...], [maxlen, len, ...] // maxlen here is necessary if we want to support resizing the string params.
-
-	// layout of the following arrays is only correct if magic_code matches. if does not match, then the init code
-	// should fix the layout.
-
-	// I'd very much like to do something like this, instead of the one "values" array and offsetof_* functions, but
-	// c/c++ doesn't allow 0-sized arrays (we don't want to pay the max 14-byte penalty
-//	u8  values_8[PARAMS_COUNT_8];
-//	u16 values_16[PARAMS_COUNT_16];
-//	u32 values_32[PARAMS_COUNT_32]; // i32, u32, f32
-//	u64 values_64[PARAMS_COUNT_64];
-//	u8  values_str[PARAMS_LEN_STR];
-
-	// offsets from start of the struct
-	inline int offsetof_8()   { return offsetof(paramsys_valuemem_t, values); }
-	inline int offsetof_16()  { int end = offsetof_8() + count_8; return end + (end & 1); } // aligned by 2 bytes
-	inline int offsetof_32()  { int end = offsetof_16() + count_16 * 2; return end + (end & 2); } // aligned by 4 bytes
-	inline int offsetof_64()  { return offsetof_32() + count_32 * 4; } // aligned by 4 bytes
-	inline int offsetof_128() { return offsetof_64() + count_64 * 8; } // aligned by 4 bytes
-	inline int offsetof_str() { return offsetof_128() + count_128 * 16; } // aligned by 4 bytes
-
-	// size in bytes, including the padding bytes between arrays of the different types. pad everything to 4 bytes,
-	// and assume address of the paramsys_valuemem struct is already aligned.
-	//int calc_values_size() { return offsetof_str() + str_len - offsetof_8(); }
-};
 #pragma pack(pop)
 
 
-enum { COMPONENT_PARAMS = 0xFD, };
-enum { P_PARAMS_VALUEMEM = 0x06, };
-
 paramsys_valuemem_t params_values = {
 	COMPONENT_PARAMS,  // 0xFD
 	P_PARAMS_VALUEMEM, // 0x06
-	1,
+	PARAMS_INDEX_BITS == 32 ? 3 : 2, // 3: header with u32 counts
 	0,
 	0,
 	0,
@@ -129,8 +87,12 @@ paramsys_valuemem_t params_values = {
 	PARAMS_COUNT_128,
 	PARAMS_COUNT_STR,
 	PARAMS_VALUES_STR_BYTES,
-	//.values = {},
+	{},
+	{ PARAMS_DEFAULTS_IMAGE_INIT },
 };
+static_assert(offsetof(paramsys_valuemem_t, values) % 4 == 0, "values has to be aligned at 4 bytes");
+
+paramsys_valuemem_t* params_valuemem = &params_values;
 
 // These are indirection to the params_values arrays by type. We have to use this indirection because c/c++ doesn't
 // allow zero-size arrays. Longer explanation in paramsys_impl_generated.h.
@@ -140,6 +102,7 @@ u32*    params_values_32  = (u32*)((u8*)&params_values + params_values.offsetof_
 u64*    params_values_64  = (u64*)((u8*)&params_values + params_values.offsetof_64());
 u8*     params_values_128 = (u8*)((u8*)&params_values + params_values.offsetof_128());
 u8*     params_values_str = (u8*)((u8*)&params_values + params_values.offsetof_str());
+bool    params_values_readonly;
 
 
 // TODO: additional indirection. still encode length in param type.
@@ -149,7 +112,7 @@ struct {
 	void* values;
 	void* defaults;
 	void* defminmax;
-} paramsys_type_table[17] = {
+} paramsys_type_table[19] = {
 	{"u8",      1,  params_values_8,   defaults_8,   defminmax_8 },
 	{"u16",     2,  params_values_16,  defaults_16,  defminmax_16},
 	{"u32",     4,  params_values_32,  defaults_32,  defminmax_32},
@@ -167,315 +130,3174 @@ struct {
 	{"time_unix_us64",  8, params_values_64,  defaults_64,  defminmax_64},
 	{"time_atomic_u64", 8, params_values_64,  defaults_64,  defminmax_64},
 	{"str",             0, nullptr, nullptr, nullptr}, // here only for the type name
+	{"str16",           0, nullptr, nullptr, nullptr},
+	{"buf",             0, nullptr, nullptr, nullptr},
+};
+
+inline const char* l_param_type_to_str(params_type_e param_type);
+inline u32         l_param_len_bytes(param_info_t* param_info);
+inline u8          l_param_size_class(param_info_t* param_info);
+inline bool        l_param_is_variable_size(param_info_t* param_info);
+inline bool        l_param_has_no_default(param_info_t* param_info);
+inline void*       l_param_get_default_ptr(param_info_t* param_info);
+inline void*       l_param_get_value_ptr(param_info_t* param_info);
+inline u8          l_hot_size_class(const paramsys_hot_t* hot);
+inline u32         l_hot_len_bytes(const paramsys_hot_t* hot);
+inline bool        l_hot_is_variable_size(const paramsys_hot_t* hot);
+inline u8*         l_hot_get_value_ptr(const paramsys_ctx_t* ctx, const paramsys_hot_t* hot);
+inline paramsys_arena_header_t* l_arena(const paramsys_ctx_t* ctx);
+inline u8*         l_arena_bytes(const paramsys_ctx_t* ctx);
+inline paramsys_arena_ref_t* l_arena_ref(const paramsys_ctx_t* ctx, const paramsys_hot_t* hot);
+inline u16         l_arena_max_len(const paramsys_hot_t* hot);
+inline const u8*   l_arena_default(const paramsys_hot_t* hot, u16* out_len);
+inline void        l_hot_copy_value(u8 size_class, void* dst, const void* src);
+inline bool        l_access_bit(const u64* bits, param_index_t param_index);
+inline u8*         l_param_get_default_str_ptr(param_info_t* param_info);
+inline u8*         l_param_get_value_str_ptr(param_info_t* param_info);
+bool               l_params_set_str(paramsys_ctx_t* ctx, const paramsys_hot_t* hot, const char* str, u8 str_len);
+param_error_t      l_caller_check_write(const params_caller_t* caller, param_index_t param_index);
+param_error_t      l_arena_set(paramsys_ctx_t* ctx, const paramsys_hot_t* hot, const void* data, u16 len, bool locked,
+                               bool* out_changed);
+param_error_t      l_params_ctx_set_arena(paramsys_ctx_t* ctx, param_index_t param_index, params_type_e type, const void* data,
+                                          u16 len);
+bool               l_arena_lock(paramsys_ctx_t* ctx);
+void               l_arena_unlock(paramsys_ctx_t* ctx);
+void               l_arena_compact(paramsys_ctx_t* ctx);
+u32                l_arena_validate(paramsys_ctx_t* ctx, param_index_t* out_param_indices, u32 max_count, u32 fixed,
+                                    bool notify);
+void               l_params_store_append(param_index_t param_index);
+void               l_params_store_apply(u32 param_index, const u8* value, u16 len);
+bool               l_params_apply_limits(const paramsys_hot_t* hot, conv_t* val);
+bool               l_params_write_value(paramsys_ctx_t* ctx, const paramsys_hot_t* hot, const void* valueptr);
+void               l_params_write_begin_mask(paramsys_ctx_t* ctx, u32 size_class_mask);
+void               l_params_write_end_mask(paramsys_ctx_t* ctx, u32 size_class_mask);
+void               l_params_mark_changed(param_index_t param_index);
+static void        l_history_record(param_index_t param_index);
+void               l_params_ctx_on_value_changed(paramsys_ctx_t* ctx, param_index_t param_index);
+bool               l_profiles_capture(param_index_t param_index);
+void               l_profiles_switch(int to);
+int                l_profile_find(const char* name);
+bool               l_profile_valid(int profile);
+param_error_t      l_profile_set_override(int profile, param_index_t param_index, const void* value, u32 len);
+void               l_profiles_patch_base(u8* values);
+inline u32         l_value_max_len(const paramsys_ctx_t* ctx, const paramsys_hot_t* hot);
+inline void        l_value_save(const paramsys_ctx_t* ctx, const paramsys_hot_t* hot, u8* out);
+inline bool        l_value_equal(const paramsys_ctx_t* ctx, const paramsys_hot_t* hot, const u8* saved);
+inline void        l_slot_copy(u8* dst, const u8* src, u32 len);
+bool               l_slot_equal(const paramsys_hot_t* hot, const u8* a, const u8* b, u32 len);
+u8*                l_txn_find(params_txn_t* txn, param_index_t param_index);
+u8*                l_txn_stage(params_txn_t* txn, param_index_t param_index, u32 len);
+void               l_params_store_maybe_compact();
+bool               l_params_load_snapshot(const u8* image, u32 len);
+u32                l_params_validate_all(paramsys_ctx_t* ctx, param_index_t* out_param_indices, u32 max_count, bool notify);
+param_error_t      l_params_reset_to_defaults(paramsys_ctx_t* ctx, bool by_component, u8 component);
+param_error_t      l_params_copy_from_value(param_info_t* param_info, void* out_default);
+param_error_t      l_params_copy_to_value(param_info_t* param_info, void* in_value);
+param_error_t      l_params_copy_default(param_info_t* param_info, void* out_default);
+param_error_t      l_params_copy_defminmax_or_default(param_info_t* param_info, void* out_default);
+void               l_params_copy_from_defaults_str(param_info_t* param_info, u8* out_str);
+void               l_bytes_to_hex_prefix(const u8* data, u16 len, char* dst, u32 dst_max_len);
+void               l_params_print_all(params_table_t* params_info);
+
+
+// every value change gets appended here. nullptr if params_init_from_store was not used.
+static paramsys_store_t* l_store = nullptr;
+// store snapshot: values memory header, values[0 .. values_bytes_used], u32 layout_count, layout_count layout entries.
+// the layout is that of the firmware that wrote the snapshot, so the biggest one we can load is bounded only by the
+// capacity and the max param count.
+#define L_SNAPSHOT_MAX_BYTES \
+	(offsetof(paramsys_valuemem_t, values) + PARAMS_VALUES_CAPACITY_BYTES + 4 + \
+	 PARAMS_MAX_COUNT * sizeof(paramsys_layout_entry_t))
+
+// Two-level bitmap, one bit per param. summary has one bit per words[] word, so a poll only looks at words that
+// actually have bits set.
+#define L_BITMAP_WORDS         ((PARAMS_COUNT + 63) / 64)
+#define L_BITMAP_SUMMARY_WORDS ((L_BITMAP_WORDS + 63) / 64)
+struct l_param_bitmap_t {
+	u64 words[L_BITMAP_WORDS];
+	u64 summary[L_BITMAP_SUMMARY_WORDS];
+};
+
+// Subscriptions. l_pending is set on every value change while there are subscriptions, cleared by params_dispatch.
+struct l_subscription_t {
+	params_change_cb_t cb; // nullptr if the slot is free
+	void*         user;
+	param_index_t first_param_index;
+	param_index_t last_param_index;
+	u8            component;
+	bool          by_component;
+};
+static l_subscription_t l_subscriptions[PARAMS_MAX_SUBSCRIPTIONS];
+static u32              l_subscription_count; // setters skip l_pending while this is 0
+static l_param_bitmap_t l_pending;
+
+// Change log for params_sync_delta. Every value change gets the next version and one entry (version <<
+// L_CHANGE_LOG_INDEX_BITS) | param_index at l_change_log[version % PARAMS_CHANGE_LOG_SIZE]. One atomic store per entry,
+// so concurrent writers can't tear it, and a reader sees from the version bits whether the entry was overwritten.
+#define L_CHANGE_LOG_INDEX_BITS (PARAMS_INDEX_BITS == 32 ? 24 : 16)
+static_assert(PARAMS_COUNT <= (1 << L_CHANGE_LOG_INDEX_BITS), "param index doesn't fit into a change log entry");
+static u64 l_version;
+static u64 l_epoch;
+static u64 l_change_log[PARAMS_CHANGE_LOG_SIZE];
+
+#pragma pack(push,1)
+struct l_sync_header_t { u8 kind; u64 epoch; u64 since_version; u64 version; };
+#pragma pack(pop)
+#define L_SYNC_SNAPSHOT 'S'
+#define L_SYNC_DELTA    'D'
+
+bool l_bitmap_mark(l_param_bitmap_t* bitmap, param_index_t param_index);
+u32  l_bitmap_take(l_param_bitmap_t* bitmap, param_index_t* out_param_indices, u32 max_count,
+                   const u64* mask = nullptr);
+bool l_bitmap_any(l_param_bitmap_t* bitmap);
+int  l_params_subscribe(const l_subscription_t* sub);
+
+#ifdef PARAMS_CONCURRENT
+static paramsys_seq_t  l_seq_local[PARAMS_SIZE_CLASS_COUNT];
+paramsys_seq_t*        params_seq = l_seq_local;
+// serializes store appends. held outside the write lock, so readers never wait for io.
+static std::mutex      l_store_mutex;
+static std::mutex      l_subscriptions_mutex; // held by params_dispatch for the duration of the callbacks
+static std::mutex      l_dispatcher_mutex;
+static std::condition_variable l_dispatcher_cv;
+static std::thread     l_dispatcher_thread;
+static bool            l_dispatcher_wakeup; // under l_dispatcher_mutex
+static bool            l_dispatcher_stop;   // under l_dispatcher_mutex
+#endif
+
+// Profiles. Ids start from 1, l_profiles[0] is never used.
+struct l_override_t {
+	param_index_t param_index;
+	u16           len;     // bytes of the value slot, strings with their max_len/len header
+	u32           pos;     // override value at data[pos], the base value it covers at data[pos + len] while the
+	                       // profile is active
+	bool          changed; // scratch of l_profiles_switch
+};
+struct l_profile_t {
+	char          name[PARAMS_PROFILE_NAME_LEN]; // "" if the slot is free
+	l_override_t* entries;                       // sorted by param_index
+	u32           count;
+	u8*           data;
+	u32           data_len;
+};
+static l_profile_t l_profiles[PARAMS_MAX_PROFILES + 1];
+static int         l_profile_active;
+static u8          l_profile_source[PARAMS_COUNT]; // id of the profile whose value a param shows, 0 for the base value
+#ifdef PARAMS_CONCURRENT
+static std::mutex  l_profiles_mutex; // taken before the write lock
+#endif
+l_override_t* l_profile_find_entry(l_profile_t* p, param_index_t param_index);
+
+// Value history. The entries of all rings, see paramsys_history_ring_t. Every ring is written lock-free by whoever
+// changes its param: a writer takes the ring's next write number n with l_history_head, and entry n % len has
+// seq 2 * n + 1 while it's written and 2 * n + 2 when done.
+struct l_history_entry_t {
+	u64 seq;
+	i64 timestamp_us;
+	u8  value[16];
+};
+static l_history_entry_t l_history_entries[PARAMS_HISTORY_ENTRIES_COUNT ? PARAMS_HISTORY_ENTRIES_COUNT : 1];
+// writes so far, by ring
+static u64               l_history_head[PARAMS_HISTORY_RINGS_COUNT ? PARAMS_HISTORY_RINGS_COUNT : 1];
+i64                      l_history_clock_realtime();
+static i64             (*l_history_now_us)() = l_history_clock_realtime;
+
+// One instance of the param table: everything that is per instance. The schema (params_info, params_hot, defaults,
+// limits) is shared. Change log, subscriptions, store and sync exist only for the default instance.
+struct paramsys_ctx_t {
+	paramsys_valuemem_t* valuemem;
+	u8*                  values;      // valuemem->values, base of paramsys_hot_t::value_offset
+	bool                 readonly;    // valuemem is a read-only shared mapping. params_set* fail.
+#ifdef PARAMS_CONCURRENT
+	paramsys_seq_t*      seq;         // [PARAMS_SIZE_CLASS_COUNT]
+	std::mutex           write_mutex; // serializes writers
+#endif
+	l_param_bitmap_t     dirty;       // set on every value change, cleared by params_take_changed
+	u32                  arena_pins;  // views held, L_ARENA_LOCKED while a writer may compact the arena
+	u64                  arena_order[PARAMS_COUNT_ARENA ? PARAMS_COUNT_ARENA : 1]; // scratch of l_arena_compact
 };
 
-template <typename T>
-static T l_clamp(T v, T lo, T hi) {
-	if (lo > hi) { T t = lo; lo = hi; hi = t; }
-	if (v > hi) return hi;
-	if (v < lo) return lo;
-	return v;
-	// could use this, but for our case, hi can be lower than lo.
-	//v = v > lo ? v : lo;
-	//return v < hi ? v : hi;
+// The instance behind the params_* functions. paramsys_bind_valuemem moves it around.
+// every member spelled out, the ones after readonly start empty.
+#ifdef PARAMS_CONCURRENT
+static paramsys_ctx_t l_ctx_default = {&params_values, params_values.values, false, l_seq_local, {}, {}, 0, {}};
+#else
+static paramsys_ctx_t l_ctx_default = {&params_values, params_values.values, false, {}, 0, {}};
+#endif
+
+// instance memory from params_ctx_create: the ctx and its seqlock counters, then the values memory header and
+// PARAMS_VALUES_LEN_BYTES of values. no room for a bigger layout, instances don't load older snapshots.
+struct l_ctx_block_t {
+	paramsys_ctx_t      ctx;
+#ifdef PARAMS_CONCURRENT
+	paramsys_seq_t      seq[PARAMS_SIZE_CLASS_COUNT];
+#endif
+};
+#define L_CTX_VALUEMEM_OFFSET ((sizeof(l_ctx_block_t) + 7) & ~(size_t)7)
+#define L_CTX_BYTES           (L_CTX_VALUEMEM_OFFSET + offsetof(paramsys_valuemem_t, values) + PARAMS_VALUES_LEN_BYTES)
+
+#ifdef PARAMS_CONCURRENT
+inline u32 l_seq_read_begin(const paramsys_ctx_t* ctx, u8 size_class) {
+	u32 s;
+	while ((s = __atomic_load_n(&ctx->seq[size_class].seq, __ATOMIC_ACQUIRE)) & 1)
+		;
+	return s;
+}
+
+inline bool l_seq_read_retry(const paramsys_ctx_t* ctx, u8 size_class, u32 s) {
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&ctx->seq[size_class].seq, __ATOMIC_RELAXED) != s;
+}
+#else
+inline u32  l_seq_read_begin(const paramsys_ctx_t*, u8) { return 0; }
+inline bool l_seq_read_retry(const paramsys_ctx_t*, u8, u32) { return false; }
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// public interface
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//void params_init(params_table_t* params_info) {
+void params_init() {
+	if (l_ctx_default.readonly)
+		return;
+
+#ifndef NDEBUG
+	for (int i = 0; i < ELEMENTS_IN_ARRAY(params_info.params_info); i++) {
+
+		param_info_t* param_info = &params_info.params_info[i];
+		// params_hot is a second view of the same layout.
+		assert(params_hot[i].type == param_info->type && l_hot_get_value_ptr(&l_ctx_default, &params_hot[i]) == (u8*)(
+		       l_param_is_variable_size(param_info) ? l_param_get_value_str_ptr(param_info) : l_param_get_value_ptr(param_info)));
+
+		// and params_defaults_image has to hold what the defaults tables say.
+		const u8* image = params_defaults_image + params_hot[i].value_offset;
+		if (!l_param_is_variable_size(param_info)) {
+			conv_t def;
+			param_error_t e = l_params_copy_default(param_info, &def);
+			assert(e == param_error_t::SUCCESS && memcmp(&def, image, l_param_len_bytes(param_info)) == 0);
+		} else if (!paramsys_type_is_arena(param_info->type)) {
+			u8 def[2 + 255];
+			l_params_copy_from_defaults_str(param_info, def);
+			assert(memcmp(def, image, 2 + def[1]) == 0);
+		} else {
+			// the image has the ref, the default itself is packed at the start of the arena.
+			u16 def_len;
+			const u8* def = l_arena_default(&params_hot[i], &def_len);
+			paramsys_arena_ref_t ref;
+			memcpy(&ref, image, sizeof(ref));
+			const u8* arena_image = params_defaults_image + PARAMS_ARENA_OFFSET + sizeof(paramsys_arena_header_t);
+			assert(ref.len == def_len && memcmp(arena_image + ref.offset, def, def_len) == 0);
+		}
+
+		// the access bitmaps have to agree with security_level, and a param that can be changed can be seen.
+		for (u32 level = 0; level < PARAMS_SECURITY_LEVELS; level++) {
+			bool listed = i != 0 && !(param_info->flags & param_info_t::DISABLED);
+			bool writable = l_access_bit(params_access_writable[level], i);
+			assert(writable == (listed && param_info->security_level <= level));
+			assert(!writable || l_access_bit(params_access_readable[level], i));
+			assert(listed || !l_access_bit(params_access_readable[level], i));
+		}
+	}
+#endif
+
+	// the profiles go, their base copies and sources would point at values that aren't there anymore.
+	{
+#ifdef PARAMS_CONCURRENT
+		std::lock_guard<std::mutex> lock(l_profiles_mutex);
+#endif
+		for (int id = 1; id <= PARAMS_MAX_PROFILES; id++) {
+			free(l_profiles[id].entries);
+			free(l_profiles[id].data);
+			memset(&l_profiles[id], 0, sizeof(l_profiles[id]));
+		}
+		memset(l_profile_source, 0, sizeof(l_profile_source));
+		__atomic_store_n(&l_profile_active, 0, __ATOMIC_RELAXED);
+	}
+
+	memcpy(params_valuemem->values, params_defaults_image, PARAMS_VALUES_LEN_BYTES);
+}
+
+void params_init_from_store(paramsys_store_t* store) {
+	params_init();
+	if (!store)
+		return;
+
+	// snapshot first. it may come from an older firmware with a different layout, then it gets migrated.
+	bool migrated = false;
+	u8* image = (u8*)malloc(L_SNAPSHOT_MAX_BYTES);
+	if (image) {
+		u32 len = store->load_snapshot(store, image, L_SNAPSHOT_MAX_BYTES);
+		migrated = l_params_load_snapshot(image, len);
+		free(image);
+	}
+
+	// then every change made after the snapshot. l_store is still nullptr, so replay doesn't append to the journal.
+	// journal records of an older firmware are by the old param indexes. those that don't fit the type are skipped.
+	store->replay_journal(store, l_params_store_apply);
+
+	// validate last, over the snapshot and the replayed records both. limits may have changed since the values were
+	// written, and the image or the journal may be damaged.
+	l_params_validate_all(&l_ctx_default, nullptr, 0, false);
+
+	l_store = store;
+	// a migrated image is written out in the new layout right away, so the migration runs only once.
+	if (migrated || store->journal_bytes > store->compact_threshold_bytes)
+		params_store_compact();
+}
+
+param_error_t params_store_compact() {
+	if (!l_store)
+		return param_error_t::FAIL;
+	u32 values_len = offsetof(paramsys_valuemem_t, values) + params_valuemem->values_bytes_used;
+	u32 len = values_len + 4 + sizeof(params_layout);
+	u8* image = (u8*)malloc(len);
+	if (!image)
+		return param_error_t::FAIL;
+	u32 layout_count = PARAMS_COUNT;
+	memcpy(image, params_valuemem, values_len);
+	l_profiles_patch_base(image + offsetof(paramsys_valuemem_t, values));
+	memcpy(image + values_len, &layout_count, 4);
+	memcpy(image + values_len + 4, params_layout, sizeof(params_layout));
+	bool ok = l_store->compact(l_store, image, len);
+	free(image);
+	return ok ? param_error_t::SUCCESS : param_error_t::FAIL;
+}
+
+param_error_t params_reset_all_to_defaults() {
+	return l_params_reset_to_defaults(&l_ctx_default, false, 0);
+}
+
+param_error_t params_reset_component(u8 component) {
+	return l_params_reset_to_defaults(&l_ctx_default, true, component);
+}
+
+u32 params_ctx_size() {
+	return L_CTX_BYTES;
+}
+
+u32 params_ctx_align() {
+	return alignof(l_ctx_block_t);
+}
+
+paramsys_ctx_t* params_ctx_create(void* mem, u32 mem_len) {
+	if (!mem || mem_len < L_CTX_BYTES || (uintptr_t)mem % alignof(l_ctx_block_t))
+		return nullptr;
+	l_ctx_block_t* block = new (mem) l_ctx_block_t();
+	paramsys_ctx_t* ctx = &block->ctx;
+
+	// same header as the default instance, values from the default image.
+	paramsys_valuemem_t* valuemem = (paramsys_valuemem_t*)((u8*)mem + L_CTX_VALUEMEM_OFFSET);
+	memcpy(valuemem, &params_values, offsetof(paramsys_valuemem_t, values));
+	valuemem->values_bytes_capacity = PARAMS_VALUES_LEN_BYTES;
+	memcpy(valuemem->values, params_defaults_image, PARAMS_VALUES_LEN_BYTES);
+	ctx->valuemem = valuemem;
+	ctx->values   = valuemem->values;
+	ctx->readonly = false;
+#ifdef PARAMS_CONCURRENT
+	ctx->seq      = block->seq;
+#endif
+	return ctx;
+}
+
+void params_ctx_destroy(paramsys_ctx_t* ctx) {
+	if (ctx && ctx != &l_ctx_default)
+		((l_ctx_block_t*)ctx)->~l_ctx_block_t();
+}
+
+paramsys_ctx_t* params_ctx_default() {
+	return &l_ctx_default;
+}
+
+param_error_t params_ctx_reset_all_to_defaults(paramsys_ctx_t* ctx) {
+	return l_params_reset_to_defaults(ctx, false, 0);
+}
+
+param_error_t params_ctx_reset_component(paramsys_ctx_t* ctx, u8 component) {
+	return l_params_reset_to_defaults(ctx, true, component);
+}
+
+// return info about the param, including defaults and limits if present. does not return current value of the param.
+param_error_t params_get_info(param_index_t param_index, param_info_public_t* out_param_info) {
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	param_info_t* param_inf = &params_info.params_info[param_index];
+
+	out_param_info->component      = param_inf->component;
+	out_param_info->type           = (params_type_e)param_inf->type;
+	out_param_info->security_level = param_inf->security_level;
+	out_param_info->name           = (const char*)param_inf->name;
+	out_param_info->has_minmax     = param_inf->flags & param_info_t::HAS_MINMAX;
+
+	if (!l_param_is_variable_size(param_inf)) {
+		param_error_t e = l_params_copy_defminmax_or_default(param_inf, &out_param_info->param_u8);
+		assert(e == param_error_t::SUCCESS);
+	} else {
+		// the default is only read within defaults_str, a broken defaults_index or len is FAIL.
+		u32 offset = param_inf->defaults_index;
+		switch (out_param_info->type) {
+		case params_type_e::STR:
+			if (offset + 2 > PARAMS_DEFAULTS_STR_LEN_BYTES ||
+			    offset + 2 + defaults_str[offset + 1] > PARAMS_DEFAULTS_STR_LEN_BYTES)
+				return param_error_t::FAIL;
+			out_param_info->param_str.max_len = defaults_str[offset];
+			out_param_info->param_str.len = defaults_str[offset + 1];
+			out_param_info->param_str.ptr = &defaults_str[offset + 2];
+			break;
+		case params_type_e::STR16:
+		case params_type_e::BUF:
+			if (offset + 4 > PARAMS_DEFAULTS_STR_LEN_BYTES ||
+			    offset + 4 + (defaults_str[offset + 2] | defaults_str[offset + 3] << 8) > PARAMS_DEFAULTS_STR_LEN_BYTES)
+				return param_error_t::FAIL;
+			out_param_info->param_buf.max_len = l_arena_max_len(&params_hot[param_index]);
+			out_param_info->param_buf.ptr =
+				(u8*)l_arena_default(&params_hot[param_index], &out_param_info->param_buf.len);
+			break;
+		default:
+			return param_error_t::NO_PARAM;
+		}
+	}
+
+	return param_error_t::SUCCESS;
+}
+
+param_index_t params_find(const char* name, u8 len) {
+	if (len == 0 || len >= sizeof(param_info_t::name))
+		return 0;
+	param_index_t param_index = paramsys_name_hash_candidate(params_name_hash_disp, PARAMS_NAME_HASH_BUCKETS,
+	                                                         params_name_hash_slots, PARAMS_NAME_HASH_SLOTS,
+	                                                         name, len);
+	const param_info_t* param_inf = &params_info.params_info[param_index];
+	if (param_index == 0 || param_inf->flags & param_info_t::DISABLED ||
+	    memcmp(param_inf->name, name, len) != 0 || param_inf->name[len] != 0)
+		return 0;
+	return param_index;
+}
+
+void params_print_all() {
+	l_params_print_all(&params_info);
+}
+
+param_error_t params_get(param_index_t param_index, params_type_e param_type, void* out_value) {
+	return params_ctx_get(&l_ctx_default, param_index, param_type, out_value);
+}
+
+param_error_t params_set(param_index_t param_index, params_type_e param_type, void* valueptr) {
+	return params_ctx_set(&l_ctx_default, param_index, param_type, valueptr);
+}
+
+param_error_t params_ctx_get(paramsys_ctx_t* ctx, param_index_t param_index, params_type_e param_type, void* out_value) {
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	if (hot->type != (u8)param_type || hot->flags & param_info_t::DISABLED)
+		return param_error_t::NO_PARAM;
+	if (l_hot_is_variable_size(hot))
+		return param_error_t::FAIL;
+	paramsys_instrument_read(param_index);
+
+	u8 size_class = l_hot_size_class(hot);
+	const u8* src = l_hot_get_value_ptr(ctx, hot);
+	u32 s;
+	do {
+		s = l_seq_read_begin(ctx, size_class);
+		l_hot_copy_value(size_class, out_value, src);
+	} while (l_seq_read_retry(ctx, size_class, s));
+	return param_error_t::SUCCESS;
+}
+
+param_error_t params_ctx_set(paramsys_ctx_t* ctx, param_index_t param_index, params_type_e param_type, void* valueptr) {
+	u64 start = paramsys_instrument_start();
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	if (ctx->readonly)
+		return param_error_t::FAIL;
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	if (hot->type != (u8)param_type || hot->flags & param_info_t::DISABLED)
+		return param_error_t::NO_PARAM;
+	if (l_hot_is_variable_size(hot))
+		return param_error_t::FAIL; // params_set_str
+	paramsys_instrument_write(param_index);
+
+	u8 size_class = l_hot_size_class(hot);
+	l_params_write_begin_mask(ctx, 1 << size_class);
+	bool changed = l_params_write_value(ctx, hot, valueptr);
+	l_params_write_end_mask(ctx, 1 << size_class);
+
+	if (changed)
+		l_params_ctx_on_value_changed(ctx, param_index);
+
+	paramsys_instrument_set_done(start);
+	return param_error_t::SUCCESS;
+}
+
+void params_on_value_changed(param_index_t param_index) {
+	l_params_mark_changed(param_index);
+
+	// a param of the active profile: the new value is the profile's now, the base value under it stays.
+	if (l_profiles_capture(param_index))
+		return;
+
+	if (l_store) {
+#ifdef PARAMS_CONCURRENT
+		std::lock_guard<std::mutex> lock(l_store_mutex);
+#endif
+		u64 start = paramsys_instrument_start();
+		l_params_store_append(param_index);
+		l_params_store_maybe_compact();
+		paramsys_instrument_store_done(start);
+	}
+}
+
+#ifdef PARAMS_CONCURRENT
+void params_seq_write_begin(u8 size_class) {
+	l_params_write_begin_mask(&l_ctx_default, 1 << size_class);
+}
+
+void params_seq_write_end(u8 size_class) {
+	l_params_write_end_mask(&l_ctx_default, 1 << size_class);
+}
+#endif
+
+param_error_t params_set_many(param_value_t* items, u32 count) {
+	return params_ctx_set_many(&l_ctx_default, items, count);
+}
+
+param_error_t params_get_many(param_value_t* items, u32 count) {
+	return params_ctx_get_many(&l_ctx_default, items, count);
+}
+
+// Publish the changes of a batch (params_set_many, transactions) after its write section: change tracking per param,
+// one store write for the whole batch. changed_index(i) is the param index of item i, PARAMS_NO_INDEX if its value
+// didn't change.
+template <typename F>
+void l_params_batch_changed(paramsys_ctx_t* ctx, u32 count, F changed_index) {
+	if (ctx != &l_ctx_default) {
+		for (u32 i = 0; i < count; i++)
+			if (changed_index(i) != PARAMS_NO_INDEX)
+				l_params_ctx_on_value_changed(ctx, changed_index(i));
+		return;
+	}
+
+	// one notification and one store write for the whole batch.
+	bool overridden = false;
+	for (u32 i = 0; i < count; i++) {
+		if (changed_index(i) == PARAMS_NO_INDEX)
+			continue;
+		l_params_mark_changed(changed_index(i));
+		overridden |= l_profiles_capture(changed_index(i));
+	}
+
+	if (l_store) {
+#ifdef PARAMS_CONCURRENT
+		std::lock_guard<std::mutex> lock(l_store_mutex);
+#endif
+		u64 start = paramsys_instrument_start();
+		if (l_store->batch_begin) l_store->batch_begin(l_store);
+		for (u32 i = 0; i < count; i++) {
+			param_index_t param_index = changed_index(i);
+			if (param_index == PARAMS_NO_INDEX)
+				continue;
+			if (!(overridden && __atomic_load_n(&l_profile_source[param_index], __ATOMIC_RELAXED)))
+				l_params_store_append(param_index);
+		}
+		if (l_store->batch_end) l_store->batch_end(l_store);
+		l_params_store_maybe_compact();
+		paramsys_instrument_store_done(start);
+	}
+}
+
+param_error_t params_ctx_set_many(paramsys_ctx_t* ctx, param_value_t* items, u32 count) {
+	u64 start = paramsys_instrument_start();
+	if (ctx->readonly)
+		return param_error_t::FAIL;
+
+	// validate everything before touching anything. a batch is applied completely or not at all.
+	u32 size_class_mask = 0;
+	u32 arena_bytes = 0;
+	for (u32 i = 0; i < count; i++) {
+		if (items[i].param_index >= PARAMS_COUNT)
+			return param_error_t::NO_PARAM;
+		const paramsys_hot_t* hot = &params_hot[items[i].param_index];
+		if (hot->type != (u8)items[i].param_type || hot->flags & param_info_t::DISABLED)
+			return param_error_t::NO_PARAM;
+		size_class_mask |= 1 << l_hot_size_class(hot);
+		if (paramsys_type_is_arena(hot->type))
+			arena_bytes += items[i].bytes_val.len < l_arena_max_len(hot) ? items[i].bytes_val.len : l_arena_max_len(hot);
+	}
+
+	// params with more than one item: only the last item reports changed, by comparing the value after the batch with
+	// the one before it. they are found by sorting the item order by param index, their old values go to old_values.
+	u32 order_local[64];
+	u32* order = count <= ELEMENTS_IN_ARRAY(order_local) ? order_local : (u32*)malloc(count * sizeof(u32));
+	if (!order)
+		return param_error_t::FAIL;
+	for (u32 i = 0; i < count; i++)
+		order[i] = i;
+	std::sort(order, order + count, [items](u32 a, u32 b) {
+		return items[a].param_index != items[b].param_index ? items[a].param_index < items[b].param_index : a < b;
+	});
+	u32 old_values_len = 0;
+	for (u32 k = 1; k < count; k++)
+		if (items[order[k]].param_index == items[order[k - 1]].param_index &&
+		    (k == 1 || items[order[k - 2]].param_index != items[order[k]].param_index))
+			old_values_len += l_value_max_len(ctx, &params_hot[items[order[k]].param_index]);
+	u8* old_values = old_values_len ? (u8*)malloc(old_values_len) : nullptr;
+	if (old_values_len && !old_values) {
+		if (order != order_local)
+			free(order);
+		return param_error_t::FAIL;
+	}
+
+	// STR16/BUF values that don't fit into the free end of the arena need compactions, and the arena lock for the
+	// whole batch. without it, a view taken halfway could make a later item fail.
+	l_params_write_begin_mask(ctx, size_class_mask);
+	bool arena_locked = false;
+	if (arena_bytes && arena_bytes > l_arena(ctx)->capacity - l_arena(ctx)->used) {
+		if (!l_arena_lock(ctx)) {
+			l_params_write_end_mask(ctx, size_class_mask);
+			free(old_values);
+			if (order != order_local)
+				free(order);
+			return param_error_t::FAIL;
+		}
+		arena_locked = true;
+	}
+
+	u32 pos = 0;
+	for (u32 k = 1; old_values && k < count; k++) {
+		if (items[order[k]].param_index == items[order[k - 1]].param_index &&
+		    (k == 1 || items[order[k - 2]].param_index != items[order[k]].param_index)) {
+			const paramsys_hot_t* hot = &params_hot[items[order[k]].param_index];
+			l_value_save(ctx, hot, old_values + pos);
+			pos += l_value_max_len(ctx, hot);
+		}
+	}
+
+	// commit. one size class per pass, so every pass reads and writes only one params_values_* array and clamps only
+	// against the matching defminmax_* array. items of the same param are applied in order, the last one wins.
+	for (u8 size_class = 0; size_class < PARAMS_SIZE_CLASS_COUNT; size_class++) {
+		if (!(size_class_mask & (1 << size_class)))
+			continue;
+		for (u32 i = 0; i < count; i++) {
+			const paramsys_hot_t* hot = &params_hot[items[i].param_index];
+			if (l_hot_size_class(hot) != size_class)
+				continue;
+			if (paramsys_type_is_arena(hot->type))
+				l_arena_set(ctx, hot, items[i].bytes_val.ptr, items[i].bytes_val.len, arena_locked, &items[i].changed);
+			else if (size_class == PARAMS_SIZE_CLASS_STR)
+				items[i].changed = l_params_set_str(ctx, hot, items[i].str_val.ptr, items[i].str_val.len);
+			else
+				items[i].changed = l_params_write_value(ctx, hot, &items[i].u8_val);
+		}
+	}
+
+	// groups of items of one param, in the same order as old_values was filled.
+	pos = 0;
+	for (u32 k = 0; old_values && k < count;) {
+		u32 end = k + 1;
+		while (end < count && items[order[end]].param_index == items[order[k]].param_index)
+			end++;
+		if (end - k > 1) {
+			const paramsys_hot_t* hot = &params_hot[items[order[k]].param_index];
+			for (u32 j = k; j < end; j++)
+				items[order[j]].changed = false;
+			items[order[end - 1]].changed = !l_value_equal(ctx, hot, old_values + pos);
+			pos += l_value_max_len(ctx, hot);
+		}
+		k = end;
+	}
+	free(old_values);
+	if (order != order_local)
+		free(order);
+
+	if (arena_locked)
+		l_arena_unlock(ctx);
+	l_params_write_end_mask(ctx, size_class_mask);
+
+	l_params_batch_changed(ctx, count, [items](u32 i) -> param_index_t {
+		return items[i].changed ? items[i].param_index : PARAMS_NO_INDEX;
+	});
+	for (u32 i = 0; i < count; i++)
+		paramsys_instrument_write(items[i].param_index);
+	paramsys_instrument_set_done(start);
+	return param_error_t::SUCCESS;
+}
+
+param_error_t params_ctx_get_many(paramsys_ctx_t* ctx, param_value_t* items, u32 count) {
+	u32 size_class_mask = 0;
+	for (u32 i = 0; i < count; i++) {
+		if (items[i].param_index >= PARAMS_COUNT)
+			return param_error_t::NO_PARAM;
+		const paramsys_hot_t* hot = &params_hot[items[i].param_index];
+		if (hot->type != (u8)items[i].param_type || paramsys_type_is_arena(hot->type) ||
+		    hot->flags & param_info_t::DISABLED)
+			return param_error_t::NO_PARAM; // params_get_view
+		size_class_mask |= 1 << l_hot_size_class(hot);
+	}
+
+	// one read section over all the involved size classes, so the values are consistent with each other.
+	u32 s[PARAMS_SIZE_CLASS_COUNT];
+	bool retry;
+	do {
+		for (u8 c = 0; c < PARAMS_SIZE_CLASS_COUNT; c++)
+			if (size_class_mask & (1 << c))
+				s[c] = l_seq_read_begin(ctx, c);
+
+		for (u32 i = 0; i < count; i++) {
+			const paramsys_hot_t* hot = &params_hot[items[i].param_index];
+			const u8* src = l_hot_get_value_ptr(ctx, hot);
+			if (!l_hot_is_variable_size(hot)) {
+				l_hot_copy_value(l_hot_size_class(hot), &items[i].u8_val, src);
+			} else {
+				items[i].str_val.ptr = (const char*)src + 2;
+				items[i].str_val.len = src[1];
+			}
+		}
+
+		retry = false;
+		for (u8 c = 0; c < PARAMS_SIZE_CLASS_COUNT; c++)
+			if (size_class_mask & (1 << c))
+				retry |= l_seq_read_retry(ctx, c, s[c]);
+	} while (retry);
+
+	for (u32 i = 0; i < count; i++)
+		paramsys_instrument_read(items[i].param_index);
+	return param_error_t::SUCCESS;
+}
+
+void params_txn_begin(params_txn_t* txn) {
+	params_ctx_txn_begin(&l_ctx_default, txn);
+}
+
+void params_ctx_txn_begin(paramsys_ctx_t* ctx, params_txn_t* txn) {
+	txn->ctx = ctx;
+	params_txn_abort(txn);
+}
+
+param_error_t params_txn_set(params_txn_t* txn, param_index_t param_index, params_type_e param_type, const void* valueptr) {
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	if (hot->type != (u8)param_type || hot->flags & param_info_t::DISABLED)
+		return param_error_t::NO_PARAM;
+	if (l_hot_is_variable_size(hot))
+		return param_error_t::FAIL; // params_txn_set_str
+
+	u32 len = l_hot_len_bytes(hot);
+	conv_t val;
+	memcpy(&val, valueptr, len);
+	if (hot->flags & param_info_t::HAS_MINMAX)
+		l_params_apply_limits(hot, &val);
+	u8* slot = l_txn_stage(txn, param_index, len);
+	if (!slot)
+		return param_error_t::FAIL;
+	memcpy(slot, &val, len);
+	return param_error_t::SUCCESS;
+}
+
+param_error_t params_txn_set_str(params_txn_t* txn, param_index_t param_index, const char* str, u8 str_len) {
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	if (hot->type != (u8)params_type_e::STR || hot->flags & param_info_t::DISABLED)
+		return param_error_t::NO_PARAM;
+
+	u8 max_len = params_info.defaults_str[hot->defaults_index];
+	u8* slot = l_txn_stage(txn, param_index, 2 + max_len);
+	if (!slot)
+		return param_error_t::FAIL;
+	if (str_len > max_len) str_len = max_len;
+	slot[0] = max_len;
+	slot[1] = str_len;
+	memcpy(slot + 2, str, str_len);
+	return param_error_t::SUCCESS;
+}
+
+param_error_t params_txn_get(params_txn_t* txn, param_index_t param_index, params_type_e param_type, void* out_value) {
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	const u8* slot = l_txn_find(txn, param_index);
+	if (!slot || hot->type != (u8)param_type || l_hot_is_variable_size(hot))
+		return params_ctx_get(txn->ctx, param_index, param_type, out_value);
+	memcpy(out_value, slot, l_hot_len_bytes(hot));
+	return param_error_t::SUCCESS;
+}
+
+param_error_t params_txn_get_str(params_txn_t* txn, param_index_t param_index, const char** out_str, u8* out_str_len) {
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	const u8* slot = l_txn_find(txn, param_index);
+	if (!slot || params_hot[param_index].type != (u8)params_type_e::STR)
+		return params_ctx_get_str(txn->ctx, param_index, out_str, out_str_len);
+	*out_str = (const char*)slot + 2;
+	*out_str_len = slot[1];
+	return param_error_t::SUCCESS;
+}
+
+param_error_t params_txn_commit(params_txn_t* txn, params_txn_validator_t validator, void* user) {
+	paramsys_ctx_t* ctx = txn->ctx;
+	// the validator runs outside the write section, it may want to params_get the params that aren't staged.
+	if (txn->overflow || ctx->readonly || (validator && !validator(txn, user))) {
+		params_txn_abort(txn);
+		return param_error_t::FAIL;
+	}
+
+	// staged values are clamped already, only copy the ones that differ.
+	bool changed[PARAMS_TXN_MAX_PARAMS];
+	l_params_write_begin_mask(ctx, txn->size_class_mask);
+	for (u32 i = 0; i < txn->count; i++) {
+		const paramsys_hot_t* hot = &params_hot[txn->entries[i].param_index];
+		const u8* slot = txn->arena + txn->entries[i].pos;
+		if (l_hot_is_variable_size(hot)) {
+			changed[i] = l_params_set_str(ctx, hot, (const char*)slot + 2, slot[1]);
+			continue;
+		}
+		u8* dst = l_hot_get_value_ptr(ctx, hot);
+		u32 len = l_hot_len_bytes(hot);
+		changed[i] = !l_slot_equal(hot, dst, slot, len);
+		if (changed[i])
+			l_slot_copy(dst, slot, len);
+	}
+	l_params_write_end_mask(ctx, txn->size_class_mask);
+
+	l_params_batch_changed(ctx, txn->count, [txn, &changed](u32 i) -> param_index_t {
+		return changed[i] ? txn->entries[i].param_index : PARAMS_NO_INDEX;
+	});
+	params_txn_abort(txn);
+	return param_error_t::SUCCESS;
+}
+
+void params_txn_abort(params_txn_t* txn) {
+	txn->size_class_mask = 0;
+	txn->count = 0;
+	txn->arena_used = 0;
+	txn->overflow = false;
+}
+
+u32 params_history_len(param_index_t param_index) {
+	if (param_index >= PARAMS_COUNT || params_history_ring_of[param_index] == PARAMS_NO_INDEX)
+		return 0;
+	return params_history_rings[params_history_ring_of[param_index]].len;
+}
+
+u32 params_history_since(param_index_t param_index, i64 since_us, params_history_entry_t* out, u32 max_count) {
+	if (param_index >= PARAMS_COUNT || params_history_ring_of[param_index] == PARAMS_NO_INDEX)
+		return 0;
+	param_index_t r = params_history_ring_of[param_index];
+	const paramsys_history_ring_t* ring = &params_history_rings[r];
+
+	// newest first, then reversed.
+	u64 head = __atomic_load_n(&l_history_head[r], __ATOMIC_ACQUIRE);
+	u32 count = 0;
+	for (u64 n = head; n > 0 && head - n < ring->len && count < max_count; n--) {
+		const l_history_entry_t* e = &l_history_entries[ring->first_entry + (n - 1) % ring->len];
+		u64 done = 2 * n;
+		u64 seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+		if (seq < done)
+			continue; // write n-1 hasn't finished yet
+		if (seq != done)
+			break;    // overwritten, and so is everything older
+		params_history_entry_t entry;
+		entry.timestamp_us = __atomic_load_n(&e->timestamp_us, __ATOMIC_RELAXED);
+		memcpy(entry.value, e->value, sizeof(entry.value));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != done || entry.timestamp_us < since_us)
+			break;
+		out[count++] = entry;
+	}
+	for (u32 i = 0; i < count / 2; i++) {
+		params_history_entry_t t = out[i];
+		out[i] = out[count - 1 - i];
+		out[count - 1 - i] = t;
+	}
+	return count;
+}
+
+void params_history_print(param_index_t param_index, i64 since_us) {
+	u32 len = params_history_len(param_index);
+	params_history_entry_t* entries = len ? (params_history_entry_t*)malloc(len * sizeof(params_history_entry_t)) : nullptr;
+	if (!entries)
+		return;
+	u32 count = params_history_since(param_index, since_us, entries, len);
+	params_type_e type = (params_type_e)params_hot[param_index].type;
+
+	printf("history of %s, %u values\n", params_info.params_info[param_index].name, count);
+	for (u32 i = 0; i < count; i++) {
+		char time_str[32];
+		char value_str[48];
+		conv_t val;
+		memcpy(&val, entries[i].value, sizeof(entries[i].value));
+		g_timestamp_us_to_iso8601(entries[i].timestamp_us, time_str, sizeof(time_str));
+		switch (type) {
+			case params_type_e::I8:  snprintf(value_str, sizeof(value_str), "%" PRIi64, (i64)val.i8_0); break;
+			case params_type_e::I16: snprintf(value_str, sizeof(value_str), "%" PRIi64, (i64)val.i16_0); break;
+			case params_type_e::I32: snprintf(value_str, sizeof(value_str), "%" PRIi64, (i64)val.i32_0); break;
+			case params_type_e::I64: snprintf(value_str, sizeof(value_str), "%" PRIi64, val.i64_0); break;
+			case params_type_e::F32: snprintf(value_str, sizeof(value_str), "%f", (f64)val.f32_0); break;
+			case params_type_e::F64: snprintf(value_str, sizeof(value_str), "%f", val.f64_0); break;
+			case params_type_e::TIME_UNIX_US64:
+			case params_type_e::TIME_ATOMIC_US64:
+				g_timestamp_us_to_iso8601(val.i64_0, value_str, sizeof(value_str));
+				break;
+			case params_type_e::UUID128:
+				g_uuid_bin_to_str_canonical(val.u8v, value_str, sizeof(value_str));
+				break;
+			default: { // unsigned and flags
+				u64 v = 0;
+				memcpy(&v, entries[i].value, paramsys_type_len(type));
+				snprintf(value_str, sizeof(value_str), "%" PRIu64, v);
+			}
+		}
+		printf("    %s %s\n", time_str, value_str);
+	}
+	free(entries);
+}
+
+void params_history_set_clock(i64 (*now_us)()) {
+	l_history_now_us = now_us ? now_us : l_history_clock_realtime;
+}
+
+u32 params_validate_all(param_index_t* out_param_indices, u32 max_count) {
+	return l_params_validate_all(&l_ctx_default, out_param_indices, max_count, true);
+}
+
+u32 params_ctx_validate_all(paramsys_ctx_t* ctx, param_index_t* out_param_indices, u32 max_count) {
+	return l_params_validate_all(ctx, out_param_indices, max_count, true);
+}
+
+// Bitmap words for the biggest fixed-size class.
+#define L_MAX(a, b) ((a) > (b) ? (a) : (b))
+#define L_VALIDATE_BITMAP_WORDS ((L_MAX(L_MAX(PARAMS_COUNT_8, PARAMS_COUNT_16), L_MAX(PARAMS_COUNT_32, PARAMS_COUNT_64)) + 63) / 64)
+
+// Vector scan of every size class, then the few values out of range get fixed one by one through the normal write
+// path. The scan reads without the seqlock, a torn read just sends a good value to the fixup, which checks again.
+u32 l_params_validate_all(paramsys_ctx_t* ctx, param_index_t* out_param_indices, u32 max_count, bool notify) {
+	if (ctx->readonly)
+		return 0;
+
+	const paramsys_valuemem_t* mem = ctx->valuemem;
+	struct { u8 size_class; const void* values; const void* limits; const param_index_t* owner; u32 count; } classes[] = {
+		{PARAMS_SIZE_CLASS_8,  (u8*)mem + mem->offsetof_8(),  params_limits_8,  params_limits_owner_8,  PARAMS_COUNT_8},
+		{PARAMS_SIZE_CLASS_16, (u8*)mem + mem->offsetof_16(), params_limits_16, params_limits_owner_16, PARAMS_COUNT_16},
+		{PARAMS_SIZE_CLASS_32, (u8*)mem + mem->offsetof_32(), params_limits_32, params_limits_owner_32, PARAMS_COUNT_32},
+		{PARAMS_SIZE_CLASS_64, (u8*)mem + mem->offsetof_64(), params_limits_64, params_limits_owner_64, PARAMS_COUNT_64},
+	};
+	u64 bad[L_VALIDATE_BITMAP_WORDS + 1];
+	u32 fixed = 0;
+
+	for (auto& c : classes) {
+		if (!c.count)
+			continue;
+		paramsys_scan_limits(c.size_class, c.values, c.limits, c.count, bad);
+
+		for (u32 w = 0; w < (c.count + 63) / 64; w++) {
+			while (bad[w]) {
+				u32 value_index = w * 64 + __builtin_ctzll(bad[w]);
+				bad[w] &= bad[w] - 1;
+				param_index_t param_index = c.owner[value_index];
+				const paramsys_hot_t* hot = &params_hot[param_index];
+				u8* ptr = l_hot_get_value_ptr(ctx, hot);
+
+				bool changed;
+				l_params_write_begin_mask(ctx, 1 << c.size_class);
+				if (hot->type == (u8)params_type_e::F32 && !isfinite(*(f32*)ptr)) {
+					changed = l_params_copy_default(&params_info.params_info[param_index], ptr) == param_error_t::SUCCESS;
+				} else if (hot->type == (u8)params_type_e::F64 && !isfinite(*(f64*)ptr)) {
+					changed = l_params_copy_default(&params_info.params_info[param_index], ptr) == param_error_t::SUCCESS;
+				} else {
+					// clamps a copy and writes it back only if it differs. no-op for params without limits.
+					changed = hot->flags & param_info_t::HAS_MINMAX && l_params_write_value(ctx, hot, ptr);
+				}
+				l_params_write_end_mask(ctx, 1 << c.size_class);
+
+				if (!changed)
+					continue;
+				if (fixed < max_count)
+					out_param_indices[fixed] = param_index;
+				fixed++;
+				if (notify)
+					l_params_ctx_on_value_changed(ctx, param_index);
+			}
+		}
+	}
+	return l_arena_validate(ctx, out_param_indices, max_count, fixed, notify);
+}
+
+// Bulk copy of params_defaults_image over the values, all of it or the runs of one component, under the write lock of
+// every size class. The params that actually change are found under the same lock and marked after it.
+param_error_t l_params_reset_to_defaults(paramsys_ctx_t* ctx, bool by_component, u8 component) {
+	if (ctx->readonly)
+		return param_error_t::FAIL;
+
+	const paramsys_component_range_t* first = params_component_ranges;
+	const paramsys_component_range_t* last = params_component_ranges + PARAMS_COMPONENT_RANGES_COUNT;
+	if (by_component) {
+		while (first != last && first->component != component) first++;
+		const paramsys_component_range_t* end = first;
+		while (end != last && end->component == component) end++;
+		if (first == end)
+			return param_error_t::NO_PARAM;
+		last = end;
+	}
+
+	// the default instance with an active profile: the base values under the overrides are reset, the overrides stay
+	// and so do the values the overridden params show. taken before the write lock, like everywhere else.
+	const l_profile_t* profile = nullptr;
+	bool base_changed = false;
+#ifdef PARAMS_CONCURRENT
+	std::unique_lock<std::mutex> profiles_lock(l_profiles_mutex, std::defer_lock);
+	if (ctx == &l_ctx_default)
+		profiles_lock.lock();
+#endif
+	if (ctx == &l_ctx_default && l_profile_active)
+		profile = &l_profiles[l_profile_active];
+
+	l_param_bitmap_t changed = {};
+	u32 arena_bytes = 0;
+	bool arena_differs = false;
+	l_params_write_begin_mask(ctx, (1 << PARAMS_SIZE_CLASS_COUNT) - 1);
+
+	for (u32 i = 0; i < PARAMS_COUNT; i++) {
+		if (by_component && params_info.params_info[i].component != component)
+			continue;
+		const paramsys_hot_t* hot = &params_hot[i];
+		const u8* value = l_hot_get_value_ptr(ctx, hot);
+		const u8* def = params_defaults_image + hot->value_offset;
+		bool differs;
+		if (profile && l_profile_source[i]) {
+			const l_override_t* e = l_profile_find_entry((l_profile_t*)profile, i);
+			base_changed |= !l_slot_equal(hot, profile->data + e->pos + e->len, def, e->len);
+			continue;
+		} else if (paramsys_type_is_arena(hot->type)) {
+			u16 def_len;
+			const u8* def_bytes = l_arena_default(hot, &def_len);
+			const paramsys_arena_ref_t* ref = l_arena_ref(ctx, hot);
+			differs = ref->len != def_len || memcmp(l_arena_bytes(ctx) + ref->offset, def_bytes, def_len) != 0;
+			if (differs)
+				arena_bytes += def_len;
+			arena_differs |= differs;
+		} else if (l_hot_is_variable_size(hot)) {
+			differs = value[1] != def[1] || memcmp(value + 2, def + 2, def[1]) != 0;
+		} else {
+			differs = memcmp(value, def, l_hot_len_bytes(hot)) != 0;
+		}
+		if (differs)
+			l_bitmap_mark(&changed, i);
+	}
+
+	// STR16/BUF defaults go through the arena like any set. like in params_set_many, if they need a compaction the
+	// arena has to be locked for all of them, or nothing is reset.
+	bool arena_locked = false;
+	if (arena_bytes && arena_bytes > l_arena(ctx)->capacity - l_arena(ctx)->used) {
+		if (!l_arena_lock(ctx)) {
+			l_params_write_end_mask(ctx, (1 << PARAMS_SIZE_CLASS_COUNT) - 1);
+			return param_error_t::FAIL;
+		}
+		arena_locked = true;
+	}
+
+	// the component runs don't cover the arena refs. neither does this copy.
+	if (by_component) {
+		for (const paramsys_component_range_t* r = first; r != last; r++)
+			memcpy(ctx->values + r->offset, params_defaults_image + r->offset, r->len);
+	} else {
+		memcpy(ctx->values, params_defaults_image, PARAMS_ARENA_REFS_OFFSET);
+	}
+	for (u32 i = 0; arena_differs && i < PARAMS_COUNT_ARENA; i++) {
+		param_index_t param_index = params_arena_params[i];
+		if (by_component && params_info.params_info[param_index].component != component)
+			continue;
+		u16 def_len;
+		const u8* def_bytes = l_arena_default(&params_hot[param_index], &def_len);
+		bool unused;
+		l_arena_set(ctx, &params_hot[param_index], def_bytes, def_len, arena_locked, &unused);
+	}
+	if (arena_locked)
+		l_arena_unlock(ctx);
+
+	// the defaults are the new base values of the overridden params, the overrides go back over them.
+	for (u32 i = 0; profile && i < profile->count; i++) {
+		const l_override_t* e = &profile->entries[i];
+		if (by_component && params_info.params_info[e->param_index].component != component)
+			continue;
+		u8* slot = ctx->values + params_hot[e->param_index].value_offset;
+		l_slot_copy(profile->data + e->pos + e->len, slot, e->len);
+		l_slot_copy(slot, profile->data + e->pos, e->len);
+	}
+
+	l_params_write_end_mask(ctx, (1 << PARAMS_SIZE_CLASS_COUNT) - 1);
+#ifdef PARAMS_CONCURRENT
+	if (profiles_lock.owns_lock())
+		profiles_lock.unlock();
+#endif
+
+	// the journal would get the override values of these params, a snapshot gets their base values.
+	if (base_changed && l_store)
+		params_store_compact();
+
+	param_index_t indices[256];
+	while (u32 count = l_bitmap_take(&changed, indices, ELEMENTS_IN_ARRAY(indices)))
+		for (u32 i = 0; i < count; i++)
+			l_params_ctx_on_value_changed(ctx, indices[i]);
+	return param_error_t::SUCCESS;
+}
+
+u32 params_take_changed(param_index_t* out_param_indices, u32 max_count) {
+	return params_ctx_take_changed(&l_ctx_default, out_param_indices, max_count);
+}
+
+bool params_is_changed(param_index_t param_index) {
+	return params_ctx_is_changed(&l_ctx_default, param_index);
+}
+
+u32 params_ctx_take_changed(paramsys_ctx_t* ctx, param_index_t* out_param_indices, u32 max_count) {
+	return l_bitmap_take(&ctx->dirty, out_param_indices, max_count);
+}
+
+void paramsys_put_back_changed(paramsys_ctx_t* ctx, const param_index_t* param_indices, u32 count) {
+	for (u32 i = 0; i < count; i++)
+		if (param_indices[i] < PARAMS_COUNT)
+			l_bitmap_mark(&ctx->dirty, param_indices[i]);
+}
+
+bool params_ctx_is_changed(paramsys_ctx_t* ctx, param_index_t param_index) {
+	if (param_index >= PARAMS_COUNT)
+		return false;
+	return __atomic_load_n(&ctx->dirty.words[param_index / 64], __ATOMIC_RELAXED) & ((u64)1 << (param_index % 64));
+}
+
+int params_subscribe(param_index_t param_index, params_change_cb_t cb, void* user) {
+	return params_subscribe_range(param_index, param_index, cb, user);
+}
+
+int params_subscribe_range(param_index_t first_param_index, param_index_t last_param_index, params_change_cb_t cb, void* user) {
+	if (!cb || first_param_index > last_param_index || last_param_index >= PARAMS_COUNT)
+		return -1;
+	l_subscription_t sub = {cb, user, first_param_index, last_param_index, 0, false};
+	return l_params_subscribe(&sub);
+}
+
+int params_subscribe_component(u8 component, params_change_cb_t cb, void* user) {
+	if (!cb)
+		return -1;
+	l_subscription_t sub = {cb, user, 0, PARAMS_COUNT - 1, component, true};
+	return l_params_subscribe(&sub);
+}
+
+void params_unsubscribe(int subscription_id) {
+	if (subscription_id < 0 || subscription_id >= PARAMS_MAX_SUBSCRIPTIONS)
+		return;
+#ifdef PARAMS_CONCURRENT
+	std::lock_guard<std::mutex> lock(l_subscriptions_mutex);
+#endif
+	if (!l_subscriptions[subscription_id].cb)
+		return;
+	l_subscriptions[subscription_id].cb = nullptr;
+	__atomic_fetch_sub(&l_subscription_count, 1, __ATOMIC_RELAXED);
+}
+
+u32 params_dispatch() {
+	if (!__atomic_load_n(&l_subscription_count, __ATOMIC_RELAXED))
+		return 0;
+#ifdef PARAMS_CONCURRENT
+	std::lock_guard<std::mutex> lock(l_subscriptions_mutex);
+#endif
+	u32 calls = 0;
+	param_index_t pending[64];
+	// at most one pass over the bitmap. params that change again meanwhile are left for the next call, so a
+	// constantly changing param can't keep us here forever.
+	for (u32 round = 0; round < L_BITMAP_WORDS; round++) {
+		u32 count = l_bitmap_take(&l_pending, pending, ELEMENTS_IN_ARRAY(pending));
+		for (u32 i = 0; i < count; i++) {
+			param_index_t param_index = pending[i];
+			u8 component = params_info.params_info[param_index].component;
+			for (u32 k = 0; k < PARAMS_MAX_SUBSCRIPTIONS; k++) {
+				l_subscription_t* sub = &l_subscriptions[k];
+				if (!sub->cb || param_index < sub->first_param_index || param_index > sub->last_param_index ||
+				    (sub->by_component && sub->component != component))
+					continue;
+				sub->cb(param_index, sub->user);
+				calls++;
+			}
+		}
+		if (count < ELEMENTS_IN_ARRAY(pending))
+			break;
+	}
+	return calls;
+}
+
+u64 params_version() {
+	return __atomic_load_n(&l_version, __ATOMIC_ACQUIRE);
+}
+
+u64 params_epoch() {
+	// time alone repeats if the process restarts within a second. the address of a global varies with aslr.
+	u64 epoch = __atomic_load_n(&l_epoch, __ATOMIC_RELAXED);
+	if (!epoch) {
+		epoch = ((u64)time(nullptr) << 20) ^ (u64)(uintptr_t)&l_epoch ^ (u64)clock();
+		if (!epoch) epoch = 1;
+		u64 expected = 0;
+		if (!__atomic_compare_exchange_n(&l_epoch, &expected, epoch, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			epoch = expected;
+	}
+	return epoch;
+}
+
+u32 params_sync_snapshot(u8* out, u32 out_max) {
+	u32 image_len = offsetof(paramsys_valuemem_t, values) + params_valuemem->values_bytes_used;
+	if (sizeof(l_sync_header_t) + image_len > out_max)
+		return 0;
+
+	l_sync_header_t h = {L_SYNC_SNAPSHOT, params_epoch(), 0, params_version()};
+	memcpy(out, &h, sizeof(h));
+
+	// one read section over the whole image.
+	u32 s[PARAMS_SIZE_CLASS_COUNT];
+	bool retry;
+	do {
+		for (u8 c = 0; c < PARAMS_SIZE_CLASS_COUNT; c++)
+			s[c] = params_seq_read_begin(c);
+		memcpy(out + sizeof(h), params_valuemem, image_len);
+		retry = false;
+		for (u8 c = 0; c < PARAMS_SIZE_CLASS_COUNT; c++)
+			retry |= params_seq_read_retry(c, s[c]);
+	} while (retry);
+
+	return sizeof(h) + image_len;
+}
+
+param_error_t params_sync_delta(u64 since_version, u8* out, u32 out_max, u32* out_len) {
+	u64 version = params_version();
+	if (since_version > version || version - since_version > PARAMS_CHANGE_LOG_SIZE)
+		return param_error_t::FAIL;
+	if (out_max < sizeof(l_sync_header_t))
+		return param_error_t::FAIL;
+
+	// every param once, even if it changed many times since since_version.
+	u64 seen[L_BITMAP_WORDS] = {};
+	u32 pos = sizeof(l_sync_header_t);
+	u64 upto = since_version;
+	for (u64 v = since_version + 1; v <= version; v++) {
+		u64 entry = __atomic_load_n(&l_change_log[v % PARAMS_CHANGE_LOG_SIZE], __ATOMIC_ACQUIRE);
+		if (entry >> L_CHANGE_LOG_INDEX_BITS != v) {
+			if (entry >> L_CHANGE_LOG_INDEX_BITS > v)
+				return param_error_t::FAIL; // overwritten meanwhile, we're too slow
+			break; // a writer has taken the version, but not written the entry yet. it goes to the next delta.
+		}
+		upto = v;
+		param_index_t param_index = entry & ((1 << L_CHANGE_LOG_INDEX_BITS) - 1);
+		u64 bit = (u64)1 << (param_index % 64);
+		if (seen[param_index / 64] & bit)
+			continue;
+		seen[param_index / 64] |= bit;
+		u32 len = paramsys_write_value_entry(param_index, out + pos, out_max - pos);
+		if (!len)
+			return param_error_t::FAIL;
+		pos += len;
+	}
+
+	l_sync_header_t h = {L_SYNC_DELTA, params_epoch(), since_version, upto};
+	memcpy(out, &h, sizeof(h));
+	*out_len = pos;
+	return param_error_t::SUCCESS;
+}
+
+u32 params_sync_make(const params_sync_state_t* replica, u8* out, u32 out_max) {
+	u32 len;
+	if (replica->epoch == params_epoch() &&
+	    params_sync_delta(replica->version, out, out_max, &len) == param_error_t::SUCCESS)
+		return len;
+	return params_sync_snapshot(out, out_max);
+}
+
+param_error_t params_sync_apply(const u8* data, u32 len, params_sync_state_t* replica) {
+	l_sync_header_t h;
+	if (len < sizeof(h))
+		return param_error_t::FAIL;
+	memcpy(&h, data, sizeof(h));
+	data += sizeof(h);
+	len -= sizeof(h);
+
+	u8 value[256]; // values in data can be unaligned
+	if (h.kind == L_SYNC_SNAPSHOT) {
+		const paramsys_valuemem_t* image = (const paramsys_valuemem_t*)data;
+		if (len != offsetof(paramsys_valuemem_t, values) + PARAMS_VALUES_LEN_BYTES || !paramsys_valuemem_header_valid(image))
+			return param_error_t::FAIL;
+		// same layout, so a value is at the same offset in the image as in our values memory.
+		for (u32 i = 1; i < PARAMS_COUNT; i++) {
+			param_info_t* param_info = &params_info.params_info[i];
+			if (param_info->flags & param_info_t::DISABLED)
+				continue;
+			param_error_t e;
+			if (!l_param_is_variable_size(param_info)) {
+				u32 offset = (u8*)l_param_get_value_ptr(param_info) - (u8*)params_valuemem;
+				memcpy(value, data + offset, l_param_len_bytes(param_info));
+				e = params_set(i, (params_type_e)param_info->type, value);
+			} else if (paramsys_type_is_arena(param_info->type)) {
+				u32 offset = l_param_get_value_str_ptr(param_info) - (u8*)params_valuemem;
+				paramsys_arena_ref_t ref;
+				memcpy(&ref, data + offset, sizeof(ref));
+				u32 arena_pos = offsetof(paramsys_valuemem_t, values) + PARAMS_ARENA_OFFSET + sizeof(paramsys_arena_header_t);
+				if ((u64)arena_pos + ref.offset + ref.len > len)
+					return param_error_t::FAIL;
+				e = l_params_ctx_set_arena(&l_ctx_default, i, (params_type_e)param_info->type, data + arena_pos + ref.offset,
+				                           ref.len);
+			} else {
+				u32 offset = l_param_get_value_str_ptr(param_info) - (u8*)params_valuemem;
+				const u8* str = data + offset;
+				e = params_set_str(i, (const char*)str + 2, str[1]);
+			}
+			if (e != param_error_t::SUCCESS)
+				return e;
+		}
+	} else if (h.kind == L_SYNC_DELTA) {
+		// the delta has to start at or before the replica version. otherwise we'd miss the changes in between.
+		if (h.epoch != replica->epoch || h.since_version > replica->version)
+			return param_error_t::FAIL;
+		u32 pos = 0;
+		while (pos < len) {
+			param_index_t param_index;
+			params_type_e type;
+			u32 value_len;
+			u32 header_len = paramsys_read_value_entry_header(data + pos, len - pos, &param_index, &type, &value_len);
+			if (!header_len)
+				return param_error_t::FAIL;
+			const u8* entry_value = data + pos + header_len;
+			pos += header_len + value_len;
+			if (!paramsys_type_is_arena((u8)type))
+				memcpy(value, entry_value, value_len);
+			param_error_t e;
+			if (paramsys_type_is_arena((u8)type))
+				e = l_params_ctx_set_arena(&l_ctx_default, param_index, type, entry_value, value_len);
+			else if (type == params_type_e::STR)
+				e = params_set_str(param_index, (const char*)value, value_len);
+			else if (value_len != paramsys_type_len(type))
+				e = param_error_t::FAIL;
+			else
+				e = params_set(param_index, type, value);
+			if (e != param_error_t::SUCCESS)
+				return e;
+		}
+		if (pos != len)
+			return param_error_t::FAIL;
+	} else {
+		return param_error_t::FAIL;
+	}
+
+	replica->epoch = h.epoch;
+	replica->version = h.version;
+	return param_error_t::SUCCESS;
+}
+
+#ifdef PARAMS_CONCURRENT
+param_error_t params_start_dispatcher(u32 coalesce_us) {
+	std::lock_guard<std::mutex> lock(l_dispatcher_mutex);
+	if (l_dispatcher_thread.joinable())
+		return param_error_t::FAIL;
+	l_dispatcher_stop = false;
+	l_dispatcher_thread = std::thread([coalesce_us]() {
+		std::unique_lock<std::mutex> lock(l_dispatcher_mutex);
+		while (!l_dispatcher_stop) {
+			// l_bitmap_any catches params that params_dispatch left pending without anyone waking us up again.
+			l_dispatcher_cv.wait(lock, []() { return l_dispatcher_wakeup || l_dispatcher_stop || l_bitmap_any(&l_pending); });
+			// let the rest of the burst arrive. it only re-marks the same pending bits.
+			if (coalesce_us)
+				l_dispatcher_cv.wait_for(lock, std::chrono::microseconds(coalesce_us), []() { return l_dispatcher_stop; });
+			l_dispatcher_wakeup = false;
+			lock.unlock();
+			params_dispatch();
+			lock.lock();
+		}
+	});
+	return param_error_t::SUCCESS;
+}
+
+void params_stop_dispatcher() {
+	{
+		std::lock_guard<std::mutex> lock(l_dispatcher_mutex);
+		if (!l_dispatcher_thread.joinable())
+			return;
+		l_dispatcher_stop = true;
+	}
+	l_dispatcher_cv.notify_one();
+	l_dispatcher_thread.join();
+}
+#endif
+
+int params_profile_create(const char* name) {
+	if (!name || !name[0] || strlen(name) >= PARAMS_PROFILE_NAME_LEN)
+		return -1;
+#ifdef PARAMS_CONCURRENT
+	std::lock_guard<std::mutex> lock(l_profiles_mutex);
+#endif
+	if (l_profile_find(name) > 0)
+		return -1;
+	for (int id = 1; id <= PARAMS_MAX_PROFILES; id++) {
+		if (l_profiles[id].name[0])
+			continue;
+		strcpy(l_profiles[id].name, name);
+		return id;
+	}
+	return -1;
+}
+
+int params_profile_find(const char* name) {
+#ifdef PARAMS_CONCURRENT
+	std::lock_guard<std::mutex> lock(l_profiles_mutex);
+#endif
+	return l_profile_find(name);
+}
+
+void params_profile_delete(int profile) {
+#ifdef PARAMS_CONCURRENT
+	std::lock_guard<std::mutex> lock(l_profiles_mutex);
+#endif
+	if (!l_profile_valid(profile))
+		return;
+	if (l_profile_active == profile)
+		l_profiles_switch(0);
+	free(l_profiles[profile].entries);
+	free(l_profiles[profile].data);
+	memset(&l_profiles[profile], 0, sizeof(l_profiles[profile]));
+}
+
+param_error_t params_profile_override(int profile, param_index_t param_index, params_type_e param_type, const void* value) {
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	if (hot->type != (u8)param_type || l_hot_is_variable_size(hot) || hot->flags & param_info_t::DISABLED)
+		return param_error_t::NO_PARAM;
+
+	conv_t val;
+	memcpy(&val, value, l_hot_len_bytes(hot));
+	if (hot->flags & param_info_t::HAS_MINMAX)
+		l_params_apply_limits(hot, &val);
+	return l_profile_set_override(profile, param_index, &val, l_hot_len_bytes(hot));
+}
+
+param_error_t params_profile_override_str(int profile, param_index_t param_index, const char* str, u8 str_len) {
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	if (hot->type != (u8)params_type_e::STR || hot->flags & param_info_t::DISABLED)
+		return param_error_t::NO_PARAM;
+
+	// the whole slot, like it is in the values memory.
+	u8 slot[2 + 255] = {};
+	slot[0] = params_info.defaults_str[hot->defaults_index];
+	if (str_len > slot[0]) str_len = slot[0];
+	slot[1] = str_len;
+	memcpy(slot + 2, str, str_len);
+	return l_profile_set_override(profile, param_index, slot, 2 + slot[0]);
+}
+
+param_error_t params_profile_activate(int profile) {
+#ifdef PARAMS_CONCURRENT
+	std::lock_guard<std::mutex> lock(l_profiles_mutex);
+#endif
+	if (profile != 0 && !l_profile_valid(profile))
+		return param_error_t::FAIL;
+	if (l_ctx_default.readonly)
+		return param_error_t::FAIL;
+	if (profile != l_profile_active)
+		l_profiles_switch(profile);
+	return param_error_t::SUCCESS;
+}
+
+int params_profile_active() {
+	return __atomic_load_n(&l_profile_active, __ATOMIC_RELAXED);
+}
+
+param_error_t params_get_str(param_index_t param_index, const char** out_str, u8* out_str_len) {
+	return params_ctx_get_str(&l_ctx_default, param_index, out_str, out_str_len);
+}
+
+param_error_t params_get_str_copy(param_index_t param_index, char* out_str, u8 out_str_max_len, u8* out_str_len) {
+	return params_ctx_get_str_copy(&l_ctx_default, param_index, out_str, out_str_max_len, out_str_len);
+}
+
+param_error_t params_set_str(param_index_t param_index, const char* str, u8 str_len) {
+	return params_ctx_set_str(&l_ctx_default, param_index, str, str_len);
+}
+
+param_error_t params_ctx_get_str(paramsys_ctx_t* ctx, param_index_t param_index, const char** out_str, u8* out_str_len) {
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	if (hot->type != (u8)params_type_e::STR || hot->flags & param_info_t::DISABLED)
+		return param_error_t::NO_PARAM;
+	paramsys_instrument_read(param_index);
+
+	u8* src = l_hot_get_value_ptr(ctx, hot);
+	*out_str_len = src[1];
+	*out_str = (char*)src + 2;
+
+	return param_error_t::SUCCESS;
+}
+
+param_error_t params_ctx_get_str_copy(paramsys_ctx_t* ctx, param_index_t param_index, char* out_str, u8 out_str_max_len,
+                                      u8* out_str_len) {
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	if (hot->type != (u8)params_type_e::STR || hot->flags & param_info_t::DISABLED)
+		return param_error_t::NO_PARAM;
+	paramsys_instrument_read(param_index);
+
+	u8* src = l_hot_get_value_ptr(ctx, hot);
+	u8 len;
+	u32 s;
+	do {
+		s = l_seq_read_begin(ctx, PARAMS_SIZE_CLASS_STR);
+		len = src[1];
+		// len can be garbage if a write is in progress. never copy more than the slot or out_str can hold.
+		if (len > src[0]) len = src[0];
+		if (len > out_str_max_len) len = out_str_max_len;
+		memcpy(out_str, src + 2, len);
+	} while (l_seq_read_retry(ctx, PARAMS_SIZE_CLASS_STR, s));
+
+	*out_str_len = len;
+	return param_error_t::SUCCESS;
+}
+
+param_error_t params_ctx_set_str(paramsys_ctx_t* ctx, param_index_t param_index, const char* str, u8 str_len) {
+	u64 start = paramsys_instrument_start();
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	if (hot->type != (u8)params_type_e::STR || hot->flags & param_info_t::DISABLED)
+		return param_error_t::NO_PARAM;
+	if (ctx->readonly)
+		return param_error_t::FAIL;
+	paramsys_instrument_write(param_index);
+
+	l_params_write_begin_mask(ctx, 1 << PARAMS_SIZE_CLASS_STR);
+	bool changed = l_params_set_str(ctx, hot, str, str_len);
+	l_params_write_end_mask(ctx, 1 << PARAMS_SIZE_CLASS_STR);
+
+	if (changed)
+		l_params_ctx_on_value_changed(ctx, param_index);
+	paramsys_instrument_set_done(start);
+	return param_error_t::SUCCESS;
+}
+
+param_error_t params_set_str16(param_index_t param_index, const char* str, u16 str_len) {
+	return l_params_ctx_set_arena(&l_ctx_default, param_index, params_type_e::STR16, str, str_len);
+}
+
+param_error_t params_set_buf(param_index_t param_index, const void* data, u16 len) {
+	return l_params_ctx_set_arena(&l_ctx_default, param_index, params_type_e::BUF, data, len);
+}
+
+param_error_t params_get_view(param_index_t param_index, params_view_t* out_view) {
+	return params_ctx_get_view(&l_ctx_default, param_index, out_view);
+}
+
+param_error_t params_get_bytes_copy(param_index_t param_index, void* out, u16 out_max_len, u16* out_len) {
+	return params_ctx_get_bytes_copy(&l_ctx_default, param_index, out, out_max_len, out_len);
+}
+
+param_error_t params_ctx_set_str16(paramsys_ctx_t* ctx, param_index_t param_index, const char* str, u16 str_len) {
+	return l_params_ctx_set_arena(ctx, param_index, params_type_e::STR16, str, str_len);
+}
+
+param_error_t params_ctx_set_buf(paramsys_ctx_t* ctx, param_index_t param_index, const void* data, u16 len) {
+	return l_params_ctx_set_arena(ctx, param_index, params_type_e::BUF, data, len);
+}
+
+// Pin first, then read the ref. A compaction that started before the pin holds the write section, so the ref is read
+// after it's done; one that would start after the pin doesn't start at all.
+param_error_t params_ctx_get_view(paramsys_ctx_t* ctx, param_index_t param_index, params_view_t* out_view) {
+	*out_view = {nullptr, 0, nullptr};
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	if (!paramsys_type_is_arena(hot->type) || hot->flags & param_info_t::DISABLED)
+		return param_error_t::NO_PARAM;
+	if (ctx->readonly)
+		return param_error_t::FAIL; // params_get_bytes_copy
+	paramsys_instrument_read(param_index);
+
+	__atomic_fetch_add(&ctx->arena_pins, 1, __ATOMIC_SEQ_CST);
+	const paramsys_arena_ref_t* src = l_arena_ref(ctx, hot);
+	paramsys_arena_ref_t ref;
+	u32 s;
+	do {
+		s = l_seq_read_begin(ctx, PARAMS_SIZE_CLASS_STR);
+		memcpy(&ref, src, sizeof(ref));
+	} while (l_seq_read_retry(ctx, PARAMS_SIZE_CLASS_STR, s));
+
+	*out_view = {l_arena_bytes(ctx) + ref.offset, ref.len, ctx};
+	return param_error_t::SUCCESS;
+}
+
+void params_release_view(params_view_t* view) {
+	if (!view->ctx)
+		return;
+	__atomic_fetch_sub(&view->ctx->arena_pins, 1, __ATOMIC_RELEASE);
+	*view = {nullptr, 0, nullptr};
+}
+
+param_error_t params_ctx_get_bytes_copy(paramsys_ctx_t* ctx, param_index_t param_index, void* out, u16 out_max_len,
+                                        u16* out_len) {
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	if (!paramsys_type_is_arena(hot->type) || hot->flags & param_info_t::DISABLED)
+		return param_error_t::NO_PARAM;
+	paramsys_instrument_read(param_index);
+
+	const paramsys_arena_ref_t* src = l_arena_ref(ctx, hot);
+	const u8* bytes = l_arena_bytes(ctx);
+	u16 len;
+	u32 s;
+	do {
+		s = l_seq_read_begin(ctx, PARAMS_SIZE_CLASS_STR);
+		// the ref can be torn while a write is in progress. never copy from outside the arena.
+		paramsys_arena_ref_t ref;
+		memcpy(&ref, src, sizeof(ref));
+		len = ref.len < out_max_len ? ref.len : out_max_len;
+		if ((u64)ref.offset + len <= PARAMS_ARENA_BYTES)
+			memcpy(out, bytes + ref.offset, len);
+		else
+			len = 0;
+	} while (l_seq_read_retry(ctx, PARAMS_SIZE_CLASS_STR, s));
+	*out_len = len;
+	return param_error_t::SUCCESS;
+}
+
+params_caller_t params_caller(u8 security_level) {
+	return params_ctx_caller(&l_ctx_default, security_level);
+}
+
+params_caller_t params_ctx_caller(paramsys_ctx_t* ctx, u8 security_level) {
+	u8 level = security_level < PARAMS_SECURITY_LEVELS ? security_level : PARAMS_SECURITY_LEVELS - 1;
+	return {ctx, params_access_readable[level], params_access_writable[level], security_level};
+}
+
+bool params_caller_can_read(const params_caller_t* caller, param_index_t param_index) {
+	return param_index < PARAMS_COUNT && l_access_bit(caller->readable, param_index);
+}
+
+bool params_caller_can_write(const params_caller_t* caller, param_index_t param_index) {
+	return param_index < PARAMS_COUNT && l_access_bit(caller->writable, param_index);
+}
+
+u32 params_caller_take_changed(const params_caller_t* caller, param_index_t* out_param_indices, u32 max_count) {
+	return l_bitmap_take(&caller->ctx->dirty, out_param_indices, max_count, caller->readable);
+}
+
+param_error_t params_caller_get(const params_caller_t* caller, param_index_t param_index, params_type_e param_type,
+                                void* out_value) {
+	if (param_index >= PARAMS_COUNT || !l_access_bit(caller->readable, param_index))
+		return param_error_t::NO_PARAM;
+	return params_ctx_get(caller->ctx, param_index, param_type, out_value);
+}
+
+param_error_t params_caller_set(const params_caller_t* caller, param_index_t param_index, params_type_e param_type,
+                                void* valueptr) {
+	param_error_t e = l_caller_check_write(caller, param_index);
+	if (e != param_error_t::SUCCESS)
+		return e;
+	return params_ctx_set(caller->ctx, param_index, param_type, valueptr);
+}
+
+param_error_t params_caller_get_str_copy(const params_caller_t* caller, param_index_t param_index, char* out_str,
+                                         u8 out_str_max_len, u8* out_str_len) {
+	if (param_index >= PARAMS_COUNT || !l_access_bit(caller->readable, param_index))
+		return param_error_t::NO_PARAM;
+	return params_ctx_get_str_copy(caller->ctx, param_index, out_str, out_str_max_len, out_str_len);
+}
+
+param_error_t params_caller_set_str(const params_caller_t* caller, param_index_t param_index, const char* str, u8 str_len) {
+	param_error_t e = l_caller_check_write(caller, param_index);
+	if (e != param_error_t::SUCCESS)
+		return e;
+	return params_ctx_set_str(caller->ctx, param_index, str, str_len);
+}
+
+param_error_t params_caller_get_bytes_copy(const params_caller_t* caller, param_index_t param_index, void* out, u16 out_max_len,
+                                           u16* out_len) {
+	if (param_index >= PARAMS_COUNT || !l_access_bit(caller->readable, param_index))
+		return param_error_t::NO_PARAM;
+	return params_ctx_get_bytes_copy(caller->ctx, param_index, out, out_max_len, out_len);
+}
+
+param_error_t params_caller_set_str16(const params_caller_t* caller, param_index_t param_index, const char* str, u16 str_len) {
+	param_error_t e = l_caller_check_write(caller, param_index);
+	if (e != param_error_t::SUCCESS)
+		return e;
+	return params_ctx_set_str16(caller->ctx, param_index, str, str_len);
+}
+
+param_error_t params_caller_set_buf(const params_caller_t* caller, param_index_t param_index, const void* data, u16 len) {
+	param_error_t e = l_caller_check_write(caller, param_index);
+	if (e != param_error_t::SUCCESS)
+		return e;
+	return params_ctx_set_buf(caller->ctx, param_index, data, len);
+}
+
+param_error_t params_caller_get_info(const params_caller_t* caller, param_index_t param_index,
+                                     param_info_public_t* out_param_info) {
+	if (param_index >= PARAMS_COUNT || !l_access_bit(caller->readable, param_index))
+		return param_error_t::NO_PARAM;
+	return params_get_info(param_index, out_param_info);
+}
+
+u32 params_caller_list(const params_caller_t* caller, param_index_t first_param_index, bool writable, param_index_t* out_param_indices,
+                       u32 max_count) {
+	const u64* bits = writable ? caller->writable : caller->readable;
+	u32 count = 0;
+	u32 w = first_param_index / 64;
+	if (w >= PARAMS_ACCESS_WORDS)
+		return 0;
+	u64 word = bits[w] & ~0ull << (first_param_index % 64);
+	while (count < max_count) {
+		if (!word) {
+			if (++w == PARAMS_ACCESS_WORDS)
+				break;
+			word = bits[w];
+			continue;
+		}
+		out_param_indices[count++] = w * 64 + __builtin_ctzll(word);
+		word &= word - 1;
+	}
+	return count;
+}
+
+
+// instrumentation
+
+#ifdef PARAMS_INSTRUMENT
+
+thread_local paramsys_instrument_shard_t* paramsys_instrument_shard;
+
+static u64                         l_instrument_counts[PARAMS_INSTRUMENT_SHARDS][2 * PARAMS_COUNT];
+static paramsys_instrument_shard_t l_instrument_shards[PARAMS_INSTRUMENT_SHARDS];
+static u32                         l_instrument_claimed;
+
+static bool l_instrument_init_shards() {
+	for (u32 i = 0; i < PARAMS_INSTRUMENT_SHARDS; i++) {
+		l_instrument_shards[i].counts = l_instrument_counts[i];
+		l_instrument_shards[i].shared = i == PARAMS_INSTRUMENT_SHARDS - 1;
+	}
+	return true;
+}
+
+// shards 0 .. PARAMS_INSTRUMENT_SHARDS - 2 have a single owner, the last one is shared by everyone after them.
+paramsys_instrument_shard_t* paramsys_instrument_claim_shard() {
+	static bool initialized = l_instrument_init_shards();
+	(void)initialized;
+	u32 i = __atomic_fetch_add(&l_instrument_claimed, 1, __ATOMIC_RELAXED);
+	if (i >= PARAMS_INSTRUMENT_SHARDS - 1)
+		i = PARAMS_INSTRUMENT_SHARDS - 1;
+	paramsys_instrument_shard = &l_instrument_shards[i];
+	return paramsys_instrument_shard;
+}
+
+u64 paramsys_instrument_now_ns() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+void paramsys_instrument_latency(params_latency_e which, u64 start_ns) {
+	u64 ns = paramsys_instrument_now_ns() - start_ns;
+	paramsys_instrument_shard_t* shard = paramsys_instrument_shard;
+	if (!shard)
+		shard = paramsys_instrument_claim_shard();
+	params_latency_t* l = &shard->latency[(u8)which];
+	u32 bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+	if (bucket >= PARAMS_INSTRUMENT_BUCKETS)
+		bucket = PARAMS_INSTRUMENT_BUCKETS - 1;
+	paramsys_instrument_add(&l->count, 1, shard->shared);
+	paramsys_instrument_add(&l->total_ns, ns, shard->shared);
+	paramsys_instrument_add(&l->buckets[bucket], 1, shard->shared);
+	u64 max = __atomic_load_n(&l->max_ns, __ATOMIC_RELAXED);
+	while (ns > max && !__atomic_compare_exchange_n(&l->max_ns, &max, ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+u32 params_instrument_counts(param_index_t first_param_index, bool include_unused, params_access_count_t* out,
+                             u32 max_count) {
+	u32 count = 0;
+	for (u32 i = first_param_index ? first_param_index : 1; i < PARAMS_COUNT && count < max_count; i++) {
+		const param_info_t* param_info = &params_info.params_info[i];
+		if (param_info->flags & param_info_t::DISABLED)
+			continue;
+		u64 reads = 0, writes = 0;
+		for (u32 s = 0; s < PARAMS_INSTRUMENT_SHARDS; s++) {
+			reads += __atomic_load_n(&l_instrument_counts[s][2 * i], __ATOMIC_RELAXED);
+			writes += __atomic_load_n(&l_instrument_counts[s][2 * i + 1], __ATOMIC_RELAXED);
+		}
+		if (!include_unused && !reads && !writes)
+			continue;
+		out[count++] = {(param_index_t)i, (const char*)param_info->name, reads, writes};
+	}
+	return count;
+}
+
+void params_instrument_latency(params_latency_e which, params_latency_t* out) {
+	memset(out, 0, sizeof(*out));
+	for (u32 s = 0; s < PARAMS_INSTRUMENT_SHARDS; s++) {
+		params_latency_t* l = &l_instrument_shards[s].latency[(u8)which];
+		out->count += __atomic_load_n(&l->count, __ATOMIC_RELAXED);
+		out->total_ns += __atomic_load_n(&l->total_ns, __ATOMIC_RELAXED);
+		out->max_ns = std::max(out->max_ns, __atomic_load_n(&l->max_ns, __ATOMIC_RELAXED));
+		for (u32 b = 0; b < PARAMS_INSTRUMENT_BUCKETS; b++)
+			out->buckets[b] += __atomic_load_n(&l->buckets[b], __ATOMIC_RELAXED);
+	}
+}
+
+void params_instrument_reset() {
+	for (u32 s = 0; s < PARAMS_INSTRUMENT_SHARDS; s++) {
+		for (u32 i = 0; i < 2 * PARAMS_COUNT; i++)
+			__atomic_store_n(&l_instrument_counts[s][i], 0, __ATOMIC_RELAXED);
+		for (u32 which = 0; which < (u8)params_latency_e::COUNT; which++) {
+			params_latency_t* l = &l_instrument_shards[s].latency[which];
+			__atomic_store_n(&l->count, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&l->total_ns, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&l->max_ns, 0, __ATOMIC_RELAXED);
+			for (u32 b = 0; b < PARAMS_INSTRUMENT_BUCKETS; b++)
+				__atomic_store_n(&l->buckets[b], 0, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+// upper bound in ns of the bucket that holds the given fraction of the calls
+static u64 l_instrument_percentile(const params_latency_t* l, double fraction) {
+	u64 need = (u64)(l->count * fraction + 0.5);
+	u64 seen = 0;
+	for (u32 b = 0; b < PARAMS_INSTRUMENT_BUCKETS; b++) {
+		seen += l->buckets[b];
+		if (seen >= need && seen)
+			return 1ull << b;
+	}
+	return l->max_ns;
+}
+
+// snprintf that keeps going after the buffer is full, so the caller checks only once at the end
+static void l_instrument_printf(char* out, u32 out_max, u32* len, const char* fmt, ...)
+	__attribute__((format(printf, 4, 5)));
+static void l_instrument_printf(char* out, u32 out_max, u32* len, const char* fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	int n = vsnprintf(*len < out_max ? out + *len : nullptr, *len < out_max ? out_max - *len : 0, fmt, args);
+	va_end(args);
+	if (n > 0)
+		*len += n;
+}
+
+u32 params_instrument_dump(params_instrument_format_e format, bool include_unused, char* out, u32 out_max) {
+	static const char* const latency_names[] = {"set", "store"};
+	bool json = format == params_instrument_format_e::JSON;
+	u32 len = 0;
+	params_access_count_t counts[64];
+	u32 n;
+	bool first = true;
+
+	l_instrument_printf(out, out_max, &len, json ? "{\"params\":[" : "%6s %-16s %12s %12s\n", "index", "name", "reads",
+	                    "writes");
+	for (param_index_t next = 0; (n = params_instrument_counts(next, include_unused, counts, 64)) != 0;
+	     next = counts[n - 1].param_index + 1) {
+		for (u32 i = 0; i < n; i++, first = false) {
+			params_access_count_t* c = &counts[i];
+			if (json)
+				l_instrument_printf(out, out_max, &len,
+				                    "%s{\"index\":%u,\"name\":\"%s\",\"reads\":%" PRIu64 ",\"writes\":%" PRIu64 "}",
+				                    first ? "" : ",", (u32)c->param_index, c->name, c->reads, c->writes);
+			else
+				l_instrument_printf(out, out_max, &len, "%6u %-16s %12" PRIu64 " %12" PRIu64 "\n",
+				                    (u32)c->param_index, c->name, c->reads, c->writes);
+		}
+		if (counts[n - 1].param_index + 1u >= PARAMS_COUNT)
+			break;
+	}
+
+	l_instrument_printf(out, out_max, &len, json ? "],\"latency\":{" : "\n%-6s %12s %10s %10s %10s %10s\n", "", "count",
+	                    "avg_ns", "p50_ns<", "p99_ns<", "max_ns");
+	for (u8 w = 0; w < (u8)params_latency_e::COUNT; w++) {
+		params_latency_t l;
+		params_instrument_latency((params_latency_e)w, &l);
+		if (!json) {
+			l_instrument_printf(out, out_max, &len, "%-6s %12" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+			                    " %10" PRIu64 "\n", latency_names[w], l.count, l.count ? l.total_ns / l.count : 0,
+			                    l_instrument_percentile(&l, 0.5), l_instrument_percentile(&l, 0.99), l.max_ns);
+			continue;
+		}
+		l_instrument_printf(out, out_max, &len, "%s\"%s\":{\"count\":%" PRIu64 ",\"total_ns\":%" PRIu64
+		                    ",\"max_ns\":%" PRIu64 ",\"buckets\":[", w ? "," : "", latency_names[w], l.count,
+		                    l.total_ns, l.max_ns);
+		for (u32 b = 0; b < PARAMS_INSTRUMENT_BUCKETS; b++)
+			l_instrument_printf(out, out_max, &len, "%s%" PRIu64, b ? "," : "", l.buckets[b]);
+		l_instrument_printf(out, out_max, &len, "]}");
+	}
+	if (json)
+		l_instrument_printf(out, out_max, &len, "}}");
+
+	return len < out_max ? len : 0;
+}
+
+void params_instrument_print(bool include_unused) {
+	u32 out_max = 512 + 64 * PARAMS_COUNT;
+	char* out = (char*)malloc(out_max);
+	if (!out)
+		return;
+	if (params_instrument_dump(params_instrument_format_e::TABLE, include_unused, out, out_max))
+		fputs(out, stdout);
+	free(out);
+}
+
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// private functions
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+inline const char* l_param_type_to_str(params_type_e param_type) {
+	assert(((u8)param_type & PARAMS_TYPE_INDEX_mask) < (u8)params_type_e::LAST);
+	return paramsys_type_table[(u8)param_type & PARAMS_TYPE_INDEX_mask].type_name;
+}
+
+// returns 0 for any variable-size types (like str)
+inline u32 l_param_len_bytes(param_info_t* param_info) {
+	return paramsys_type_table[(u8)param_info->type & PARAMS_TYPE_INDEX_mask].type_len;
+}
+
+// PARAMS_SIZE_CLASS_*, for the seqlock.
+inline u8 l_param_size_class(param_info_t* param_info) {
+	switch (l_param_len_bytes(param_info)) {
+	case 1:  return PARAMS_SIZE_CLASS_8;
+	case 2:  return PARAMS_SIZE_CLASS_16;
+	case 4:  return PARAMS_SIZE_CLASS_32;
+	case 8:  return PARAMS_SIZE_CLASS_64;
+	case 16: return PARAMS_SIZE_CLASS_128;
+	default: return PARAMS_SIZE_CLASS_STR;
+	}
+}
+
+inline bool l_param_is_variable_size(param_info_t* param_info) {
+	return param_info->type & PARAMS_TYPE_IS_VARIABLE_SIZE_bit;
+}
+
+// params_hot versions of the above, for the get/set paths.
+
+static_assert(sizeof(paramsys_hot_t) == (PARAMS_INDEX_BITS == 32 ? 10 : 8), "paramsys_hot_t has to stay small");
+static_assert(PARAMS_SIZE_CLASS_8 == 0 && PARAMS_SIZE_CLASS_16 == 1 && PARAMS_SIZE_CLASS_32 == 2 &&
+              PARAMS_SIZE_CLASS_64 == 3 && PARAMS_SIZE_CLASS_128 == 4, "l_hot_len_bytes needs len == 1 << size_class");
+
+inline u8 l_hot_size_class(const paramsys_hot_t* hot) {
+	return hot->flags >> PARAMS_HOT_SIZE_CLASS_shift;
+}
+
+// only for fixed-size types
+inline u32 l_hot_len_bytes(const paramsys_hot_t* hot) {
+	return 1 << l_hot_size_class(hot);
+}
+
+inline bool l_hot_is_variable_size(const paramsys_hot_t* hot) {
+	return hot->type & PARAMS_TYPE_IS_VARIABLE_SIZE_bit;
+}
+
+// for strings, pointer to the max_len/len header.
+inline u8* l_hot_get_value_ptr(const paramsys_ctx_t* ctx, const paramsys_hot_t* hot) {
+	return ctx->values + hot->value_offset;
+}
+
+// bit of the param in a params_access_readable/writable row. param_index has to be < PARAMS_COUNT.
+inline bool l_access_bit(const u64* bits, param_index_t param_index) {
+	return bits[param_index >> 6] >> (param_index & 63) & 1;
+}
+
+// STR16/BUF: the arena of the instance, the ref of a param, max_len and the default value from defaults_str.
+inline paramsys_arena_header_t* l_arena(const paramsys_ctx_t* ctx) {
+	return (paramsys_arena_header_t*)(ctx->values + PARAMS_ARENA_OFFSET);
+}
+
+inline u8* l_arena_bytes(const paramsys_ctx_t* ctx) {
+	return ctx->values + PARAMS_ARENA_OFFSET + sizeof(paramsys_arena_header_t);
+}
+
+inline paramsys_arena_ref_t* l_arena_ref(const paramsys_ctx_t* ctx, const paramsys_hot_t* hot) {
+	return (paramsys_arena_ref_t*)(ctx->values + hot->value_offset);
+}
+
+inline u16 l_arena_max_len(const paramsys_hot_t* hot) {
+	u16 max_len;
+	memcpy(&max_len, &defaults_str[hot->defaults_index], 2);
+	return max_len;
+}
+
+inline const u8* l_arena_default(const paramsys_hot_t* hot, u16* out_len) {
+	memcpy(out_len, &defaults_str[hot->defaults_index + 2], 2);
+	return &defaults_str[hot->defaults_index + 4];
+}
+
+// a saved copy of a value, to compare against later: fixed-size values as they are, STR as len + chars, STR16/BUF as
+// u16 len + bytes (the arena moves, so the bytes are copied out). out needs l_value_max_len bytes.
+inline u32 l_value_max_len(const paramsys_ctx_t* ctx, const paramsys_hot_t* hot) {
+	if (paramsys_type_is_arena(hot->type))
+		return 2 + l_arena_max_len(hot);
+	if (l_hot_is_variable_size(hot))
+		return 1 + l_hot_get_value_ptr(ctx, hot)[0];
+	return l_hot_len_bytes(hot);
+}
+
+inline void l_value_save(const paramsys_ctx_t* ctx, const paramsys_hot_t* hot, u8* out) {
+	const u8* value = l_hot_get_value_ptr(ctx, hot);
+	if (paramsys_type_is_arena(hot->type)) {
+		const paramsys_arena_ref_t* ref = l_arena_ref(ctx, hot);
+		memcpy(out, &ref->len, 2);
+		memcpy(out + 2, l_arena_bytes(ctx) + ref->offset, ref->len);
+	} else if (l_hot_is_variable_size(hot)) {
+		memcpy(out, value + 1, 1 + value[1]);
+	} else {
+		memcpy(out, value, l_hot_len_bytes(hot));
+	}
+}
+
+inline bool l_value_equal(const paramsys_ctx_t* ctx, const paramsys_hot_t* hot, const u8* saved) {
+	const u8* value = l_hot_get_value_ptr(ctx, hot);
+	if (paramsys_type_is_arena(hot->type)) {
+		const paramsys_arena_ref_t* ref = l_arena_ref(ctx, hot);
+		u16 len;
+		memcpy(&len, saved, 2);
+		return len == ref->len && memcmp(saved + 2, l_arena_bytes(ctx) + ref->offset, len) == 0;
+	}
+	if (l_hot_is_variable_size(hot))
+		return saved[0] == value[1] && memcmp(saved + 1, value + 2, value[1]) == 0;
+	return memcmp(saved, value, l_hot_len_bytes(hot)) == 0;
+}
+
+// copy a fixed-size value. constant-length memcpy per size class compiles to plain moves instead of a memcpy call.
+inline void l_hot_copy_value(u8 size_class, void* dst, const void* src) {
+	switch (size_class) {
+	case PARAMS_SIZE_CLASS_8:   memcpy(dst, src, 1);  break;
+	case PARAMS_SIZE_CLASS_16:  memcpy(dst, src, 2);  break;
+	case PARAMS_SIZE_CLASS_32:  memcpy(dst, src, 4);  break;
+	case PARAMS_SIZE_CLASS_64:  memcpy(dst, src, 8);  break;
+	case PARAMS_SIZE_CLASS_128: memcpy(dst, src, 16); break;
+	default: break;
+	}
+}
+
+inline bool l_param_has_no_default(param_info_t* param_info) {
+	return (param_info->flags & param_info_t::NO_DEFAULT) || (param_info->flags & param_info_t::DISABLED);
+}
+
+// Return pointer to the default value. Does no error-checking, so returns garbage if no default exists.
+inline void* l_param_get_default_ptr(param_info_t* param_info) {
+	if (param_info->flags & param_info_t::HAS_MINMAX) {
+		return (u8*)paramsys_type_table[(u8)param_info->type & PARAMS_TYPE_INDEX_mask].defminmax +
+			l_param_len_bytes(param_info) * param_info->defaults_index * 3;
+	} else {
+		return (u8*)paramsys_type_table[(u8)param_info->type & PARAMS_TYPE_INDEX_mask].defaults +
+			l_param_len_bytes(param_info) * param_info->defaults_index;
+	}
+}
+
+inline void* l_param_get_value_ptr(param_info_t* param_info) {
+	return (u8*)paramsys_type_table[(u8) param_info->type & PARAMS_TYPE_INDEX_mask].values +
+		l_param_len_bytes(param_info) * param_info->value_index;
+}
+
+// return nullptr if the str has no default
+inline u8* l_param_get_default_str_ptr(param_info_t* param_info) {
+	assert(l_param_is_variable_size(param_info));
+	return &params_info.defaults_str[param_info->defaults_index];
+}
+
+// return nullptr if the str has no default
+inline u8* l_param_get_value_str_ptr(param_info_t* param_info) {
+	assert(l_param_is_variable_size(param_info));
+	return &params_values_str[param_info->value_index];
+}
+
+// TODO: rename str to buf? str should always have a terminating zero?
+// str_len is without terminating zero.
+// return true if the value changed.
+bool l_params_set_str(paramsys_ctx_t* ctx, const paramsys_hot_t* hot, const char* str, u8 str_len) {
+	u8* dst = l_hot_get_value_ptr(ctx, hot);
+	u8 max_len = dst[0];
+	assert(params_info.defaults_str[hot->defaults_index] == max_len);
+	if (str_len > max_len) str_len = max_len;
+	if (dst[1] == str_len && memcmp(dst+2, str, str_len) == 0)
+		return false;
+	// bytes first, then the length. a reader without the seqlock sees at worst a mix of old and new bytes, but never
+	// a length that covers bytes not written yet.
+	memcpy(dst+2, str, str_len);
+	dst[1] = str_len;
+	return true;
+}
+
+// STR16/BUF values in the arena, see paramsys_arena_ref_t. Views pin the arena with arena_pins. A writer that has to
+// compact takes L_ARENA_LOCKED in arena_pins, which it gets only while no view is held; views taken meanwhile wait
+// for the write section in their seqlock read.
+#define L_ARENA_LOCKED 0x80000000u
+
+bool l_arena_lock(paramsys_ctx_t* ctx) {
+	u32 expected = 0;
+	return __atomic_compare_exchange_n(&ctx->arena_pins, &expected, L_ARENA_LOCKED, false, __ATOMIC_SEQ_CST,
+	                                   __ATOMIC_RELAXED);
+}
+
+void l_arena_unlock(paramsys_ctx_t* ctx) {
+	__atomic_fetch_and(&ctx->arena_pins, ~L_ARENA_LOCKED, __ATOMIC_RELEASE);
+}
+
+// Slide the values down to the start of the arena, in offset order, and drop the garbage in between. Has to be called
+// inside a write section with the arena locked.
+void l_arena_compact(paramsys_ctx_t* ctx) {
+	u64* order = ctx->arena_order;
+	for (u32 i = 0; i < PARAMS_COUNT_ARENA; i++)
+		order[i] = (u64)l_arena_ref(ctx, &params_hot[params_arena_params[i]])->offset << 32 | i;
+	std::sort(order, order + PARAMS_COUNT_ARENA);
+
+	u8* bytes = l_arena_bytes(ctx);
+	u32 used = 0;
+	for (u32 i = 0; i < PARAMS_COUNT_ARENA; i++) {
+		paramsys_arena_ref_t* ref = l_arena_ref(ctx, &params_hot[params_arena_params[(u32)order[i]]]);
+		if (ref->offset != used)
+			memmove(bytes + used, bytes + ref->offset, ref->len);
+		ref->offset = used;
+		used += ref->len;
+	}
+	l_arena(ctx)->used = used;
+}
+
+// NO_PARAM if the caller can't see the param, DENIED if it can but can't change it.
+param_error_t l_caller_check_write(const params_caller_t* caller, param_index_t param_index) {
+	if (param_index >= PARAMS_COUNT || !l_access_bit(caller->readable, param_index))
+		return param_error_t::NO_PARAM;
+	if (!l_access_bit(caller->writable, param_index))
+		return param_error_t::DENIED;
+	return param_error_t::SUCCESS;
+}
+
+// Append the value at the free end of the arena and point the ref to it, compacting first if it doesn't fit. The
+// capacity is the sum of all max_len plus the biggest one, so after a compaction it always fits. locked: the caller
+// holds the arena lock (a batch), otherwise it's taken here if a compaction is needed. FAIL if it can't be taken.
+// data can't be in the arena: a view of it would keep the arena from compacting. Has to be called inside a write
+// section. *out_changed is true if the value changed.
+param_error_t l_arena_set(paramsys_ctx_t* ctx, const paramsys_hot_t* hot, const void* data, u16 len, bool locked,
+                          bool* out_changed) {
+	*out_changed = false;
+	u16 max_len = l_arena_max_len(hot);
+	if (len > max_len) len = max_len;
+	paramsys_arena_header_t* arena = l_arena(ctx);
+	paramsys_arena_ref_t* ref = l_arena_ref(ctx, hot);
+	u8* bytes = l_arena_bytes(ctx);
+	if (ref->len == len && memcmp(bytes + ref->offset, data, len) == 0)
+		return param_error_t::SUCCESS;
+
+	if (arena->capacity - arena->used < len) {
+		if (!locked && !l_arena_lock(ctx))
+			return param_error_t::FAIL;
+		l_arena_compact(ctx);
+		if (!locked)
+			l_arena_unlock(ctx);
+	}
+	// old value stays in place for the views that may still point to it.
+	memcpy(bytes + arena->used, data, len);
+	ref->offset = arena->used;
+	ref->len = len;
+	arena->used += len;
+	*out_changed = true;
+	return param_error_t::SUCCESS;
+}
+
+param_error_t l_params_ctx_set_arena(paramsys_ctx_t* ctx, param_index_t param_index, params_type_e type, const void* data,
+                                     u16 len) {
+	u64 start = paramsys_instrument_start();
+	if (param_index >= PARAMS_COUNT)
+		return param_error_t::NO_PARAM;
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	if (hot->type != (u8)type || hot->flags & param_info_t::DISABLED)
+		return param_error_t::NO_PARAM;
+	if (ctx->readonly)
+		return param_error_t::FAIL;
+	paramsys_instrument_write(param_index);
+
+	bool changed;
+	l_params_write_begin_mask(ctx, 1 << PARAMS_SIZE_CLASS_STR);
+	param_error_t e = l_arena_set(ctx, hot, data, len, false, &changed);
+	l_params_write_end_mask(ctx, 1 << PARAMS_SIZE_CLASS_STR);
+
+	if (changed)
+		l_params_ctx_on_value_changed(ctx, param_index);
+	paramsys_instrument_set_done(start);
+	return e;
+}
+
+// Fix what a damaged or migrated image can have in the arena: a broken header resets all the STR16/BUF values to
+// their defaults, a value past the used end of the arena gets its default, a value longer than max_len is cut.
+// Returns fixed plus the number of params fixed here, like l_params_validate_all.
+u32 l_arena_validate(paramsys_ctx_t* ctx, param_index_t* out_param_indices, u32 max_count, u32 fixed, bool notify) {
+	if (!PARAMS_COUNT_ARENA)
+		return fixed;
+	l_param_bitmap_t changed = {};
+	l_params_write_begin_mask(ctx, 1 << PARAMS_SIZE_CLASS_STR);
+	paramsys_arena_header_t* arena = l_arena(ctx);
+	if (arena->capacity != PARAMS_ARENA_BYTES || arena->used > arena->capacity) {
+		memcpy(ctx->values + PARAMS_ARENA_REFS_OFFSET, params_defaults_image + PARAMS_ARENA_REFS_OFFSET,
+		       PARAMS_VALUES_LEN_BYTES - PARAMS_ARENA_REFS_OFFSET);
+		for (u32 i = 0; i < PARAMS_COUNT_ARENA; i++)
+			l_bitmap_mark(&changed, params_arena_params[i]);
+	}
+	for (u32 i = 0; i < PARAMS_COUNT_ARENA; i++) {
+		const paramsys_hot_t* hot = &params_hot[params_arena_params[i]];
+		paramsys_arena_ref_t* ref = l_arena_ref(ctx, hot);
+		if ((u64)ref->offset + ref->len > arena->used) {
+			u16 len;
+			const u8* def = l_arena_default(hot, &len);
+			*ref = {0, 0, 0};
+			bool unused;
+			if (l_arena_set(ctx, hot, def, len, false, &unused) != param_error_t::SUCCESS)
+				continue; // views held, try again next time
+			l_bitmap_mark(&changed, params_arena_params[i]);
+		} else if (ref->len > l_arena_max_len(hot)) {
+			ref->len = l_arena_max_len(hot);
+			l_bitmap_mark(&changed, params_arena_params[i]);
+		}
+	}
+	l_params_write_end_mask(ctx, 1 << PARAMS_SIZE_CLASS_STR);
+
+	param_index_t indices[64];
+	while (u32 count = l_bitmap_take(&changed, indices, ELEMENTS_IN_ARRAY(indices))) {
+		for (u32 i = 0; i < count; i++) {
+			if (fixed < max_count)
+				out_param_indices[fixed] = indices[i];
+			fixed++;
+			if (notify)
+				l_params_ctx_on_value_changed(ctx, indices[i]);
+		}
+	}
+	return fixed;
+}
+
+// Param bit first, summary bit second. l_bitmap_take clears them in the opposite order, so no bit is lost.
+// Return true if the summary bit was not set before, meaning a consumer may not know about this bit yet.
+bool l_bitmap_mark(l_param_bitmap_t* bitmap, param_index_t param_index) {
+	u32 word = param_index / 64;
+	__atomic_fetch_or(&bitmap->words[word], (u64)1 << (param_index % 64), __ATOMIC_RELEASE);
+	u64 bit = (u64)1 << (word % 64);
+	return !(__atomic_fetch_or(&bitmap->summary[word / 64], bit, __ATOMIC_RELEASE) & bit);
+}
+
+// Write up to max_count indices of set bits to out_param_indices in ascending order and clear them. Bits that didn't
+// fit stay set. With a mask (a bit per param, like the caller bitmaps) only the bits set in it are taken, the others
+// stay set as well.
+u32 l_bitmap_take(l_param_bitmap_t* bitmap, param_index_t* out_param_indices, u32 max_count, const u64* mask) {
+	u32 count = 0;
+
+	for (u32 s = 0; s < L_BITMAP_SUMMARY_WORDS; s++) {
+		if (!__atomic_load_n(&bitmap->summary[s], __ATOMIC_RELAXED))
+			continue;
+		u64 summary = __atomic_exchange_n(&bitmap->summary[s], 0, __ATOMIC_ACQUIRE);
+		u64 kept = 0; // summary bits of the words that still have bits outside the mask
+
+		while (summary) {
+			u32 word = s * 64 + __builtin_ctzll(summary);
+			summary &= summary - 1;
+			u64 word_mask = mask ? mask[word] : ~(u64)0;
+			u64 bits = __atomic_fetch_and(&bitmap->words[word], ~word_mask, __ATOMIC_ACQUIRE);
+			if (bits & ~word_mask)
+				kept |= (u64)1 << (word % 64);
+			bits &= word_mask;
+
+			while (bits && count < max_count) {
+				out_param_indices[count++] = word * 64 + __builtin_ctzll(bits);
+				bits &= bits - 1;
+			}
+
+			if (count == max_count) {
+				// out of room. put back whatever wasn't returned.
+				if (bits) {
+					__atomic_fetch_or(&bitmap->words[word], bits, __ATOMIC_RELEASE);
+					summary |= (u64)1 << (word % 64);
+				}
+				if (summary | kept)
+					__atomic_fetch_or(&bitmap->summary[s], summary | kept, __ATOMIC_RELEASE);
+				return count;
+			}
+		}
+		if (kept)
+			__atomic_fetch_or(&bitmap->summary[s], kept, __ATOMIC_RELEASE);
+	}
+	return count;
+}
+
+bool l_bitmap_any(l_param_bitmap_t* bitmap) {
+	for (u32 s = 0; s < L_BITMAP_SUMMARY_WORDS; s++)
+		if (__atomic_load_n(&bitmap->summary[s], __ATOMIC_RELAXED))
+			return true;
+	return false;
+}
+
+// Record the current value of a HISTORY param of the default instance. Called for every change, so no locks.
+static void l_history_record(param_index_t param_index) {
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	param_index_t r = params_history_ring_of[param_index];
+	const paramsys_history_ring_t* ring = &params_history_rings[r];
+	u8 size_class = l_hot_size_class(hot);
+
+	conv_t value = {}; // the entry stores all of it, not only the bytes of the size class
+	u32 s;
+	do {
+		s = l_seq_read_begin(&l_ctx_default, size_class);
+		l_hot_copy_value(size_class, &value, l_hot_get_value_ptr(&l_ctx_default, hot));
+	} while (l_seq_read_retry(&l_ctx_default, size_class, s));
+	i64 now = l_history_now_us();
+
+	u64 n = __atomic_fetch_add(&l_history_head[r], 1, __ATOMIC_RELAXED);
+	l_history_entry_t* e = &l_history_entries[ring->first_entry + n % ring->len];
+	__atomic_store_n(&e->seq, 2 * n + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&e->timestamp_us, now, __ATOMIC_RELAXED);
+	memcpy(e->value, &value, sizeof(e->value));
+	__atomic_store_n(&e->seq, 2 * n + 2, __ATOMIC_RELEASE);
+}
+
+i64 l_history_clock_realtime() {
+	timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (i64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Transactions. Linear search, a transaction has at most PARAMS_TXN_MAX_PARAMS params.
+
+u8* l_txn_find(params_txn_t* txn, param_index_t param_index) {
+	for (u32 i = 0; i < txn->count; i++)
+		if (txn->entries[i].param_index == param_index)
+			return txn->arena + txn->entries[i].pos;
+	return nullptr;
+}
+
+// The arena slot of the param, taken now if the param isn't staged yet. nullptr if the transaction is full.
+u8* l_txn_stage(params_txn_t* txn, param_index_t param_index, u32 len) {
+	if (u8* slot = l_txn_find(txn, param_index))
+		return slot;
+	if (txn->count == PARAMS_TXN_MAX_PARAMS || txn->arena_used + len > PARAMS_TXN_ARENA_BYTES) {
+		txn->overflow = true;
+		return nullptr;
+	}
+	txn->entries[txn->count++] = {param_index, txn->arena_used};
+	txn->size_class_mask |= 1 << l_hot_size_class(&params_hot[param_index]);
+	u8* slot = txn->arena + txn->arena_used;
+	txn->arena_used += len;
+	return slot;
+}
+
+// Profiles. l_profile_find, l_profile_valid, l_profile_find_entry and l_profiles_switch need l_profiles_mutex held.
+
+int l_profile_find(const char* name) {
+	for (int id = 1; id <= PARAMS_MAX_PROFILES; id++)
+		if (l_profiles[id].name[0] && strncmp(l_profiles[id].name, name, PARAMS_PROFILE_NAME_LEN) == 0)
+			return id;
+	return -1;
+}
+
+bool l_profile_valid(int profile) {
+	return profile >= 1 && profile <= PARAMS_MAX_PROFILES && l_profiles[profile].name[0];
+}
+
+l_override_t* l_profile_find_entry(l_profile_t* p, param_index_t param_index) {
+	u32 lo = 0, hi = p->count;
+	while (lo < hi) {
+		u32 mid = (lo + hi) / 2;
+		if (p->entries[mid].param_index < param_index) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo < p->count && p->entries[lo].param_index == param_index ? &p->entries[lo] : nullptr;
+}
+
+// memcpy with the common slot sizes inlined. most overrides are 1..8 byte values.
+inline void l_slot_copy(u8* dst, const u8* src, u32 len) {
+	switch (len) {
+		case 1: *dst = *src; break;
+		case 2: memcpy(dst, src, 2); break;
+		case 4: memcpy(dst, src, 4); break;
+		case 8: memcpy(dst, src, 8); break;
+		default: memcpy(dst, src, len);
+	}
+}
+
+// same effective value. strings by their current len, the rest of the slot doesn't matter.
+bool l_slot_equal(const paramsys_hot_t* hot, const u8* a, const u8* b, u32 len) {
+	if (l_hot_is_variable_size(hot))
+		return a[1] == b[1] && memcmp(a + 2, b + 2, a[1]) == 0;
+	switch (len) {
+		case 1: return *a == *b;
+		case 2: { u16 x, y; memcpy(&x, a, 2); memcpy(&y, b, 2); return x == y; }
+		case 4: { u32 x, y; memcpy(&x, a, 4); memcpy(&y, b, 4); return x == y; }
+		case 8: { u64 x, y; memcpy(&x, a, 8); memcpy(&y, b, 8); return x == y; }
+		default: return memcmp(a, b, len) == 0;
+	}
+}
+
+param_error_t l_profile_set_override(int profile, param_index_t param_index, const void* value, u32 len) {
+#ifdef PARAMS_CONCURRENT
+	std::lock_guard<std::mutex> lock(l_profiles_mutex);
+#endif
+	if (!l_profile_valid(profile))
+		return param_error_t::FAIL;
+	l_profile_t* p = &l_profiles[profile];
+	l_override_t* e = l_profile_find_entry(p, param_index);
+	bool added = !e;
+
+	if (added) {
+		l_override_t* entries = (l_override_t*)realloc(p->entries, (p->count + 1) * sizeof(l_override_t));
+		if (entries) p->entries = entries;
+		u8* data = (u8*)realloc(p->data, p->data_len + 2 * len);
+		if (data) p->data = data;
+		if (!entries || !data)
+			return param_error_t::FAIL;
+		u32 i = 0;
+		while (i < p->count && p->entries[i].param_index < param_index) i++;
+		memmove(&p->entries[i + 1], &p->entries[i], (p->count - i) * sizeof(l_override_t));
+		p->entries[i] = {param_index, (u16)len, p->data_len, false};
+		p->data_len += 2 * len;
+		p->count++;
+		e = &p->entries[i];
+	}
+	memcpy(p->data + e->pos, value, len);
+
+	if (l_profile_active != profile)
+		return param_error_t::SUCCESS;
+
+	// active: only this one param changes.
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	u8* slot = l_hot_get_value_ptr(&l_ctx_default, hot);
+	l_params_write_begin_mask(&l_ctx_default, 1 << l_hot_size_class(hot));
+	bool changed = !l_slot_equal(hot, slot, (u8*)value, len);
+	if (added) {
+		memcpy(p->data + e->pos + len, slot, len);
+		__atomic_store_n(&l_profile_source[param_index], (u8)profile, __ATOMIC_RELAXED);
+	}
+	memcpy(slot, value, len);
+	l_params_write_end_mask(&l_ctx_default, 1 << l_hot_size_class(hot));
+	if (changed)
+		l_params_mark_changed(param_index);
+	return param_error_t::SUCCESS;
 }
 
-inline const char* l_param_type_to_str(params_type_e param_type);
-inline u32         l_param_len_bytes(param_info_t* param_info);
-inline bool        l_param_is_variable_size(param_info_t* param_info);
-inline bool        l_param_has_no_default(param_info_t* param_info);
-inline void*       l_param_get_default_ptr(param_info_t* param_info);
-inline void*       l_param_get_value_ptr(param_info_t* param_info);
-inline u8*         l_param_get_default_str_ptr(param_info_t* param_info);
-inline u8*         l_param_get_value_str_ptr(param_info_t* param_info);
-void               l_params_set_str(param_info_t* param_info, const char* str, u8 str_len);
-param_error_t      l_params_copy_from_value(param_info_t* param_info, void* out_default);
-param_error_t      l_params_copy_to_value(param_info_t* param_info, void* in_value);
-param_error_t      l_params_copy_default(param_info_t* param_info, void* out_default);
-param_error_t      l_params_copy_defminmax_or_default(param_info_t* param_info, void* out_default);
-void               l_params_copy_from_defaults_str(param_info_t* param_info, u8* out_str);
-void               l_params_print_all(params_table_t* params_info);
+// Put the base values back under the active profile and the overrides of profile to over theirs. Only the params of
+// the two profiles are touched, and only those whose value differs afterwards are marked changed.
+void l_profiles_switch(int to) {
+	l_profile_t* from = l_profile_active ? &l_profiles[l_profile_active] : nullptr;
+	l_profile_t* into = to ? &l_profiles[to] : nullptr;
+	u8* values = l_ctx_default.values;
 
+	l_params_write_begin_mask(&l_ctx_default, (1 << PARAMS_SIZE_CLASS_COUNT) - 1);
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// public interface
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// 0xff marks the params of the old profile for the loops below.
+	for (u32 i = 0; from && i < from->count; i++) {
+		const l_override_t* e = &from->entries[i];
+		l_slot_copy(values + params_hot[e->param_index].value_offset, from->data + e->pos + e->len, e->len);
+		__atomic_store_n(&l_profile_source[e->param_index], 0xff, __ATOMIC_RELAXED);
+	}
+	for (u32 i = 0; into && i < into->count; i++) {
+		l_override_t* e = &into->entries[i];
+		const paramsys_hot_t* hot = &params_hot[e->param_index];
+		u8* slot = values + hot->value_offset;
+		u8* base = into->data + e->pos + e->len;
+		l_slot_copy(base, slot, e->len);
+		l_slot_copy(slot, into->data + e->pos, e->len);
+		// params of the old profile are compared with the old override below.
+		e->changed = l_profile_source[e->param_index] != 0xff && !l_slot_equal(hot, slot, base, e->len);
+		__atomic_store_n(&l_profile_source[e->param_index], (u8)to, __ATOMIC_RELAXED);
+	}
+	for (u32 i = 0; from && i < from->count; i++) {
+		l_override_t* e = &from->entries[i];
+		const paramsys_hot_t* hot = &params_hot[e->param_index];
+		if (l_profile_source[e->param_index] == 0xff)
+			__atomic_store_n(&l_profile_source[e->param_index], 0, __ATOMIC_RELAXED);
+		e->changed = !l_slot_equal(hot, values + hot->value_offset, from->data + e->pos, e->len);
+	}
+	__atomic_store_n(&l_profile_active, to, __ATOMIC_RELAXED);
 
+	l_params_write_end_mask(&l_ctx_default, (1 << PARAMS_SIZE_CLASS_COUNT) - 1);
 
-//void params_init(params_table_t* params_info) {
-void params_init() {
+	// not params_on_value_changed, the store keeps the base values. a param of both profiles is only in from->changed.
+	for (u32 i = 0; into && i < into->count; i++)
+		if (into->entries[i].changed)
+			l_params_mark_changed(into->entries[i].param_index);
+	for (u32 i = 0; from && i < from->count; i++)
+		if (from->entries[i].changed)
+			l_params_mark_changed(from->entries[i].param_index);
+}
 
-	// copy values from eeprom to ram. (TODO:)
-	// or, if first use, copy defaults to ram.
+// A write to a param of the active profile goes to the profile's override. Return false if no profile overrides it.
+bool l_profiles_capture(param_index_t param_index) {
+	if (!__atomic_load_n(&l_profile_source[param_index], __ATOMIC_RELAXED))
+		return false;
+#ifdef PARAMS_CONCURRENT
+	std::lock_guard<std::mutex> lock(l_profiles_mutex);
+#endif
+	u8 id = l_profile_source[param_index];
+	if (!id)
+		return false;
+	l_profile_t* p = &l_profiles[id];
+	const l_override_t* e = l_profile_find_entry(p, param_index);
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	const u8* slot = l_hot_get_value_ptr(&l_ctx_default, hot);
+	u32 s;
+	do {
+		s = l_seq_read_begin(&l_ctx_default, l_hot_size_class(hot));
+		memcpy(p->data + e->pos, slot, e->len);
+	} while (l_seq_read_retry(&l_ctx_default, l_hot_size_class(hot), s));
+	return true;
+}
 
-	for (int i = 0; i < ELEMENTS_IN_ARRAY(params_info.params_info); i++) {
+// Write the base values over the overrides of the active profile in a copy of the values memory.
+void l_profiles_patch_base(u8* values) {
+#ifdef PARAMS_CONCURRENT
+	std::lock_guard<std::mutex> lock(l_profiles_mutex);
+#endif
+	if (!l_profile_active)
+		return;
+	const l_profile_t* p = &l_profiles[l_profile_active];
+	for (u32 i = 0; i < p->count; i++) {
+		const l_override_t* e = &p->entries[i];
+		memcpy(values + params_hot[e->param_index].value_offset, p->data + e->pos + e->len, e->len);
+	}
+}
 
-		param_info_t* param_info = &params_info.params_info[i];
+int l_params_subscribe(const l_subscription_t* sub) {
+#ifdef PARAMS_CONCURRENT
+	std::lock_guard<std::mutex> lock(l_subscriptions_mutex);
+#endif
+	for (int i = 0; i < PARAMS_MAX_SUBSCRIPTIONS; i++) {
+		if (l_subscriptions[i].cb)
+			continue;
+		l_subscriptions[i] = *sub;
+		__atomic_fetch_add(&l_subscription_count, 1, __ATOMIC_RELAXED);
+		return i;
+	}
+	return -1;
+}
 
-		if (!l_param_is_variable_size(param_info)) {
+// Mark the param in the dirty bitmap and in the change log and, if anyone has subscribed, as pending for
+// params_dispatch.
+void l_params_mark_changed(param_index_t param_index) {
+	if (params_hot[param_index].flags & param_info_t::HISTORY)
+		l_history_record(param_index);
 
-			conv_t* cval = (conv_t*)l_param_get_value_ptr(param_info);
-			conv_t* cdef = (conv_t*)l_param_get_default_ptr(param_info);
+	l_bitmap_mark(&l_ctx_default.dirty, param_index);
 
-			param_error_t e = l_params_copy_default(param_info, l_param_get_value_ptr(param_info));
-			assert(e == param_error_t::SUCCESS);
+	u64 version = __atomic_add_fetch(&l_version, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&l_change_log[version % PARAMS_CHANGE_LOG_SIZE], version << L_CHANGE_LOG_INDEX_BITS | param_index,
+	                 __ATOMIC_RELEASE);
 
-		} else {
-			switch (param_info->type) {
-			case (u8)params_type_e::STR: {
-				u8* ptr = (u8*)l_param_get_value_str_ptr(param_info);
-				assert(ptr);
-				l_params_copy_from_defaults_str(param_info, ptr);
-				break;
-			}
-			default:
-				assert(false);
-			}
+	if (!__atomic_load_n(&l_subscription_count, __ATOMIC_RELAXED))
+		return;
+	bool wake = l_bitmap_mark(&l_pending, param_index);
+#ifdef PARAMS_CONCURRENT
+	// only the first change of a burst pays for waking up the dispatcher thread.
+	if (wake) {
+		{
+			std::lock_guard<std::mutex> lock(l_dispatcher_mutex);
+			l_dispatcher_wakeup = true;
 		}
+		l_dispatcher_cv.notify_one();
 	}
+#else
+	(void)wake;
+#endif
 }
 
-// return info about the param, including defaults and limits if present. does not return current value of the param.
-param_error_t params_get_info(u16 param_index, param_info_public_t* out_param_info) {
-	if (param_index > PARAMS_COUNT)
-		return param_error_t::NO_PARAM;
-	param_info_t* param_inf = &params_info.params_info[param_index];
+// params_on_value_changed for any instance. The others only have their dirty bitmap.
+void l_params_ctx_on_value_changed(paramsys_ctx_t* ctx, param_index_t param_index) {
+	if (ctx == &l_ctx_default)
+		params_on_value_changed(param_index);
+	else
+		l_bitmap_mark(&ctx->dirty, param_index);
+}
 
-	out_param_info->component      = param_inf->component;
-	out_param_info->type           = (params_type_e)param_inf->type;
-	out_param_info->security_level = param_inf->security_level;
-	out_param_info->name           = (const char*)param_inf->name;
-	out_param_info->has_minmax     = param_inf->flags & param_info_t::HAS_MINMAX;
+// Write section over one or more size classes. size_class_mask has bit (1 << PARAMS_SIZE_CLASS_*) set for every
+// class that is going to be written. Readers of all these classes retry until l_params_write_end_mask.
+void l_params_write_begin_mask(paramsys_ctx_t* ctx, u32 size_class_mask) {
+#ifdef PARAMS_CONCURRENT
+	ctx->write_mutex.lock();
+	for (u8 c = 0; c < PARAMS_SIZE_CLASS_COUNT; c++) {
+		if (!(size_class_mask & (1 << c))) continue;
+		u32 s = __atomic_load_n(&ctx->seq[c].seq, __ATOMIC_RELAXED);
+		__atomic_store_n(&ctx->seq[c].seq, s + 1, __ATOMIC_RELAXED);
+	}
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+#else
+	(void)ctx;
+	(void)size_class_mask;
+#endif
+}
 
-	if (!l_param_is_variable_size(param_inf)) {
-		param_error_t e = l_params_copy_defminmax_or_default(param_inf, &out_param_info->param_u8);
-		assert(e == param_error_t::SUCCESS);
-	} else {
-		switch (out_param_info->type) {
-		case params_type_e::STR:
-			out_param_info->param_str.max_len = params_info.defaults_str[param_inf->defaults_index];
-			out_param_info->param_str.len = params_info.defaults_str[param_inf->defaults_index + 1];
-			out_param_info->param_str.ptr = &params_info.defaults_str[param_inf->defaults_index + 2];
-			break;
-		default:
-			return param_error_t::NO_PARAM;
-		}
+void l_params_write_end_mask(paramsys_ctx_t* ctx, u32 size_class_mask) {
+#ifdef PARAMS_CONCURRENT
+	for (u8 c = 0; c < PARAMS_SIZE_CLASS_COUNT; c++) {
+		if (!(size_class_mask & (1 << c))) continue;
+		u32 s = __atomic_load_n(&ctx->seq[c].seq, __ATOMIC_RELAXED);
+		__atomic_store_n(&ctx->seq[c].seq, s + 1, __ATOMIC_RELEASE);
 	}
+	ctx->write_mutex.unlock();
+#else
+	(void)ctx;
+	(void)size_class_mask;
+#endif
+}
 
-	return param_error_t::SUCCESS;
+void paramsys_bind_valuemem(paramsys_valuemem_t* mem, paramsys_seq_t* seq, bool readonly) {
+#ifdef PARAMS_CONCURRENT
+	params_seq        = seq ? seq : l_seq_local;
+	l_ctx_default.seq = params_seq;
+#else
+	(void)seq;
+#endif
+	l_ctx_default.valuemem = mem;
+	l_ctx_default.values   = mem->values;
+	l_ctx_default.readonly = readonly;
+	params_values_readonly = readonly;
+	params_valuemem   = mem;
+	params_values_8   = mem->values;
+	params_values_16  = (u16*)((u8*)mem + mem->offsetof_16());
+	params_values_32  = (u32*)((u8*)mem + mem->offsetof_32());
+	params_values_64  = (u64*)((u8*)mem + mem->offsetof_64());
+	params_values_128 = (u8*)mem + mem->offsetof_128();
+	params_values_str = (u8*)mem + mem->offsetof_str();
+
+	for (auto& t : paramsys_type_table) {
+		switch (t.type_len) {
+		case 1:  t.values = params_values_8;   break;
+		case 2:  t.values = params_values_16;  break;
+		case 4:  t.values = params_values_32;  break;
+		case 8:  t.values = params_values_64;  break;
+		case 16: t.values = params_values_128; break;
+		default: break; // str
+		}
+	}
 }
 
-void params_print_all() {
-	l_params_print_all(&params_info);
+bool paramsys_valuemem_header_valid(const paramsys_valuemem_t* mem) {
+	return mem->component             == COMPONENT_PARAMS &&
+	       mem->packet_type           == P_PARAMS_VALUEMEM &&
+	       mem->packet_version        == params_values.packet_version &&
+	       mem->values_bytes_capacity == PARAMS_VALUES_CAPACITY_BYTES &&
+	       mem->values_bytes_used     == PARAMS_VALUES_LEN_BYTES &&
+	       mem->count_8               == PARAMS_COUNT_8 &&
+	       mem->count_16              == PARAMS_COUNT_16 &&
+	       mem->count_32              == PARAMS_COUNT_32 &&
+	       mem->count_64              == PARAMS_COUNT_64 &&
+	       mem->count_128             == PARAMS_COUNT_128 &&
+	       mem->count_str             == PARAMS_COUNT_STR &&
+	       mem->len_str               == PARAMS_VALUES_STR_BYTES;
 }
 
-param_error_t params_get(u16 param_index, params_type_e param_type, void* out_value) {
-	if (param_index > PARAMS_COUNT)
-		return param_error_t::NO_PARAM;
-	param_info_t* param_info = &params_info.params_info[param_index];
-	if (param_info->type != (u8)param_type)
-		return param_error_t::NO_PARAM;
+// byte offset of the size class values array from the start of mem. -1 for unknown lengths.
+static int l_valuemem_class_offset(const paramsys_valuemem_t* mem, u8 type_len) {
+	switch (type_len) {
+	case 1:  return mem->offsetof_8();
+	case 2:  return mem->offsetof_16();
+	case 4:  return mem->offsetof_32();
+	case 8:  return mem->offsetof_64();
+	case 16: return mem->offsetof_128();
+	default: return -1;
+	}
+}
 
-	param_error_t e = l_params_copy_from_value(param_info, out_value);
-	return e;
+static u32 l_valuemem_class_count(const paramsys_valuemem_t* mem, u8 type_len) {
+	switch (type_len) {
+	case 1:  return mem->count_8;
+	case 2:  return mem->count_16;
+	case 4:  return mem->count_32;
+	case 8:  return mem->count_64;
+	case 16: return mem->count_128;
+	default: return 0;
+	}
 }
 
-param_error_t params_set(u16 param_index, params_type_e param_type, void* valueptr) {
-	if (param_index > PARAMS_COUNT)
-		return param_error_t::NO_PARAM;
-	param_info_t *param_info = &params_info.params_info[param_index];
-	if (param_info->type != (u8) param_type)
-		return param_error_t::NO_PARAM;
+bool paramsys_migrate(const paramsys_valuemem_t* old_mem, const paramsys_layout_entry_t* old_layout, u32 old_count,
+                      paramsys_valuemem_t* mem, const paramsys_layout_entry_t* layout, u32 count) {
+	// the old size class regions have to be inside the used part of the old values.
+	u32 old_end = old_mem->offsetof_8() + old_mem->values_bytes_used;
+	if ((u32)old_mem->offsetof_str() + old_mem->len_str > old_end)
+		return false;
+	// the old arena, if there is one, has to be inside too, and every old STR16/BUF ref inside its used part.
+	paramsys_arena_header_t old_arena = {0, 0};
+	if (old_mem->has_arena()) {
+		memcpy(&old_arena, (const u8*)old_mem + old_mem->offsetof_arena(), sizeof(old_arena));
+		if (old_arena.used > old_arena.capacity ||
+		    (u64)old_mem->offsetof_arena() + sizeof(old_arena) + old_arena.capacity > old_end)
+			return false;
+	}
+	const u8* old_arena_bytes = (const u8*)old_mem + old_mem->offsetof_arena() + sizeof(old_arena);
+	for (u32 i = 0; i < old_count; i++) {
+		const paramsys_layout_entry_t* o = &old_layout[i];
+		if (o->type == (u8)params_type_e::STR) {
+			if ((u32)o->value_index + 2 + o->str_max_len > old_mem->len_str)
+				return false;
+		} else if (paramsys_type_is_arena(o->type)) {
+			if ((u32)o->value_index + sizeof(paramsys_arena_ref_t) > old_mem->len_str)
+				return false;
+			paramsys_arena_ref_t ref;
+			memcpy(&ref, (const u8*)old_mem + old_mem->offsetof_str() + o->value_index, sizeof(ref));
+			if ((u64)ref.offset + ref.len > old_arena.used)
+				return false;
+		} else {
+			u8 type_len = paramsys_type_len((params_type_e)o->type);
+			if (!type_len || o->value_index >= l_valuemem_class_count(old_mem, type_len))
+				return false;
+		}
+	}
 
-	u32 value_len = l_param_len_bytes(param_info);
-	conv_t val; // temporary. used when value has to be clamped.
-	void* validated_value;
+	// values array of every fixed-size type in the old and in the new memory, so the loop doesn't recalculate them.
+	const u8* src_values[(u8)params_type_e::LAST];
+	u8* dst_values[(u8)params_type_e::LAST];
+	for (u8 t = 0; t < (u8)params_type_e::LAST; t++) {
+		u8 type_len = paramsys_type_table[t].type_len;
+		src_values[t] = type_len ? (const u8*)old_mem + l_valuemem_class_offset(old_mem, type_len) : nullptr;
+		dst_values[t] = type_len ? (u8*)mem + l_valuemem_class_offset(mem, type_len) : nullptr;
+	}
+	const u8* src_str = (const u8*)old_mem + old_mem->offsetof_str();
+	u8* dst_str = (u8*)mem + mem->offsetof_str();
+	if (old_count > count)
+		old_count = count;
+
+	// the new arena is rebuilt in a scratch copy: its refs point to the defaults, and the defaults have to stay
+	// readable until every param has been moved. the max_len of the new params isn't in the layout, values longer
+	// than that are cut by l_params_validate_all after the migration. a value that doesn't fit the rest of the arena
+	// is cut to what fits.
+	paramsys_arena_header_t* arena =
+		mem->has_arena() ? (paramsys_arena_header_t*)((u8*)mem + mem->offsetof_arena()) : nullptr;
+	u8* arena_bytes = arena ? (u8*)(arena + 1) : nullptr;
+	u8* scratch = nullptr;
+	u32 scratch_used = 0;
+	for (u32 i = 0; arena && !scratch && i < count; i++)
+		if (paramsys_type_is_arena(layout[i].type))
+			scratch = (u8*)malloc(arena->capacity ? arena->capacity : 1);
+
+	for (u32 i = 0; scratch && i < count; i++) {
+		const paramsys_layout_entry_t* n = &layout[i];
+		if (!paramsys_type_is_arena(n->type))
+			continue;
+		paramsys_arena_ref_t* ref = (paramsys_arena_ref_t*)(dst_str + n->value_index);
+		const u8* src = arena_bytes + ref->offset; // the default
+		u32 len = (u64)ref->offset + ref->len <= arena->used ? ref->len : 0;
+		const paramsys_layout_entry_t* o = i < old_count ? &old_layout[i] : nullptr;
+		if (o && o->type == n->type) {
+			paramsys_arena_ref_t old_ref;
+			memcpy(&old_ref, src_str + o->value_index, sizeof(old_ref));
+			src = old_arena_bytes + old_ref.offset;
+			len = old_ref.len;
+		} else if (o && o->type == (u8)params_type_e::STR && n->type == (u8)params_type_e::STR16) {
+			// a string that outgrew 255 bytes keeps its value.
+			src = src_str + o->value_index + 2;
+			len = src[-1] < o->str_max_len ? src[-1] : o->str_max_len;
+		}
+		if (len > arena->capacity - scratch_used)
+			len = arena->capacity - scratch_used;
+		memcpy(scratch + scratch_used, src, len);
+		*ref = {scratch_used, (u16)len, 0};
+		scratch_used += len;
+	}
+	if (scratch) {
+		memcpy(arena_bytes, scratch, scratch_used);
+		arena->used = scratch_used;
+		free(scratch);
+	}
 
-	// if param has_minmax:
-	//     copy value to internal buf
-	//     apply limits to the value in internal buf
-	//     point validated_value to the resulting value
-	// else:
-	//     point validated_value to the wanted value given by the user
-	//
-	// if validated_value is different from the real RAM values* buf:
-	//     set the param VALUE_CHANGED flag
-	//
-	// copy validated_value to RAM values* buf.
+	for (u32 i = 0; i < old_count; i++) {
+		const paramsys_layout_entry_t* o = &old_layout[i];
+		const paramsys_layout_entry_t* n = &layout[i];
+		if (o->type != n->type || paramsys_type_is_arena(n->type))
+			continue; // type changed, keep the default. arena values are done above
+
+		if (n->type == (u8)params_type_e::STR) {
+			const u8* src = src_str + o->value_index;
+			u8* dst = dst_str + n->value_index;
+			u8 len = src[1];
+			if (len > o->str_max_len) len = o->str_max_len;
+			if (len > n->str_max_len) len = n->str_max_len;
+			dst[0] = n->str_max_len;
+			dst[1] = len;
+			memcpy(dst + 2, src + 2, len);
+		} else {
+			u8 type_len = paramsys_type_table[n->type].type_len;
+			memcpy(dst_values[n->type] + n->value_index * type_len, src_values[n->type] + o->value_index * type_len,
+			       type_len);
+		}
+	}
+	return true;
+}
 
-	bool has_minmax = param_info->flags & param_info_t::HAS_MINMAX;
+u32 paramsys_write_value_entry(param_index_t param_index, u8* out, u32 out_max) {
+	if (param_index >= PARAMS_COUNT)
+		return 0;
+	param_info_t* param_info = &params_info.params_info[param_index];
+	if (param_info->flags & param_info_t::DISABLED)
+		return 0;
+
+	// the entry after the param index
+	u8* e = out + PARAMS_ENTRY_INDEX_LEN;
+	if (paramsys_type_is_arena(param_info->type)) {
+		// max_len can be more than a packet. check the room against the current len, read together with the bytes.
+		const u32 header_len = PARAMS_VALUE_ENTRY_HEADER_LEN + 1; // u16 len
+		const paramsys_hot_t* hot = &params_hot[param_index];
+		u32 len;
+		bool fits;
+		u32 s;
+		do {
+			s = params_seq_read_begin(PARAMS_SIZE_CLASS_STR);
+			paramsys_arena_ref_t ref = *l_arena_ref(&l_ctx_default, hot);
+			len = ref.len;
+			fits = header_len + len <= out_max && (u64)ref.offset + len <= PARAMS_ARENA_BYTES;
+			if (fits) {
+				memcpy(out, &param_index, PARAMS_ENTRY_INDEX_LEN);
+				e[0] = param_info->type;
+				memcpy(e + 1, &ref.len, 2);
+				memcpy(e + 3, l_arena_bytes(&l_ctx_default) + ref.offset, len);
+			}
+		} while (params_seq_read_retry(PARAMS_SIZE_CLASS_STR, s));
+		return fits ? header_len + len : 0;
+	}
 
-	// If has_minmax, then we need to copy the wanted value to local buf in order to apply the minmax limits.
-	// Otherwise we'd overwrite the value given us by the user in *valueptr, and that's not ok.
-	if (has_minmax) {
+	// check the room against the max len of strings, the current len can be torn until the read section is over.
+	bool variable_size = l_param_is_variable_size(param_info);
+	u32 max_len = variable_size ? l_param_get_value_str_ptr(param_info)[0] : l_param_len_bytes(param_info);
+	if (PARAMS_VALUE_ENTRY_HEADER_LEN + max_len > out_max)
+		return 0;
+
+	u8 size_class = l_param_size_class(param_info);
+	u32 len;
+	u32 s;
+	do {
+		s = params_seq_read_begin(size_class);
+		memcpy(out, &param_index, PARAMS_ENTRY_INDEX_LEN);
+		e[0] = param_info->type;
+		if (!variable_size) {
+			// a copy of known size per size class, not a memcpy call per value. export goes through here for every param.
+			len = max_len;
+			l_hot_copy_value(size_class, e + 2, l_param_get_value_ptr(param_info));
+		} else {
+			const u8* src = l_param_get_value_str_ptr(param_info);
+			len = src[1];
+			if (len > max_len) len = max_len;
+			memcpy(e + 2, src + 2, len);
+		}
+		e[1] = len;
+	} while (params_seq_read_retry(size_class, s));
+	return PARAMS_VALUE_ENTRY_HEADER_LEN + len;
+}
 
-		memcpy(&val, valueptr, value_len);
-		void* default_ptr = l_param_get_default_ptr(param_info);
+u32 paramsys_value_entry_max_len() {
+	return PARAMS_VALUE_ENTRY_HEADER_LEN + (PARAMS_ARENA_MAX_LEN + 1 > 255 ? PARAMS_ARENA_MAX_LEN + 1 : 255);
+}
 
-		switch (param_type) {
-		case params_type_e::U8: {
-			auto d = (defminmax_u8_t *) default_ptr;
-			val.u8_0 = l_clamp(val.u8_0, d->min, d->max);
-			break;
-		}
-		case params_type_e::U16: {
-			auto d = (defminmax_u16_t *) default_ptr;
-			val.u16_0 = l_clamp(val.u16_0, d->min, d->max);
-			break;
-		}
-		case params_type_e::U32: {
-			auto d = (defminmax_u32_t *) default_ptr;
-			val.u32_0 = l_clamp(val.u32_0, d->min, d->max);
-			break;
-		}
-		case params_type_e::U64: {
-			auto d = (defminmax_u64_t *) default_ptr;
-			val.u64_0 = l_clamp(val.u64_0, d->min, d->max);
-			break;
-		}
-		case params_type_e::I8: {
-			auto d = (defminmax_i8_t *) default_ptr;
-			val.i8_0 = l_clamp(val.i8_0, d->min, d->max);
-			break;
-		}
-		case params_type_e::I16: {
-			auto d = (defminmax_i16_t *) default_ptr;
-			val.i16_0 = l_clamp(val.i16_0, d->min, d->max);
-			break;
-		}
-		case params_type_e::I32: {
-			auto d = (defminmax_i32_t *) default_ptr;
-			val.i32_0 = l_clamp(val.i32_0, d->min, d->max);
-			break;
-		}
-		case params_type_e::I64: {
-			auto d = (defminmax_i64_t *) default_ptr;
-			val.i64_0 = l_clamp(val.i64_0, d->min, d->max);
-			break;
-		}
-		case params_type_e::F32: {
-			auto d = (defminmax_f32_t *) default_ptr;
-			val.f32_0 = l_clamp(val.f32_0, d->min, d->max);
-			break;
+u32 paramsys_write_value_entries(param_index_t first_param_index, param_index_t last_param_index, u8* out, u32 out_max,
+                                 u32* out_next_param_index, const u64* readable) {
+	u32 pos = 0;
+	u32 last = last_param_index < PARAMS_COUNT ? last_param_index : PARAMS_COUNT - 1;
+	*out_next_param_index = (u32)last_param_index + 1;
+	for (u32 i = first_param_index; i <= last; i++) {
+		if (readable) {
+			// jump to the next param the caller can see, a word of 64 params at a time.
+			u64 word = readable[i >> 6] >> (i & 63);
+			if (!word) {
+				i |= 63;
+				continue;
+			}
+			i += __builtin_ctzll(word);
+			if (i > last)
+				break;
 		}
-		case params_type_e::F64: {
-			auto d = (defminmax_f64_t *) default_ptr;
-			val.f64_0 = l_clamp(val.f64_0, d->min, d->max);
+		if (params_info.params_info[i].flags & param_info_t::DISABLED)
+			continue;
+		u32 len = paramsys_write_value_entry(i, out + pos, out_max - pos);
+		if (!len) {
+			*out_next_param_index = i;
 			break;
 		}
-		default:
-			assert(false);
-			return param_error_t::NO_PARAM;
-		}
-
-		validated_value = &val;
-
-	} else {
-		validated_value = valueptr;
+		pos += len;
 	}
+	return pos;
+}
 
-	void* param_value_ptr = l_param_get_value_ptr(param_info);
-	assert(param_value_ptr);
-
-	// Check if current value and wanted value differ.
-	if (memcmp(validated_value, param_value_ptr, value_len) != 0) {
-		param_info->flags |= param_info_t::VALUE_CHANGED;
+u32 paramsys_write_info_entry(param_index_t param_index, u8* out, u32 out_max) {
+	if (param_index >= PARAMS_COUNT)
+		return 0;
+	param_info_t* param_info = &params_info.params_info[param_index];
+	if (param_info->flags & param_info_t::DISABLED)
+		return 0;
+
+	u8 name_len = strnlen(param_info->name, sizeof(param_info->name));
+	// the entry after the param index
+	u8* e = out + PARAMS_ENTRY_INDEX_LEN;
+	if (paramsys_type_is_arena(param_info->type)) {
+		// u16 max_len and len, no limits.
+		u16 max_len = l_arena_max_len(&params_hot[param_index]);
+		u16 len;
+		const u8* def = l_arena_default(&params_hot[param_index], &len);
+		u32 total = PARAMS_ENTRY_INDEX_LEN + 9 + name_len + len;
+		if (total > out_max)
+			return 0;
+		memcpy(out, &param_index, PARAMS_ENTRY_INDEX_LEN);
+		e[0] = param_info->type;
+		e[1] = param_info->component;
+		e[2] = param_info->security_level;
+		e[3] = 0;
+		memcpy(e + 4, &max_len, 2);
+		e[6] = name_len;
+		memcpy(e + 7, param_info->name, name_len);
+		memcpy(e + 7 + name_len, &len, 2);
+		memcpy(e + 9 + name_len, def, len);
+		return total;
 	}
+	bool has_minmax = param_info->flags & param_info_t::HAS_MINMAX;
+	bool variable_size = l_param_is_variable_size(param_info);
+	u8* default_str = variable_size ? l_param_get_default_str_ptr(param_info) : nullptr;
+	u8 max_len = variable_size ? default_str[0] : l_param_len_bytes(param_info);
+	u8 len = variable_size ? default_str[1] : max_len;
+	u32 values_len = (has_minmax ? 3 : 1) * len;
+	u32 total = PARAMS_ENTRY_INDEX_LEN + 7 + name_len + values_len;
+	if (total > out_max)
+		return 0;
+
+	memcpy(out, &param_index, PARAMS_ENTRY_INDEX_LEN);
+	e[0] = param_info->type;
+	e[1] = param_info->component;
+	e[2] = param_info->security_level;
+	e[3] = has_minmax;
+	e[4] = max_len;
+	e[5] = name_len;
+	memcpy(e + 6, param_info->name, name_len);
+	e[6 + name_len] = len;
+	if (variable_size)
+		memcpy(e + 7 + name_len, default_str + 2, len);
+	else
+		l_params_copy_defminmax_or_default(param_info, e + 7 + name_len); // zeroes if there's no default
+	return total;
+}
 
-	// copy wanted value to the current values array.
-	memcpy(param_value_ptr, validated_value, value_len);
+u8 paramsys_type_len(params_type_e type) {
+	if ((u8)type & PARAMS_TYPE_IS_VARIABLE_SIZE_bit)
+		return 0;
+	if ((u8)type >= (u8)params_type_e::LAST)
+		return 0;
+	return paramsys_type_table[(u8)type].type_len;
+}
 
-	return param_error_t::SUCCESS;
+bool paramsys_param_desc(param_index_t param_index, const char** out_name, params_type_e* out_type) {
+	if (param_index >= PARAMS_COUNT || params_info.params_info[param_index].flags & param_info_t::DISABLED)
+		return false;
+	*out_name = params_info.params_info[param_index].name;
+	*out_type = (params_type_e)params_hot[param_index].type;
+	return true;
 }
 
-param_error_t params_get_str(u16 param_index, const char** out_str, u8* out_str_len) {
-	if (param_index > PARAMS_COUNT)
-		return param_error_t::NO_PARAM;
+// Write the current value of the param to the store journal.
+void l_params_store_append(param_index_t param_index) {
 	param_info_t* param_info = &params_info.params_info[param_index];
-	if (param_info->type != (u8)params_type_e::STR)
-		return param_error_t::NO_PARAM;
 
-	u8* src = l_param_get_value_str_ptr(param_info);
-	*out_str_len = src[1];
-	*out_str = (char*)src + 2;
+	if (!l_param_is_variable_size(param_info)) {
+		l_store->append(l_store, param_index, (u8*)l_param_get_value_ptr(param_info), l_param_len_bytes(param_info));
+	} else if (paramsys_type_is_arena(param_info->type)) {
+		paramsys_arena_ref_t ref = *l_arena_ref(&l_ctx_default, &params_hot[param_index]);
+		if ((u64)ref.offset + ref.len <= PARAMS_ARENA_BYTES)
+			l_store->append(l_store, param_index, l_arena_bytes(&l_ctx_default) + ref.offset, ref.len);
+	} else {
+		u8* src = l_param_get_value_str_ptr(param_info);
+		l_store->append(l_store, param_index, src + 2, src[1]);
+	}
+}
 
-	return param_error_t::SUCCESS;
+void l_params_store_maybe_compact() {
+	if (l_store->journal_bytes > l_store->compact_threshold_bytes)
+		params_store_compact();
 }
 
-param_error_t params_set_str(u16 param_index, const char* str, u8 str_len) {
-	if (param_index > PARAMS_COUNT)
-		return param_error_t::NO_PARAM;
-	param_info_t* param_info = &params_info.params_info[param_index];
-	if (param_info->type != (u8)params_type_e::STR)
-		return param_error_t::NO_PARAM;
+// Load a store snapshot (see params_init_from_store) into the values memory. Return true if it had an older layout
+// and was migrated. An image that can't be used is ignored, the values stay as they are.
+bool l_params_load_snapshot(const u8* image, u32 len) {
+	const paramsys_valuemem_t* mem = (const paramsys_valuemem_t*)image;
+	const u32 header_len = offsetof(paramsys_valuemem_t, values);
+	if (len < header_len)
+		return false;
+
+	// written before the snapshots had a layout descriptor. usable only if the layout is exactly ours.
+	if (len == header_len + PARAMS_VALUES_LEN_BYTES && paramsys_valuemem_header_valid(mem)) {
+		memcpy(params_valuemem->values, mem->values, PARAMS_VALUES_LEN_BYTES);
+		return false;
+	}
 
-	l_params_set_str(param_info, str, str_len);
-	return param_error_t::SUCCESS;
+	if (mem->component != COMPONENT_PARAMS || mem->packet_type != P_PARAMS_VALUEMEM ||
+	    mem->packet_version != params_values.packet_version ||
+	    mem->values_bytes_used > PARAMS_VALUES_CAPACITY_BYTES || len < header_len + mem->values_bytes_used + 4)
+		return false;
+	u32 layout_pos = header_len + mem->values_bytes_used;
+	u32 layout_count;
+	memcpy(&layout_count, image + layout_pos, 4);
+	if (layout_count > PARAMS_MAX_COUNT || len != layout_pos + 4 + layout_count * sizeof(paramsys_layout_entry_t))
+		return false;
+	const paramsys_layout_entry_t* layout = (const paramsys_layout_entry_t*)(image + layout_pos + 4);
+
+	if (layout_count == PARAMS_COUNT && paramsys_valuemem_header_valid(mem) &&
+	    memcmp(layout, params_layout, sizeof(params_layout)) == 0) {
+		memcpy(params_valuemem->values, mem->values, PARAMS_VALUES_LEN_BYTES);
+		return false;
+	}
+
+	return paramsys_migrate(mem, layout, layout_count, params_valuemem, params_layout, PARAMS_COUNT);
 }
 
+// Journal replay callback. Every record is written raw in a write section of its size class, like the snapshot
+// before it: no change tracking, history or subscriptions, and fixed-size values are clamped already here. The
+// validate pass of params_init_from_store after the replay brings all of them within the current limits. Records that
+// don't match the param type anymore and records of disabled params are skipped.
+void l_params_store_apply(u32 param_index, const u8* value, u16 len) {
+	if (param_index >= PARAMS_COUNT)
+		return;
+	const paramsys_hot_t* hot = &params_hot[param_index];
+	if (hot->flags & param_info_t::DISABLED)
+		return;
+	u32 size_class_mask = 1 << l_hot_size_class(hot);
+
+	if (!l_hot_is_variable_size(hot)) {
+		if (len != l_hot_len_bytes(hot))
+			return;
+		l_params_write_begin_mask(&l_ctx_default, size_class_mask);
+		l_params_write_value(&l_ctx_default, hot, value);
+		l_params_write_end_mask(&l_ctx_default, size_class_mask);
+	} else if (hot->type == (u8)params_type_e::STR) {
+		if (len > 0xff)
+			return;
+		l_params_write_begin_mask(&l_ctx_default, size_class_mask);
+		l_params_set_str(&l_ctx_default, hot, (const char*)value, len);
+		l_params_write_end_mask(&l_ctx_default, size_class_mask);
+	} else if (paramsys_type_is_arena(hot->type)) {
+		// a damaged snapshot can leave a broken arena header or a ref that points outside the arena, l_arena_set
+		// can't work on those. l_arena_validate fixes them after the replay, the record is lost.
+		paramsys_arena_header_t* arena = l_arena(&l_ctx_default);
+		const paramsys_arena_ref_t* ref = l_arena_ref(&l_ctx_default, hot);
+		if (arena->capacity != PARAMS_ARENA_BYTES || arena->used > arena->capacity ||
+		    (u64)ref->offset + ref->len > arena->used)
+			return;
+		bool unused;
+		l_params_write_begin_mask(&l_ctx_default, size_class_mask);
+		param_error_t e = l_arena_set(&l_ctx_default, hot, value, len, false, &unused);
+		l_params_write_end_mask(&l_ctx_default, size_class_mask);
+		// FAIL only if a compaction can't take the arena lock, and no view can be held before init is done.
+		assert(e == param_error_t::SUCCESS);
+		(void)e;
+	}
+}
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// private functions
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Clamp the value if the param has limits and write it to the values memory. Works only for fixed-size types.
+// Has to be called inside a write section. Return true if the value changed.
+bool l_params_write_value(paramsys_ctx_t* ctx, const paramsys_hot_t* hot, const void* valueptr) {
+	u32 value_len = l_hot_len_bytes(hot);
+	conv_t val; // temporary. used when value has to be clamped.
+	void* validated_value;
 
+	// if param has_minmax:
+	//     copy value to internal buf
+	//     apply limits to the value in internal buf
+	//     point validated_value to the resulting value
+	// else:
+	//     point validated_value to the wanted value given by the user
+	//
+	// if validated_value is different from the real RAM values* buf:
+	//     copy validated_value to RAM values* buf
+	//     return true, so that the caller can mark the param changed (params_on_value_changed)
 
-inline const char* l_param_type_to_str(params_type_e param_type) {
-	assert(((u8)param_type & PARAMS_TYPE_INDEX_mask) < (u8)params_type_e::LAST);
-	return paramsys_type_table[(u8)param_type & PARAMS_TYPE_INDEX_mask].type_name;
-}
+	bool has_minmax = hot->flags & param_info_t::HAS_MINMAX;
 
-// returns 0 for any variable-size types (like str)
-inline u32 l_param_len_bytes(param_info_t* param_info) {
-	return paramsys_type_table[(u8)param_info->type & PARAMS_TYPE_INDEX_mask].type_len;
-}
+	// If has_minmax, then we need to copy the wanted value to local buf in order to apply the minmax limits.
+	// Otherwise we'd overwrite the value given us by the user in *valueptr, and that's not ok.
+	if (has_minmax) {
 
-inline bool l_param_is_variable_size(param_info_t* param_info) {
-	return param_info->type & PARAMS_TYPE_IS_VARIABLE_SIZE_bit;
-}
+		memcpy(&val, valueptr, value_len);
+		if (!l_params_apply_limits(hot, &val))
+			return false;
 
-inline bool l_param_has_no_default(param_info_t* param_info) {
-	return (param_info->flags & param_info_t::NO_DEFAULT) || (param_info->flags & param_info_t::DISABLED);
-}
+		validated_value = &val;
 
-// Return pointer to the default value. Does no error-checking, so returns garbage if no default exists.
-inline void* l_param_get_default_ptr(param_info_t* param_info) {
-	if (param_info->flags & param_info_t::HAS_MINMAX) {
-		return (u8*)paramsys_type_table[(u8)param_info->type & PARAMS_TYPE_INDEX_mask].defminmax +
-			l_param_len_bytes(param_info) * param_info->defaults_index * 3;
 	} else {
-		return (u8*)paramsys_type_table[(u8)param_info->type & PARAMS_TYPE_INDEX_mask].defaults +
-			l_param_len_bytes(param_info) * param_info->defaults_index;
+		validated_value = (void*)valueptr;
 	}
-}
-
-inline void* l_param_get_value_ptr(param_info_t* param_info) {
-	return (u8*)paramsys_type_table[(u8) param_info->type & PARAMS_TYPE_INDEX_mask].values +
-		l_param_len_bytes(param_info) * param_info->value_index;
-}
 
-// return nullptr if the str has no default
-inline u8* l_param_get_default_str_ptr(param_info_t* param_info) {
-	assert(l_param_is_variable_size(param_info));
-	return &params_info.defaults_str[param_info->defaults_index];
-}
+	void* param_value_ptr = l_hot_get_value_ptr(ctx, hot);
 
-// return nullptr if the str has no default
-inline u8* l_param_get_value_str_ptr(param_info_t* param_info) {
-	assert(l_param_is_variable_size(param_info));
-	return &params_values_str[param_info->value_index];
+	// Check if current value and wanted value differ. If yes, copy wanted value to the current values array.
+	if (memcmp(validated_value, param_value_ptr, value_len) == 0)
+		return false;
+	memcpy(param_value_ptr, validated_value, value_len);
+	return true;
 }
 
-// TODO: rename str to buf? str should always have a terminating zero?
-// str_len is without terminating zero.
-void l_params_set_str(param_info_t* param_info, const char* str, u8 str_len) {
-	u8* dst = l_param_get_value_str_ptr(param_info);
-	u8 max_len = dst[0];
-	assert(params_info.defaults_str[param_info->defaults_index] == max_len);
-	if (str_len > max_len) str_len = max_len;
-	dst[1] = str_len;
-	memcpy(dst+2, str, str_len);
 
-	// TODO: check if changed and set the changed flag.
+// Apply the min/max limits of a HAS_MINMAX param to the value in val, in place. Goes straight to the defminmax_*
+// array of the type. NaN and inf become the default, like in params_validate_all. Return false if the param type can't
+// have limits.
+bool l_params_apply_limits(const paramsys_hot_t* hot, conv_t* val) {
+	switch ((params_type_e)hot->type) {
+	case params_type_e::U8: {
+		auto d = (defminmax_u8_t*)defminmax_8 + hot->defaults_index;
+		val->u8_0 = param_clamp(val->u8_0, d->min, d->max);
+		break;
+	}
+	case params_type_e::U16: {
+		auto d = (defminmax_u16_t*)defminmax_16 + hot->defaults_index;
+		val->u16_0 = param_clamp(val->u16_0, d->min, d->max);
+		break;
+	}
+	case params_type_e::U32: {
+		auto d = (defminmax_u32_t*)defminmax_32 + hot->defaults_index;
+		val->u32_0 = param_clamp(val->u32_0, d->min, d->max);
+		break;
+	}
+	case params_type_e::U64: {
+		auto d = (defminmax_u64_t*)defminmax_64 + hot->defaults_index;
+		val->u64_0 = param_clamp(val->u64_0, d->min, d->max);
+		break;
+	}
+	case params_type_e::I8: {
+		auto d = (defminmax_i8_t*)defminmax_8 + hot->defaults_index;
+		val->i8_0 = param_clamp(val->i8_0, d->min, d->max);
+		break;
+	}
+	case params_type_e::I16: {
+		auto d = (defminmax_i16_t*)defminmax_16 + hot->defaults_index;
+		val->i16_0 = param_clamp(val->i16_0, d->min, d->max);
+		break;
+	}
+	case params_type_e::I32: {
+		auto d = (defminmax_i32_t*)defminmax_32 + hot->defaults_index;
+		val->i32_0 = param_clamp(val->i32_0, d->min, d->max);
+		break;
+	}
+	case params_type_e::I64: {
+		auto d = (defminmax_i64_t*)defminmax_64 + hot->defaults_index;
+		val->i64_0 = param_clamp(val->i64_0, d->min, d->max);
+		break;
+	}
+	case params_type_e::F32: {
+		auto d = (defminmax_f32_t*)defminmax_32 + hot->defaults_index;
+		val->f32_0 = isfinite(val->f32_0) ? param_clamp(val->f32_0, d->min, d->max) : d->default_val;
+		break;
+	}
+	case params_type_e::F64: {
+		auto d = (defminmax_f64_t*)defminmax_64 + hot->defaults_index;
+		val->f64_0 = isfinite(val->f64_0) ? param_clamp(val->f64_0, d->min, d->max) : d->default_val;
+		break;
+	}
+	default:
+		assert(false);
+		return false;
+	}
+	return true;
 }
 
 // Copy param value from internal RAM param values buf to out_value. Works only for fixed-size types.
@@ -583,6 +3405,18 @@ void l_params_copy_from_defaults_str(param_info_t* param_info, u8* out_str) {
 	memcpy(out_str+2, src+2, str_len);
 }
 
+// Hex of the first bytes of data, as many as fit into dst. Zero-terminated.
+void l_bytes_to_hex_prefix(const u8* data, u16 len, char* dst, u32 dst_max_len) {
+	static const char digits[] = "0123456789abcdef";
+	u32 n = (dst_max_len - 1) / 2;
+	if (n > len) n = len;
+	for (u32 i = 0; i < n; i++) {
+		dst[2 * i] = digits[data[i] >> 4];
+		dst[2 * i + 1] = digits[data[i] & 0xf];
+	}
+	dst[2 * n] = 0;
+}
+
 void l_build_param_info_base_str(param_info_t* param_info, const char* prefix, char* dst, u32 dst_max_len) {
 	assert(param_info);
 	const char* type_str = l_param_type_to_str((params_type_e)param_info->type);
@@ -592,6 +3426,8 @@ void l_build_param_info_base_str(param_info_t* param_info, const char* prefix, c
 
 void l_params_print_all(params_table_t* params_info) {
 	if (!params_info) return;
+	// str16 and buf values are copied in here. a view doesn't work in a read-only instance, a copy does.
+	u8* bytes = (u8*)malloc(PARAMS_ARENA_MAX_LEN + 1);
 
 	for (int i = 0; i < ELEMENTS_IN_ARRAY(params_info->params_info); i++) {
 
@@ -756,8 +3592,35 @@ void l_params_print_all(params_table_t* params_info) {
 				       param_inf.param_str.len, param_inf.param_str.ptr);
 				break;
 			}
+			case params_type_e::STR16: {
+				u16 len;
+				if (!bytes || params_get_bytes_copy(i, bytes, PARAMS_ARENA_MAX_LEN, &len) != param_error_t::SUCCESS) {
+					printf("ERROR ASSERT\n");
+					break;
+				}
+				printf("%sval '%.*s' def '%.*s'\n", base_str, len, (const char*)bytes,
+				       param_inf.param_buf.len, param_inf.param_buf.ptr);
+				break;
+			}
+			case params_type_e::BUF: {
+				// first bytes in hex, the whole thing can be kilobytes.
+				u16 len;
+				if (!bytes || params_get_bytes_copy(i, bytes, PARAMS_ARENA_MAX_LEN, &len) != param_error_t::SUCCESS) {
+					printf("ERROR ASSERT\n");
+					break;
+				}
+				char hex_val[2 * 16 + 1];
+				char hex_default[2 * 16 + 1];
+				l_bytes_to_hex_prefix(bytes, len, hex_val, sizeof(hex_val));
+				l_bytes_to_hex_prefix(param_inf.param_buf.ptr, param_inf.param_buf.len, hex_default, sizeof(hex_default));
+				printf("%sval %s%s (%u bytes) def %s%s (%u bytes)\n", base_str,
+				       hex_val, len > 16 ? ".." : "", len,
+				       hex_default, param_inf.param_buf.len > 16 ? ".." : "", param_inf.param_buf.len);
+				break;
+			}
 			default: break;
 			};
 		}
 	}
+	free(bytes);
 }
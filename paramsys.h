@@ -11,11 +11,30 @@
 
 #include "stdints.h"
 
-#include "paramsys_generated.h"
+#include <string.h> // memcpy, memcmp
+#include <math.h> // isfinite
 
+// PARAMS_INDEX_BITS, and PARAMS_VALUES_CAPACITY_BYTES if the default isn't enough. Written by paramsys_generate.py
+// together with the param headers. The PARAM_x_index defines and handles are in paramsys_generated.h (all params) and
+// paramsys_generated_component_N.h (the params of component N), include the one you need.
+#include "paramsys_generated_config.h"
 
 
+#ifndef PARAMS_VALUES_CAPACITY_BYTES
 #define PARAMS_VALUES_CAPACITY_BYTES (65536*2) // feel free to change this. beware that changing this will reset all the params to default values.
+#endif
+#define PARAMS_CHANGE_LOG_SIZE 1024 // value changes remembered for params_sync_delta. replicas further behind get a snapshot.
+
+// Param index. Also the width of the defaults/values indices in the tables and of the per size class counts. u16 keeps
+// the tables small, paramsys_generate.py switches to u32 when the table doesn't fit (more than 65535 params, or more
+// than 64 kB of strings or string defaults). The values memory layout differs, so switching resets the stored values.
+#if PARAMS_INDEX_BITS == 32
+typedef u32 param_index_t;
+#define PARAMS_MAX_COUNT 0x1000000 // the change log of params_sync_delta keeps the index in 24 bits
+#else
+typedef u16 param_index_t;
+#define PARAMS_MAX_COUNT 0xffff // 0xffff is PARAMS_NO_INDEX
+#endif
 
 // bits 0..2: param length in bytes, but given in left-shifts of value 1. valid if bit 3 is set.
 //   001 - 1 byte
@@ -32,7 +51,7 @@
 //   0010 - float
 //   0011 - flags
 //   0100 - str
-//   0101 - buf?
+//   0101 - buf
 //   0110 - unix time microseconds. u64?
 //   0111 - atomic time microseconds. u64?
 //   1000 - uuid128. u128?
@@ -80,13 +99,16 @@ enum class params_type_e : u8 {
 	TIME_ATOMIC_US64 = 15,
 	// all variable-size types have to be after this line
 	STR              = 16 | 0b10000000,
-	LAST    = 17 // has to be last type num + 1
+	STR16            = 17 | 0b10000000, // up to 65535 bytes, in the arena. see params_set_str16.
+	BUF              = 18 | 0b10000000, // same, binary data
+	LAST    = 19 // has to be last type num + 1
 };
 
 enum class param_error_t : u8 {
 	SUCCESS = 0,
 	FAIL = 1,
 	NO_PARAM = 2, // param_index out of bounds, or wrong param_type
+	DENIED = 3,   // the caller can see the param but its security level doesn't allow the change. see params_caller_t
 };
 
 
@@ -112,47 +134,607 @@ struct param_info_public_t {
 		struct { f64 default_val, min, max; } param_f64;
 		struct { u8  default_val[16]; }       param_uuid128;
 		struct { i64 default_val; }           param_time_us64;
-		//struct param_buf { u16 len; u8* ptr; };
 		struct { u8 max_len; u8 len; u8* ptr; } param_str; // NOT zero-terminated
+		struct { u16 max_len; u16 len; u8* ptr; } param_buf; // STR16 and BUF. NOT zero-terminated
 	};
 };
 #pragma pack(pop)
 
 
+struct paramsys_store_t;
+
+// Set every value to its default. The values memory is statically initialized with the same default image, so
+// values read before params_init() are the defaults too.
 void          params_init();
-param_error_t params_get_info(u16 param_index, param_info_public_t* out_param_info);
+// Like params_init(), but then loads the persisted values from the store (snapshot + journal replay) and from now on
+// appends every value change to the store journal. See paramsys_store.h.
+void          params_init_from_store(paramsys_store_t* store);
+param_error_t params_store_compact(); // write a full snapshot now and empty the journal
+// Reset values to their defaults with bulk copies of the generated default image: all of them, or only the params of
+// one component. Params whose value actually changes count as changes (change tracking, subscriptions, store). FAIL if
+// the values memory is read-only or STR16/BUF defaults don't fit into the arena while views are held, NO_PARAM if no
+// param has this component.
+param_error_t params_reset_all_to_defaults();
+param_error_t params_reset_component(u8 component);
+
+// Move the values memory into a shared file mapping, so that several processes on the same machine read the same
+// values with zero copies. Use a file under /dev/shm for a POSIX shm segment. Call after params_init*().
+//   writer - exactly one process. Maps read-write. If the file already holds a valid image (the writer restarted),
+//            those values are kept, otherwise the current values of this process are copied in.
+//   reader - maps read-only and fails if the file doesn't hold an image with exactly the layout of this build.
+//            params_set* return FAIL, the typed params_set<PARAM_x>() does nothing.
+param_error_t params_map_shared(const char* path, bool writer);
+void          params_unmap_shared(); // copies the shared values back to process-local memory
+param_error_t params_get_info(param_index_t param_index, param_info_public_t* out_param_info);
+// Return the index of the enabled param with this name (len without the terminating zero), 0 if there's none.
+// Constant time, uses a perfect hash generated by paramsys_generate.py.
+param_index_t params_find(const char* name, u8 len);
 void          params_print_all();
 
 // we could do without param_type here, but it really helps to prevent bugs and serves as forced documentation when using this function.
-param_error_t params_get(u16 param_index, params_type_e param_type, void* out_value);
-param_error_t params_set(u16 param_index, params_type_e param_type, void* valueptr); // applies min/max if necessary
-param_error_t params_get_str(u16 param_index, const char** out_str, u8* out_str_len);
-param_error_t params_set_str(u16 param_index, const char* str, u8 str_len);
-//param_error_t params_save(u16 param_index);
+// Disabled params (a "-" line in the schema) are in the values memory but return NO_PARAM here, like a wrong type.
+param_error_t params_get(param_index_t param_index, params_type_e param_type, void* out_value);
+param_error_t params_set(param_index_t param_index, params_type_e param_type, void* valueptr); // applies min/max if necessary
+param_error_t params_get_str(param_index_t param_index, const char** out_str, u8* out_str_len); // not safe with concurrent writers
+param_error_t params_get_str_copy(param_index_t param_index, char* out_str, u8 out_str_max_len, u8* out_str_len); // copies at most out_str_max_len bytes
+param_error_t params_set_str(param_index_t param_index, const char* str, u8 str_len);
+
+// batch get/set
+
+// One param of a batch. The value is given/returned in the union member matching param_type, the same bytes that
+// params_get/params_set would take through valueptr. STR uses str_val, STR16 and BUF bytes_val (set only).
+// params_get_many returns a pointer into the values memory for strings, like params_get_str.
+struct param_value_t {
+	param_index_t param_index;
+	params_type_e param_type;
+	bool          changed; // out: set by params_set_many if the batch changed the value. only on the last item of a param.
+	union {
+		u8  u8_val;
+		u16 u16_val;
+		u32 u32_val;
+		u64 u64_val;
+		i8  i8_val;
+		i16 i16_val;
+		i32 i32_val;
+		i64 i64_val;
+		f32 f32_val;
+		f64 f64_val;
+		u8  uuid128_val[16];
+		struct { const char* ptr; u8 len; } str_val;
+		struct { const void* ptr; u16 len; } bytes_val;
+	};
+};
+
+// Apply a batch of values as one unit. Every item is validated (index, type) first; if any is invalid, NO_PARAM is
+// returned and nothing is applied. Same with FAIL if STR16/BUF values don't fit into the arena while views are held.
+// Then all values are clamped and committed in one write section (params_get_many never sees half a batch), change
+// tracking is updated and the store gets one write for the whole batch.
+param_error_t params_set_many(param_value_t* items, u32 count);
+// Read all items in one read section, so the values are consistent with each other.
+param_error_t params_get_many(param_value_t* items, u32 count);
+
+// Check every fixed-size value against its current limits, one vector pass per size class (AVX2/SSE4.2 if the cpu has
+// them). Values out of range are clamped, NaN and inf floats are reset to the default. STR16/BUF values that point
+// outside the arena get their default, longer than max_len ones are cut. Fixed values count as changes (change
+// tracking, subscriptions, store). Writes up to max_count indices of the fixed params to out_param_indices and returns
+// how many were fixed, which can be more than max_count. Done by params_init_from_store after loading the values; call
+// it after anything else that writes the values memory without params_set.
+u32           params_validate_all(param_index_t* out_param_indices, u32 max_count);
+
+// Change tracking. Every actual value change (params_set*, params_set_str, typed handles) sets the param's bit in a
+// dirty bitmap. params_take_changed writes up to max_count indices of changed params to out_param_indices in
+// ascending index order, clears their bits and returns how many were written. Params that didn't fit stay marked.
+// Cost is proportional to the number of changed params, not to PARAMS_COUNT.
+u32           params_take_changed(param_index_t* out_param_indices, u32 max_count);
+bool          params_is_changed(param_index_t param_index);
+//param_error_t params_save(param_index_t param_index);
+
+// Value history. Params with the history:N option in the generator input keep their last N values, each with the
+// time of the change in TIME_UNIX_US64 microseconds, in a preallocated ring. Every actual value change of the default
+// instance is recorded, whatever made it (params_set*, batches, resets, profiles, typed handles). Recording is one
+// lock-free ring write: no allocations, no locks, constant cost. Fixed-size params only.
+
+struct params_history_entry_t {
+	i64 timestamp_us;
+	u8  value[16]; // the bytes params_get would return
+};
+
+u32           params_history_len(param_index_t param_index); // N, 0 if the param has no history
+// Copy the recorded values with timestamp_us >= since_us to out, oldest first, and return how many. If there are more
+// than max_count, the newest max_count. Entries overwritten while reading are skipped.
+u32           params_history_since(param_index_t param_index, i64 since_us, params_history_entry_t* out, u32 max_count);
+void          params_history_print(param_index_t param_index, i64 since_us); // with g_timestamp_us_to_iso8601 times
+// Clock of the recorded times. The default is CLOCK_REALTIME.
+void          params_history_set_clock(i64 (*now_us)());
+
+// Instances. Several independent param sets in one process, one per device for example. The schema (params_info,
+// defaults, limits) is shared and read-only, an instance owns only its values memory, seqlock counters and dirty
+// bitmap, all in one block of params_ctx_size() bytes that the caller allocates (an arena is fine).
+// params_ctx_create initializes the block to the defaults. The params_ctx_* functions do to an instance what the
+// params_* functions above do to the default instance (params_ctx_default()). Subscriptions, the store, sync,
+// shared mapping, the wire protocol and the typed handles work only on the default instance.
+struct paramsys_ctx_t;
+
+u32             params_ctx_size();
+u32             params_ctx_align(); // the block has to be aligned at this
+paramsys_ctx_t* params_ctx_create(void* mem, u32 mem_len); // nullptr if mem is too small or misaligned
+void            params_ctx_destroy(paramsys_ctx_t* ctx);   // doesn't free the block
+paramsys_ctx_t* params_ctx_default();
+
+param_error_t params_ctx_get(paramsys_ctx_t* ctx, param_index_t param_index, params_type_e param_type, void* out_value);
+param_error_t params_ctx_set(paramsys_ctx_t* ctx, param_index_t param_index, params_type_e param_type, void* valueptr);
+param_error_t params_ctx_get_str(paramsys_ctx_t* ctx, param_index_t param_index, const char** out_str, u8* out_str_len);
+param_error_t params_ctx_get_str_copy(paramsys_ctx_t* ctx, param_index_t param_index, char* out_str, u8 out_str_max_len,
+                                      u8* out_str_len);
+param_error_t params_ctx_set_str(paramsys_ctx_t* ctx, param_index_t param_index, const char* str, u8 str_len);
+param_error_t params_ctx_set_many(paramsys_ctx_t* ctx, param_value_t* items, u32 count);
+param_error_t params_ctx_get_many(paramsys_ctx_t* ctx, param_value_t* items, u32 count);
+param_error_t params_ctx_reset_all_to_defaults(paramsys_ctx_t* ctx);
+param_error_t params_ctx_reset_component(paramsys_ctx_t* ctx, u8 component);
+u32           params_ctx_validate_all(paramsys_ctx_t* ctx, param_index_t* out_param_indices, u32 max_count);
+u32           params_ctx_take_changed(paramsys_ctx_t* ctx, param_index_t* out_param_indices, u32 max_count);
+bool          params_ctx_is_changed(paramsys_ctx_t* ctx, param_index_t param_index);
+
+// Long strings and buffers. STR16 and BUF params hold up to 65000 bytes (the generated max_len), BUF for binary data.
+// Their values are in an arena at the end of the values memory, and a param takes only its current length there, so
+// a later firmware can raise max_len (or turn a str into a str16) and keep the value. Sets are copy-on-write: the new
+// value goes to the free end of the arena and the old bytes stay where they are until the arena compacts itself,
+// which happens when a set doesn't fit and no view is held.
+//
+// A view is a pointer to the value in the arena that stays valid, whatever the writers do, until
+// params_release_view. Hold views briefly: while any view of an instance is held its arena can't compact, and a set
+// that doesn't fit returns FAIL. Sets cut values longer than max_len. The _copy functions need no release and work on
+// a read-only shared mapping too, where views don't (the writer process can't see the views of other processes).
+// Batches (params_set_many) can set these params with bytes_val, params_get_many and transactions don't take them.
+
+struct params_view_t {
+	const u8*       ptr; // len bytes, NOT zero-terminated
+	u16             len;
+	paramsys_ctx_t* ctx;
+};
+
+param_error_t params_set_str16(param_index_t param_index, const char* str, u16 str_len);
+param_error_t params_set_buf(param_index_t param_index, const void* data, u16 len);
+param_error_t params_get_view(param_index_t param_index, params_view_t* out_view); // STR16 or BUF
+void          params_release_view(params_view_t* view);                  // no-op if already released
+param_error_t params_get_bytes_copy(param_index_t param_index, void* out, u16 out_max_len, u16* out_len); // at most out_max_len
+
+param_error_t params_ctx_set_str16(paramsys_ctx_t* ctx, param_index_t param_index, const char* str, u16 str_len);
+param_error_t params_ctx_set_buf(paramsys_ctx_t* ctx, param_index_t param_index, const void* data, u16 len);
+param_error_t params_ctx_get_view(paramsys_ctx_t* ctx, param_index_t param_index, params_view_t* out_view);
+param_error_t params_ctx_get_bytes_copy(paramsys_ctx_t* ctx, param_index_t param_index, void* out, u16 out_max_len,
+                                        u16* out_len);
+
+// Access by security level, for remote operators and other callers with limited rights. A caller of level L sees the
+// params with a read level <= L and can change the ones with a security_level <= L (the "R/W" security_level column
+// of paramsys_generate.py, R = W if there's only one). For the caller, params it can't see don't exist: NO_PARAM, and
+// they aren't listed. Setting a param it sees but can't change returns DENIED. The generator precomputes a bitmap of
+// the readable and of the writable params for every level, so a check is one bit test and params_caller_list skips
+// 64 params at a time. A level above the highest one in the table has the access of the highest one. The params_*
+// and params_ctx_* functions above don't check the level, they are for the firmware itself.
+
+struct params_caller_t {
+	paramsys_ctx_t* ctx;
+	const u64*      readable; // bit param_index % 64 of word param_index / 64
+	const u64*      writable;
+	u8              security_level;
+};
+
+params_caller_t params_caller(u8 security_level); // on the default instance
+params_caller_t params_ctx_caller(paramsys_ctx_t* ctx, u8 security_level);
+bool            params_caller_can_read(const params_caller_t* caller, param_index_t param_index);
+bool            params_caller_can_write(const params_caller_t* caller, param_index_t param_index);
+
+param_error_t params_caller_get(const params_caller_t* caller, param_index_t param_index, params_type_e param_type,
+                                void* out_value);
+param_error_t params_caller_set(const params_caller_t* caller, param_index_t param_index, params_type_e param_type,
+                                void* valueptr);
+param_error_t params_caller_get_str_copy(const params_caller_t* caller, param_index_t param_index, char* out_str,
+                                         u8 out_str_max_len, u8* out_str_len);
+param_error_t params_caller_set_str(const params_caller_t* caller, param_index_t param_index, const char* str, u8 str_len);
+param_error_t params_caller_get_bytes_copy(const params_caller_t* caller, param_index_t param_index, void* out, u16 out_max_len,
+                                           u16* out_len);
+param_error_t params_caller_set_str16(const params_caller_t* caller, param_index_t param_index, const char* str, u16 str_len);
+param_error_t params_caller_set_buf(const params_caller_t* caller, param_index_t param_index, const void* data, u16 len);
+param_error_t params_caller_get_info(const params_caller_t* caller, param_index_t param_index,
+                                     param_info_public_t* out_param_info);
+// params_ctx_take_changed of only the params the caller can see. The changes of the others stay marked for whoever
+// can see them.
+u32           params_caller_take_changed(const params_caller_t* caller, param_index_t* out_param_indices,
+                                         u32 max_count);
+// Indices of the params the caller can see (writable: can change) from first_param_index up, at most max_count.
+// Returns the count. To go on, call again from the last index + 1.
+u32           params_caller_list(const params_caller_t* caller, param_index_t first_param_index, bool writable,
+                                 param_index_t* out_param_indices, u32 max_count);
+
+// Transactions. Stage writes to several params in a params_txn_t, then publish them all at once with
+// params_txn_commit, or drop them with params_txn_abort. Staged values are clamped to the param limits right away and
+// kept in the transaction's fixed arena (no allocations), params_txn_get reads them back. Nothing is written before the
+// commit, so a failed or aborted transaction leaves no trace. The commit calls the validator with the staged values,
+// then writes them in one write section like params_set_many (params_get_many never sees a half-applied transaction)
+// and publishes the changes with one store write. Commit cost is proportional to the number of staged params.
+
+#define PARAMS_TXN_MAX_PARAMS  32
+#define PARAMS_TXN_ARENA_BYTES 512
+
+struct params_txn_t {
+	paramsys_ctx_t* ctx;
+	u32             size_class_mask;
+	u16             count;
+	u16             arena_used;
+	bool            overflow; // a set didn't fit into entries or arena. commit fails.
+	// staged value at arena[pos], the same bytes as in the values memory. strings with their max_len/len header.
+	struct { param_index_t param_index; u16 pos; } entries[PARAMS_TXN_MAX_PARAMS];
+	u8              arena[PARAMS_TXN_ARENA_BYTES];
+};
+
+// Called by params_txn_commit before anything is written. Read the staged values with params_txn_get*, the rest
+// of the params with params_get*. Return false to reject the transaction.
+typedef bool (*params_txn_validator_t)(params_txn_t* txn, void* user);
+
+void          params_txn_begin(params_txn_t* txn); // on the default instance
+void          params_ctx_txn_begin(paramsys_ctx_t* ctx, params_txn_t* txn);
+// NO_PARAM for a wrong index or type, FAIL if the transaction is full (and commit will fail). Setting the same param
+// again replaces its staged value.
+param_error_t params_txn_set(params_txn_t* txn, param_index_t param_index, params_type_e param_type, const void* valueptr);
+param_error_t params_txn_set_str(params_txn_t* txn, param_index_t param_index, const char* str, u8 str_len);
+// The staged value if there is one, the current value otherwise.
+param_error_t params_txn_get(params_txn_t* txn, param_index_t param_index, params_type_e param_type, void* out_value);
+param_error_t params_txn_get_str(params_txn_t* txn, param_index_t param_index, const char** out_str, u8* out_str_len);
+// Publish all staged values, or none: FAIL if the transaction overflowed, the validator rejected it or the values
+// memory is read-only. The transaction is empty afterwards either way.
+param_error_t params_txn_commit(params_txn_t* txn, params_txn_validator_t validator = nullptr, void* user = nullptr);
+void          params_txn_abort(params_txn_t* txn);
+
+// Change subscriptions. A subscription is a callback for one param, a range of params or all params of a component.
+// Setters only mark the changed param as pending (one bit, same as the dirty bitmap above). Callbacks are called
+// later, from params_dispatch(), once per pending param no matter how many times it changed meanwhile, so read the
+// latest value with params_get* in the callback. params_dispatch runs on the caller's thread, or on the dispatcher
+// thread (PARAMS_CONCURRENT only), so slow subscribers never slow down the setters.
+// Don't subscribe or unsubscribe from inside a callback.
+
+#define PARAMS_MAX_SUBSCRIPTIONS 32
+
+typedef void (*params_change_cb_t)(param_index_t param_index, void* user);
+
+// These return the subscription id, or -1 if all PARAMS_MAX_SUBSCRIPTIONS are taken.
+int           params_subscribe(param_index_t param_index, params_change_cb_t cb, void* user);
+int           params_subscribe_range(param_index_t first_param_index, param_index_t last_param_index, params_change_cb_t cb, void* user); // inclusive
+int           params_subscribe_component(u8 component, params_change_cb_t cb, void* user);
+void          params_unsubscribe(int subscription_id);
+u32           params_dispatch(); // call the callbacks of the pending params. returns the number of callbacks called.
+#ifdef PARAMS_CONCURRENT
+// Thread that sleeps until something is pending, waits coalesce_us more for the rest of the burst, then calls
+// params_dispatch.
+param_error_t params_start_dispatcher(u32 coalesce_us = 1000);
+void          params_stop_dispatcher();
+#endif
+
+// Profiles. Named overlays on the base values of the default instance, each with only the params it overrides.
+// Activating a profile swaps its override values into the values memory and keeps the base values they cover aside,
+// so reads stay as fast as without profiles and a switch costs O(overridden params of the old and the new profile).
+// Only params whose effective value changes are marked changed (change tracking, subscriptions, sync). The store
+// keeps the base values: switches aren't written to it, and neither are writes to a param the active profile
+// overrides, those go to the profile's override instead. A reset to defaults resets the base values and keeps the
+// overrides, so params the active profile overrides still show the override. params_init deletes all profiles.
+
+#define PARAMS_MAX_PROFILES      8
+#define PARAMS_PROFILE_NAME_LEN 16 // with the terminating zero
+
+// Return the profile id (1 .. PARAMS_MAX_PROFILES), or -1 if the name is taken, too long or all profiles are taken.
+int           params_profile_create(const char* name);
+int           params_profile_find(const char* name); // -1 if there's no such profile
+void          params_profile_delete(int profile);    // goes back to the base values if the profile is active
+// Add or change an override. The value is clamped to the param limits. Applies right away if the profile is active.
+param_error_t params_profile_override(int profile, param_index_t param_index, params_type_e param_type, const void* value);
+param_error_t params_profile_override_str(int profile, param_index_t param_index, const char* str, u8 str_len);
+param_error_t params_profile_activate(int profile); // 0 for none, only the base values
+int           params_profile_active();
+
+// Snapshot/delta sync between instances (a controller and its replicas, in other processes or on other machines).
+//
+// Every value change increments the version of this instance and goes into a change log of the last
+// PARAMS_CHANGE_LOG_SIZE changes. A replica remembers the epoch and version it has applied (params_sync_state_t) and
+// the controller answers with params_sync_make: a delta with only the params changed since that version if the
+// change log still covers it, otherwise a snapshot of the whole values memory. So steady-state traffic follows the
+// change rate, not the table size.
+//
+// sync data: u8 kind ('S' snapshot, 'D' delta), u64 epoch, u64 since_version, u64 version, then
+//   snapshot: paramsys_valuemem_t header and values[0 .. values_bytes_used]. Needs the exact same param layout.
+//   delta:    value entries param_index_t param_index, u8 type, u8 len, value[len] (strings without the max_len/len
+//             header).
+// Host byte order. Values are read after the version, so they can be newer than it. Applying a change twice is
+// harmless, so nothing is lost.
+
+struct params_sync_state_t {
+	u64 epoch;   // instance (process run) of the controller the version belongs to. 0 if nothing applied yet.
+	u64 version;
+};
+
+u64           params_version(); // number of value changes since params_init. 0 in the beginning.
+u64           params_epoch();   // differs between process runs, so versions of an earlier run are not mistaken for ours
+// Write a snapshot of all values. Return the length, 0 if out_max is too small.
+u32           params_sync_snapshot(u8* out, u32 out_max);
+// Write a delta of params changed since since_version. FAIL if the change log doesn't go back that far or out_max
+// is too small; use a snapshot then.
+param_error_t params_sync_delta(u64 since_version, u8* out, u32 out_max, u32* out_len);
+// What the controller sends to a replica in the given state: a delta if possible, a snapshot if not. Return the
+// length, 0 if out_max is too small even for the snapshot.
+u32           params_sync_make(const params_sync_state_t* replica, u8* out, u32 out_max);
+// Apply sync data made by params_sync_make (or _snapshot, _delta) of another instance and update the replica state.
+// Values go through params_set, so clamping, change tracking, subscriptions and the store see them like local sets.
+// FAIL if a delta doesn't follow the replica state (ask for a snapshot then), the data is broken or the layout differs.
+param_error_t params_sync_apply(const u8* data, u32 len, params_sync_state_t* replica);
 
 // convenience functions
 
 // these will limit the value to min/max if the param has min/max set.
-inline param_error_t params_set_i8 (u16 param_index, i8  value) { return params_set(param_index, params_type_e::I8,  &value); }
-inline param_error_t params_set_i16(u16 param_index, i16 value) { return params_set(param_index, params_type_e::I16, &value); }
-inline param_error_t params_set_i32(u16 param_index, i32 value) { return params_set(param_index, params_type_e::I32, &value); }
-inline param_error_t params_set_i64(u16 param_index, i64 value) { return params_set(param_index, params_type_e::I64, &value); }
-inline param_error_t params_set_u8 (u16 param_index, u8  value) { return params_set(param_index, params_type_e::U8,  &value); }
-inline param_error_t params_set_u16(u16 param_index, u16 value) { return params_set(param_index, params_type_e::U16, &value); }
-inline param_error_t params_set_u32(u16 param_index, u32 value) { return params_set(param_index, params_type_e::U32, &value); }
-inline param_error_t params_set_u64(u16 param_index, u64 value) { return params_set(param_index, params_type_e::U64, &value); }
-inline param_error_t params_set_f32(u16 param_index, f32 value) { return params_set(param_index, params_type_e::F32, &value); }
-inline param_error_t params_set_f64(u16 param_index, f64 value) { return params_set(param_index, params_type_e::F64, &value); }
+inline param_error_t params_set_i8 (param_index_t param_index, i8  value) { return params_set(param_index, params_type_e::I8,  &value); }
+inline param_error_t params_set_i16(param_index_t param_index, i16 value) { return params_set(param_index, params_type_e::I16, &value); }
+inline param_error_t params_set_i32(param_index_t param_index, i32 value) { return params_set(param_index, params_type_e::I32, &value); }
+inline param_error_t params_set_i64(param_index_t param_index, i64 value) { return params_set(param_index, params_type_e::I64, &value); }
+inline param_error_t params_set_u8 (param_index_t param_index, u8  value) { return params_set(param_index, params_type_e::U8,  &value); }
+inline param_error_t params_set_u16(param_index_t param_index, u16 value) { return params_set(param_index, params_type_e::U16, &value); }
+inline param_error_t params_set_u32(param_index_t param_index, u32 value) { return params_set(param_index, params_type_e::U32, &value); }
+inline param_error_t params_set_u64(param_index_t param_index, u64 value) { return params_set(param_index, params_type_e::U64, &value); }
+inline param_error_t params_set_f32(param_index_t param_index, f32 value) { return params_set(param_index, params_type_e::F32, &value); }
+inline param_error_t params_set_f64(param_index_t param_index, f64 value) { return params_set(param_index, params_type_e::F64, &value); }
 
 // these return zero if param not found
-inline f32           params_get_f32(u16 param_index) { f32 v; return params_get(param_index, params_type_e::F32, &v) == param_error_t::SUCCESS ? v : 0.f; }
-inline f64           params_get_f64(u16 param_index) { f64 v; return params_get(param_index, params_type_e::F64, &v) == param_error_t::SUCCESS ? v : 0.; }
-inline i8            params_get_i8 (u16 param_index) { i8  v; return params_get(param_index, params_type_e::I8,  &v) == param_error_t::SUCCESS ? v : 0; }
-inline i16           params_get_i16(u16 param_index) { i16 v; return params_get(param_index, params_type_e::I16, &v) == param_error_t::SUCCESS ? v : 0; }
-inline i32           params_get_i32(u16 param_index) { i32 v; return params_get(param_index, params_type_e::I32, &v) == param_error_t::SUCCESS ? v : 0; }
-inline i64           params_get_i64(u16 param_index) { i64 v; return params_get(param_index, params_type_e::I64, &v) == param_error_t::SUCCESS ? v : 0; }
-inline u8            params_get_u8 (u16 param_index) { u8  v; return params_get(param_index, params_type_e::U8,  &v) == param_error_t::SUCCESS ? v : 0; }
-inline u16           params_get_u16(u16 param_index) { u16 v; return params_get(param_index, params_type_e::U16, &v) == param_error_t::SUCCESS ? v : 0; }
-inline u32           params_get_u32(u16 param_index) { u32 v; return params_get(param_index, params_type_e::U32, &v) == param_error_t::SUCCESS ? v : 0; }
-inline u64           params_get_u64(u16 param_index) { u64 v; return params_get(param_index, params_type_e::U64, &v) == param_error_t::SUCCESS ? v : 0; }
+inline f32           params_get_f32(param_index_t param_index) { f32 v; return params_get(param_index, params_type_e::F32, &v) == param_error_t::SUCCESS ? v : 0.f; }
+inline f64           params_get_f64(param_index_t param_index) { f64 v; return params_get(param_index, params_type_e::F64, &v) == param_error_t::SUCCESS ? v : 0.; }
+inline i8            params_get_i8 (param_index_t param_index) { i8  v; return params_get(param_index, params_type_e::I8,  &v) == param_error_t::SUCCESS ? v : 0; }
+inline i16           params_get_i16(param_index_t param_index) { i16 v; return params_get(param_index, params_type_e::I16, &v) == param_error_t::SUCCESS ? v : 0; }
+inline i32           params_get_i32(param_index_t param_index) { i32 v; return params_get(param_index, params_type_e::I32, &v) == param_error_t::SUCCESS ? v : 0; }
+inline i64           params_get_i64(param_index_t param_index) { i64 v; return params_get(param_index, params_type_e::I64, &v) == param_error_t::SUCCESS ? v : 0; }
+inline u8            params_get_u8 (param_index_t param_index) { u8  v; return params_get(param_index, params_type_e::U8,  &v) == param_error_t::SUCCESS ? v : 0; }
+inline u16           params_get_u16(param_index_t param_index) { u16 v; return params_get(param_index, params_type_e::U16, &v) == param_error_t::SUCCESS ? v : 0; }
+inline u32           params_get_u32(param_index_t param_index) { u32 v; return params_get(param_index, params_type_e::U32, &v) == param_error_t::SUCCESS ? v : 0; }
+inline u64           params_get_u64(param_index_t param_index) { u64 v; return params_get(param_index, params_type_e::U64, &v) == param_error_t::SUCCESS ? v : 0; }
+
+
+// concurrency
+//
+// Compile with PARAMS_CONCURRENT defined to make the API safe for many reader threads and occasional writers.
+// Every size class of the values memory has a sequence counter (seqlock). Readers never lock: they copy the value and
+// retry if a write to the same size class was in progress or happened meanwhile, so they never see torn u64/uuid128/
+// str values. Writers are serialized by a mutex and make the counter odd for the duration of the write.
+// Without PARAMS_CONCURRENT all of this compiles away.
+//
+// Use params_get_str_copy instead of params_get_str if there are concurrent writers.
+
+enum {
+	PARAMS_SIZE_CLASS_8, PARAMS_SIZE_CLASS_16, PARAMS_SIZE_CLASS_32, PARAMS_SIZE_CLASS_64, PARAMS_SIZE_CLASS_128,
+	PARAMS_SIZE_CLASS_STR,
+	PARAMS_SIZE_CLASS_COUNT
+};
+
+// one seqlock counter, alone on its cache line.
+struct alignas(64) paramsys_seq_t { u32 seq; };
+
+#ifdef PARAMS_CONCURRENT
+
+extern paramsys_seq_t* params_seq; // [PARAMS_SIZE_CLASS_COUNT]. points into the shared mapping if params_map_shared is used.
+
+inline u32 params_seq_read_begin(u8 size_class) {
+	u32 s;
+	while ((s = __atomic_load_n(&params_seq[size_class].seq, __ATOMIC_ACQUIRE)) & 1)
+		;
+	return s;
+}
+
+// true if the values read since params_seq_read_begin may be torn and have to be read again.
+inline bool params_seq_read_retry(u8 size_class, u32 s) {
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&params_seq[size_class].seq, __ATOMIC_RELAXED) != s;
+}
+
+void params_seq_write_begin(u8 size_class); // takes the writer lock
+void params_seq_write_end(u8 size_class);   // releases the writer lock
+
+#else
+
+inline u32  params_seq_read_begin(u8) { return 0; }
+inline bool params_seq_read_retry(u8, u32) { return false; }
+inline void params_seq_write_begin(u8) {}
+inline void params_seq_write_end(u8) {}
+
+#endif
+
+
+// instrumentation
+//
+// Compile with PARAMS_INSTRUMENT defined to count the reads and writes of every param and to time params_set* and the
+// store journal writes. The counters are in per-thread shards, so threads counting the same hot param don't bounce its
+// cache line between cores. A thread takes a shard on its first counted call and keeps it. Threads past the first
+// PARAMS_INSTRUMENT_SHARDS - 1 share the last shard, with atomic adds. Latencies go into log2 histograms: bucket k
+// counts the calls that took [2^(k-1), 2^k) ns. Reads are the index api, the typed params_get<PARAM_x>() and the
+// string/bytes getters; writes are every params_set* call that passes the index and type checks, changed or not.
+//
+// Without PARAMS_INSTRUMENT the hooks are empty inline functions and none of the params_instrument_* api exists.
+// Overhead, paramsys_bench_instrument against paramsys_bench (-O2, one thread, in a vm):
+//   params_get_u16 (index api)          5.3 ->   6.5 ns
+//   params_get<PARAM_p12_U16>           0.8 ->   2.6 ns
+//   params_set_u16 minmax (index api)  69   -> 183   ns
+//   params_set<PARAM_p11_U16_minmax>   36   -> 144   ns
+// Almost all of the set overhead is the two clock_gettime(CLOCK_MONOTONIC) calls of the latency histogram, which are
+// slow in a vm. On bare metal they are ~20 ns each.
+
+#ifdef PARAMS_INSTRUMENT
+
+#define PARAMS_INSTRUMENT_SHARDS  16
+#define PARAMS_INSTRUMENT_BUCKETS 32
+
+enum class params_latency_e : u8 {
+	SET   = 0, // params_set*, params_set_many, typed params_set<PARAM_x>()
+	STORE = 1, // writing a change to the store journal, with the compaction it triggers
+	COUNT = 2
+};
+
+struct params_latency_t {
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+	u64 buckets[PARAMS_INSTRUMENT_BUCKETS];
+};
+
+struct params_access_count_t {
+	param_index_t param_index;
+	const char*   name;
+	u64           reads;
+	u64           writes;
+};
+
+enum class params_instrument_format_e : u8 { TABLE, JSON };
+
+// Sums over all the shards. Counts taken while other threads run are a little behind, never torn.
+// params_instrument_counts writes the counts of the enabled params from first_param_index on, skipping the ones never
+// read or written unless include_unused, and returns how many it wrote. Continue from the last param_index + 1.
+u32           params_instrument_counts(param_index_t first_param_index, bool include_unused, params_access_count_t* out,
+                                       u32 max_count);
+void          params_instrument_latency(params_latency_e which, params_latency_t* out);
+void          params_instrument_reset(); // counts racing with the reset may survive it
+// The counts (by index and name) and the latency histograms as a text table or as json. Return the length, 0 if it
+// doesn't fit into out_max.
+u32           params_instrument_dump(params_instrument_format_e format, bool include_unused, char* out, u32 out_max);
+void          params_instrument_print(bool include_unused); // the table to stdout
+
+// the hooks. not meant to be called by the user.
+struct paramsys_instrument_shard_t {
+	u64*             counts; // [2 * PARAMS_COUNT], reads and writes of param i at 2 * i and 2 * i + 1
+	bool             shared;
+	params_latency_t latency[(u8)params_latency_e::COUNT];
+};
+
+extern thread_local paramsys_instrument_shard_t* paramsys_instrument_shard;
+paramsys_instrument_shard_t* paramsys_instrument_claim_shard();
+u64                          paramsys_instrument_now_ns();
+void                         paramsys_instrument_latency(params_latency_e which, u64 start_ns);
+
+inline void paramsys_instrument_add(u64* counter, u64 n, bool shared) {
+	if (shared)
+		__atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+	else
+		__atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+inline void paramsys_instrument_count(param_index_t param_index, bool write) {
+	paramsys_instrument_shard_t* shard = paramsys_instrument_shard;
+	if (!shard)
+		shard = paramsys_instrument_claim_shard();
+	paramsys_instrument_add(&shard->counts[2 * (u32)param_index + write], 1, shard->shared);
+}
+
+inline void paramsys_instrument_read(param_index_t param_index) { paramsys_instrument_count(param_index, false); }
+inline void paramsys_instrument_write(param_index_t param_index) { paramsys_instrument_count(param_index, true); }
+inline u64  paramsys_instrument_start() { return paramsys_instrument_now_ns(); }
+inline void paramsys_instrument_set_done(u64 start) { paramsys_instrument_latency(params_latency_e::SET, start); }
+inline void paramsys_instrument_store_done(u64 start) { paramsys_instrument_latency(params_latency_e::STORE, start); }
+
+#else
+
+inline void paramsys_instrument_read(param_index_t) {}
+inline void paramsys_instrument_write(param_index_t) {}
+inline u64  paramsys_instrument_start() { return 0; }
+inline void paramsys_instrument_set_done(u64) {}
+inline void paramsys_instrument_store_done(u64) {}
+
+#endif
+
+
+// typed param handles
+
+// Compile-time handle to a fixed-size param. paramsys_generate.py writes one of these into paramsys_generated.h for
+// every enabled param, named PARAM_<param name> (PARAM_p7_U32_minmax for example). Type, position in the values array
+// and limits are all known at build time, so params_get<PARAM_x>() and params_set<PARAM_x>(value) compile down to a
+// direct load/store (plus an inlined clamp if the param has min/max). No index bounds check, no type check, no
+// paramsys_type_table lookup. The index-based void* API above is still the way to go for dynamic/remote access.
+//
+// Params with min/max get a derived struct that overrides has_minmax, default_val, min and max.
+template <typename T, params_type_e TYPE, param_index_t INDEX, param_index_t VALUE_INDEX>
+struct param_handle_t {
+	typedef T value_t;
+	static constexpr params_type_e type        = TYPE;
+	static constexpr param_index_t index       = INDEX;
+	static constexpr param_index_t value_index = VALUE_INDEX; // index to params_values_8/16/32/64, depending on sizeof(T)
+	static constexpr bool          has_minmax  = false;
+	static constexpr T             default_val = 0; // only with has_minmax, for NaN and inf
+	static constexpr T             min = 0;
+	static constexpr T             max = 0;
+};
+
+// Per size class views into the values memory. Defined in paramsys.cpp.
+extern u8*  params_values_8;
+extern u16* params_values_16;
+extern u32* params_values_32;
+extern u64* params_values_64;
+// true while the values memory is a read-only shared mapping (a params_map_shared reader). typed sets do nothing then.
+extern bool params_values_readonly;
+
+// Called by params_set* every time a param value actually changes. Not meant to be called by the user.
+void params_on_value_changed(param_index_t param_index);
+
+// lo and hi can be in any order. the params always have min <= max (paramsys_generate.py rejects anything else), the
+// vector scan of params_validate_all counts on it.
+template <typename T>
+constexpr T param_clamp(T v, T lo, T hi) {
+	if (lo > hi) { T t = lo; lo = hi; hi = t; }
+	if (v > hi) return hi;
+	if (v < lo) return lo;
+	return v;
+	// could use this, but for our case, hi can be lower than lo.
+	//v = v > lo ? v : lo;
+	//return v < hi ? v : hi;
+}
+
+template <typename H>
+inline u8* params_value_ptr() {
+	typedef typename H::value_t T;
+	static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8, "only fixed-size scalar params have handles");
+	if constexpr (sizeof(T) == 1) return params_values_8 + H::value_index;
+	if constexpr (sizeof(T) == 2) return (u8*)(params_values_16 + H::value_index);
+	if constexpr (sizeof(T) == 4) return (u8*)(params_values_32 + H::value_index);
+	if constexpr (sizeof(T) == 8) return (u8*)(params_values_64 + H::value_index);
+}
+
+template <typename H>
+constexpr u8 params_size_class() {
+	typedef typename H::value_t T;
+	return sizeof(T) == 1 ? PARAMS_SIZE_CLASS_8 : sizeof(T) == 2 ? PARAMS_SIZE_CLASS_16 :
+	       sizeof(T) == 4 ? PARAMS_SIZE_CLASS_32 : PARAMS_SIZE_CLASS_64;
+}
+
+template <typename H>
+inline typename H::value_t params_get() {
+	paramsys_instrument_read(H::index);
+	typename H::value_t v;
+	u32 s;
+	do {
+		s = params_seq_read_begin(params_size_class<H>());
+		memcpy(&v, params_value_ptr<H>(), sizeof(v)); // 64-bit values are only 4-byte aligned. memcpy is still a single load.
+	} while (params_seq_read_retry(params_size_class<H>(), s));
+	return v;
+}
 
+// applies min/max if the param has them. NaN and inf written to a float param with min/max become the default, like
+// params_set and params_validate_all do. does nothing in a reader process, where params_set returns FAIL.
+template <typename H>
+inline void params_set(typename H::value_t value) {
+	if (__builtin_expect(params_values_readonly, 0))
+		return;
+	u64 start = paramsys_instrument_start();
+	paramsys_instrument_write(H::index);
+	if constexpr (H::has_minmax && (H::type == params_type_e::F32 || H::type == params_type_e::F64))
+		value = isfinite(value) ? param_clamp(value, H::min, H::max) : H::default_val;
+	else if constexpr (H::has_minmax)
+		value = param_clamp(value, H::min, H::max);
+	u8* ptr = params_value_ptr<H>();
+	params_seq_write_begin(params_size_class<H>());
+	bool changed = memcmp(ptr, &value, sizeof(value)) != 0;
+	if (changed)
+		memcpy(ptr, &value, sizeof(value));
+	params_seq_write_end(params_size_class<H>());
+	if (changed)
+		params_on_value_changed(H::index);
+	paramsys_instrument_set_done(start);
+}
@@ -0,0 +1,733 @@
+// Microbenchmarks for the paramsys hot paths. Prints ns per operation.
+
+#include <stdio.h>
+#include <stdlib.h> // aligned_alloc
+#include <inttypes.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#ifdef PARAMS_CONCURRENT
+#include <thread>
+#include <atomic>
+#endif
+
+#include "paramsys_generated.h"
+#include "paramsys_internal.h" // paramsys_name_hash_candidate
+#include "paramsys_text.h"
+
+
+// keeps the compiler from optimizing away the benchmarked reads and from hoisting them out of the loop.
+template <typename T>
+static inline void l_sink(T& v) { asm volatile("" : : "r,m"(v) : "memory"); }
+
+template <typename F>
+static void l_bench(const char* name, u64 iterations, F f) {
+	auto start = std::chrono::steady_clock::now();
+	f(iterations);
+	auto end = std::chrono::steady_clock::now();
+	double ns = std::chrono::duration<double, std::nano>(end - start).count();
+	printf("%-40s %8.2f ns/op\n", name, ns / iterations);
+}
+
+
+// params_find vs a linear strcmp scan over synthetic name tables of different sizes. The perfect hash is built the
+// same way paramsys_generate.py builds it (build_name_hash), so the lookup cost is the same as with a generated table.
+struct l_name_table_t {
+	std::vector<param_info_t> info; // only name is used. [0] is the internal param
+	std::vector<u16> disp;
+	std::vector<param_index_t> slots;
+};
+
+static void l_build_name_table(l_name_table_t* t, u32 count) {
+	t->info.assign(count + 1, param_info_t());
+	for (u32 i = 1; i <= count; i++)
+		snprintf(t->info[i].name, sizeof(t->info[i].name), "p%u_synth", i);
+
+	u32 num_buckets = (count + 3) / 4;
+	std::vector<std::vector<u16>> buckets(num_buckets);
+	for (u32 i = 1; i <= count; i++)
+		buckets[paramsys_name_hash(t->info[i].name, strlen(t->info[i].name), 0) % num_buckets].push_back(i);
+	std::vector<u32> order(num_buckets);
+	for (u32 b = 0; b < num_buckets; b++) order[b] = b;
+	std::stable_sort(order.begin(), order.end(), [&](u32 a, u32 b) { return buckets[a].size() > buckets[b].size(); });
+
+	t->disp.assign(num_buckets, 0);
+	t->slots.assign(count, 0);
+	std::vector<u32> pos;
+	for (u32 b : order) {
+		for (u32 d = 1; d < 0x10000 && !buckets[b].empty(); d++) {
+			pos.clear();
+			for (u16 i : buckets[b]) {
+				u32 p = paramsys_name_hash(t->info[i].name, strlen(t->info[i].name), d) % count;
+				if (t->slots[p] || std::find(pos.begin(), pos.end(), p) != pos.end()) break;
+				pos.push_back(p);
+			}
+			if (pos.size() != buckets[b].size()) continue;
+			t->disp[b] = d;
+			for (u32 k = 0; k < pos.size(); k++) t->slots[pos[k]] = buckets[b][k];
+			break;
+		}
+	}
+}
+
+static param_index_t l_find_hashed(const l_name_table_t* t, const char* name, u8 len) {
+	param_index_t i = paramsys_name_hash_candidate(t->disp.data(), t->disp.size(), t->slots.data(), t->slots.size(), name, len);
+	if (i == 0 || memcmp(t->info[i].name, name, len) != 0 || t->info[i].name[len] != 0) return 0;
+	return i;
+}
+
+static param_index_t l_find_linear(const l_name_table_t* t, const char* name) {
+	for (u32 i = 1; i < t->info.size(); i++)
+		if (strcmp(t->info[i].name, name) == 0) return i;
+	return 0;
+}
+
+static void l_bench_find(u32 count) {
+	static l_name_table_t t;
+	struct name_t { char name[16]; u8 len; };
+	static std::vector<name_t> names;
+	l_build_name_table(&t, count);
+	names.assign(1024, {});
+	for (u32 k = 0; k < names.size(); k++) {
+		u32 i = 1 + (u32)((k * 2654435761ull) % count);
+		names[k].len = snprintf(names[k].name, sizeof(names[k].name), "p%u_synth", i);
+	}
+
+	char label[64];
+	snprintf(label, sizeof(label), "name lookup, %5u params, perfect hash", count);
+	l_bench(label, 2000000, [](u64 n) {
+		for (u64 i = 0; i < n; i++) { auto& q = names[i & 1023]; param_index_t v = l_find_hashed(&t, q.name, q.len); l_sink(v); }
+	});
+	snprintf(label, sizeof(label), "name lookup, %5u params, linear strcmp", count);
+	l_bench(label, count > 1000 ? 2000 : 200000, [](u64 n) {
+		for (u64 i = 0; i < n; i++) { auto& q = names[i & 1023]; param_index_t v = l_find_linear(&t, q.name); l_sink(v); }
+	});
+}
+
+
+// types of the synthetic params, param i is l_synth_types[i % 16]. str last, so the fixed-size ones are i % 15.
+static const params_type_e l_synth_types[] = {
+	params_type_e::U8, params_type_e::U16, params_type_e::U32, params_type_e::U64, params_type_e::I8,
+	params_type_e::I16, params_type_e::I32, params_type_e::I64, params_type_e::F32, params_type_e::F64,
+	params_type_e::FLAGS8, params_type_e::FLAGS16, params_type_e::FLAGS32, params_type_e::UUID128,
+	params_type_e::TIME_UNIX_US64, params_type_e::STR,
+};
+
+
+// Random-index gets over a synthetic table of 65535 fixed-size params. "cold" is how params_get worked before
+// params_hot: the 24-byte param_info_t (name inline) and the values pointer from the type table. "hot" is the 8-byte
+// paramsys_hot_t with the value offset. The param_info_t table and the values are together bigger than L2 on most
+// machines, the hot table and the values aren't.
+struct l_type_entry_t { u8 type_len; u8* values; };
+
+struct l_get_tables_t {
+	std::vector<param_info_t>   info;
+	std::vector<paramsys_hot_t> hot;
+	std::vector<u8>             values;
+	l_type_entry_t              types[(u8)params_type_e::LAST];
+};
+
+static l_get_tables_t l_get_tables;
+
+static void l_build_get_tables(u32 count) {
+	l_get_tables_t* t = &l_get_tables;
+	const u32 num_types = sizeof(l_synth_types) / sizeof(l_synth_types[0]) - 1; // no str
+	u32 class_count[5] = {}; // by size class
+	t->info.assign(count, param_info_t());
+	t->hot.assign(count, paramsys_hot_t());
+	for (u32 i = 0; i < count; i++) {
+		param_info_t* p = &t->info[i];
+		snprintf(p->name, sizeof(p->name), "p%u_synth", i);
+		p->type = (u8)l_synth_types[i % num_types];
+		u32 len = paramsys_type_len((params_type_e)p->type);
+		u8 size_class = len == 1 ? 0 : len == 2 ? 1 : len == 4 ? 2 : len == 8 ? 3 : 4;
+		p->value_index = class_count[size_class]++;
+		t->hot[i].type = p->type;
+		t->hot[i].flags = size_class << PARAMS_HOT_SIZE_CLASS_shift;
+	}
+	u32 class_offset[5], offset = 0;
+	for (u32 c = 0; c < 5; c++) {
+		class_offset[c] = offset;
+		offset += class_count[c] << c;
+	}
+	t->values.assign(offset, 0x5a);
+	for (u8 type = 0; type < (u8)params_type_e::LAST; type++) {
+		u32 len = paramsys_type_len((params_type_e)type);
+		u8 size_class = len == 1 ? 0 : len == 2 ? 1 : len == 4 ? 2 : len == 8 ? 3 : 4;
+		t->types[type].type_len = len;
+		t->types[type].values = len ? t->values.data() + class_offset[size_class] : nullptr;
+	}
+	for (u32 i = 0; i < count; i++)
+		t->hot[i].value_offset = class_offset[t->hot[i].flags >> PARAMS_HOT_SIZE_CLASS_shift] +
+		                         t->info[i].value_index * paramsys_type_len((params_type_e)t->info[i].type);
+}
+
+static inline param_error_t l_get_cold(param_index_t param_index, params_type_e type, void* out) {
+	const param_info_t* p = &l_get_tables.info[param_index];
+	if (p->type != (u8)type) return param_error_t::NO_PARAM;
+	const l_type_entry_t* te = &l_get_tables.types[p->type & PARAMS_TYPE_INDEX_mask];
+	memcpy(out, te->values + te->type_len * p->value_index, te->type_len);
+	return param_error_t::SUCCESS;
+}
+
+static inline param_error_t l_get_hot(param_index_t param_index, params_type_e type, void* out) {
+	const paramsys_hot_t* h = &l_get_tables.hot[param_index];
+	if (h->type != (u8)type) return param_error_t::NO_PARAM;
+	const u8* src = l_get_tables.values.data() + h->value_offset;
+	switch (h->flags >> PARAMS_HOT_SIZE_CLASS_shift) {
+	case 0: memcpy(out, src, 1); break;
+	case 1: memcpy(out, src, 2); break;
+	case 2: memcpy(out, src, 4); break;
+	case 3: memcpy(out, src, 8); break;
+	default: memcpy(out, src, 16); break;
+	}
+	return param_error_t::SUCCESS;
+}
+
+static void l_bench_hot_cold_get() {
+	const u32 count = 65535;
+	l_build_get_tables(count);
+	printf("random gets, %u params: param_info_t table %zu kB, hot table %zu kB, values %zu kB\n", count,
+	       l_get_tables.info.size() * sizeof(param_info_t) / 1024, l_get_tables.hot.size() * sizeof(paramsys_hot_t) / 1024,
+	       l_get_tables.values.size() / 1024);
+	// indexes from an lcg over the whole table. the type of param i is l_synth_types[i % 15].
+	l_bench("random-index get, param_info_t (before)", 20000000, [count](u64 n) {
+		u8 out[16];
+		u32 x = 1;
+		for (u64 i = 0; i < n; i++) {
+			x = x * 1664525 + 1013904223;
+			param_index_t param_index = (param_index_t)((x >> 8) % count);
+			param_error_t e = l_get_cold(param_index, l_synth_types[param_index % 15], out);
+			l_sink(e); l_sink(out);
+		}
+	});
+	l_bench("random-index get, paramsys_hot_t (after)", 20000000, [count](u64 n) {
+		u8 out[16];
+		u32 x = 1;
+		for (u64 i = 0; i < n; i++) {
+			x = x * 1664525 + 1013904223;
+			param_index_t param_index = (param_index_t)((x >> 8) % count);
+			param_error_t e = l_get_hot(param_index, l_synth_types[param_index % 15], out);
+			l_sink(e); l_sink(out);
+		}
+	});
+}
+
+
+// Setting all values to their defaults over the synthetic table of l_bench_hot_cold_get. "per param" is how params_init
+// worked before params_defaults_image: a flags branch, the default pointer from the type table and one small copy for
+// every param. "image" is the one memcpy it is now.
+static void l_bench_init_defaults() {
+	l_get_tables_t* t = &l_get_tables;
+	const u32 count = (u32)t->info.size();
+	std::vector<u8> image(t->values.size(), 0x33);
+	for (u32 i = 0; i < count; i += 7)
+		t->info[i].flags = param_info_t::NO_DEFAULT;
+
+	char label[80];
+	snprintf(label, sizeof(label), "init defaults, %u params, per param (before)", count);
+	l_bench(label, 200 * (u64)count, [&](u64 n) {
+		for (u64 k = 0; k < n / count; k++) {
+			for (u32 i = 0; i < count; i++) {
+				const param_info_t* p = &t->info[i];
+				const l_type_entry_t* te = &t->types[p->type & PARAMS_TYPE_INDEX_mask];
+				u8* dst = te->values + te->type_len * p->value_index;
+				if (p->flags & (param_info_t::NO_DEFAULT | param_info_t::DISABLED))
+					memset(dst, 0, te->type_len);
+				else
+					memcpy(dst, image.data() + (dst - t->values.data()), te->type_len);
+			}
+			l_sink(t->values[0]);
+		}
+	});
+	snprintf(label, sizeof(label), "init defaults, %u params, image (after)", count);
+	l_bench(label, 200 * (u64)count, [&](u64 n) {
+		for (u64 k = 0; k < n / count; k++) {
+			memcpy(t->values.data(), image.data(), image.size());
+			l_sink(t->values[0]);
+		}
+	});
+
+	l_bench("params_init, generated table", 1000000, [](u64 n) {
+		for (u64 i = 0; i < n; i++) params_init();
+	});
+	l_bench("params_reset_component, generated table, nothing changes", 1000000, [](u64 n) {
+		for (u64 i = 0; i < n; i++) { param_error_t e = params_reset_component(1); l_sink(e); }
+	});
+}
+
+
+// paramsys_migrate of a synthetic image with 100k params. The new firmware appends params of every type, so every
+// size class after the first one moves, and changes the max_len of every other string.
+struct l_image_t {
+	std::vector<paramsys_layout_entry_t> layout;
+	std::vector<u8> buf; // valuemem header + values[0 .. values_bytes_used]
+	paramsys_valuemem_t* mem() { return (paramsys_valuemem_t*)buf.data(); }
+};
+
+// layout the params the same way paramsys_generate.py does: value indexes by size class in param order.
+static void l_build_image(l_image_t* img, u32 count, u32 appended, bool new_str_lens) {
+	const u32 num_types = sizeof(l_synth_types) / sizeof(l_synth_types[0]);
+	u32 class_count[17] = {}; // by type len
+	u32 len_str = 0;
+	img->layout.assign(count + appended, paramsys_layout_entry_t());
+	for (u32 i = 0; i < count + appended; i++) {
+		paramsys_layout_entry_t* e = &img->layout[i];
+		e->type = (u8)l_synth_types[(i < count ? i : i * 7) % num_types];
+		if (e->type == (u8)params_type_e::STR) {
+			e->str_max_len = new_str_lens && (i & 16) ? 4 : 6;
+			e->value_index = len_str;
+			len_str += 2 + e->str_max_len;
+		} else {
+			e->value_index = class_count[paramsys_type_len((params_type_e)e->type)]++;
+		}
+	}
+
+	paramsys_valuemem_t h = {};
+	h.component = COMPONENT_PARAMS;
+	h.packet_type = P_PARAMS_VALUEMEM;
+	h.count_8 = class_count[1]; h.count_16 = class_count[2]; h.count_32 = class_count[4];
+	h.count_64 = class_count[8]; h.count_128 = class_count[16];
+	h.len_str = len_str;
+	h.values_bytes_used = h.offsetof_str() + len_str - h.offsetof_8();
+	h.values_bytes_capacity = h.values_bytes_used;
+	img->buf.assign(h.offsetof_8() + h.values_bytes_used, 0);
+	memcpy(img->buf.data(), &h, offsetof(paramsys_valuemem_t, values));
+	u8* str = img->buf.data() + h.offsetof_str();
+	for (auto& e : img->layout)
+		if (e.type == (u8)params_type_e::STR) str[e.value_index] = e.str_max_len;
+}
+
+static void l_bench_migrate(u32 count) {
+	static l_image_t old_img, new_img;
+	l_build_image(&old_img, count, 0, false);
+	l_build_image(&new_img, count, count / 64, true);
+	// something recognizable in the old values
+	for (u32 i = 8 + offsetof(paramsys_valuemem_t, values); i < old_img.buf.size(); i++)
+		old_img.buf[i] = (u8)(i * 131);
+
+	char label[64];
+	snprintf(label, sizeof(label), "paramsys_migrate, %u params, per param", count);
+	l_bench(label, 20 * count, [count](u64 n) {
+		for (u64 i = 0; i < n / count; i++) {
+			paramsys_migrate(old_img.mem(), old_img.layout.data(), old_img.layout.size(),
+			                 new_img.mem(), new_img.layout.data(), new_img.layout.size());
+			l_sink(new_img.buf[new_img.buf.size() - 1]);
+		}
+	});
+
+	u32 moved = 0, wrong = 0;
+	for (u32 i = 0; i < count; i++) {
+		const paramsys_layout_entry_t* o = &old_img.layout[i];
+		const paramsys_layout_entry_t* e = &new_img.layout[i];
+		if (e->type == (u8)params_type_e::STR) continue;
+		u8 len = paramsys_type_len((params_type_e)e->type);
+		const u8* src = (u8*)old_img.mem() + (len == 1 ? old_img.mem()->offsetof_8() : len == 2 ? old_img.mem()->offsetof_16() :
+			len == 4 ? old_img.mem()->offsetof_32() : len == 8 ? old_img.mem()->offsetof_64() : old_img.mem()->offsetof_128());
+		const u8* dst = (u8*)new_img.mem() + (len == 1 ? new_img.mem()->offsetof_8() : len == 2 ? new_img.mem()->offsetof_16() :
+			len == 4 ? new_img.mem()->offsetof_32() : len == 8 ? new_img.mem()->offsetof_64() : new_img.mem()->offsetof_128());
+		moved++;
+		if (memcmp(src + o->value_index * len, dst + e->value_index * len, len) != 0) wrong++;
+	}
+	printf("    %u fixed-size values moved, %u wrong\n", moved, wrong);
+}
+
+// the bulk limit scan alone, over one big size class. limits like the generator emits them: min/max/kind
+// keys, a mix of u32, i32 and f32 params with a few values out of range.
+static void l_bench_scan_limits(u32 count) {
+	std::vector<u32> values(count), limits(3 * count);
+	u32* min = limits.data();
+	u32* max = min + count;
+	u32* kind = max + count;
+	for (u32 i = 0; i < count; i++) {
+		u32 t = i % 3; // u32, i32, f32
+		kind[i] = t == 0 ? 0x80000000u : t == 1 ? 0 : 0x7fffffffu;
+		if (t == 0) { min[i] = 10 ^ 0x80000000u; max[i] = 1000 ^ 0x80000000u; values[i] = 10 + i % 990; }
+		if (t == 1) { min[i] = (u32)-500; max[i] = 500; values[i] = (u32)(i32)(i % 1000 - 500); }
+		if (t == 2) { f32 lo = -1, hi = 1, v = (i % 200) / 100.f - 1;
+		              memcpy(&min[i], &lo, 4); min[i] ^= 0x7fffffffu;
+		              memcpy(&max[i], &hi, 4); values[i] = 0; memcpy(&values[i], &v, 4); }
+		if (i % 1000 == 999) values[i] = 0xfffffff0u; // too big as u32, nan as f32, a fine -16 as i32
+	}
+	std::vector<u64> bitmap((count + 63) / 64 + 1);
+
+	for (int isa = (int)paramsys_isa_e::SCALAR; isa <= (int)paramsys_isa_e::AVX2; isa++) {
+		if (paramsys_scan_limits_set_isa((paramsys_isa_e)isa) != (paramsys_isa_e)isa)
+			continue;
+		char label[80];
+		snprintf(label, sizeof(label), "paramsys_scan_limits %s, %u u32 values, per value", paramsys_scan_limits_isa_name(), count);
+		l_bench(label, 200 * (u64)count, [&](u64 n) {
+			for (u64 i = 0; i < n / count; i++) {
+				paramsys_scan_limits(PARAMS_SIZE_CLASS_32, values.data(), limits.data(), count, bitmap.data());
+				l_sink(bitmap[0]);
+			}
+		});
+		u32 bad = 0;
+		for (u64 w : bitmap) bad += __builtin_popcountll(w);
+		printf("    %u out of range\n", bad);
+	}
+	paramsys_scan_limits_set_isa(paramsys_isa_e::AVX2);
+
+	l_bench("params_validate_all, generated table, nothing to fix", 1000000, [](u64 n) {
+		for (u64 i = 0; i < n; i++) {
+			u32 r = params_validate_all(nullptr, 0);
+			l_sink(r);
+		}
+	});
+}
+
+// Text export/import of the generated table, per param. The table is small, so it's the per-param cost that counts:
+// 100k params take 100000 times that. The snprintf line is roughly what params_print_all does per param.
+static void l_bench_text() {
+	static char buf[64 * 1024];
+	static std::vector<param_index_t> indices;
+	for (u32 i = 1; i < PARAMS_COUNT; i++) {
+		const char*   name;
+		params_type_e type;
+		if (paramsys_param_desc((param_index_t)i, &name, &type)) indices.push_back((param_index_t)i);
+	}
+	const u32 count = (u32)indices.size();
+	const u64 N = 20000;
+	for (int f = 0; f < 2; f++) {
+		static params_text_format_e format;
+		format = f ? params_text_format_e::CSV : params_text_format_e::JSON;
+		static u32 len;
+		char label[80];
+		auto start = std::chrono::steady_clock::now();
+		for (u64 i = 0; i < N; i++) len = params_export(format, buf, sizeof(buf));
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / N / count;
+		snprintf(label, sizeof(label), "params_export %s, per param", f ? "csv" : "json");
+		printf("%-40s %8.2f ns/op  (%.2f ms per 100k params)\n", label, ns, ns * 100000 / 1e6);
+		start = std::chrono::steady_clock::now();
+		for (u64 i = 0; i < N; i++) params_import(format, buf, len, nullptr);
+		ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / N / count;
+		snprintf(label, sizeof(label), "params_import %s, per param", f ? "csv" : "json");
+		printf("%-40s %8.2f ns/op  (%.2f ms per 100k params)\n", label, ns, ns * 100000 / 1e6);
+	}
+	auto start = std::chrono::steady_clock::now();
+	for (u64 i = 0; i < N; i++) {
+		for (param_index_t k : indices) {
+			param_info_public_t info;
+			params_get_info(k, &info);
+			char line[200];
+			u64 v[8] = {};
+			params_get(k, info.type, v);
+			snprintf(line, sizeof(line), "    %-16s %3u %3u val %" PRIu64 " def %" PRIu64, info.name, info.component,
+			         info.security_level, v[0], (u64)info.param_u64.default_val);
+			l_sink(line[5]);
+		}
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / N / count;
+	printf("%-40s %8.2f ns/op\n", "params_get_info + snprintf, per param", ns);
+}
+
+// STR16 sets and reads of p31_endpoint. Two 1000 byte values take turns: every set appends a copy to the arena and
+// every few sets one compacts it. The view is a pin and a seqlock read of the ref, no copy.
+static void l_bench_arena() {
+	static char values[2][1000];
+	memset(values[0], 'a', sizeof(values[0]));
+	memset(values[1], 'b', sizeof(values[1]));
+	l_bench("params_set_str16, 1000 bytes", 2000000, [](u64 n) {
+		for (u64 i = 0; i < n; i++) {
+			param_error_t e = params_set_str16(PARAM_p31_endpoint_index, values[i & 1], sizeof(values[0]));
+			l_sink(e);
+		}
+	});
+	l_bench("params_get_view + release", 20000000, [](u64 n) {
+		for (u64 i = 0; i < n; i++) {
+			params_view_t view;
+			params_get_view(PARAM_p31_endpoint_index, &view);
+			l_sink(view.ptr[0]);
+			params_release_view(&view);
+		}
+	});
+	l_bench("params_get_bytes_copy, 1000 bytes", 5000000, [](u64 n) {
+		u8 out[1024];
+		u16 len;
+		for (u64 i = 0; i < n; i++) {
+			params_get_bytes_copy(PARAM_p31_endpoint_index, out, sizeof(out), &len);
+			l_sink(out);
+		}
+	});
+}
+
+// The access check on top of a get is one bit test in the level's readable bitmap.
+static void l_bench_caller() {
+	static params_caller_t caller = params_caller(1);
+	l_bench("params_get u16", 50000000, [](u64 n) {
+		for (u64 i = 0; i < n; i++) {
+			u16 v;
+			params_get(PARAM_p11_U16_minmax_index, params_type_e::U16, &v);
+			l_sink(v);
+		}
+	});
+	l_bench("params_caller_get u16", 50000000, [](u64 n) {
+		for (u64 i = 0; i < n; i++) {
+			u16 v;
+			params_caller_get(&caller, PARAM_p11_U16_minmax_index, params_type_e::U16, &v);
+			l_sink(v);
+		}
+	});
+	l_bench("params_caller_list, all readable", 5000000, [](u64 n) {
+		for (u64 i = 0; i < n; i++) {
+			param_index_t out[256];
+			u32 count = params_caller_list(&caller, 0, false, out, 256);
+			l_sink(count);
+		}
+	});
+}
+
+#ifdef PARAMS_CONCURRENT
+
+// One writer thread keeps rewriting a u64, a uuid128 and a str param with self-consistent values (both u64 halves
+// equal, all uuid bytes equal, str of n copies of the same char with n derived from that char). Reader threads check
+// every value they read. Any inconsistency is a torn read.
+static void l_bench_concurrent_readers(int num_readers, double seconds) {
+	std::atomic<bool> stop(false);
+	std::atomic<u64> total_reads(0);
+	std::atomic<u64> torn(0);
+
+	std::thread writer([&]() {
+		for (u32 k = 1; !stop.load(std::memory_order_relaxed); k++) {
+			u64 v = (u64)k << 32 | k;
+			params_set_u64(PARAM_p4_U64_index, v);
+			u8 uuid[16];
+			memset(uuid, (u8)k, sizeof(uuid));
+			params_set(PARAM_p29_uuid128_index, params_type_e::UUID128, uuid);
+			char str[20];
+			char c = 'a' + k % 26;
+			u8 len = 1 + (c - 'a') % 20;
+			memset(str, c, len);
+			params_set_str(PARAM_p25_test_8_STR_index, str, len);
+			std::this_thread::sleep_for(std::chrono::microseconds(10));
+		}
+	});
+
+	std::vector<std::thread> readers;
+	for (int r = 0; r < num_readers; r++) {
+		readers.emplace_back([&]() {
+			u64 n = 0, bad = 0;
+			while (!stop.load(std::memory_order_relaxed)) {
+				u64 v = params_get_u64(PARAM_p4_U64_index);
+				if ((u32)v != (u32)(v >> 32)) bad++;
+				u8 uuid[16];
+				params_get(PARAM_p29_uuid128_index, params_type_e::UUID128, uuid);
+				for (int i = 1; i < 16; i++) if (uuid[i] != uuid[0]) { bad++; break; }
+				char str[32];
+				u8 len;
+				params_get_str_copy(PARAM_p25_test_8_STR_index, str, sizeof(str), &len);
+				if (len && len != 1 + (str[0] - 'a') % 20) bad++;
+				for (int i = 1; i < len; i++) if (str[i] != str[0]) { bad++; break; }
+				n += 3;
+			}
+			total_reads += n;
+			torn += bad;
+		});
+	}
+
+	std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+	stop = true;
+	writer.join();
+	for (auto& t : readers) t.join();
+
+	double ns_per_read = seconds * 1e9 * num_readers / total_reads;
+	printf("concurrent readers %2i %8.2f ns/read per thread %12.0f reads/s total  torn %llu\n",
+	       num_readers, ns_per_read, total_reads / seconds, (unsigned long long)torn.load());
+}
+
+#endif
+
+
+int main() {
+
+	params_init();
+
+	const u64 N = 20000000;
+
+	l_bench("params_get_u16 (index api)", N, [](u64 n) {
+		for (u64 i = 0; i < n; i++) { u16 v = params_get_u16(PARAM_p12_U16_index); l_sink(v); }
+	});
+	l_bench("params_get<PARAM_p12_U16>", N, [](u64 n) {
+		for (u64 i = 0; i < n; i++) { u16 v = params_get<PARAM_p12_U16>(); l_sink(v); }
+	});
+	l_bench("params_get_f32 (index api)", N, [](u64 n) {
+		for (u64 i = 0; i < n; i++) { f32 v = params_get_f32(PARAM_p28_test_3_F32_index); l_sink(v); }
+	});
+	l_bench("params_get<PARAM_p28_test_3_F32>", N, [](u64 n) {
+		for (u64 i = 0; i < n; i++) { f32 v = params_get<PARAM_p28_test_3_F32>(); l_sink(v); }
+	});
+	// the same through a second instance.
+	static paramsys_ctx_t* ctx = params_ctx_create(aligned_alloc(params_ctx_align(), params_ctx_size()), params_ctx_size());
+	l_bench("params_ctx_get u16, second instance", N, [](u64 n) {
+		for (u64 i = 0; i < n; i++) { u16 v; params_ctx_get(ctx, PARAM_p12_U16_index, params_type_e::U16, &v); l_sink(v); }
+	});
+	l_bench("params_ctx_set u16 minmax, second instance", N, [](u64 n) {
+		for (u64 i = 0; i < n; i++) { u16 v = (u16)i; params_ctx_set(ctx, PARAM_p11_U16_minmax_index, params_type_e::U16, &v); }
+	});
+	l_bench("params_set_u16 minmax (index api)", N, [](u64 n) {
+		for (u64 i = 0; i < n; i++) params_set_u16(PARAM_p11_U16_minmax_index, (u16)i);
+	});
+	l_bench("params_set<PARAM_p11_U16_minmax>", N, [](u64 n) {
+		for (u64 i = 0; i < n; i++) params_set<PARAM_p11_U16_minmax>((u16)i);
+	});
+	// value history. p7 is recorded, p5 is the same size class with limits but without history. every set changes the
+	// value.
+	l_bench("params_set_i32 minmax, no history", N, [](u64 n) {
+		for (u64 i = 0; i < n; i++) params_set_i32(PARAM_p5_I32_minmax_index, -(i32)(i % 100));
+	});
+	l_bench("params_set_u32 minmax, history", N, [](u64 n) {
+		for (u64 i = 0; i < n; i++) params_set_u32(PARAM_p7_U32_minmax_index, (u32)(i % 100));
+	});
+	params_history_set_clock([]() -> i64 { return 0; });
+	l_bench("params_set_u32 minmax, history, no clock", N, [](u64 n) {
+		for (u64 i = 0; i < n; i++) params_set_u32(PARAM_p7_U32_minmax_index, (u32)(i % 100));
+	});
+	params_history_set_clock(nullptr);
+	l_bench("params_set_i64 (index api)", N, [](u64 n) {
+		for (u64 i = 0; i < n; i++) params_set_i64(PARAM_p2_I64_index, (i64)i);
+	});
+	l_bench("params_set<PARAM_p2_I64>", N, [](u64 n) {
+		for (u64 i = 0; i < n; i++) params_set<PARAM_p2_I64>((i64)i);
+	});
+	static param_value_t batch[4] = {};
+	batch[0].param_index = PARAM_p11_U16_minmax_index; batch[0].param_type = params_type_e::U16;
+	batch[1].param_index = PARAM_p5_I32_minmax_index;  batch[1].param_type = params_type_e::I32;
+	batch[2].param_index = PARAM_p1_I64_minmax_index;  batch[2].param_type = params_type_e::I64;
+	batch[3].param_index = PARAM_p28_test_3_F32_index; batch[3].param_type = params_type_e::F32;
+	l_bench("4 x params_set (index api), per batch", N / 4, [](u64 n) {
+		for (u64 i = 0; i < n; i++) {
+			params_set_u16(PARAM_p11_U16_minmax_index, (u16)i);
+			params_set_i32(PARAM_p5_I32_minmax_index, -(i32)i);
+			params_set_i64(PARAM_p1_I64_minmax_index, (i64)i);
+			params_set_f32(PARAM_p28_test_3_F32_index, (f32)i);
+		}
+	});
+	l_bench("params_set_many, 4 params, per batch", N / 4, [](u64 n) {
+		for (u64 i = 0; i < n; i++) {
+			batch[0].u16_val = (u16)i;
+			batch[1].i32_val = -(i32)i;
+			batch[2].i64_val = (i64)i;
+			batch[3].f32_val = (f32)i;
+			params_set_many(batch, 4);
+		}
+	});
+	l_bench("params_txn, 4 params, per commit", N / 4, [](u64 n) {
+		static params_txn_t txn;
+		params_txn_begin(&txn);
+		for (u64 i = 0; i < n; i++) {
+			u16 a = (u16)i; i32 b = -(i32)i; i64 c = (i64)i; f32 d = (f32)i;
+			params_txn_set(&txn, PARAM_p11_U16_minmax_index, params_type_e::U16, &a);
+			params_txn_set(&txn, PARAM_p5_I32_minmax_index, params_type_e::I32, &b);
+			params_txn_set(&txn, PARAM_p1_I64_minmax_index, params_type_e::I64, &c);
+			params_txn_set(&txn, PARAM_p28_test_3_F32_index, params_type_e::F32, &d);
+			params_txn_commit(&txn);
+		}
+	});
+
+	// two profiles over every enabled fixed-size param, with values 1 and 2 above the base. a switch between them
+	// against setting the same values one by one.
+	static param_index_t prof_params[256];
+	static u8            prof_values[2][256][16];
+	static params_type_e prof_types[256];
+	static u32 prof_count = 0;
+	static int prof[2] = {params_profile_create("bench_a"), params_profile_create("bench_b")};
+	for (param_index_t i = 1; i <= PARAM_p30_time_unix_index; i++) {
+		param_info_public_t info;
+		u8 base[16] = {};
+		if (params_get_info(i, &info) != param_error_t::SUCCESS || info.type == params_type_e::STR ||
+		    params_get(i, info.type, base) != param_error_t::SUCCESS)
+			continue;
+		for (int k = 0; k < 2; k++) {
+			memcpy(prof_values[k][prof_count], base, 16);
+			prof_values[k][prof_count][0] += 1 + k;
+			params_profile_override(prof[k], i, info.type, prof_values[k][prof_count]);
+		}
+		prof_params[prof_count] = i;
+		prof_types[prof_count++] = info.type;
+	}
+	char prof_label[80];
+	snprintf(prof_label, sizeof(prof_label), "profile switch, %u overrides", prof_count);
+	l_bench(prof_label, N / 100, [](u64 n) {
+		for (u64 i = 0; i < n; i++) params_profile_activate(prof[i & 1]);
+	});
+	params_profile_activate(0);
+	snprintf(prof_label, sizeof(prof_label), "%u x params_set, same values", prof_count);
+	l_bench(prof_label, N / 100, [](u64 n) {
+		for (u64 i = 0; i < n; i++)
+			for (u32 k = 0; k < prof_count; k++)
+				params_set(prof_params[k], prof_types[k], prof_values[i & 1][k]);
+	});
+
+	l_bench("params_take_changed, 1 changed param", N / 10, [](u64 n) {
+		param_index_t changed[16];
+		for (u64 i = 0; i < n; i++) {
+			params_set<PARAM_p12_U16>((u16)i);
+			u32 c = params_take_changed(changed, 16);
+			l_sink(c);
+		}
+	});
+
+	static u32 callbacks = 0;
+	int sub = params_subscribe(PARAM_p12_U16_index, [](param_index_t, void*) { callbacks++; }, nullptr);
+	l_bench("params_set_u16 with a subscriber", N, [](u64 n) {
+		for (u64 i = 0; i < n; i++) params_set_u16(PARAM_p12_U16_index, (u16)i);
+	});
+	params_dispatch();
+	callbacks = 0;
+	l_bench("500 x params_set_u16 + params_dispatch", N / 500, [](u64 n) {
+		for (u64 i = 0; i < n; i++) {
+			for (u32 k = 0; k < 500; k++) params_set_u16(PARAM_p12_U16_index, (u16)(i + k));
+			params_dispatch();
+		}
+	});
+	printf("    callbacks per burst: %.2f\n", callbacks / (double)(N / 500));
+	params_unsubscribe(sub);
+
+	static u8 sync_buf[PARAMS_VALUES_CAPACITY_BYTES + 1024];
+	static params_sync_state_t replica;
+	replica.epoch = params_epoch();
+	l_bench("params_sync_make, delta of 1 changed param", N / 10, [](u64 n) {
+		for (u64 i = 0; i < n; i++) {
+			replica.version = params_version();
+			params_set_u16(PARAM_p12_U16_index, (u16)i);
+			u32 len = params_sync_make(&replica, sync_buf, sizeof(sync_buf));
+			l_sink(len);
+		}
+	});
+	l_bench("params_sync_snapshot", N / 100, [](u64 n) {
+		for (u64 i = 0; i < n; i++) { u32 len = params_sync_snapshot(sync_buf, sizeof(sync_buf)); l_sink(len); }
+	});
+	printf("    delta of 1 param %u bytes, snapshot %u bytes\n",
+	       params_sync_make(&replica, sync_buf, sizeof(sync_buf)), params_sync_snapshot(sync_buf, sizeof(sync_buf)));
+
+	l_bench("params_find (generated table)", N / 10, [](u64 n) {
+		for (u64 i = 0; i < n; i++) { param_index_t v = params_find("p28_test_3_F32", 14); l_sink(v); }
+	});
+	l_bench_find(10);
+	l_bench_find(1000);
+	l_bench_find(30000);
+
+	l_bench_hot_cold_get();
+	l_bench_init_defaults();
+	l_bench_migrate(100000);
+	l_bench_scan_limits(60000);
+	l_bench_text();
+	l_bench_arena();
+	l_bench_caller();
+
+#ifdef PARAMS_CONCURRENT
+	int max_readers = std::thread::hardware_concurrency();
+	if (max_readers < 1) max_readers = 1;
+	for (int r = 1; r <= max_readers; r *= 2)
+		l_bench_concurrent_readers(r, 0.5);
+	if ((max_readers & (max_readers - 1)) != 0)
+		l_bench_concurrent_readers(max_readers, 0.5);
+#endif
+
+#ifdef PARAMS_INSTRUMENT
+	printf("\naccess counts and latencies of the default instance:\n");
+	params_instrument_print(false);
+#endif
+
+	return 0;
+}
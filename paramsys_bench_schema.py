@@ -0,0 +1,79 @@
+# Licence: pick one - public domain / UNLICENCE (https://www.unlicense.org) / MIT (https://opensource.org/licenses/MIT).
+
+# Writes a synthetic schema of COUNT params for paramsys_bench_table, as bench_component_1.params ..
+# bench_component_4.params in OUT_DIR. Every type, with and without min/max, in a fixed rotation, so a table of 30
+# params has one of each and the bigger tables the same mix. The output only depends on COUNT.
+#
+#   python3 paramsys_bench_schema.py COUNT OUT_DIR
+#
+# then paramsys_generate.py -o OUT_DIR OUT_DIR/bench_component_*.params
+
+import argparse
+import os
+import sys
+
+COMPONENTS = 4
+
+# type, name suffix, values after the type. one of each per 30 params. names have to fit in 15 chars.
+ROTATION = [
+	("u8",               "u8",      "7"),
+	("u8",               "u8m",     "5 0 100"),
+	("u16",              "u16",     "42"),
+	("u16",              "u16m",    "10 1 1000"),
+	("u32",              "u32",     "42"),
+	("u32",              "u32m",    "10 1 100000"),
+	("u64",              "u64",     "42"),
+	("u64",              "u64m",    "10 1 100000"),
+	("i8",               "i8",      "-7"),
+	("i8",               "i8m",     "-5 -20 30"),
+	("i16",              "i16",     "-42"),
+	("i16",              "i16m",    "-10 -1000 1000"),
+	("i32",              "i32",     "-42"),
+	("i32",              "i32m",    "-10 -100000 100000"),
+	("i64",              "i64",     "-42"),
+	("i64",              "i64m",    "-10 -100000 100000"),
+	("f32",              "f32",     "1.5"),
+	("f32",              "f32m",    "1.5 -2 3"),
+	("f64",              "f64",     "2.5"),
+	("f64",              "f64m",    "2.5 -20 30"),
+	("flags8",           "fl8",     "3"),
+	("flags16",          "fl16",    "257"),
+	("flags32",          "fl32",    "260"),
+	("uuid128",          "uuid",    "12345678-1234-5678-1234-567812345678"),
+	("time_unix_us64",   "tunix",   "1111111111111"),
+	("time_atomic_us64", "tatom",   "2014-02-11T18:46:22Z"),
+	("str",              "str",     '"s{i}" 20'),
+	("str",              "str",     '"" 8'),
+	("str16",            "s16",     '"https://example.com/{i}" 256'),
+	("buf",              "buf",     "0x0102030405060708 64"),
+]
+
+
+def write_schema(count, out_dir):
+	os.makedirs(out_dir, exist_ok=True)
+	files = [open(os.path.join(out_dir, f"bench_component_{c + 1}.params"), "w") for c in range(COMPONENTS)]
+	for f in files:
+		f.write(f"# synthetic schema for paramsys_bench_table, {count} params. written by paramsys_bench_schema.py\n")
+	for i in range(1, count + 1):
+		component = 1 + (i - 1) * COMPONENTS // count
+		type_name, suffix, values = ROTATION[(i - 1) % len(ROTATION)]
+		security = f"{i % 3}/{i % 3 + 1}" if i % 7 == 0 else str(i % 4)
+		files[component - 1].write(f"{i} p{i}_{suffix} {component} {security} {type_name} {values.format(i=i)}\n")
+	for f in files:
+		f.close()
+
+
+def main():
+	parser = argparse.ArgumentParser(description="Write a synthetic paramsys schema for the benchmarks.")
+	parser.add_argument("count", type=int, help="number of params")
+	parser.add_argument("out_dir", help="where to write bench_component_1..4.params")
+	args = parser.parse_args()
+	if args.count < 1:
+		print("count has to be at least 1", file=sys.stderr)
+		return 1
+	write_schema(args.count, args.out_dir)
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
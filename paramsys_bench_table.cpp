@@ -0,0 +1,385 @@
+// Licence: pick one - public domain / UNLICENCE (https://www.unlicense.org) / MIT (https://opensource.org/licenses/MIT).
+
+// Benchmarks of the public paramsys operations on a synthetic table of N params (paramsys_bench_schema.py), built once
+// per table size as paramsys_bench_table_N. Prints ns/op, ops/s and cpu cycles/op. With --json FILE also writes one
+// json object per benchmark per line, to keep and compare between releases:
+//
+//   {"bench": "params_get u16", "params": 1000, "index_bits": 16, "iterations": 41943040, "ns_per_op": 2.61,
+//    "ops_per_s": 383141762, "cycles_per_op": 7.9}
+//
+// cycles_per_op is null where the cycle counter can't be read (not linux, or perf events not allowed). The per-param
+// benchmarks walk the params of a type in a shuffled order, so on big tables they pay the cache misses a real caller
+// would. params_init, print and export are per whole table.
+
+#include <stdio.h>
+#include <stdlib.h> // malloc
+#include <string.h> // strcmp
+#include <fcntl.h> // open
+#include <unistd.h> // dup, read
+#include <chrono>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include "paramsys_generated.h"
+#include "paramsys_internal.h" // PARAMS_TYPE_INDEX_mask
+#include "paramsys_text.h"
+
+
+// keeps the compiler from optimizing away the benchmarked reads and from hoisting them out of the loop.
+template <typename T>
+static inline void l_sink(T& v) { asm volatile("" : : "r,m"(v) : "memory"); }
+
+static const char* l_type_names[] = {
+	"u8", "u16", "u32", "u64", "i8", "i16", "i32", "i64", "f32", "f64", "flags8", "flags16", "flags32", "uuid128",
+	"time_unix_us64", "time_atomic_us64", "str", "str16", "buf",
+};
+static const u8 l_type_sizes[] = {1, 2, 4, 8, 1, 2, 4, 8, 4, 8, 1, 2, 4, 16, 8, 8}; // fixed-size types
+
+static int   l_cycles_fd = -1;
+static FILE* l_json;
+
+// user space cpu cycles of this thread, if the kernel lets us count them.
+static void l_cycles_open() {
+#ifdef __linux__
+	perf_event_attr attr = {};
+	attr.type           = PERF_TYPE_HARDWARE;
+	attr.size           = sizeof(attr);
+	attr.config         = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv     = 1;
+	l_cycles_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+static bool l_cycles_read(u64* out) {
+	return l_cycles_fd >= 0 && read(l_cycles_fd, out, sizeof(*out)) == sizeof(*out);
+}
+
+// one run of f(n). *out_cycles is -1 without the cycle counter.
+template <typename F>
+static double l_run(F& f, u64 n, double* out_cycles) {
+	u64 c0 = 0, c1 = 0;
+	bool cycles = l_cycles_read(&c0);
+	auto start = std::chrono::steady_clock::now();
+	f(n);
+	auto end = std::chrono::steady_clock::now();
+	cycles = cycles && l_cycles_read(&c1);
+	*out_cycles = cycles ? (double)(c1 - c0) : -1;
+	return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+struct l_result_t {
+	u64    n;
+	double ns;
+	double cycles; // -1 without the cycle counter
+};
+
+// doubles n until a run takes 20 ms, then keeps the best of 3 runs of about 100 ms.
+template <typename F>
+static l_result_t l_measure(F f) {
+	u64 n = 1;
+	double cycles;
+	double ns = l_run(f, n, &cycles);
+	while (ns < 20e6) {
+		n *= 2;
+		ns = l_run(f, n, &cycles);
+	}
+	l_result_t best = {(u64)(n * 100e6 / ns) + 1, 1e300, -1};
+	for (int k = 0; k < 3; k++) {
+		ns = l_run(f, best.n, &cycles);
+		if (ns < best.ns) {
+			best.ns     = ns;
+			best.cycles = cycles;
+		}
+	}
+	return best;
+}
+
+static void l_report(const char* name, const l_result_t& r) {
+	double ns_per_op = r.ns / r.n;
+	double ops_per_s = 1e9 / ns_per_op;
+	char cycles_str[32] = "-";
+	if (r.cycles >= 0)
+		snprintf(cycles_str, sizeof(cycles_str), "%.1f", r.cycles / r.n);
+	printf("%-48s %10.2f ns/op %14.0f ops/s %10s cycles/op\n", name, ns_per_op, ops_per_s, cycles_str);
+	if (l_json) {
+		if (r.cycles < 0)
+			snprintf(cycles_str, sizeof(cycles_str), "null");
+		fprintf(l_json, "{\"bench\": \"%s\", \"params\": %u, \"index_bits\": %u, \"iterations\": %llu, "
+		                "\"ns_per_op\": %.3f, \"ops_per_s\": %.0f, \"cycles_per_op\": %s}\n",
+		        name, PARAMS_COUNT - 1, PARAMS_INDEX_BITS, (unsigned long long)r.n, ns_per_op, ops_per_s, cycles_str);
+	}
+}
+
+template <typename F>
+static void l_bench(const char* name, F f) {
+	l_report(name, l_measure(f));
+}
+
+// A param to read or write, with two values to alternate between so that every set is a change.
+struct l_target_t {
+	param_index_t param_index;
+	u8            values[2][16];
+};
+
+// params grouped by type and has_minmax, and by type only. each group is shuffled and repeated up to a power of two,
+// so the benchmarks can pick the next one with a mask.
+static std::vector<l_target_t> l_groups[(u8)params_type_e::LAST][2];
+static std::vector<l_target_t> l_groups_by_type[(u8)params_type_e::LAST];
+
+static u32 l_rand_state = 1;
+static u32 l_rand() {
+	l_rand_state = l_rand_state * 1664525 + 1013904223;
+	return l_rand_state >> 8;
+}
+
+static void l_shuffle_and_fill(std::vector<l_target_t>* group) {
+	u32 count = (u32)group->size();
+	if (!count)
+		return;
+	for (u32 i = count; i > 1; i--)
+		std::swap((*group)[i - 1], (*group)[l_rand() % i]);
+	u32 size = 1;
+	while (size < count) size *= 2;
+	for (u32 i = count; i < size; i++)
+		group->push_back((*group)[i % count]);
+}
+
+static void l_collect_params() {
+	for (u32 i = 1; i < PARAMS_COUNT; i++) {
+		param_info_public_t info;
+		if (params_get_info((param_index_t)i, &info) != param_error_t::SUCCESS)
+			continue;
+		l_target_t t = {};
+		t.param_index = (param_index_t)i;
+		if (info.has_minmax) {
+			// min and max, both in range and different
+			u32 len = l_type_sizes[(u8)info.type];
+			const u8* defminmax = (const u8*)&info.param_u8;
+			memcpy(t.values[0], defminmax + len, len);
+			memcpy(t.values[1], defminmax + 2 * len, len);
+		} else if (!((u8)info.type & PARAMS_TYPE_IS_VARIABLE_SIZE_bit)) {
+			params_get(t.param_index, info.type, t.values[0]);
+			memcpy(t.values[1], t.values[0], 16);
+			t.values[1][0] ^= 1;
+		}
+		l_groups[(u8)info.type & PARAMS_TYPE_INDEX_mask][info.has_minmax].push_back(t);
+		l_groups_by_type[(u8)info.type & PARAMS_TYPE_INDEX_mask].push_back(t);
+	}
+	for (u8 type = 0; type < (u8)params_type_e::LAST; type++) {
+		l_shuffle_and_fill(&l_groups[type][0]);
+		l_shuffle_and_fill(&l_groups[type][1]);
+		l_shuffle_and_fill(&l_groups_by_type[type]);
+	}
+}
+
+static void l_bench_fixed_size() {
+	char label[80];
+	for (u8 type = 0; type <= (u8)params_type_e::TIME_ATOMIC_US64; type++) {
+		static const std::vector<l_target_t>* group;
+		static params_type_e param_type;
+		param_type = (params_type_e)type;
+		// get doesn't look at the limits, one run over all the params of the type is enough.
+		group = &l_groups_by_type[type];
+		if (!group->empty()) {
+			snprintf(label, sizeof(label), "params_get %s", l_type_names[type]);
+			l_bench(label, [](u64 n) {
+				u32 mask = (u32)group->size() - 1;
+				u8 out[16];
+				for (u64 i = 0; i < n; i++) {
+					param_error_t e = params_get((*group)[i & mask].param_index, param_type, out);
+					l_sink(e); l_sink(out);
+				}
+			});
+		}
+		for (int minmax = 0; minmax < 2; minmax++) {
+			group = &l_groups[type][minmax];
+			if (group->empty())
+				continue;
+			snprintf(label, sizeof(label), "params_set %s%s", l_type_names[type], minmax ? " minmax" : "");
+			l_bench(label, [](u64 n) {
+				u32 mask = (u32)group->size() - 1;
+				for (u64 i = 0; i < n; i++) {
+					const l_target_t* t = &(*group)[i & mask];
+					param_error_t e = params_set(t->param_index, param_type, (void*)t->values[(i / (mask + 1)) & 1]);
+					l_sink(e);
+				}
+			});
+		}
+	}
+}
+
+static void l_bench_variable_size() {
+	static const std::vector<l_target_t>* str   = &l_groups[(u8)params_type_e::STR & PARAMS_TYPE_INDEX_mask][0];
+	static const std::vector<l_target_t>* str16 = &l_groups[(u8)params_type_e::STR16 & PARAMS_TYPE_INDEX_mask][0];
+	static const std::vector<l_target_t>* buf   = &l_groups[(u8)params_type_e::BUF & PARAMS_TYPE_INDEX_mask][0];
+	static char long_value[2][200];
+	memset(long_value[0], 'a', sizeof(long_value[0]));
+	memset(long_value[1], 'b', sizeof(long_value[1]));
+
+	if (!str->empty()) {
+		l_bench("params_get_str", [](u64 n) {
+			u32 mask = (u32)str->size() - 1;
+			for (u64 i = 0; i < n; i++) {
+				const char* s;
+				u8 len;
+				param_error_t e = params_get_str((*str)[i & mask].param_index, &s, &len);
+				l_sink(e); l_sink(s);
+			}
+		});
+		l_bench("params_set_str, 8 bytes", [](u64 n) {
+			u32 mask = (u32)str->size() - 1;
+			for (u64 i = 0; i < n; i++) {
+				param_error_t e = params_set_str((*str)[i & mask].param_index, long_value[(i / (mask + 1)) & 1], 8);
+				l_sink(e);
+			}
+		});
+	}
+	if (!str16->empty()) {
+		l_bench("params_set_str16, 200 bytes", [](u64 n) {
+			u32 mask = (u32)str16->size() - 1;
+			for (u64 i = 0; i < n; i++) {
+				param_error_t e = params_set_str16((*str16)[i & mask].param_index, long_value[(i / (mask + 1)) & 1],
+				                                   200);
+				l_sink(e);
+			}
+		});
+		l_bench("params_get_bytes_copy str16, 200 bytes", [](u64 n) {
+			u32 mask = (u32)str16->size() - 1;
+			char out[256];
+			for (u64 i = 0; i < n; i++) {
+				u16 len;
+				param_error_t e = params_get_bytes_copy((*str16)[i & mask].param_index, out, sizeof(out), &len);
+				l_sink(e); l_sink(out);
+			}
+		});
+	}
+	if (!buf->empty()) {
+		l_bench("params_set_buf, 64 bytes", [](u64 n) {
+			u32 mask = (u32)buf->size() - 1;
+			for (u64 i = 0; i < n; i++) {
+				param_error_t e = params_set_buf((*buf)[i & mask].param_index, long_value[(i / (mask + 1)) & 1], 64);
+				l_sink(e);
+			}
+		});
+	}
+}
+
+static void l_bench_lookup() {
+	struct name_t { const char* name; u8 len; };
+	static std::vector<param_index_t> indices;
+	static std::vector<name_t> names;
+	for (u32 i = 1; i < PARAMS_COUNT; i++) {
+		param_info_public_t info;
+		if (params_get_info((param_index_t)i, &info) != param_error_t::SUCCESS)
+			continue;
+		indices.push_back((param_index_t)i);
+		names.push_back({info.name, (u8)strlen(info.name)});
+	}
+	for (u32 i = (u32)indices.size(); i > 1; i--) {
+		u32 k = l_rand() % i;
+		std::swap(indices[i - 1], indices[k]);
+		std::swap(names[i - 1], names[k]);
+	}
+	if (indices.empty())
+		return;
+
+	l_bench("params_get_info", [](u64 n) {
+		u32 count = (u32)indices.size();
+		for (u64 i = 0, k = 0; i < n; i++) {
+			param_info_public_t info;
+			param_error_t e = params_get_info(indices[k], &info);
+			l_sink(e); l_sink(info);
+			if (++k == count) k = 0;
+		}
+	});
+	l_bench("params_find", [](u64 n) {
+		u32 count = (u32)names.size();
+		for (u64 i = 0, k = 0; i < n; i++) {
+			param_index_t v = params_find(names[k].name, names[k].len);
+			l_sink(v);
+			if (++k == count) k = 0;
+		}
+	});
+}
+
+static void l_bench_table() {
+	l_bench("params_init, whole table", [](u64 n) {
+		for (u64 i = 0; i < n; i++) params_init();
+	});
+	l_bench("params_reset_all_to_defaults, whole table", [](u64 n) {
+		for (u64 i = 0; i < n; i++) { param_error_t e = params_reset_all_to_defaults(); l_sink(e); }
+	});
+	l_bench("params_validate_all, whole table", [](u64 n) {
+		for (u64 i = 0; i < n; i++) { u32 r = params_validate_all(nullptr, 0); l_sink(r); }
+	});
+
+	// params_print_all writes to stdout, into /dev/null for the measurement.
+	fflush(stdout);
+	int saved_stdout = dup(1);
+	int null_fd = open("/dev/null", O_WRONLY);
+	if (saved_stdout >= 0 && null_fd >= 0 && dup2(null_fd, 1) >= 0) {
+		l_result_t r = l_measure([](u64 n) { for (u64 i = 0; i < n; i++) params_print_all(); });
+		fflush(stdout);
+		dup2(saved_stdout, 1);
+		l_report("params_print_all, whole table", r);
+	}
+	if (null_fd >= 0) close(null_fd);
+	if (saved_stdout >= 0) close(saved_stdout);
+
+	static u32 text_max = PARAMS_COUNT * 512 + (1 << 20);
+	static char* text = (char*)malloc(text_max);
+	static u32 text_len;
+	l_bench("params_export json, whole table", [](u64 n) {
+		for (u64 i = 0; i < n; i++) {
+			text_len = params_export(params_text_format_e::JSON, text, text_max);
+			l_sink(text_len);
+		}
+	});
+	l_bench("params_export csv, whole table", [](u64 n) {
+		for (u64 i = 0; i < n; i++) {
+			text_len = params_export(params_text_format_e::CSV, text, text_max);
+			l_sink(text_len);
+		}
+	});
+	l_bench("params_import csv, whole table", [](u64 n) {
+		for (u64 i = 0; i < n; i++) {
+			param_error_t e = params_import(params_text_format_e::CSV, text, text_len, nullptr);
+			l_sink(e);
+		}
+	});
+	free(text);
+}
+
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--json") && i + 1 < argc) {
+			l_json = fopen(argv[++i], "w");
+			if (!l_json) {
+				perror(argv[i]);
+				return 1;
+			}
+		} else {
+			fprintf(stderr, "usage: %s [--json FILE]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	params_init();
+	l_cycles_open();
+	printf("%u params, param_index_t u%u, cycle counter %s\n", PARAMS_COUNT - 1, PARAMS_INDEX_BITS,
+	       l_cycles_fd >= 0 ? "on" : "not available");
+
+	l_collect_params();
+	l_bench_fixed_size();
+	l_bench_variable_size();
+	l_bench_lookup();
+	l_bench_table();
+
+	if (l_json)
+		fclose(l_json);
+	return 0;
+}
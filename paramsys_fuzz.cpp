@@ -0,0 +1,950 @@
+// Licence: pick one - public domain / UNLICENCE (https://www.unlicense.org) / MIT (https://opensource.org/licenses/MIT).
+
+// Fuzz and differential harness for the set/clamp/get paths. An input is a stream of operations (set one or more
+// params by (index, type, value), reset, validate) that runs three times side by side:
+//
+//   * on the default instance through the fast paths: typed handles, params_set_many, transactions and
+//     params_validate_all with the best vector scan the cpu has
+//   * on a second instance, one plain params_ctx_set / params_ctx_set_str per item and the scalar validate scan
+//   * on a reference model in here, which knows only what params_get_info says about the params
+//
+// After every operation all values of both instances are read back (index api, typed handles, string and bytes
+// copies) and compared byte for byte with the model, and the return codes with what the model expects. The first
+// difference prints the operation and the param and aborts.
+//
+// Built with clang and PARAMSYS_FUZZ_LIBFUZZER it's a libFuzzer target (-fsanitize=fuzzer). Otherwise it has its own
+// main, for gcc and for running a corpus under the sanitizers without libFuzzer:
+//
+//   paramsys_fuzz_driver                   random operation streams from a fixed seed
+//   paramsys_fuzz_driver --random N SEED   N random streams
+//   paramsys_fuzz_driver FILE|DIR ..       run the inputs, like libFuzzer does with a corpus
+//   paramsys_fuzz_driver --corpus DIR      write the seed corpus for the generated table: every param set to its
+//                                          default, min, max, just past min and max, NaN and inf, through every path
+
+#include <stdio.h>
+#include <stdlib.h> // aligned_alloc
+#include <string.h> // memcpy
+#include <math.h> // isfinite
+#include <vector>
+#include <string>
+#ifndef PARAMSYS_FUZZ_LIBFUZZER
+#include <dirent.h> // opendir
+#include <sys/stat.h> // stat, mkdir
+#endif
+
+#include "paramsys_generated.h"
+#include "paramsys_internal.h" // paramsys_scan_limits_set_isa
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// the operation stream
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// op byte % L_OP_COUNT, then
+//   L_OP_SET:             path byte, count byte (1 + count % L_SET_MAX_ITEMS items), per item: index
+//                         (sizeof(param_index_t) bytes, little endian), type byte, 16 value bytes. a type byte with the
+//                         high bit set means the param's own type. STR values are a len byte and up to 15 chars,
+//                         STR16 and BUF values a u16 len and 14 pattern bytes repeated up to len (l_item_bytes).
+//   L_OP_RESET_ALL:       -
+//   L_OP_RESET_COMPONENT: component byte
+//   L_OP_VALIDATE:        -
+// Missing bytes at the end of the input read as zero.
+enum l_op_e : u8 { L_OP_SET, L_OP_RESET_ALL, L_OP_RESET_COMPONENT, L_OP_VALIDATE, L_OP_COUNT };
+enum l_path_e : u8 { L_PATH_INDEX, L_PATH_TYPED, L_PATH_MANY, L_PATH_TXN, L_PATH_COUNT };
+static const char* l_path_names[] = {"index api", "typed handle", "set_many", "txn"};
+
+#define L_SET_MAX_ITEMS 4
+#define L_VALUE_BYTES   16
+
+// the types a set can ask for. the wrong ones for a param have to come back NO_PARAM.
+static const params_type_e l_types[] = {
+	params_type_e::U8,      params_type_e::U16,     params_type_e::U32,     params_type_e::U64,
+	params_type_e::I8,      params_type_e::I16,     params_type_e::I32,     params_type_e::I64,
+	params_type_e::F32,     params_type_e::F64,     params_type_e::FLAGS8,  params_type_e::FLAGS16,
+	params_type_e::FLAGS32, params_type_e::UUID128, params_type_e::TIME_UNIX_US64, params_type_e::TIME_ATOMIC_US64,
+	params_type_e::STR,     params_type_e::STR16,   params_type_e::BUF,
+};
+#define L_TYPES_COUNT (sizeof(l_types) / sizeof(l_types[0]))
+
+struct l_input_t {
+	const u8* p;
+	size_t    left;
+};
+
+static void l_take(l_input_t* in, void* out, size_t n) {
+	size_t k = n < in->left ? n : in->left;
+	memcpy(out, in->p, k);
+	memset((u8*)out + k, 0, n - k);
+	in->p += k;
+	in->left -= k;
+}
+
+static u8 l_take_u8(l_input_t* in) {
+	u8 v;
+	l_take(in, &v, 1);
+	return v;
+}
+
+struct l_item_t {
+	param_index_t param_index;
+	params_type_e type;
+	u8            value[L_VALUE_BYTES];
+};
+
+// STR16 and BUF values of up to 64k don't fit into an item. the item has the len and a pattern, this makes the bytes.
+// a pattern byte changes every round, so a value differs from a shorter or longer one made of the same pattern.
+#define L_BYTES_MAX 0xffff
+static u16 l_item_bytes(const l_item_t* item, u8* out) {
+	u16 len;
+	memcpy(&len, item->value, 2);
+	for (u32 k = 0; k < len; k++)
+		out[k] = item->value[2 + k % (L_VALUE_BYTES - 2)] + k / (L_VALUE_BYTES - 2);
+	return len;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// the reference model
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct l_ref_param_t {
+	params_type_e type;
+	bool          disabled;       // in the table, but every get and set is NO_PARAM
+	u8            component;
+	u8            len;            // fixed-size types. 0 for the rest.
+	bool          has_minmax;
+	u8            def[L_VALUE_BYTES];
+	u8            min[L_VALUE_BYTES];
+	u8            max[L_VALUE_BYTES];
+	u8            str_max_len;    // STR
+	u8            str_def_len;
+	u8            str_def[255];
+	u16           bytes_max_len;  // STR16, BUF
+	u16           bytes_def_len;
+	const u8*     bytes_def;
+};
+
+struct l_ref_t {
+	l_ref_param_t params[PARAMS_COUNT];
+	u8            values[PARAMS_COUNT][L_VALUE_BYTES];
+	u8            str_lens[PARAMS_COUNT];
+	u8            strs[PARAMS_COUNT][255];
+	u16           bytes_lens[PARAMS_COUNT];
+	u8*           bytes[PARAMS_COUNT]; // bytes_max_len each, nullptr for the other types
+};
+
+static l_ref_t l_ref;
+
+static u8 l_type_len(params_type_e type) {
+	switch (type) {
+	case params_type_e::U8: case params_type_e::I8: case params_type_e::FLAGS8: return 1;
+	case params_type_e::U16: case params_type_e::I16: case params_type_e::FLAGS16: return 2;
+	case params_type_e::U32: case params_type_e::I32: case params_type_e::F32: case params_type_e::FLAGS32: return 4;
+	case params_type_e::U64: case params_type_e::I64: case params_type_e::F64: return 8;
+	case params_type_e::TIME_UNIX_US64: case params_type_e::TIME_ATOMIC_US64: return 8;
+	case params_type_e::UUID128: return 16;
+	default: return 0;
+	}
+}
+
+static bool l_ref_init() {
+	for (u32 i = 0; i < PARAMS_COUNT; i++) {
+		param_info_public_t info;
+		l_ref_param_t* r = &l_ref.params[i];
+		if (params_get_info(i, &info) != param_error_t::SUCCESS) {
+			fprintf(stderr, "params_get_info(%u) failed\n", i);
+			return false;
+		}
+		r->type = info.type;
+		// params_find leaves disabled params out. param 0 isn't found either, but it's usable.
+		r->disabled = i != 0 && params_find(info.name, (u8)strlen(info.name)) != i;
+		r->component = info.component;
+		r->len = l_type_len(info.type);
+		r->has_minmax = info.has_minmax;
+		if (r->len) {
+			// every param_xx member starts with default_val, min, max of the type, packed.
+			const u8* d = (const u8*)&info.param_u8;
+			memcpy(r->def, d, r->len);
+			if (r->has_minmax) {
+				memcpy(r->min, d + r->len, r->len);
+				memcpy(r->max, d + 2 * r->len, r->len);
+			}
+		} else if (info.type == params_type_e::STR) {
+			r->str_max_len = info.param_str.max_len;
+			r->str_def_len = info.param_str.len;
+			memcpy(r->str_def, info.param_str.ptr, info.param_str.len);
+		} else {
+			r->bytes_max_len = info.param_buf.max_len;
+			r->bytes_def_len = info.param_buf.len;
+			r->bytes_def = info.param_buf.ptr;
+			l_ref.bytes[i] = (u8*)malloc(r->bytes_max_len ? r->bytes_max_len : 1);
+			if (!l_ref.bytes[i])
+				return false;
+		}
+	}
+	return true;
+}
+
+static void l_ref_reset(u32 param_index) {
+	const l_ref_param_t* r = &l_ref.params[param_index];
+	memcpy(l_ref.values[param_index], r->def, r->len);
+	l_ref.str_lens[param_index] = r->str_def_len;
+	memcpy(l_ref.strs[param_index], r->str_def, r->str_def_len);
+	l_ref.bytes_lens[param_index] = r->bytes_def_len;
+	if (l_ref.bytes[param_index])
+		memcpy(l_ref.bytes[param_index], r->bytes_def, r->bytes_def_len);
+}
+
+template <typename T>
+static void l_ref_clamp_as(u8* value, const u8* def_bytes, const u8* min_bytes, const u8* max_bytes) {
+	T v, lo, hi;
+	memcpy(&v, value, sizeof(T));
+	memcpy(&lo, min_bytes, sizeof(T));
+	memcpy(&hi, max_bytes, sizeof(T));
+	// NaN and inf are set as the default. v - v is NaN for both, and NaN != NaN. never true for the integer types.
+	if (v - v != v - v) {
+		memcpy(value, def_bytes, sizeof(T));
+		return;
+	}
+	// written the other way around than param_clamp on purpose.
+	if (v < lo) v = lo;
+	else if (hi < v) v = hi;
+	memcpy(value, &v, sizeof(T));
+}
+
+static void l_ref_clamp(const l_ref_param_t* r, u8* value) {
+	if (!r->has_minmax)
+		return;
+	switch (r->type) {
+	case params_type_e::U8:  l_ref_clamp_as<u8>(value, r->def, r->min, r->max); break;
+	case params_type_e::U16: l_ref_clamp_as<u16>(value, r->def, r->min, r->max); break;
+	case params_type_e::U32: l_ref_clamp_as<u32>(value, r->def, r->min, r->max); break;
+	case params_type_e::U64: l_ref_clamp_as<u64>(value, r->def, r->min, r->max); break;
+	case params_type_e::I8:  l_ref_clamp_as<i8>(value, r->def, r->min, r->max); break;
+	case params_type_e::I16: l_ref_clamp_as<i16>(value, r->def, r->min, r->max); break;
+	case params_type_e::I32: l_ref_clamp_as<i32>(value, r->def, r->min, r->max); break;
+	case params_type_e::I64: l_ref_clamp_as<i64>(value, r->def, r->min, r->max); break;
+	case params_type_e::F32: l_ref_clamp_as<f32>(value, r->def, r->min, r->max); break;
+	case params_type_e::F64: l_ref_clamp_as<f64>(value, r->def, r->min, r->max); break;
+	default: break;
+	}
+}
+
+static bool l_ref_valid(const l_item_t* item) {
+	return item->param_index < PARAMS_COUNT && l_ref.params[item->param_index].type == item->type &&
+	       !l_ref.params[item->param_index].disabled;
+}
+
+static bool l_ref_is_bytes(params_type_e type) {
+	return type == params_type_e::STR16 || type == params_type_e::BUF;
+}
+
+static void l_ref_set(const l_item_t* item) {
+	const l_ref_param_t* r = &l_ref.params[item->param_index];
+	if (r->type == params_type_e::STR) {
+		u8 len = item->value[0] < r->str_max_len ? item->value[0] : r->str_max_len;
+		l_ref.str_lens[item->param_index] = len;
+		memcpy(l_ref.strs[item->param_index], item->value + 1, len);
+		return;
+	}
+	if (l_ref_is_bytes(r->type)) {
+		// sets cut values longer than max_len
+		static u8 bytes[L_BYTES_MAX];
+		u16 len = l_item_bytes(item, bytes);
+		l_ref.bytes_lens[item->param_index] = len < r->bytes_max_len ? len : r->bytes_max_len;
+		memcpy(l_ref.bytes[item->param_index], bytes, l_ref.bytes_lens[item->param_index]);
+		return;
+	}
+	u8 value[L_VALUE_BYTES];
+	memcpy(value, item->value, r->len);
+	l_ref_clamp(r, value);
+	memcpy(l_ref.values[item->param_index], value, r->len);
+}
+
+// the value as bytes to compare, fixed-size, len + chars or u16 len + bytes. out needs 2 + L_BYTES_MAX bytes.
+static u32 l_ref_bytes(u32 param_index, u8* out) {
+	const l_ref_param_t* r = &l_ref.params[param_index];
+	if (l_ref_is_bytes(r->type)) {
+		memcpy(out, &l_ref.bytes_lens[param_index], 2);
+		memcpy(out + 2, l_ref.bytes[param_index], l_ref.bytes_lens[param_index]);
+		return 2 + l_ref.bytes_lens[param_index];
+	}
+	if (r->type == params_type_e::STR) {
+		out[0] = l_ref.str_lens[param_index];
+		memcpy(out + 1, l_ref.strs[param_index], out[0]);
+		return 1 + out[0];
+	}
+	memcpy(out, l_ref.values[param_index], r->len);
+	return r->len;
+}
+
+// params_validate_all: NaN and inf go back to the default, the rest is clamped (which sets never leave undone).
+static void l_ref_validate() {
+	for (u32 i = 0; i < PARAMS_COUNT; i++) {
+		const l_ref_param_t* r = &l_ref.params[i];
+		u8* v = l_ref.values[i];
+		f32 f;
+		f64 d;
+		if (r->type == params_type_e::F32 && (memcpy(&f, v, 4), !isfinite(f)))
+			memcpy(v, r->def, 4);
+		else if (r->type == params_type_e::F64 && (memcpy(&d, v, 8), !isfinite(d)))
+			memcpy(v, r->def, 8);
+		else if (r->len)
+			l_ref_clamp(r, v);
+	}
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// the two instances
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static paramsys_ctx_t* l_fast;   // the default instance, fast paths
+static paramsys_ctx_t* l_scalar; // one plain call per item
+
+// typed handles by param index, nullptr where the param has none
+struct l_typed_t {
+	void (*set)(const void* value);
+	void (*get)(void* out_value);
+};
+static l_typed_t l_typed[PARAMS_COUNT];
+
+template <typename H>
+static void l_typed_set(const void* value) {
+	typename H::value_t v;
+	memcpy(&v, value, sizeof(v));
+	params_set<H>(v);
+}
+
+template <typename H>
+static void l_typed_get(void* out_value) {
+	typename H::value_t v = params_get<H>();
+	memcpy(out_value, &v, sizeof(v));
+}
+
+#define L_TYPED_HANDLE(H) l_typed[H::index] = {l_typed_set<H>, l_typed_get<H>};
+
+static bool l_init() {
+	params_init();
+	l_fast = params_ctx_default();
+	void* mem = aligned_alloc(params_ctx_align(), (params_ctx_size() + params_ctx_align() - 1) / params_ctx_align() *
+	                                                  params_ctx_align());
+	l_scalar = mem ? params_ctx_create(mem, params_ctx_size()) : nullptr;
+	if (!l_scalar) {
+		fprintf(stderr, "params_ctx_create failed\n");
+		return false;
+	}
+	PARAMS_FOR_EACH_HANDLE(L_TYPED_HANDLE)
+	return l_ref_init();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// checks
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static char l_op_desc[256]; // the operation being run, for the failure message
+
+static void l_print_bytes(const char* what, const void* bytes, u32 len) {
+	fprintf(stderr, "  %-8s", what);
+	for (u32 i = 0; i < len; i++)
+		fprintf(stderr, " %02x", ((const u8*)bytes)[i]);
+	fprintf(stderr, "\n");
+}
+
+[[noreturn]] static void l_fail(u32 param_index, const char* what, const void* expected, const void* got, u32 len) {
+	fprintf(stderr, "paramsys_fuzz: %s after %s, param %u (type %u)\n", what, l_op_desc, param_index,
+	        param_index < PARAMS_COUNT ? (u32)l_ref.params[param_index].type : 0u);
+	l_print_bytes("expected", expected, len);
+	l_print_bytes("got", got, len);
+	abort();
+}
+
+static void l_check_error(u32 param_index, const char* what, param_error_t expected, param_error_t got) {
+	if (expected != got)
+		l_fail(param_index, what, &expected, &got, sizeof(param_error_t));
+}
+
+// every value of both instances against the model
+static void l_check_all() {
+	u8 got[L_VALUE_BYTES];
+	char str[256];
+	static u8 bytes[0xffff];
+	u8 str_len;
+	u16 bytes_len;
+	for (u32 i = 0; i < PARAMS_COUNT; i++) {
+		const l_ref_param_t* r = &l_ref.params[i];
+		for (paramsys_ctx_t* ctx : {l_fast, l_scalar}) {
+			const char* name = ctx == l_fast ? "value of the default instance" : "value of the second instance";
+			if (r->disabled) {
+				param_error_t e = r->len ? params_ctx_get(ctx, i, r->type, got) :
+				                  r->type == params_type_e::STR ?
+				                  params_ctx_get_str_copy(ctx, i, str, sizeof(str) - 1, &str_len) :
+				                  params_ctx_get_bytes_copy(ctx, i, bytes, sizeof(bytes), &bytes_len);
+				l_check_error(i, "get of a disabled param", param_error_t::NO_PARAM, e);
+			} else if (r->len) {
+				l_check_error(i, "params_ctx_get", param_error_t::SUCCESS, params_ctx_get(ctx, i, r->type, got));
+				if (memcmp(got, l_ref.values[i], r->len) != 0)
+					l_fail(i, name, l_ref.values[i], got, r->len);
+			} else if (r->type == params_type_e::STR) {
+				l_check_error(i, "params_ctx_get_str_copy", param_error_t::SUCCESS,
+				              params_ctx_get_str_copy(ctx, i, str, sizeof(str) - 1, &str_len));
+				if (str_len != l_ref.str_lens[i] || memcmp(str, l_ref.strs[i], str_len) != 0)
+					l_fail(i, name, l_ref.strs[i], str, str_len > l_ref.str_lens[i] ? str_len : l_ref.str_lens[i]);
+			} else {
+				l_check_error(i, "params_ctx_get_bytes_copy", param_error_t::SUCCESS,
+				              params_ctx_get_bytes_copy(ctx, i, bytes, sizeof(bytes), &bytes_len));
+				u16 want_len = l_ref.bytes_lens[i];
+				if (bytes_len != want_len || memcmp(bytes, l_ref.bytes[i], bytes_len) != 0)
+					l_fail(i, name, l_ref.bytes[i], bytes, bytes_len > want_len ? bytes_len : want_len);
+			}
+		}
+		if (l_typed[i].get) {
+			l_typed[i].get(got);
+			if (memcmp(got, l_ref.values[i], r->len) != 0)
+				l_fail(i, "params_get<PARAM_x>()", l_ref.values[i], got, r->len);
+		}
+	}
+}
+
+
+// params_init and the resets with an active profile. the overrides survive a reset and show until the profile is
+// deactivated, the base values under them are the defaults then. params_init drops the profiles. runs once, on the
+// first enabled fixed-size param that isn't a float (a NaN default wouldn't compare).
+static bool l_check_profiles() {
+	u32 i = 1;
+	while (i < PARAMS_COUNT && (!l_ref.params[i].len || l_ref.params[i].disabled ||
+	                            l_ref.params[i].type == params_type_e::F32 || l_ref.params[i].type == params_type_e::F64))
+		i++;
+	if (i == PARAMS_COUNT)
+		return true;
+	const l_ref_param_t* r = &l_ref.params[i];
+	u8 base[L_VALUE_BYTES], over[L_VALUE_BYTES], got[L_VALUE_BYTES];
+	auto expect = [i, r, &got](const char* what, const u8* expected) {
+		params_get(i, r->type, got);
+		if (memcmp(got, expected, r->len) != 0)
+			l_fail(i, what, expected, got, r->len);
+	};
+
+	for (int init = 0; init < 3; init++) {
+		params_init();
+		// a base value and an override value that differ from the default and from each other, after clamping.
+		memcpy(base, r->def, r->len);
+		base[0] ^= 1;
+		params_set(i, r->type, base);
+		params_get(i, r->type, base);
+		memcpy(over, base, r->len);
+		over[0] ^= 2;
+		int profile = params_profile_create("fuzz");
+		if (profile < 0 || params_profile_override(profile, i, r->type, over) != param_error_t::SUCCESS ||
+		    params_profile_activate(profile) != param_error_t::SUCCESS) {
+			fprintf(stderr, "paramsys_fuzz: can't set up a profile for param %u\n", i);
+			return false;
+		}
+		params_get(i, r->type, over);
+		snprintf(l_op_desc, sizeof(l_op_desc), "%s with an active profile",
+		         init == 0 ? "params_init" : init == 1 ? "params_reset_all_to_defaults" : "params_reset_component");
+		if (init == 0) {
+			params_init();
+			expect("value", r->def);
+			if (params_profile_active() != 0 || params_profile_find("fuzz") != -1)
+				l_fail(i, "profile left after params_init", r->def, got, 0);
+			params_set(i, r->type, base);
+			expect("base value set after params_init", base);
+			continue;
+		}
+		if (init == 1)
+			params_reset_all_to_defaults();
+		else
+			params_reset_component(r->component);
+		expect("overridden value", over);
+		params_profile_activate(0);
+		expect("base value after deactivating the profile", r->def);
+		params_profile_activate(profile);
+		expect("overridden value after activating the profile again", over);
+	}
+	params_init();
+	return true;
+}
+
+// read levels of the params with an "R/W" security_level in schema/. params_get_info has only W, every other param
+// is R = W. a table generated from other schema files checks as if all of its params were R = W.
+static const struct {
+	const char* name;
+	u8          read_level;
+} l_read_levels[] = {{"p31_endpoint", 0}, {"p32_cert", 2}};
+
+// params_caller_* of every level of the sample schema and one above: NO_PARAM for the params the level can't see
+// (param 0 and disabled ones neither), DENIED for a set of those it sees but can't change, SUCCESS for the rest, and
+// params_caller_list lists exactly the ones it sees or can change. runs once, on the default values, and the sets
+// write the defaults again.
+static bool l_check_callers() {
+	static u8 read_level[PARAMS_COUNT];
+	static u8 write_level[PARAMS_COUNT];
+	for (u32 i = 0; i < PARAMS_COUNT; i++) {
+		param_info_public_t info;
+		params_get_info(i, &info);
+		write_level[i] = read_level[i] = info.security_level;
+		for (const auto& r : l_read_levels)
+			if (params_find(r.name, (u8)strlen(r.name)) == i)
+				read_level[i] = r.read_level;
+	}
+
+	static param_index_t listed[PARAMS_COUNT];
+	static u8 bytes[0xffff];
+	for (u8 level : {0, 1, 2, 3, 255}) {
+		params_caller_t caller = params_caller(level);
+		snprintf(l_op_desc, sizeof(l_op_desc), "params_caller_* of level %u", level);
+		u32 visible_count = 0, writable_count = 0;
+		for (u32 i = 0; i < PARAMS_COUNT; i++) {
+			const l_ref_param_t* r = &l_ref.params[i];
+			bool visible = i != 0 && !r->disabled && read_level[i] <= level;
+			bool writable = visible && write_level[i] <= level;
+			visible_count += visible;
+			writable_count += writable;
+			param_error_t get_expected = visible ? param_error_t::SUCCESS : param_error_t::NO_PARAM;
+			param_error_t set_expected = !visible ? param_error_t::NO_PARAM :
+			                             !writable ? param_error_t::DENIED : param_error_t::SUCCESS;
+			u8 value[L_VALUE_BYTES];
+			char str[256];
+			u8 str_len;
+			u16 bytes_len;
+			if (r->len) {
+				l_check_error(i, "params_caller_get", get_expected, params_caller_get(&caller, i, r->type, value));
+				memcpy(value, r->def, r->len);
+				l_check_error(i, "params_caller_set", set_expected, params_caller_set(&caller, i, r->type, value));
+			} else if (r->type == params_type_e::STR) {
+				l_check_error(i, "params_caller_get_str_copy", get_expected,
+				              params_caller_get_str_copy(&caller, i, str, sizeof(str) - 1, &str_len));
+				l_check_error(i, "params_caller_set_str", set_expected,
+				              params_caller_set_str(&caller, i, (const char*)r->str_def, r->str_def_len));
+			} else {
+				l_check_error(i, "params_caller_get_bytes_copy", get_expected,
+				              params_caller_get_bytes_copy(&caller, i, bytes, sizeof(bytes), &bytes_len));
+				param_error_t e = r->type == params_type_e::STR16 ?
+				                  params_caller_set_str16(&caller, i, (const char*)r->bytes_def, r->bytes_def_len) :
+				                  params_caller_set_buf(&caller, i, r->bytes_def, r->bytes_def_len);
+				l_check_error(i, "params_caller_set_str16/buf", set_expected, e);
+			}
+		}
+
+		for (bool writable : {false, true}) {
+			u32 count = params_caller_list(&caller, 0, writable, listed, PARAMS_COUNT);
+			u32 expected_count = writable ? writable_count : visible_count;
+			if (count != expected_count)
+				l_fail(0, writable ? "count of params_caller_list(writable)" : "count of params_caller_list",
+				       &expected_count, &count, sizeof(count));
+			for (u32 k = 0; k < count; k++) {
+				u32 i = listed[k];
+				bool ok = i < PARAMS_COUNT && (k == 0 || listed[k - 1] < i) && i != 0 && !l_ref.params[i].disabled &&
+				          read_level[i] <= level && (!writable || write_level[i] <= level);
+				if (!ok)
+					l_fail(i, writable ? "listed by params_caller_list(writable)" : "listed by params_caller_list",
+					       &i, &i, 0);
+			}
+		}
+	}
+	return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// running the operations
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void l_take_item(l_input_t* in, l_item_t* item) {
+	param_index_t raw;
+	l_take(in, &raw, sizeof(raw));
+	// a few past the end, to hit the index checks
+	item->param_index = (param_index_t)((u32)raw % (PARAMS_COUNT + 4u));
+	u8 t = l_take_u8(in);
+	if (t & 0x80 && item->param_index < PARAMS_COUNT)
+		item->type = l_ref.params[item->param_index].type;
+	else
+		item->type = l_types[t % L_TYPES_COUNT];
+	l_take(in, item->value, sizeof(item->value));
+	if (item->type == params_type_e::STR)
+		item->value[0] %= L_VALUE_BYTES;
+	if (l_ref_is_bytes(item->type)) {
+		// up to a bit over max_len, to hit the cut. short ones for the wrong params.
+		u16 len;
+		memcpy(&len, item->value, 2);
+		bool own = item->param_index < PARAMS_COUNT && l_ref.params[item->param_index].type == item->type;
+		len %= own ? l_ref.params[item->param_index].bytes_max_len + 17u : 64u;
+		memcpy(item->value, &len, 2);
+	}
+}
+
+// one plain call, on either instance
+static param_error_t l_set_one(paramsys_ctx_t* ctx, const l_item_t* item) {
+	static u8 bytes[L_BYTES_MAX];
+	if (item->type == params_type_e::STR)
+		return params_ctx_set_str(ctx, item->param_index, (const char*)item->value + 1, item->value[0]);
+	if (item->type == params_type_e::STR16)
+		return params_ctx_set_str16(ctx, item->param_index, (const char*)bytes, l_item_bytes(item, bytes));
+	if (item->type == params_type_e::BUF)
+		return params_ctx_set_buf(ctx, item->param_index, bytes, l_item_bytes(item, bytes));
+	return params_ctx_set(ctx, item->param_index, item->type, (void*)item->value);
+}
+
+static void l_run_set(l_path_e path, l_item_t* items, u32 count) {
+	bool all_valid = true;
+	for (u32 i = 0; i < count; i++)
+		all_valid &= l_ref_valid(&items[i]);
+
+	if (path == L_PATH_INDEX || path == L_PATH_TYPED) {
+		// one by one, every item on its own.
+		for (u32 i = 0; i < count; i++) {
+			l_item_t* item = &items[i];
+			bool valid = l_ref_valid(item);
+			param_error_t expected = valid ? param_error_t::SUCCESS : param_error_t::NO_PARAM;
+			if (path == L_PATH_TYPED && valid && l_typed[item->param_index].set)
+				l_typed[item->param_index].set(item->value);
+			else
+				l_check_error(item->param_index, "set on the default instance", expected, l_set_one(l_fast, item));
+			l_check_error(item->param_index, "set on the second instance", expected, l_set_one(l_scalar, item));
+			if (valid)
+				l_ref_set(item);
+		}
+		return;
+	}
+
+	// set_many and transactions apply all the items or none of them. transactions don't take STR16/BUF, they stop at
+	// the first item that fails, with FAIL for a STR16/BUF param and NO_PARAM for the rest.
+	param_error_t e;
+	param_error_t expected = all_valid ? param_error_t::SUCCESS : param_error_t::NO_PARAM;
+	param_value_t values[L_SET_MAX_ITEMS];
+	static u8 bytes[L_SET_MAX_ITEMS][L_BYTES_MAX];
+	if (path == L_PATH_MANY) {
+		for (u32 i = 0; i < count; i++) {
+			values[i].param_index = items[i].param_index;
+			values[i].param_type = items[i].type;
+			if (items[i].type == params_type_e::STR)
+				values[i].str_val = {(const char*)items[i].value + 1, items[i].value[0]};
+			else if (l_ref_is_bytes(items[i].type))
+				values[i].bytes_val = {bytes[i], l_item_bytes(&items[i], bytes[i])};
+			else
+				memcpy(&values[i].u8_val, items[i].value, sizeof(items[i].value));
+		}
+		e = params_ctx_set_many(l_fast, values, count);
+	} else {
+		for (u32 i = 0; i < count; i++) {
+			if (!l_ref_valid(&items[i]) || l_ref_is_bytes(items[i].type)) {
+				expected = l_ref_valid(&items[i]) ? param_error_t::FAIL : param_error_t::NO_PARAM;
+				break;
+			}
+		}
+		static params_txn_t txn;
+		params_txn_begin(&txn);
+		e = param_error_t::SUCCESS;
+		for (u32 i = 0; i < count && e == param_error_t::SUCCESS; i++) {
+			if (items[i].type == params_type_e::STR)
+				e = params_txn_set_str(&txn, items[i].param_index, (const char*)items[i].value + 1, items[i].value[0]);
+			else
+				e = params_txn_set(&txn, items[i].param_index, items[i].type, items[i].value);
+		}
+		if (e == param_error_t::SUCCESS)
+			e = params_txn_commit(&txn);
+		else
+			params_txn_abort(&txn);
+	}
+	l_check_error(items[0].param_index, "batch on the default instance", expected, e);
+	if (expected != param_error_t::SUCCESS)
+		return;
+	static u8 before[L_SET_MAX_ITEMS][2 + L_BYTES_MAX];
+	u32 before_len[L_SET_MAX_ITEMS];
+	for (u32 i = 0; i < count; i++)
+		before_len[i] = l_ref_bytes(items[i].param_index, before[i]);
+	for (u32 i = 0; i < count; i++) {
+		l_check_error(items[i].param_index, "set on the second instance", param_error_t::SUCCESS,
+		              l_set_one(l_scalar, &items[i]));
+		l_ref_set(&items[i]);
+	}
+	if (path != L_PATH_MANY)
+		return;
+
+	// set_many: only the last item of a param says if the batch changed it, from the values before and after.
+	for (u32 i = 0; i < count; i++) {
+		bool last = true;
+		for (u32 j = i + 1; j < count; j++)
+			last &= items[j].param_index != items[i].param_index;
+		static u8 after[2 + L_BYTES_MAX];
+		u32 after_len = l_ref_bytes(items[i].param_index, after);
+		bool expected = last && (after_len != before_len[i] || memcmp(after, before[i], after_len) != 0);
+		if (values[i].changed != expected)
+			l_fail(items[i].param_index, "set_many changed", &expected, &values[i].changed, sizeof(bool));
+	}
+}
+
+static void l_run_reset_component(u8 component) {
+	bool any = false;
+	// the internal param 0 counts too, it's in component 0.
+	for (u32 i = 0; i < PARAMS_COUNT; i++) {
+		if (l_ref.params[i].component == component) {
+			l_ref_reset(i);
+			any = true;
+		}
+	}
+	param_error_t expected = any ? param_error_t::SUCCESS : param_error_t::NO_PARAM;
+	l_check_error(0, "params_ctx_reset_component on the default instance", expected,
+	              params_ctx_reset_component(l_fast, component));
+	l_check_error(0, "params_ctx_reset_component on the second instance", expected,
+	              params_ctx_reset_component(l_scalar, component));
+}
+
+static void l_reset_all() {
+	params_ctx_reset_all_to_defaults(l_fast);
+	params_ctx_reset_all_to_defaults(l_scalar);
+	for (u32 i = 0; i < PARAMS_COUNT; i++)
+		l_ref_reset(i);
+}
+
+static void l_run(const u8* data, size_t size) {
+	static bool ready = l_init() && l_check_profiles() && l_check_callers();
+	if (!ready)
+		abort();
+
+	l_reset_all();
+	l_input_t in = {data, size};
+	param_index_t fixed[64];
+	while (in.left) {
+		u8 op = l_take_u8(&in) % L_OP_COUNT;
+		switch (op) {
+		case L_OP_SET: {
+			l_path_e path = (l_path_e)(l_take_u8(&in) % L_PATH_COUNT);
+			u32 count = 1 + l_take_u8(&in) % L_SET_MAX_ITEMS;
+			l_item_t items[L_SET_MAX_ITEMS];
+			for (u32 i = 0; i < count; i++)
+				l_take_item(&in, &items[i]);
+			snprintf(l_op_desc, sizeof(l_op_desc), "%s of %u items, the first %u type %u", l_path_names[path], count,
+			         (u32)items[0].param_index, (u32)items[0].type);
+			l_run_set(path, items, count);
+			break;
+		}
+		case L_OP_RESET_ALL:
+			snprintf(l_op_desc, sizeof(l_op_desc), "reset all");
+			l_reset_all();
+			break;
+		case L_OP_RESET_COMPONENT: {
+			u8 component = l_take_u8(&in);
+			snprintf(l_op_desc, sizeof(l_op_desc), "reset component %u", component);
+			l_run_reset_component(component);
+			break;
+		}
+		case L_OP_VALIDATE: {
+			snprintf(l_op_desc, sizeof(l_op_desc), "validate");
+			params_ctx_validate_all(l_fast, fixed, 64);
+			paramsys_isa_e isa = paramsys_scan_limits_set_isa(paramsys_isa_e::SCALAR);
+			params_ctx_validate_all(l_scalar, fixed, 64);
+			paramsys_scan_limits_set_isa(isa);
+			l_ref_validate();
+			break;
+		}
+		}
+		l_check_all();
+	}
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const u8* data, size_t size) {
+	l_run(data, size);
+	return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// standalone driver
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PARAMSYS_FUZZ_LIBFUZZER
+
+static void l_put(std::vector<u8>& out, const void* bytes, size_t n) {
+	out.insert(out.end(), (const u8*)bytes, (const u8*)bytes + n);
+}
+
+static void l_put_set(std::vector<u8>& out, l_path_e path, param_index_t param_index, const void* value, u32 len) {
+	u8 value_bytes[L_VALUE_BYTES] = {};
+	memcpy(value_bytes, value, len);
+	u8 head[] = {L_OP_SET, path, 0};
+	l_put(out, head, sizeof(head));
+	l_put(out, &param_index, sizeof(param_index));
+	u8 own_type = 0x80;
+	l_put(out, &own_type, 1);
+	l_put(out, value_bytes, sizeof(value_bytes));
+}
+
+typedef std::vector<std::vector<u8>> l_seed_values_t;
+
+// default, default + 1 and with limits min, max, min - 1, max + 1. plus the extra ones.
+template <typename T>
+static void l_add_edges(l_seed_values_t& values, const l_ref_param_t* r, std::initializer_list<T> extra = {}) {
+	T def, lo, hi;
+	memcpy(&def, r->def, sizeof(T));
+	std::vector<T> v = {def, (T)(def + 1)};
+	if (r->has_minmax) {
+		memcpy(&lo, r->min, sizeof(T));
+		memcpy(&hi, r->max, sizeof(T));
+		v.insert(v.end(), {lo, hi, (T)(lo - 1), (T)(hi + 1)});
+	}
+	v.insert(v.end(), extra);
+	for (T x : v)
+		values.emplace_back((const u8*)&x, (const u8*)&x + sizeof(T));
+}
+
+// the value edges of one param, every one through every path, validated at the end. STR, STR16 and BUF get a value
+// longer than their max_len.
+static std::vector<u8> l_seed(u32 param_index) {
+	const l_ref_param_t* r = &l_ref.params[param_index];
+	l_seed_values_t values;
+	switch (r->type) {
+	case params_type_e::U8:  case params_type_e::FLAGS8:  l_add_edges<u8>(values, r); break;
+	case params_type_e::U16: case params_type_e::FLAGS16: l_add_edges<u16>(values, r); break;
+	case params_type_e::U32: case params_type_e::FLAGS32: l_add_edges<u32>(values, r); break;
+	case params_type_e::U64: l_add_edges<u64>(values, r); break;
+	case params_type_e::I8:  l_add_edges<i8>(values, r); break;
+	case params_type_e::I16: l_add_edges<i16>(values, r); break;
+	case params_type_e::I32: l_add_edges<i32>(values, r); break;
+	case params_type_e::I64: case params_type_e::TIME_UNIX_US64: case params_type_e::TIME_ATOMIC_US64:
+		l_add_edges<i64>(values, r);
+		break;
+	case params_type_e::F32: l_add_edges<f32>(values, r, {NAN, INFINITY, -INFINITY, -0.0f}); break;
+	case params_type_e::F64: l_add_edges<f64>(values, r, {NAN, INFINITY, -INFINITY, -0.0}); break;
+	case params_type_e::UUID128:
+		values.emplace_back(r->def, r->def + 16);
+		values.emplace_back(16, 0xff);
+		break;
+	case params_type_e::STR: {
+		u8 s[L_VALUE_BYTES];
+		s[0] = r->str_max_len < L_VALUE_BYTES - 1 ? r->str_max_len + 1 : L_VALUE_BYTES - 1;
+		for (u32 i = 1; i < L_VALUE_BYTES; i++) s[i] = 'a' + i;
+		values.emplace_back(s, s + L_VALUE_BYTES);
+		s[0] = 0;
+		values.emplace_back(s, s + L_VALUE_BYTES);
+		break;
+	}
+	case params_type_e::STR16: case params_type_e::BUF: {
+		// empty, the default length, max_len and one past it
+		u8 s[L_VALUE_BYTES];
+		for (u32 i = 2; i < L_VALUE_BYTES; i++) s[i] = 'a' + i;
+		for (u16 len : {(u16)0, r->bytes_def_len, r->bytes_max_len, (u16)(r->bytes_max_len + 1)}) {
+			memcpy(s, &len, 2);
+			values.emplace_back(s, s + L_VALUE_BYTES);
+		}
+		break;
+	}
+	default:
+		return {};
+	}
+	std::vector<u8> out;
+	for (u8 path = 0; path < L_PATH_COUNT; path++)
+		for (auto& v : values)
+			l_put_set(out, (l_path_e)path, param_index, v.data(), v.size());
+	out.push_back(L_OP_VALIDATE);
+	return out;
+}
+
+static int l_write_corpus(const char* dir) {
+	static bool ready = l_init();
+	if (!ready)
+		return 1;
+	mkdir(dir, 0755);
+	u32 written = 0;
+	for (u32 i = 1; i < PARAMS_COUNT; i++) {
+		std::vector<u8> seed = l_seed(i);
+		if (seed.empty())
+			continue;
+		char path[1024];
+		snprintf(path, sizeof(path), "%s/param_%u", dir, i);
+		FILE* f = fopen(path, "wb");
+		if (!f || fwrite(seed.data(), 1, seed.size(), f) != seed.size()) {
+			fprintf(stderr, "can't write %s\n", path);
+			if (f) fclose(f);
+			return 1;
+		}
+		fclose(f);
+		written++;
+	}
+	printf("wrote %u seeds to %s\n", written, dir);
+	return 0;
+}
+
+static bool l_run_file(const char* path) {
+	FILE* f = fopen(path, "rb");
+	if (!f) {
+		fprintf(stderr, "can't open %s\n", path);
+		return false;
+	}
+	std::vector<u8> data;
+	u8 buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		data.insert(data.end(), buf, buf + n);
+	fclose(f);
+	LLVMFuzzerTestOneInput(data.data(), data.size());
+	return true;
+}
+
+static bool l_run_path(const char* path, u32* count) {
+	struct stat st;
+	if (stat(path, &st) != 0) {
+		fprintf(stderr, "can't stat %s\n", path);
+		return false;
+	}
+	if (!S_ISDIR(st.st_mode)) {
+		(*count)++;
+		return l_run_file(path);
+	}
+	DIR* d = opendir(path);
+	if (!d)
+		return false;
+	bool ok = true;
+	while (dirent* e = readdir(d)) {
+		if (e->d_name[0] == '.')
+			continue;
+		std::string sub = std::string(path) + "/" + e->d_name;
+		ok &= l_run_path(sub.c_str(), count);
+	}
+	closedir(d);
+	return ok;
+}
+
+// xorshift64, the same streams on every machine
+static u64 l_rand(u64* state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static void l_run_random(u32 count, u64 seed) {
+	u64 state = seed ? seed : 1;
+	std::vector<u8> data;
+	for (u32 i = 0; i < count; i++) {
+		data.resize(16 + l_rand(&state) % 1024);
+		for (auto& b : data)
+			b = (u8)l_rand(&state);
+		LLVMFuzzerTestOneInput(data.data(), data.size());
+	}
+	printf("%u random streams from seed %llu, no differences\n", count, (unsigned long long)seed);
+}
+
+int main(int argc, char** argv) {
+	if (argc == 3 && strcmp(argv[1], "--corpus") == 0)
+		return l_write_corpus(argv[2]);
+	if (argc >= 2 && strcmp(argv[1], "--random") == 0) {
+		l_run_random(argc >= 3 ? (u32)strtoul(argv[2], nullptr, 0) : 1000,
+		             argc >= 4 ? strtoull(argv[3], nullptr, 0) : 1);
+		return 0;
+	}
+	if (argc == 1) {
+		l_run_random(1000, 1);
+		return 0;
+	}
+	u32 count = 0;
+	bool ok = true;
+	for (int i = 1; i < argc; i++)
+		ok &= l_run_path(argv[i], &count);
+	printf("ran %u inputs, no differences\n", count);
+	return ok ? 0 : 1;
+}
+
+#endif
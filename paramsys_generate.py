@@ -1,101 +1,41 @@
 # Elmo Trolla, 2020-07-21
 # Licence: pick one - public domain / UNLICENCE (https://www.unlicense.org) / MIT (https://opensource.org/licenses/MIT).
 
-params_input = """
-# name, type, default, min, max
-# name, type, "default", maxlen # maxlen without terminating zero? there is no terminating zero..
-
-# Line starts with "-" to disable the parameter. it will still exist in memory, but won't be accessible from the API.
-
-# string type param values are utf8 encoded
-# strings are in python format, meaning characters can be escaped. "\u1234hello" ? TODO: format
-# TODO: add flags8, flags16, flags32 and date and uuid types.
-# TODO: prevent float NaN and infinities. and subnormal?
-
-# can use hex values. but not for negative values.
-
-#    -----name------  component security_level type  defalt     min     max
-#   "               "
-# 0 is used internally
-#   "_internalparam_", (u8)params_type_e::U32, 0x00,   0,     0,     0,  param_info_t::NO_DEFAULT},')
-
-  1  p11_U16_minmax   1     1   u16     90       1   65535
-#  1  p1_I64_minmax    1     1   i64   -100    -200   0x12c  # 0x12c is 300
-  2  p2_I64           1     1   i64    -99
-  3  p3_U64_minmax    1     1   u64     98
-  4  p4_U64           1     1   u64     97
-  5  p5_I32_minmax    1     1   i32    -96  -10000       0
-  6  p6_I32           1     1   i32    -95
-  7  p7_U32_minmax    1     1   u32     94       0       100
-  8  p8_U32           1     1   u32     93
-  9  p9_I16_minmax    1     1   i16    -92       1    0xff
- 10  p10_I16          1     1   i16    -91
-# 11  p11_U16_minmax   1     1   u16     90       1   65535
- 11  p1_I64_minmax    1     1   i64   -100    -200   0x12c  # 0x12c is 300
- 12  p12_U16          1     1   u16     89
- 13  p13_I8_minmax    1     1   i8     -88     -20      30
- 14  p14_I8           1     1   i8     -87
- 15  p15_I8_overflw   1     1   i8     125
- 16  p16_U16_overflw  1     1   u16      2
- 17  p17_U16_overflw  1     1   u16  32768
- 18  p18_U16_overflw  1     1   u16  32769      33   65535       
-
- 19  p19_flags8       1     1   flags8
- 20  p20_flags8       1     1   flags8   6
- 21  p21_flags16      1     1   flags16  257
- 22  p22_flags32      1     1   flags32  260
-
- 23  p23_time_unix    1     1   time_unix_us64
- 24  p24_time_atomic  1     1   time_atomic_us64   2014-02-11T18:46:22.66Z # possible formats:
-                                                                           # 2014-02-11T18:46:22Z
-                                                                           # 2014-02-11T18:46:22.4439128Z
-                                                                           # 2014-02-11T18:46:22,443Z
-                                                                           # 19209324924
-                                                                           # 19_209_324_924
-
- 25  p25_test_8_STR   1     1   str   "hello" 20
- 26  p26_test_10_STR  1     1   str   ""      5
-
- 27  p27_test_2_F64   1     1   f64    -10     -20     30
- 28  p28_test_3_F32   1     1   f32      1       0      2
-
- 29  p29_uuid128      1     1   uuid128      # possible formats: 12345678123456781234567812345678
-                                             #                   12345678-1234-5678-1234-567812345678
-                                             #                   0x12345678123456781234567812345678
-                                             # TODO: endianness? seems that the 0x format is not the real memory representation. TODO: real real?
-
- 30  p30_time_unix    1     1   time_unix_us64  1111111111111
-
-#  3  p1_U64          1     1     i8   1000
-  
-#  1  test_1_I32      1     1    i32     10       5     15
-#  2  test_2_F64      1     1    f64    -10     -20     30
-#  3  test_3_F32      1     1    f32      1       0      2
-#  4  test_4_U8       1     1     u8    255
-#  5  test_5_I32      1     1    i32    100      90    110
-#- 6  test_6_U32      1     1    u32    200     190    210
-#  7  test_7_U32      1     1    u32    400     390    410
-#  9  test_9_U32      1     1    u32    500     490    510
-# 11  test_11_I16     1     1    i16   -400    -390   -410
-
-#  8  test_8_STR      1     1    str   "hello" 20
-# 10  test_10_STR     1     1    str   ""      5
-
-"""
+# Reads the schema files (schema/*.params by default, one per component. the format is described in
+# schema/component_1.params) and writes into the output dir:
+#
+#   paramsys_generated_config.h       param_index_t width and the values capacity. included by paramsys.h.
+#   paramsys_generated_component_N.h  PARAM_x_index defines and typed handles of the params of component N.
+#   paramsys_generated.h              includes all the component headers.
+#   paramsys_impl_generated.h         the tables. included only by paramsys.cpp.
+#
+# A header is written only if its contents change, so editing one component rebuilds only the code that includes that
+# component's header (and paramsys.cpp).
+#
+#   python3 paramsys_generate.py [-o out_dir] [--index-bits 16|32] [--stamp file] [schema files..]
 
 import logging
 log = logging.getLogger(__name__)
 
 logging.basicConfig(level=logging.NOTSET, format="%(asctime)s %(name)s %(levelname)-5s: %(message)s")
 
+import argparse
+import datetime
+import glob
+import io
+import math
+import os
 import struct
+import sys
 import uuid
-import datetime
 
 
 #FILENAME_PREPEND = "test-"
 FILENAME_PREPEND = ""
 
+PARAMS_VALUES_CAPACITY_BYTES_DEFAULT = 65536 * 2  # PARAMS_VALUES_CAPACITY_BYTES in paramsys.h
+PARAMS_MAX_COUNT_32 = 0x1000000  # PARAMS_MAX_COUNT in paramsys.h with 32-bit indices
+
 # TODO: implement u128, i128. struct module doesn't support these.
 
 u8, u16, u32, u64,\
@@ -104,7 +44,11 @@ u8, u16, u32, u64,\
 	flags8, flags16, flags32,\
 	uuid128,\
 	time_unix_us64, time_atomic_us64,\
-	strt = 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17
+	strt, str16t, buft = 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19
+
+# variable-size types with the value in the arena (str16 and buf) vs in a fixed slot (str)
+arena_types = (str16t, buft)
+variable_types = (strt,) + arena_types
 
 type_minmax = {
 	u8: (0, 0xff), u16: (0, 0xffff), u32: (0, 0xffffffff), u64: (0, 0xffffffffffffffff),
@@ -119,7 +63,7 @@ type_from_str = {
 	"flags8": flags8, "flags16": flags16, "flags32": flags32,
 	"uuid128": uuid128,
 	"time_unix_us64": time_unix_us64, "time_atomic_us64": time_atomic_us64,
-	"str": strt}
+	"str": strt, "str16": str16t, "buf": buft}
 
 type_to_str = {
 	u8: "u8", u16: "u16", u32: "u32", u64: "u64",
@@ -128,13 +72,31 @@ type_to_str = {
 	flags8: "flags8", flags16: "flags16", flags32: "flags32",
 	uuid128: "uuid128",
 	time_unix_us64: "time_unix_us64", time_atomic_us64: "time_atomic_us64",
-	strt: "str"}
+	strt: "str", str16t: "str16", buft: "buf"}
 
 type_to_structpack = {
 	u8: ">B", u16: ">H", u32: ">I", u64: ">Q", i8: ">b", i16: ">h", i32: ">i", i64: ">q", f32: ">f", f64: ">d",
 	flags8: ">B", flags16: ">H", flags32: ">I",
 	time_unix_us64: ">q", time_atomic_us64: ">q"}
 
+# c type of the value for typed handles (param_handle_t). uuid128 and str don't get handles.
+type_to_ctype = {
+	u8: "u8", u16: "u16", u32: "u32", u64: "u64", i8: "i8", i16: "i16", i32: "i32", i64: "i64", f32: "f32", f64: "f64",
+	flags8: "u8", flags16: "u16", flags32: "u32",
+	time_unix_us64: "i64", time_atomic_us64: "i64"}
+
+
+def gen_handle_literal(param_type, value):
+	"""c++ constant expression for value, exactly representable in the c type of the param."""
+	ctype = type_to_ctype[param_type]
+	if param_type in (f32, f64):
+		# round-trip through the packed representation so that f32 literals are exactly what ends up in defminmax_32.
+		v = struct.unpack(type_to_structpack[param_type], struct.pack(type_to_structpack[param_type], value))[0]
+		return f"({ctype}){v!r}"
+	if value == -0x8000000000000000:
+		return "(-0x7fffffffffffffffll - 1)"  # -0x8000000000000000ll would be an unsigned literal negated
+	return f"({ctype}){value}{'ull' if value > 0x7fffffff else ''}"
+
 
 def timestr_to_timestamp(timestr):
 	"""timestr format: '2014-02-11T18:46:22Z' | '2014-02-11T18:46:22.4439128Z' | '2014-02-11T18:46:22,443Z' """
@@ -165,12 +127,55 @@ def validate(param_type, values_list):
 			raise RuntimeError(f"some values are out of range of {minval}..{maxval}")
 
 
+def validate_minmax(param, line_num):
+	# param_clamp would take min and max in any order, but the vector scan of params_validate_all wouldn't.
+	if param.has_minmax and param.min_value > param.max_value:
+		raise RuntimeError(f"error parsing line {line_num}: min {param.min_value} is bigger than max {param.max_value}")
+
+
+FLT_MAX = struct.unpack(">f", bytes.fromhex("7f7fffff"))[0]
+DBL_MAX = struct.unpack(">d", bytes.fromhex("7fefffffffffffff"))[0]
+
+
+def validate_float(param_type, values_list):
+	for v in values_list:
+		if not math.isfinite(v):
+			raise RuntimeError(f"NaN and infinite values are not allowed: {v}")
+		if param_type == f32 and abs(v) > FLT_MAX:
+			raise RuntimeError(f"value out of f32 range: {v}")
+
+
+def limit_key(param_type, value, bits):
+	"""value as a signed integer that orders the same way, in the two's complement bit pattern of a bits-wide int.
+	see paramsys_scan_limits. unsigned: flip the sign bit. signed: as is. float: flip the non-sign bits of negatives."""
+	mask = (1 << bits) - 1
+	sign = 1 << (bits - 1)
+	if param_type in (f32, f64):
+		b = struct.unpack(">I" if param_type == f32 else ">Q", struct.pack(type_to_structpack[param_type], value))[0]
+		return b ^ (mask ^ sign) if b & sign else b
+	if param_type in (u8, u16, u32, u64, flags8, flags16, flags32):
+		return (value ^ sign) & mask
+	return value & mask
+
+
+def limit_kind(param_type, bits):
+	"""per value mask of paramsys_scan_limits that turns the raw value into its limit_key."""
+	mask = (1 << bits) - 1
+	sign = 1 << (bits - 1)
+	if param_type in (f32, f64):
+		return mask ^ sign
+	if param_type in (u8, u16, u32, u64, flags8, flags16, flags32):
+		return sign
+	return 0
+
+
 class Param:
 	def __init__(self, index, name, component, security_level, param_type):
 		self.index = index
 		self.name = name
 		self.component = component
-		self.security_level = security_level
+		self.security_level = security_level  # lowest caller level that can change the param
+		self.read_level = security_level  # lowest caller level that can see the param
 		self.param_type = param_type
 
 		self.used = True
@@ -187,12 +192,16 @@ class Param:
 		#   str:
 		#       '124,   5, 0x6b, 0x65, 0x6c, 0x6c, 0x6f' (for max len 124 and default str "hello")
 		#       '124,   0" (for max len 124 and no default str)
+		#   str16, buf: the same with u16 max len and len, little-endian
+		#       '0x00, 0x04,   5, 0x00, 0x6b, 0x65, 0x6c, 0x6c, 0x6f' (for max len 1024 and default "hello")
 		self.default_value_str = None
+		self.source = ""  # schema file
 		self.line_num = -1
 		self.line_str = ""
 
 		# flags. TODO: move to flags..
 		self.has_minmax = False
+		self.history_len = 0  # history:N option
 
 	def __str__(self):
 		return f"used {self.used:5} idx {self.index:2} {self.name:15} comp {self.component:3} seclevel {self.security_level:3} {type_to_str[self.param_type]:3} has_def {self.has_default:5} def_idx {self.defaults_index:2} val_idx {self.values_index:2}"
@@ -260,10 +269,13 @@ class ParamTime(Param):
 
 class ParamStr(Param):
 	def __init__(self, index, name, component, security_level, param_type):
-		assert param_type in (strt,)
+		assert param_type in variable_types
 		super().__init__(index, name, component, security_level, param_type)
 		self.max_len = -1  # TODO: with or without zerotermination?
-		self.default_value = ""
+		self.default_value = ""  # bytes for buf
+
+	def default_bytes(self):
+		return self.default_value if self.param_type == buft else bytes(self.default_value, "utf8")
 
 	def __str__(self):
 		return super().__str__() + f' max_len {self.max_len:3} def {repr(self.default_value)}'
@@ -271,7 +283,7 @@ class ParamStr(Param):
 
 # - 6  PARAM_6_U32      1     1    u32    200,     190,    210
 # return ParamInt, ParamFloat, ParamStr object,
-def parse_line_to_param(line_num, line_str):
+def parse_line_to_param(source, line_num, line_str):
 	try:
 		l = line_str.strip()
 		if "#" in l:
@@ -293,13 +305,18 @@ def parse_line_to_param(line_num, line_str):
 		index = int(index)
 		assert len(name) <= 15
 		component = int(component)
+		read_level, _, security_level = security_level.rpartition("/")
 		security_level = int(security_level)
+		read_level = int(read_level) if read_level else security_level
+		assert 0 <= read_level <= security_level <= 255
 		if param_type not in type_from_str:
 			raise RuntimeError(f"unknown param_type: {param_type!r}")
 		param_type = type_from_str[param_type]
 		line_remainder = line_remainder.strip()
 
 		r = line_remainder.split()
+		options = [o for o in r if o.startswith("history:")]
+		r = [o for o in r if o not in options]
 
 		if param_type in [u8, u16, u32, u64, i8, i16, i32, i64]:
 			param = ParamInt(index, name, component, security_level, param_type)
@@ -320,6 +337,7 @@ def parse_line_to_param(line_num, line_str):
 				raise RuntimeError("error parsing line %i: %r" % (line_num, line_str))
 
 			validate(param_type, (param.default_value, param.min_value, param.max_value))
+			validate_minmax(param, line_num)
 
 		elif param_type in [f32, f64]:
 			param = ParamFloat(index, name, component, security_level, param_type)
@@ -339,6 +357,9 @@ def parse_line_to_param(line_num, line_str):
 			else:
 				raise RuntimeError("error parsing line %i: %r" % (line_num, line_str))
 
+			validate_float(param_type, (param.default_value, param.min_value, param.max_value))
+			validate_minmax(param, line_num)
+
 		elif param_type in [flags8, flags16, flags32]:
 			param = ParamFlags(index, name, component, security_level, param_type)
 
@@ -398,13 +419,40 @@ def parse_line_to_param(line_num, line_str):
 			param.default_value = str(r[0][1:-1])  # parses escape codes. for example \t will result in 1 byte.
 			param.has_default = bool(param.default_value)
 			param.max_len = str_to_int(r[1])
+			assert 0 <= param.max_len <= 255
+
+		elif param_type in arena_types:
+			param = ParamStr(index, name, component, security_level, param_type)
+
+			# 31  p31_endpoint     1     1   str16  "https://example.com/api/v1"  1024
+			# 32  p32_cert         1     1   buf    0x30820122300d                4096
+
+			assert len(r) == 2
+			if param_type == buft and r[0] != '""':
+				assert r[0].startswith("0x")
+				param.default_value = bytes.fromhex(r[0][2:])
+			else:
+				assert r[0][0] == '"' and r[0][-1] == '"' and len(r[0]) >= 2
+				param.default_value = str(r[0][1:-1]) if param_type == str16t else b""
+			param.has_default = bool(param.default_value)
+			param.max_len = str_to_int(r[1])
+			assert 0 <= param.max_len <= 65000
+			assert len(param.default_bytes()) <= param.max_len
 
 		else:
 			raise RuntimeError("error parsing line %i. unknown param type %i: %r" % (line_num, param_type, line_str))
 
+		param.source = source
 		param.line_num = line_num
 		param.line_str = line_str
 		param.used = param_used
+		param.read_level = read_level
+
+		for o in options:
+			if param_type in variable_types:
+				raise RuntimeError(f"history is for fixed-size types only: {line_str!r}")
+			param.history_len = str_to_int(o.split(":", 1)[1])
+			assert 0 < param.history_len <= 65535
 
 		# Remove default values for unused params. These params still have to take up space in the values
 		# array in EEPROM, because removing params from EEPROM would require the firmware image to know
@@ -414,32 +462,35 @@ def parse_line_to_param(line_num, line_str):
 			param.has_default = False
 			param.has_minmax = False
 			param.default_value = None
+			param.history_len = 0
 
 		return param
 
 	except RuntimeError:
-		log.error("error parsing line %i: %r" % (line_num, line_str))
+		log.error("%s:%i: error parsing line: %r" % (source, line_num, line_str))
 		raise
 	except:
-		log.error("error parsing line %i: %r" % (line_num, line_str))
+		log.error("%s:%i: error parsing line: %r" % (source, line_num, line_str))
 		raise
 		#log.exception("")
 		#raise RuntimeError("error parsing line %i: %r" % (line_num, line_str))
 
 
-def parse_text_to_params(params_input):
+def parse_schema_file(path):
 	params_list = []
-	for i, line in enumerate( params_input.splitlines() ):
-		param = parse_line_to_param(i, line)
-		params_list.append(param)
+	with open(path, "rt", encoding="utf8") as f:
+		for i, line in enumerate(f):
+			param = parse_line_to_param(path, i + 1, line)
+			if param:
+				params_list.append(param)
 
 	return params_list
 
 
 class ParamsProcessed:
 	def __init__(self, params_list):
-		self.params_unsorted = params_list[:]
 		self.params = sorted(params_list, key=lambda x: x.index)
+		params_list = self.params
 
 		# ensure the sorting contract and that all indices are present
 		for i in range(len(self.params)-1):
@@ -450,7 +501,10 @@ class ParamsProcessed:
 		self.params_32  = [param for param in params_list if param.param_type in (i32, u32, f32, flags32)]
 		self.params_64  = [param for param in params_list if param.param_type in (i64, u64, f64, time_unix_us64, time_atomic_us64)]
 		self.params_128 = [param for param in params_list if param.param_type in (uuid128,)]
-		self.params_str = [param for param in params_list if param.param_type == strt]
+		# str slots first, then the arena refs of str16 and buf (8 bytes each). the arena follows the str region.
+		self.params_str = [param for param in params_list if param.param_type == strt] + \
+			[param for param in params_list if param.param_type in arena_types]
+		self.params_arena = [param for param in self.params_str if param.param_type in arena_types]
 
 		# parameters that have defaults, but not defminmax.
 		self.params_defaults_8   = [param for param in self.params_8   if param.has_default and not param.has_minmax]
@@ -478,6 +532,10 @@ class ParamsProcessed:
 					return f"{param.max_len:3}, {len(param.default_value):3}, " + s
 				else:
 					return f"{param.max_len:3},   0"
+			if param.param_type in arena_types:
+				b = param.default_bytes()
+				header = struct.pack("<HH", param.max_len, len(b))
+				return ", ".join(f"0x{c:02x}" for c in header + b)
 
 			if param.has_default:
 				if param.param_type == uuid128:
@@ -517,9 +575,10 @@ class ParamsProcessed:
 		# calculate values_index (index to EEPROM values array) for every parameter.
 
 		for params_list in [self.params_8, self.params_16, self.params_32, self.params_64, self.params_128, self.params_str]:
-			# ensure the sorting contract
+			# ensure the sorting contract. params_str has the str params first, then the arena ones, each sorted.
 			for i in range(len(params_list) - 1):
-				assert params_list[i + 1].index - params_list[i].index >= 1
+				assert params_list[i + 1].index - params_list[i].index >= 1 or \
+					(params_list[i + 1].param_type in arena_types) != (params_list[i].param_type in arena_types)
 
 			for i, param in enumerate(params_list):
 				param.values_index = i
@@ -529,15 +588,26 @@ class ParamsProcessed:
 		values_index = 0
 		for param in self.params_str:
 			param.values_index = values_index
-			values_index += 2 + param.max_len  # 2 bytes are max str len and current len
+			values_index += self._str_slot_len(param)
 
 		assert values_index == self._calc_values_str_bytes()
 
+		# byte offset of every value from the start of the values array, for params_hot.
+
+		offsets = self._calc_values_offsets()
+		for params_list, offset, type_len, size_class in zip(
+				[self.params_8, self.params_16, self.params_32, self.params_64, self.params_128, self.params_str],
+				offsets, [1, 2, 4, 8, 16, 1], ["8", "16", "32", "64", "128", "STR"]):
+			for param in params_list:
+				param.values_offset = offset + param.values_index * type_len
+				param.size_class = size_class
+
 		# calculate defaults_index (index to defaults array in firmware image) for every fixed-size parameter.
 
 		params_list_list = [
 			self.params_defaults_8, self.params_defaults_16,
 			self.params_defaults_32, self.params_defaults_64,
+			self.params_defaults_128,
 			self.params_defminmax_8, self.params_defminmax_16,
 			self.params_defminmax_32, self.params_defminmax_64,
 			self.params_defminmax_128]
@@ -556,33 +626,146 @@ class ParamsProcessed:
 		str_param_index = 0
 		for i, param in enumerate(self.params_defaults_str):
 			param.defaults_index = str_param_index
-			str_param_index += 2 + (len(param.default_value))
+			str_param_index += self._str_default_len(param)
 
-	def _calc_values_len_bytes(self):
-		"""total len of values of all fixed size types, with padding"""
+	def _calc_values_offsets(self):
+		"""offsets of the 8, 16, 32, 64, 128 and str values arrays from the start of the values array"""
 		def offsetof_8(): return 0
 		def offsetof_16(): end = offsetof_8() + len(self.params_8); return end + (end & 1)  # aligned by 2 bytes
 		def offsetof_32(): end = offsetof_16() + len(self.params_16) * 2; return end + (end & 2)  # aligned by 4 bytes
 		def offsetof_64(): return offsetof_32() + len(self.params_32) * 4  # aligned by 4 bytes
 		def offsetof_128(): return offsetof_64() + len(self.params_64) * 8  # aligned by 4 bytes
 		def offsetof_str(): return offsetof_128() + len(self.params_128) * 16  # aligned by 4 bytes
+		return offsetof_8(), offsetof_16(), offsetof_32(), offsetof_64(), offsetof_128(), offsetof_str()
 
+	def _calc_values_len_bytes(self):
+		"""total len of values of all fixed size types, with padding, and the arena"""
 		strlen = self._calc_values_str_bytes()
-		return offsetof_str() + strlen, strlen
+		if not self.params_arena:
+			return self._calc_values_offsets()[5] + strlen, strlen
+		return self.calc_arena_offset() + 8 + self.calc_arena_bytes(), strlen
 
 	def _calc_values_str_bytes(self):
 		"""sub-length of values_len_bytes. used for error checking in c code."""
-		return sum(2 + s.max_len for s in self.params_str)  # 2 bytes are max str len and current len
+		return sum(self._str_slot_len(s) for s in self.params_str)
 
 	def _calc_defaults_str_len_bytes(self):
-		# length byte + length of the default value
-		return sum(2 + len(param.default_value) for param in self.params_str)
+		return sum(self._str_default_len(param) for param in self.params_str)
+
+	@staticmethod
+	def _str_slot_len(param):
+		# str: max str len and current len bytes, then the chars. str16, buf: paramsys_arena_ref_t.
+		return 2 + param.max_len if param.param_type == strt else 8
+
+	@staticmethod
+	def _str_default_len(param):
+		# max len and len (u8 for str, u16 for str16 and buf), then the default value
+		return (2 if param.param_type == strt else 4) + len(param.default_bytes())
+
+	def calc_index_bits(self):
+		"""16 if param indices and the defaults_index/value_index of every param fit into u16 (0xffff is
+		PARAMS_NO_INDEX), else 32."""
+		assert len(self.params) <= PARAMS_MAX_COUNT_32
+		if len(self.params) <= 0xffff and all(param.values_index <= 0xffff and param.defaults_index <= 0xffff for param in self.params):
+			return 16
+		return 32
+
+	def calc_arena_offset(self):
+		"""offset of the arena header (paramsys_arena_header_t) from the start of the values array. aligned by 4."""
+		end = self._calc_values_offsets()[5] + self._calc_values_str_bytes()
+		return (end + 3) & ~3
+
+	def calc_arena_bytes(self):
+		"""arena capacity. every value at its max len plus room for one more copy-on-write, so a set always fits
+		after a compaction."""
+		if not self.params_arena:
+			return 0
+		return (sum(s.max_len for s in self.params_arena) + max(s.max_len for s in self.params_arena) + 3) & ~3
+
+
+def name_hash(name, seed):
+	"""same as paramsys_name_hash in paramsys_internal.h. name is bytes."""
+	h = (0x811c9dc5 ^ (seed * 0x9e3779b9)) & 0xffffffff
+	for c in name:
+		h = ((h ^ c) * 0x01000193) & 0xffffffff
+	h ^= h >> 16
+	h = (h * 0x85ebca6b) & 0xffffffff
+	h ^= h >> 13
+	h = (h * 0xc2b2ae35) & 0xffffffff
+	h ^= h >> 16
+	return h
+
+
+def build_name_hash(names_and_indices):
+	"""Minimal perfect hash over the names (hash and displace). Return (disp, slots).
+
+	Names are hashed to buckets, and buckets are placed biggest first: for every bucket search the displacement
+	(seed of the second hash) that puts all its names into free slots. One slot per name, so the table is minimal.
+	Except for big tables: with every slot taken but one, the last buckets need about as many tries as there are
+	names. 1/8 spare slots keeps it at a few tries per bucket, and a 100k table takes seconds instead of minutes.
+	"""
+	n = max(1, len(names_and_indices))
+	if n >= 4096:
+		n += n // 8
+	num_buckets = max(1, (n + 3) // 4)
+	while True:
+		buckets = [[] for _ in range(num_buckets)]
+		for name, index in names_and_indices:
+			buckets[name_hash(name, 0) % num_buckets].append((name, index))
+
+		disp = [0] * num_buckets
+		slots = [None] * n
+		ok = True
+		for b in sorted(range(num_buckets), key=lambda b: -len(buckets[b])):
+			if not buckets[b]:
+				break
+			for d in range(1, 0x10000):
+				positions = [name_hash(name, d) % n for name, _ in buckets[b]]
+				if len(set(positions)) == len(positions) and all(slots[pos] is None for pos in positions):
+					break
+			else:
+				ok = False
+				break
+			disp[b] = d
+			for pos, (name, index) in zip(positions, buckets[b]):
+				slots[pos] = index
+		if ok:
+			# empty slots only when there are no names at all, or the spare ones of big tables. index 0 is the internal param,
+			# never found by name.
+			return disp, [0 if index is None else index for index in slots]
+		num_buckets *= 2  # didn't fit into u16 displacements. smaller buckets are easier to place.
+
+
+def write_if_changed(path, text):
+	"""write text to path unless the file already has exactly that. keeps the mtime, so nothing gets rebuilt."""
+	try:
+		with open(path, "rt", encoding="utf8", newline="") as f:
+			if f.read() == text:
+				return False
+	except FileNotFoundError:
+		pass
+	with open(path, "wt", encoding="utf8", newline="") as f:
+		f.write(text)
+	return True
 
 
 class GeneratedHeader:
-	def __init__(self, public_filenamepath, impl_filenamepath):
-		self.file_public = open(public_filenamepath, "wt")
-		self.file_impl = open(impl_filenamepath, "wt")
+	def __init__(self, out_dir, index_bits, values_capacity_bytes):
+		self.out_dir = out_dir
+		self.index_bits = index_bits
+		self.values_capacity_bytes = values_capacity_bytes  # None for the default of paramsys.h
+		self.file_impl = io.StringIO()
+		self.files_public = {}  # file name: StringIO
+
+	def finish(self):
+		"""write the headers that changed, remove component headers of components that don't exist anymore."""
+		files = dict(self.files_public)
+		files[FILENAME_PREPEND + "paramsys_impl_generated.h"] = self.file_impl
+		written = [name for name, f in files.items() if write_if_changed(os.path.join(self.out_dir, name), f.getvalue())]
+		for path in glob.glob(os.path.join(self.out_dir, FILENAME_PREPEND + "paramsys_generated_component_*.h")):
+			if os.path.basename(path) not in files:
+				os.remove(path)
+		return written
 
 	def write_impl_file(self, params_processed):
 		p = params_processed
@@ -606,7 +789,7 @@ class GeneratedHeader:
 			f"#define PARAMS_COUNT_32  {len(p.params_32)}\n"
 			f"#define PARAMS_COUNT_64  {len(p.params_64)}\n"
 			f"#define PARAMS_COUNT_128 {len(p.params_128)}\n"
-			f"#define PARAMS_COUNT_STR {len(p.params_str)}\n"
+			f"#define PARAMS_COUNT_STR {len(p.params_str)}  // str, str16 and buf\n"
 			"\n"
 			f"#define PARAMS_COUNT_DEFAULTS_8    {len(p.params_defaults_8)}\n"
 			f"#define PARAMS_COUNT_DEFAULTS_16   {len(p.params_defaults_16)}\n"
@@ -625,6 +808,12 @@ class GeneratedHeader:
 			"\n"
 			f"#define PARAMS_DEFAULTS_STR_LEN_BYTES {p.params_defaults_str_len_bytes}\n"
 			"\n"
+			f"#define PARAMS_COUNT_ARENA       {len(p.params_arena)}  // str16 and buf\n"
+			f"#define PARAMS_ARENA_REFS_OFFSET {p.params_arena[0].values_offset if p.params_arena else p.params_values_len_bytes}  // first paramsys_arena_ref_t, PARAMS_VALUES_LEN_BYTES if none\n"
+			f"#define PARAMS_ARENA_OFFSET      {p.calc_arena_offset() if p.params_arena else 0}  // paramsys_arena_header_t\n"
+			f"#define PARAMS_ARENA_BYTES       {p.calc_arena_bytes()}\n"
+			f"#define PARAMS_ARENA_MAX_LEN     {max((s.max_len for s in p.params_arena), default=0)}  // longest str16/buf\n"
+			"\n"
 			"\n"
 		)
 
@@ -716,6 +905,18 @@ class GeneratedHeader:
 		# now generate the next part..
 		#
 
+		def gen_param_flags_str(param):
+			if not param.used:
+				return "param_info_t::DISABLED"
+			if param.param_type in [u8, u16, u32, u64, i8, i16, i32, i64, f32, f64]:
+				if param.has_minmax:
+					return "param_info_t::HAS_MINMAX"
+				elif not param.has_default:
+					return "param_info_t::NO_DEFAULT"
+			elif not param.has_default:
+				return "param_info_t::NO_DEFAULT"
+			return "0"
+
 		f.write(
 			"params_table_t params_info = {\n"
 				"\t{ // params_info\n"
@@ -731,21 +932,11 @@ class GeneratedHeader:
 			name_str = f'"{param.name}"'
 			param_type_str = type_to_str[param.param_type].upper()   # F32
 			param_type_str = f"(u8)params_type_e::{param_type_str}"  # (u8)params_type_e::F32
-			param_flags_str = "0"
-			if not param.used:
-				param_flags_str = "param_info_t::DISABLED"
-			else:
-				if param.param_type in [u8, u16, u32, u64, i8, i16, i32, i64, f32, f64]:
-					if param.has_minmax:
-						param_flags_str = "param_info_t::HAS_MINMAX"
-					elif not param.has_default:
-						param_flags_str = "param_info_t::NO_DEFAULT"
-				elif not param.has_default:
-					param_flags_str = "param_info_t::NO_DEFAULT"
+			param_flags_str = gen_param_flags_str(param)
 
 			return f'{{{name_str:17}, {param_type_str:22}, 0x{param.component:02x}, {param.security_level:3}, {param.defaults_index:5}, {param.values_index:5},  {param_flags_str}}},\n'
 
-		for param in p.params_unsorted:
+		for param in p.params:
 			f.write("\t\t" + gen_param_info_str(param))
 
 		f.write("\t},\n")
@@ -783,7 +974,7 @@ class GeneratedHeader:
 			f.write(f"\t{{ // defaults_str\n")
 			for param in p.params_str:
 				if param.has_default:
-					f.write(f'\t\t{param.default_value_str}, // {param.name} max_len {param.max_len} len {len(param.default_value)} {param.default_value!r}\n')
+					f.write(f'\t\t{param.default_value_str}, // {param.name} max_len {param.max_len} len {len(param.default_bytes())} {param.default_value.hex() if param.param_type == buft else repr(param.default_value)}\n')
 				else:
 					f.write(f'\t\t{param.default_value_str}, // {param.name} max_len {param.max_len}\n')
 			f.write("\t},\n")
@@ -817,20 +1008,269 @@ class GeneratedHeader:
 		f.write(f'u8* defaults_str = {"params_info.defaults_str" if p.params_defaults_str else "nullptr"};\n')
 		f.write("\n")
 
-		#for param in p.params_unsorted:
+		# hot descriptor. the part of params_info that params_get/params_set need.
+
+		f.write(
+			"// Hot part of params_info, see paramsys_hot_t.\n"
+			"const paramsys_hot_t params_hot[PARAMS_COUNT] = {\n"
+			"\t// type, flags | size class << PARAMS_HOT_SIZE_CLASS_shift, defaults_index, value_offset\n")
+		for param in p.params:
+			param_type_str = f"(u8)params_type_e::{type_to_str[param.param_type].upper()}"
+			size_class_str = f"PARAMS_SIZE_CLASS_{param.size_class}"
+			flags = gen_param_flags_str(param)
+			if param.history_len:
+				flags = "param_info_t::HISTORY" if flags == "0" else flags + " | param_info_t::HISTORY"
+			flags_str = f"{flags:24} | {size_class_str:21} << PARAMS_HOT_SIZE_CLASS_shift"
+			f.write(f"\t{{{param_type_str:22}, {flags_str}, {param.defaults_index:5}, {param.values_offset:6}}}, // {param.index} {param.name}\n")
+		f.write("};\n")
+		f.write("\n")
+
+		# default values image. the exact bytes of params_valuemem->values after params_init, padding and string
+		# headers included. params_values is statically initialized with it, and params_init/params_reset_* copy it.
+
+		image = bytearray(p.params_values_len_bytes)
+		arena_offset = p.calc_arena_offset()
+		arena_used = 0
+		for param in p.params:
+			offset = param.values_offset
+			if param.param_type == strt:
+				b = bytes(param.default_value, "utf8")
+				image[offset:offset + 2 + len(b)] = bytes([param.max_len, len(b)]) + b
+			elif param.param_type in arena_types:
+				# paramsys_arena_ref_t to the default value, the defaults are packed at the start of the arena.
+				b = param.default_bytes()
+				image[offset:offset + 8] = struct.pack("<IHH", arena_used, len(b), 0)
+				start = arena_offset + 8 + arena_used
+				image[start:start + len(b)] = b
+				arena_used += len(b)
+			elif not param.used or not param.has_default:
+				pass  # zeroes
+			elif param.param_type == uuid128:
+				image[offset:offset + 16] = param.default_value.bytes
+			else:
+				b = struct.pack("<" + type_to_structpack[param.param_type][1:], param.default_value)
+				image[offset:offset + len(b)] = b
+
+		if p.params_arena:
+			image[arena_offset:arena_offset + 8] = struct.pack("<II", arena_used, p.calc_arena_bytes())
+
+		f.write("// Default values image, see params_reset_all_to_defaults. Also the static initializer of params_values.\n")
+		f.write("#define PARAMS_DEFAULTS_IMAGE_INIT \\\n")
+		for i in range(0, len(image), 16):
+			f.write("\t" + " ".join(f"0x{b:02x}," for b in image[i:i + 16]) + (" \\\n" if i + 16 < len(image) else "\n"))
+		f.write("alignas(8) const u8 params_defaults_image[PARAMS_VALUES_LEN_BYTES] = { PARAMS_DEFAULTS_IMAGE_INIT };\n")
+		f.write("\n")
+
+		# value runs by component, for params_reset_component. neighbouring values of the same component merge. str16
+		# and buf are reset through the arena, not with a copy of the image.
+
+		runs = []
+		for param in sorted(p.params, key=lambda param: (param.component, param.values_offset)):
+			if param.param_type in arena_types:
+				continue
+			size = 2 + param.max_len if param.param_type == strt else {u8: 1, i8: 1, flags8: 1, u16: 2, i16: 2, flags16: 2,
+				u32: 4, i32: 4, f32: 4, flags32: 4, uuid128: 16}.get(param.param_type, 8)
+			if runs and runs[-1][0] == param.component and runs[-1][1] + runs[-1][2] == param.values_offset:
+				runs[-1][2] += size
+			else:
+				runs.append([param.component, param.values_offset, size])
+
+		f.write(
+			"// Runs of values by component, see paramsys_component_range_t.\n"
+			f"#define PARAMS_COMPONENT_RANGES_COUNT {len(runs)}\n"
+			"const paramsys_component_range_t params_component_ranges[PARAMS_COMPONENT_RANGES_COUNT] = {\n")
+		for component, offset, size in runs:
+			f.write(f"\t{{0x{component:02x}, {{}}, {offset:6}, {size:6}}},\n")
+		f.write("};\n")
+		f.write("\n")
+
+		# value history rings, for params_history_since. the entries themselves are in paramsys.cpp.
+
+		rings = [param for param in p.params if param.history_len]
+		ring_of = [(1 << self.index_bits) - 1] * len(p.params)  # PARAMS_NO_INDEX
+		f.write(
+			"// Value history rings, see paramsys_history_ring_t.\n"
+			f"#define PARAMS_HISTORY_RINGS_COUNT   {len(rings)}\n"
+			f"#define PARAMS_HISTORY_ENTRIES_COUNT {sum(param.history_len for param in rings)}\n")
+		if rings:
+			f.write("const paramsys_history_ring_t params_history_rings[PARAMS_HISTORY_RINGS_COUNT] = {\n")
+			first = 0
+			for i, param in enumerate(rings):
+				f.write(f"\t{{{param.index:5}, {param.history_len:5}, {first:6}}}, // {param.name}\n")
+				ring_of[param.index] = i
+				first += param.history_len
+			f.write("};\n")
+		else:
+			f.write("const paramsys_history_ring_t* params_history_rings = nullptr;\n")
+		f.write("// ring by param index, PARAMS_NO_INDEX if the param has no history.\n")
+		f.write("const param_index_t params_history_ring_of[PARAMS_COUNT] = {\n")
+		for i in range(0, len(ring_of), 16):
+			f.write("\t" + " ".join(f"{v:5}," for v in ring_of[i:i + 16]) + "\n")
+		f.write("};\n")
+		f.write("\n")
+
+		# limits of every value of a size class in value order, for params_validate_all. the values memory can then be
+		# checked with a straight vector pass. params without limits get the whole range of the type, floats the finite
+		# range, so NaN and inf are always out of range.
+
+		f.write("// Limits by size class in value order, see paramsys_scan_limits. [0] min, [1] max, [2] kind.\n")
+		for bits, params_list in [(8, p.params_8), (16, p.params_16), (32, p.params_32), (64, p.params_64)]:
+			ctype = f"u{bits}"
+			if not params_list:
+				f.write(f"const {ctype}* params_limits_{bits} = nullptr;\n")
+				f.write(f"const param_index_t* params_limits_owner_{bits} = nullptr;\n")
+				continue
+			suffix = "ull" if bits == 64 else ""
+			width = bits // 4
+			rows = [[], [], []]
+			for param in params_list:
+				if param.param_type in (f32, f64):
+					lo, hi = (-FLT_MAX, FLT_MAX) if param.param_type == f32 else (-DBL_MAX, DBL_MAX)
+				else:
+					lo, hi = type_minmax[param.param_type]
+				if param.used and param.has_minmax:
+					lo, hi = param.min_value, param.max_value
+				rows[0].append(limit_key(param.param_type, lo, bits))
+				rows[1].append(limit_key(param.param_type, hi, bits))
+				rows[2].append(limit_kind(param.param_type, bits))
+			f.write(f"static const {ctype} l_params_limits_{bits}[3][PARAMS_COUNT_{bits}] = {{\n")
+			for row in rows:
+				f.write("\t{ " + ", ".join(f"0x{v:0{width}x}{suffix}" for v in row) + " },\n")
+			f.write("};\n")
+			f.write(f"static const param_index_t l_params_limits_owner_{bits}[PARAMS_COUNT_{bits}] = {{ " +
+				", ".join(str(param.index) for param in params_list) + " };\n")
+			f.write(f"const {ctype}* params_limits_{bits} = &l_params_limits_{bits}[0][0];\n")
+			f.write(f"const param_index_t* params_limits_owner_{bits} = l_params_limits_owner_{bits};\n")
+		f.write("\n")
+
+		# str16 and buf params, for the arena compaction and resets.
+
+		f.write("// STR16 and BUF params, the ones with a paramsys_arena_ref_t.\n")
+		if p.params_arena:
+			f.write("const param_index_t params_arena_params[PARAMS_COUNT_ARENA] = { " +
+				", ".join(str(param.index) for param in p.params_arena) + " };\n")
+		else:
+			f.write("const param_index_t* params_arena_params = nullptr;\n")
+		f.write("\n")
+
+		# layout descriptor. stored with the persisted values, so that a later build can move them to its own layout.
+
+		f.write(
+			"// Layout of the values memory: type, str max_len, value_index for every param. See paramsys_migrate.\n"
+			"const paramsys_layout_entry_t params_layout[PARAMS_COUNT] = {\n")
+		for param in p.params:
+			max_len = param.max_len if param.param_type == strt else 0
+			param_type_str = f"(u8)params_type_e::{type_to_str[param.param_type].upper()}"
+			f.write(f"\t{{{param_type_str:22}, {max_len:3}, {param.values_index:5}}}, // {param.index} {param.name}\n")
+		f.write("};\n")
+		f.write("\n")
+
+		# name lookup table for params_find. disabled params are left out, so they can't be found by name.
+
+		disp, slots = build_name_hash([(param.name.encode(), param.index) for param in p.params[1:] if param.used])
+
+		def write_array(values):
+			for i in range(0, len(values), 16):
+				f.write("\t" + " ".join(f"{v:5}," for v in values[i:i + 16]) + "\n")
+
+		f.write(
+			"\n"
+			"// Minimal perfect hash over the names of the enabled params. See paramsys_name_hash_candidate.\n"
+			f"#define PARAMS_NAME_HASH_BUCKETS {len(disp)}\n"
+			f"#define PARAMS_NAME_HASH_SLOTS   {len(slots)}\n"
+			"\n"
+			"const u16 params_name_hash_disp[PARAMS_NAME_HASH_BUCKETS] = {\n")
+		write_array(disp)
+		f.write(
+			"};\n"
+			"\n"
+			"// param index by slot\n"
+			"const param_index_t params_name_hash_slots[PARAMS_NAME_HASH_SLOTS] = {\n")
+		write_array(slots)
+		f.write("};\n")
+		f.write("\n")
+
+		# access bitmaps, one row per caller security level. a caller above the highest level used gets the last row.
+
+		levels = 1 + max(max(param.read_level, param.security_level) for param in p.params[1:] if param.used)
+		words = (len(p.params) + 63) // 64
+
+		def write_access_bitmap(name, level_of):
+			f.write(f"const u64 {name}[PARAMS_SECURITY_LEVELS][PARAMS_ACCESS_WORDS] = {{\n")
+			row = [0] * words
+			params_by_level = [[] for _ in range(levels)]
+			for param in p.params[1:]:
+				if param.used:
+					params_by_level[level_of(param)].append(param)
+			for level in range(levels):
+				# every level can access everything the level below it can
+				for param in params_by_level[level]:
+					row[param.index // 64] |= 1 << (param.index % 64)
+				f.write("\t{ " + ", ".join(f"0x{v:016x}ull" for v in row) + f" }}, // level {level}\n")
+			f.write("};\n")
+
+		f.write(
+			"// Params a caller of each security level can see and change, bit param_index % 64 of word param_index / 64.\n"
+			"// Param 0 and disabled params are in none. See params_caller_t.\n"
+			f"#define PARAMS_SECURITY_LEVELS {levels}\n"
+			f"#define PARAMS_ACCESS_WORDS    {words}\n"
+			"\n")
+		write_access_bitmap("params_access_readable", lambda param: param.read_level)
+		write_access_bitmap("params_access_writable", lambda param: param.security_level)
+		f.write("\n")
+
+		#for param in p.params:
 		#	print(str(param))
 
-	def write_public_file(self, params_processed):
+	def write_public_files(self, params_processed):
 		p = params_processed
-		f = self.file_public
 
+		f = self.files_public[FILENAME_PREPEND + "paramsys_generated_config.h"] = io.StringIO()
+		f.write(
+			"// autogenerated file. changes in here will be overwritten!\n"
+			"\n"
+			"#pragma once\n"
+			"\n"
+			f"#define PARAMS_INDEX_BITS {self.index_bits}  // param_index_t is u{self.index_bits}\n")
+		if self.values_capacity_bytes:
+			f.write(f"#define PARAMS_VALUES_CAPACITY_BYTES {self.values_capacity_bytes}  // the default of paramsys.h is too small\n")
+
+		components = sorted(set(param.component for param in p.params[1:]))  # skip the first special _internalparam_
+
+		f = self.files_public[FILENAME_PREPEND + "paramsys_generated.h"] = io.StringIO()
+		f.write(
+			"// autogenerated file. changes in here will be overwritten!\n"
+			"\n"
+			"#pragma once\n"
+			"\n"
+			"// all the params. code that needs only the params of one component can include just its header.\n"
+			"\n")
+		for component in components:
+			f.write(f'#include "{FILENAME_PREPEND}paramsys_generated_component_{component}.h"\n')
+		f.write(f"\n#define PARAMS_COUNT {len(p.params)}  // including the internal param 0\n")
+
+		# X-macro over every typed handle, for code that has to reach all of them (paramsys_fuzz.cpp).
+		handles = [param for param in p.params[1:] if param.used and param.param_type in type_to_ctype]
+		f.write("\n#define PARAMS_FOR_EACH_HANDLE(X)")
+		for param in handles:
+			f.write(f" \\\n\tX(PARAM_{param.name})")
+		f.write("\n")
+
+		for component in components:
+			f = self.files_public[f"{FILENAME_PREPEND}paramsys_generated_component_{component}.h"] = io.StringIO()
+			params = [param for param in p.params[1:] if param.component == component]
+			self.write_component_file(f, params)
+
+	def write_component_file(self, f, params):
 		f.write(
 			"// autogenerated file. changes in here will be overwritten!\n"
 			"\n"
 			"#pragma once"
 			"\n"
+			"\n"
+			'#include "paramsys.h"\n'
 			"\n")
-		for param in params_processed.params[1:]: # skip the first special _internalparam_
+		for param in params:
 			name = param.name + "_index"
 			if param.used:
 				# padding: 21 = 15 (max param name len) + 6 (len of "_index")
@@ -838,52 +1278,128 @@ class GeneratedHeader:
 			else:
 				f.write(f"//#define PARAM_{name:21} {param.index} // param is disabled\n")
 
+		# typed handles. see param_handle_t in paramsys.h. only for enabled fixed-size scalar params.
 
-def main():
+		f.write(
+			"\n"
+			"\n"
+			"// typed handles for params_get<PARAM_x>() and params_set<PARAM_x>(value)\n"
+			"\n")
+		for param in params:
+			if not param.used or param.param_type not in type_to_ctype:
+				continue
+			ctype = type_to_ctype[param.param_type]
+			base = f"param_handle_t<{ctype}, params_type_e::{type_to_str[param.param_type].upper()}, {param.index}, {param.values_index}>"
+			if param.has_minmax:
+				lo = gen_handle_literal(param.param_type, param.min_value)
+				hi = gen_handle_literal(param.param_type, param.max_value)
+				de = gen_handle_literal(param.param_type, param.default_value)
+				f.write(
+					f"struct PARAM_{param.name} : {base} {{\n"
+					f"\tstatic constexpr bool has_minmax = true;\n"
+					f"\tstatic constexpr {ctype} default_val = {de};\n"
+					f"\tstatic constexpr {ctype} min = {lo};\n"
+					f"\tstatic constexpr {ctype} max = {hi};\n"
+					f"}};\n")
+			else:
+				f.write(f"typedef {base} PARAM_{param.name};\n")
 
-	# 1. parse the params_input string to a list of ParamInt, ParamFloat, ParamStr, .. objects.
-	# 2. ensure that param indices start from 1 and there are no missing and reused indices.
-	# 3. prepend the _internalparam_ with index 0 for the c implementation.
-	# 4. parse the params input file
-	# 5. generate output c header files.
 
-	params_list = [param for param in parse_text_to_params(params_input) if param]
+def main():
 
-	# find out if some indices are missing
+	# 1. parse the schema files to a list of ParamInt, ParamFloat, ParamStr, .. objects.
+	# 2. ensure that param indices start from 1 and there are no missing and reused indices or names. one pass, a
+	#    table of 100k params is checked as fast as it's parsed.
+	# 3. prepend the _internalparam_ with index 0 for the c implementation.
+	# 4. calculate the memory layout and pick the index width.
+	# 5. generate output c header files, write the ones that changed.
+
+	parser = argparse.ArgumentParser(description="Generate the paramsys headers from the schema files.")
+	parser.add_argument("schema", nargs="*", help="schema files. default: schema/*.params next to this script")
+	parser.add_argument("-o", "--out-dir", default=".", help="where to write the headers. default: current dir")
+	parser.add_argument("--index-bits", type=int, choices=(16, 32),
+		help="width of param_index_t. default: 16 if the table fits, else 32")
+	parser.add_argument("--stamp", help="file to touch after a successful run, for build systems")
+	parser.add_argument("-v", "--verbose", action="store_true", help="list every param")
+	args = parser.parse_args()
+
+	schema_files = args.schema or sorted(glob.glob(os.path.join(os.path.dirname(os.path.abspath(__file__)), "schema", "*.params")))
+	if not schema_files:
+		log.error("no schema files")
+		return 1
 
-	indices = set(param.index for param in params_list)
-	params_missing = False
-	for i in range(1, max(indices)):
-		if i not in indices:
-			params_missing = True
-			log.error(f"missing parameter with index {i}")
+	params_list = []
+	for path in schema_files:
+		params_list += parse_schema_file(path)
+	if not params_list:
+		log.error("no params in the schema files")
+		return 1
 
-	# find out if param names are reused
+	# find out if some indices are missing or reused, and if param names are reused
 
+	params_by_index = [None] * (1 + max(param.index for param in params_list))
 	params_names = {}
-	params_reused = False
+	errors = False
 	for param in params_list:
-		if param.name in params_names:
-			params_reused = True
-			log.error(f"param named {param.name!r} used multiple times")
-		params_names[param.name] = 1
+		if param.index < 1:
+			errors = True
+			log.error(f"{param.source}:{param.line_num}: index {param.index} of {param.name!r}, indices start from 1")
+			continue
+		other = params_by_index[param.index]
+		if other:
+			errors = True
+			log.error(f"{param.source}:{param.line_num}: index {param.index} of {param.name!r} is already used by {other.name!r} in {other.source}:{other.line_num}")
+		params_by_index[param.index] = param
+		other = params_names.get(param.name)
+		if other:
+			errors = True
+			log.error(f"{param.source}:{param.line_num}: param named {param.name!r} is already defined in {other.source}:{other.line_num}")
+		params_names[param.name] = param
+	for i in range(1, len(params_by_index)):
+		if not params_by_index[i]:
+			errors = True
+			log.error(f"missing parameter with index {i}")
 
-	if params_missing or params_reused:
-		return
+	if errors:
+		return 1
 
-	# add the internal parameter
-	params_list.insert(0, ParamInt(0, "_internalparam_", 0, 0, u32))
+	# add the internal parameter. params_list is sorted by index from here on.
+	params_list = [ParamInt(0, "_internalparam_", 0, 0, u32)] + params_by_index[1:]
 
 	# parse params and generate the c header files
 
 	params_processed = ParamsProcessed(params_list)
-	generated_header_file = GeneratedHeader(FILENAME_PREPEND + "paramsys_generated.h", FILENAME_PREPEND + "paramsys_impl_generated.h")
+
+	index_bits = params_processed.calc_index_bits()
+	if args.index_bits:
+		if args.index_bits < index_bits:
+			log.error(f"the table doesn't fit into {args.index_bits}-bit indices")
+			return 1
+		index_bits = args.index_bits
+	values_capacity_bytes = None
+	if params_processed.params_values_len_bytes > PARAMS_VALUES_CAPACITY_BYTES_DEFAULT:
+		values_capacity_bytes = PARAMS_VALUES_CAPACITY_BYTES_DEFAULT
+		while values_capacity_bytes < params_processed.params_values_len_bytes:
+			values_capacity_bytes *= 2
+
+	os.makedirs(args.out_dir, exist_ok=True)
+	generated_header_file = GeneratedHeader(args.out_dir, index_bits, values_capacity_bytes)
 	generated_header_file.write_impl_file(params_processed)
-	generated_header_file.write_public_file(params_processed)
+	generated_header_file.write_public_files(params_processed)
+	written = generated_header_file.finish()
 
-	for param in params_list:
-		log.info(f"index {param.index:03} {param.name!r:17} type {type_to_str[param.param_type]}")
+	if args.verbose:
+		for param in params_list:
+			log.info(f"index {param.index:03} {param.name!r:17} type {type_to_str[param.param_type]}")
+	log.info(f"{len(params_list)} params from {len(schema_files)} schema files, param_index_t u{index_bits}, "
+		f"values {params_processed.params_values_len_bytes} bytes. written: {', '.join(written) or 'nothing, no changes'}")
+
+	if args.stamp:
+		with open(args.stamp, "wt") as f:
+			pass
+		os.utime(args.stamp)
+	return 0
 
 
 if __name__ == "__main__":
-	main()
+	sys.exit(main())
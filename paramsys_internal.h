@@ -5,10 +5,14 @@
 
 #include "stdints.h"
 
+#include <stddef.h> // offsetof
+
+#include "paramsys.h" // PARAMS_VALUES_CAPACITY_BYTES
+
 
 #define PARAMS_TYPE_IS_VARIABLE_SIZE_bit ((u8)0b10000000)
 #define PARAMS_TYPE_INDEX_mask           ((u8)0b01111111)
-#define PARAMS_NO_INDEX            0xffff
+#define PARAMS_NO_INDEX            ((param_index_t)-1)
 
 //#define PARAMS_TYPE_len_is_first4bits_bit 0b01000000
 //#define PARAMS_HAS_MINMAXDEFAULT  ((u8)0b10000000) // if bit not set, then param still has the default
@@ -17,21 +21,22 @@
 #pragma pack(push,1)
 
 // Every parameter is described by one of these. There's a simple array of these structs that contains every parameter.
-// 24 bytes per param.
+// 24 bytes per param, 28 with 32-bit param indices.
 struct param_info_t {
 	enum flags_e : u8 {
 		DISABLED      = 1, // implies NO_DEFAULT
 		NO_DEFAULT    = 2,
 		HAS_MINMAX    = 4, // has min and max in addition to the default value
-		VALUE_CHANGED = 128
+		HISTORY       = 8, // only in paramsys_hot_t::flags. changes are recorded, see params_history_since.
+		// 128 was VALUE_CHANGED. changes are tracked in a separate dirty bitmap now (params_take_changed).
 	};
-	char name[16];       // zero-terminated! so 15 useful characters.
-	u8   type;           //
+	char name[16];                // zero-terminated! so 15 useful characters.
+	u8   type;                    //
 	u8   component;
-	u8   security_level; // who can change or see the param.
-	u16  defaults_index; // index to the corresponding defaults_8/defaults_16/.. or default_minmax_* array
-	u16  value_index;    // pointer to param value. if type is string, then first byte is string length.
-	u8   flags;          //
+	u8   security_level;          // who can change or see the param.
+	param_index_t defaults_index; // index to the corresponding defaults_8/defaults_16/.. or default_minmax_* array
+	param_index_t value_index;    // pointer to param value. if type is string, then first byte is string length.
+	u8   flags;                   //
 };
 
 /*
@@ -41,8 +46,9 @@ defaults_str layout:
     parameter types), we need to keep the string max len value also in eeprom. so, the simplest strings are in memory
     like this:
         defaults: max_len, len, char1, char2, .. len, char1, char2, char3, ..
-    in the future, when we need longer than 255 byte strings and more than 65k of total length, we need to add
-    a different string type. str16 maybe?
+    str16 and buf have a u16 max_len and a u16 len instead:
+        defaults: max_len_lo, max_len_hi, len_lo, len_hi, byte1, byte2, ..
+    their values are not in the str slots but in the arena, see paramsys_arena_ref_t.
 
 
     you can't remove string params. but you can rename them and make them shorter.
@@ -61,4 +67,233 @@ struct defminmax_f64_t { f64 default_val; f64 min; f64 max; };
 
 //struct default_str_t { u8 max_len; u16 start_index; }; // max_len is without the length byte.
 
+// Hot part of the param descriptor, everything params_get/params_set need. params_hot[PARAMS_COUNT] in
+// paramsys_impl_generated.h, next to params_info. Names, component and security level are only in params_info, so the
+// value paths don't drag them through the cache. 8 bytes per param, 10 with 32-bit param indices.
+struct paramsys_hot_t {
+	u8            type;           // params_type_e
+	u8            flags;          // param_info_t::flags_e in the low bits, size class (PARAMS_SIZE_CLASS_*) in the
+	                              // high bits
+	param_index_t defaults_index; // same as param_info_t::defaults_index
+	u32           value_offset;   // byte offset of the value from params_valuemem->values. strings: of the
+	                              // max_len/len header.
+};
+#define PARAMS_HOT_SIZE_CLASS_shift 4
+#define PARAMS_HOT_FLAGS_mask       ((u8)0b00001111)
+
+// Value slot of a STR16/BUF param in the str region of the values memory. The value is len bytes at offset in the
+// arena that follows the str region: a paramsys_arena_header_t, then capacity bytes. Values are never written in place:
+// a set appends the new value at arena used and moves the ref, a compaction slides the live values down to the start.
+struct paramsys_arena_ref_t {
+	u32 offset;
+	u16 len;
+	u16 reserved;
+};
+struct paramsys_arena_header_t {
+	u32 used;     // values and garbage of overwritten values, everything after is free
+	u32 capacity; // bytes after the header
+};
+
+// One param of the layout descriptor (params_layout in paramsys_impl_generated.h), indexed by param index. Persisted
+// together with the values, so that values written by an older build can be moved to the layout of this one.
+struct paramsys_layout_entry_t {
+	u8            type;        // params_type_e
+	u8            str_max_len; // 0 for fixed-size types, STR16 and BUF
+	param_index_t value_index; // index to params_values_8/16/.. of the size class. byte offset in params_values_str
+	                           // for strings.
+};
+
+// Contiguous run of values of one component in the values memory. params_component_ranges in
+// paramsys_impl_generated.h has them sorted by component, then offset. Values of neighbouring params of the same
+// component are merged into one run, so a component reset is a few memcpy from params_defaults_image.
+struct paramsys_component_range_t {
+	u8  component;
+	u8  reserved[3];
+	u32 offset; // byte offset from params_valuemem->values
+	u32 len;
+};
+
+// Value history ring of one param. params_history_rings in paramsys_impl_generated.h, params_history_ring_of maps the
+// param index to its ring. The entries of all rings are one preallocated array in paramsys.cpp, this ring has
+// len of them starting from first_entry.
+struct paramsys_history_ring_t {
+	param_index_t param_index;
+	u16           len;
+	u32           first_entry;
+};
+
+#pragma pack(pop)
+
+
+enum { COMPONENT_PARAMS = 0xFD, };
+enum { P_PARAMS_VALUEMEM = 0x06, };
+
+#pragma pack(push,1)
+
+// Memory layout in EEPROM.
+// But there's always a RAM mirror of the whole parameters struct.
+struct paramsys_valuemem_t {
+	u8 component;
+	u8 packet_type;
+	u8 packet_version;
+	//u32 some_magic_code..
+	u8 reserved1;
+	u8 reserved2;
+	u8 reserved3;
+	u32 values_bytes_capacity;
+	u32 values_bytes_used;
+	param_index_t count_8;  // num of values by type length in "values" array. i8, u8, flags8.
+	param_index_t count_16; // i16, u16, flags16. address: values + count_8 * sizeof(i8)
+	param_index_t count_32; // i32, u32, flags32. address: values + count_8 * sizeof(i8) + count_16 * sizeof(i16)
+	param_index_t count_64; // ..
+	param_index_t count_128; // ..
+	param_index_t count_str; // TODO: need this? maybe.
+	u32 len_str;
+	// pads the header to 32 bytes, 48 with 32-bit param indices. was missing before packet_version 2, and the values
+	// weren't aligned.
+	u8  reserved4[PARAMS_INDEX_BITS == 32 ? 6 : 2];
+
+
+	// this has to be the last entry!
+	// also, this HAS to be aligned at 4 bytes in relation to the struct start.
+	u8  values[PARAMS_VALUES_CAPACITY_BYTES];
+
+	// strings: [maxlen, len, ...], [maxlen, len, ...] // maxlen here is necessary if we want to support resizing the string params.
+
+	// layout of the following arrays is only correct if magic_code matches. if does not match, then the init code
+	// should fix the layout.
+
+	// I'd very much like to do something like this, instead of the one "values" array and offsetof_* functions, but
+	// c/c++ doesn't allow 0-sized arrays (we don't want to pay the max 14-byte penalty
+//	u8  values_8[PARAMS_COUNT_8];
+//	u16 values_16[PARAMS_COUNT_16];
+//	u32 values_32[PARAMS_COUNT_32]; // i32, u32, f32
+//	u64 values_64[PARAMS_COUNT_64];
+//	u8  values_str[PARAMS_LEN_STR];
+
+	// offsets from start of the struct
+	inline int offsetof_8()   const { return offsetof(paramsys_valuemem_t, values); }
+	inline int offsetof_16()  const { int end = offsetof_8() + count_8; return end + (end & 1); } // aligned by 2 bytes
+	inline int offsetof_32()  const { int end = offsetof_16() + count_16 * 2; return end + (end & 2); } // aligned by 4 bytes
+	inline int offsetof_64()  const { return offsetof_32() + count_32 * 4; } // aligned by 4 bytes
+	inline int offsetof_128() const { return offsetof_64() + count_64 * 8; } // aligned by 4 bytes
+	inline int offsetof_str() const { return offsetof_128() + count_128 * 16; } // aligned by 4 bytes
+	// paramsys_arena_header_t. there's an arena only if values_bytes_used reaches past the str region.
+	inline int offsetof_arena() const { int end = offsetof_str() + (int)len_str; return (end + 3) & ~3; }
+	inline bool has_arena() const {
+		return offsetof_8() + values_bytes_used >= (u32)offsetof_arena() + sizeof(paramsys_arena_header_t);
+	}
+
+	// size in bytes, including the padding bytes between arrays of the different types. pad everything to 4 bytes,
+	// and assume address of the paramsys_valuemem struct is already aligned.
+	//int calc_values_size() { return offsetof_str() + str_len - offsetof_8(); }
+};
 #pragma pack(pop)
+
+// The values memory currently in use. Points to the static params_values, or to a shared mapping
+// (params_map_shared). Always go through this pointer or params_values_* instead of params_values directly.
+extern paramsys_valuemem_t* params_valuemem;
+
+// Point params_valuemem, params_values_8/16/.. and paramsys_type_table to mem. Values in mem are used as is.
+// seq is the seqlock counter array [PARAMS_SIZE_CLASS_COUNT] that goes with mem (nullptr for the process-local one).
+void paramsys_bind_valuemem(paramsys_valuemem_t* mem, paramsys_seq_t* seq, bool readonly);
+// Check that a values memory image (loaded from a store or a shared mapping) has exactly the layout of this firmware.
+bool paramsys_valuemem_header_valid(const paramsys_valuemem_t* mem);
+
+// Move the values of old_mem, laid out as old_layout, into mem, laid out as layout (the layout of this build). One
+// linear pass over the params. Params that are new or changed type keep what's in mem (the defaults), strings are cut
+// to the new max_len. A STR that became STR16 keeps its value. Doesn't clamp, the caller has to re-apply the limits.
+// Returns false if old_layout doesn't fit old_mem (values outside of values_bytes_used), mem is untouched then.
+bool paramsys_migrate(const paramsys_valuemem_t* old_mem, const paramsys_layout_entry_t* old_layout, u32 old_count,
+                      paramsys_valuemem_t* mem, const paramsys_layout_entry_t* layout, u32 count);
+
+// Bulk limit check of one size class (paramsys_simd.cpp). values are the count values of a fixed-size class
+// PARAMS_SIZE_CLASS_8..64, limits its [3][count] min, max and kind keys from paramsys_impl_generated.h
+// (params_limits_*). Clears out_bitmap ((count + 63) / 64 words) and sets bit i for every value i outside its limits.
+// NaN and inf floats are always outside. Runs with AVX2 or SSE4.2 if the cpu has them.
+enum class paramsys_isa_e : u8 { SCALAR, SSE42, AVX2 };
+void paramsys_scan_limits(u8 size_class, const void* values, const void* limits, u32 count, u64* out_bitmap);
+// Use at most this instruction set from now on, for benchmarks. Return the one in use.
+paramsys_isa_e paramsys_scan_limits_set_isa(paramsys_isa_e isa);
+const char*    paramsys_scan_limits_isa_name();
+
+inline bool paramsys_type_is_arena(u8 type) {
+	return type == (u8)params_type_e::STR16 || type == (u8)params_type_e::BUF;
+}
+
+// Value and info entries start with the param index, in as many bytes as param_index_t has. The value entry header is
+// the index, u8 type and u8 len.
+#define PARAMS_ENTRY_INDEX_LEN        ((u32)sizeof(param_index_t))
+#define PARAMS_VALUE_ENTRY_HEADER_LEN (PARAMS_ENTRY_INDEX_LEN + 2)
+
+// Value entries for the wire protocol (paramsys_proto.cpp): param_index_t param_index, u8 type, u8 len, value[len],
+// with a u16 len for STR16 and BUF. Host byte order. Fixed-size values are copied straight from the values memory,
+// strings without their max_len/len header.
+// Return the entry length, 0 if it doesn't fit into out_max or the param doesn't exist or is disabled.
+u32  paramsys_write_value_entry(param_index_t param_index, u8* out, u32 out_max);
+// Longest value entry any param of this build can have.
+u32  paramsys_value_entry_max_len();
+// Write entries of all enabled params first_param_index..last_param_index (inclusive) until out is full. Return the
+// number of bytes written, *out_next_param_index is the first param that didn't fit (last_param_index + 1 if all did).
+// readable (params_caller_t::readable) leaves out the params a caller can't see, nullptr for all.
+u32  paramsys_write_value_entries(param_index_t first_param_index, param_index_t last_param_index, u8* out,
+                                  u32 out_max, u32* out_next_param_index, const u64* readable = nullptr);
+// Mark the params changed again in the dirty bitmap of ctx, and nothing else: no change log, subscriptions or store.
+// For params taken with params_*take_changed that couldn't be passed on after all.
+void paramsys_put_back_changed(paramsys_ctx_t* ctx, const param_index_t* param_indices, u32 count);
+// Info entry, see paramsys_proto.h. 0 if it doesn't fit or the param doesn't exist or is disabled.
+u32  paramsys_write_info_entry(param_index_t param_index, u8* out, u32 out_max);
+// Parse the header of the value entry at in. Return the header length (PARAMS_VALUE_ENTRY_HEADER_LEN, one more for
+// STR16 and BUF), 0 if in_len is too short for the header or the value.
+inline u32 paramsys_read_value_entry_header(const u8* in, u32 in_len, param_index_t* out_param_index,
+                                            params_type_e* out_type, u32* out_len) {
+	if (in_len < PARAMS_VALUE_ENTRY_HEADER_LEN)
+		return 0;
+	memcpy(out_param_index, in, PARAMS_ENTRY_INDEX_LEN);
+	const u8* h = in + PARAMS_ENTRY_INDEX_LEN;
+	*out_type = (params_type_e)h[0];
+	u32 header_len = PARAMS_VALUE_ENTRY_HEADER_LEN;
+	*out_len = h[1];
+	if (paramsys_type_is_arena(h[0])) {
+		if (in_len < PARAMS_VALUE_ENTRY_HEADER_LEN + 1)
+			return 0;
+		u16 len;
+		memcpy(&len, h + 1, 2);
+		*out_len = len;
+		header_len = PARAMS_VALUE_ENTRY_HEADER_LEN + 1;
+	}
+	return header_len + *out_len <= in_len ? header_len : 0;
+}
+// Value length in bytes of a fixed-size type, 0 for variable-size types.
+u8   paramsys_type_len(params_type_e type);
+// Name (zero-terminated) and type of an enabled param. false if the param doesn't exist or is disabled.
+bool paramsys_param_desc(param_index_t param_index, const char** out_name, params_type_e* out_type);
+
+
+// Name lookup. paramsys_generate.py builds a minimal perfect hash (hash and displace) over the names of all enabled
+// params: bucket = hash(name, 0) % num_buckets, slot = hash(name, disp[bucket]) % num_slots, and slots[slot] is the
+// param index. A lookup is two hashes and one name compare, whatever the number of params. The generator has a copy of
+// paramsys_name_hash, keep them in sync.
+
+// fnv-1a with the seed mixed into the offset basis, then the murmur3 finalizer. fnv alone has weak low bits, and we
+// take the hash modulo small numbers.
+inline u32 paramsys_name_hash(const char* name, u8 len, u32 seed) {
+	u32 h = 0x811c9dc5 ^ (seed * 0x9e3779b9);
+	for (u8 i = 0; i < len; i++) {
+		h ^= (u8)name[i];
+		h *= 0x01000193;
+	}
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+// Return the only param index that can have this name. Caller has to compare the name.
+inline param_index_t paramsys_name_hash_candidate(const u16* disp, u32 num_buckets, const param_index_t* slots,
+                                                  u32 num_slots, const char* name, u8 len) {
+	u32 bucket = paramsys_name_hash(name, len, 0) % num_buckets;
+	return slots[paramsys_name_hash(name, len, disp[bucket]) % num_slots];
+}
@@ -0,0 +1,263 @@
+// Licence: pick one - public domain / UNLICENCE (https://www.unlicense.org) / MIT (https://opensource.org/licenses/MIT).
+
+// Encoder/decoder and request handler of the paramsys wire protocol. See paramsys_proto.h for the format.
+
+#include "paramsys_proto.h"
+#include "paramsys_internal.h"
+
+#include <string.h> // memcpy
+
+
+// start a frame: length prefix (filled in by l_frame_end) and the payload header. return the body position.
+static u32 l_frame_begin(u8* out, u8 packet_type, u8 request_id, param_error_t error) {
+	out[4] = COMPONENT_PARAMS;
+	out[5] = packet_type;
+	out[6] = request_id;
+	out[7] = (u8)error;
+	return 4 + PARAMS_PROTO_HEADER_LEN;
+}
+
+static u32 l_frame_end(u8* out, u32 len) {
+	u32 payload_len = len - 4;
+	memcpy(out, &payload_len, 4);
+	return len;
+}
+
+static u32 l_encode_index_request(u8* out, u32 out_max, u8 packet_type, u8 request_id, param_index_t param_index) {
+	if (out_max < 4 + PARAMS_PROTO_HEADER_LEN + PARAMS_ENTRY_INDEX_LEN)
+		return 0;
+	u32 pos = l_frame_begin(out, packet_type, request_id, param_error_t::SUCCESS);
+	memcpy(out + pos, &param_index, PARAMS_ENTRY_INDEX_LEN);
+	return l_frame_end(out, pos + PARAMS_ENTRY_INDEX_LEN);
+}
+
+u32 paramsys_proto_encode_get(u8* out, u32 out_max, u8 request_id, param_index_t param_index) {
+	return l_encode_index_request(out, out_max, P_PARAMS_GET, request_id, param_index);
+}
+
+u32 paramsys_proto_encode_get_info(u8* out, u32 out_max, u8 request_id, param_index_t param_index) {
+	return l_encode_index_request(out, out_max, P_PARAMS_GET_INFO, request_id, param_index);
+}
+
+u32 paramsys_proto_encode_set(u8* out, u32 out_max, u8 request_id, param_index_t param_index, params_type_e type,
+                              const void* value, u16 len) {
+	bool arena = paramsys_type_is_arena((u8)type);
+	u32 header_len = PARAMS_VALUE_ENTRY_HEADER_LEN + arena;
+	if (!arena && len > 0xff)
+		return 0;
+	if (out_max < 4 + PARAMS_PROTO_HEADER_LEN + header_len + len)
+		return 0;
+	u32 pos = l_frame_begin(out, P_PARAMS_SET, request_id, param_error_t::SUCCESS);
+	memcpy(out + pos, &param_index, PARAMS_ENTRY_INDEX_LEN);
+	out[pos + PARAMS_ENTRY_INDEX_LEN] = (u8)type;
+	memcpy(out + pos + PARAMS_ENTRY_INDEX_LEN + 1, &len, arena ? 2 : 1);
+	memcpy(out + pos + header_len, value, len);
+	return l_frame_end(out, pos + header_len + len);
+}
+
+u32 paramsys_proto_encode_dump_range(u8* out, u32 out_max, u8 request_id, param_index_t first_param_index,
+                                     param_index_t last_param_index) {
+	if (out_max < 4 + PARAMS_PROTO_HEADER_LEN + 2 * PARAMS_ENTRY_INDEX_LEN)
+		return 0;
+	u32 pos = l_frame_begin(out, P_PARAMS_DUMP_RANGE, request_id, param_error_t::SUCCESS);
+	memcpy(out + pos, &first_param_index, PARAMS_ENTRY_INDEX_LEN);
+	memcpy(out + pos + PARAMS_ENTRY_INDEX_LEN, &last_param_index, PARAMS_ENTRY_INDEX_LEN);
+	return l_frame_end(out, pos + 2 * PARAMS_ENTRY_INDEX_LEN);
+}
+
+u32 paramsys_proto_encode_dump_changed(u8* out, u32 out_max, u8 request_id) {
+	if (out_max < 4 + PARAMS_PROTO_HEADER_LEN)
+		return 0;
+	u32 pos = l_frame_begin(out, P_PARAMS_DUMP_CHANGED, request_id, param_error_t::SUCCESS);
+	return l_frame_end(out, pos);
+}
+
+paramsys_proto_decode_e paramsys_proto_decode(const u8* in, u32 in_len, paramsys_proto_msg_t* out_msg,
+                                              u32* out_frame_len) {
+	if (in_len < 4)
+		return paramsys_proto_decode_e::INCOMPLETE;
+	u32 payload_len;
+	memcpy(&payload_len, in, 4);
+	if (payload_len < PARAMS_PROTO_HEADER_LEN || payload_len > PARAMS_PROTO_MAX_PAYLOAD)
+		return paramsys_proto_decode_e::INVALID;
+	if (in_len < 4 + payload_len)
+		return paramsys_proto_decode_e::INCOMPLETE;
+	if (in[4] != COMPONENT_PARAMS)
+		return paramsys_proto_decode_e::INVALID;
+
+	out_msg->packet_type = in[5];
+	out_msg->request_id  = in[6];
+	out_msg->error       = (param_error_t)in[7];
+	out_msg->body        = in + 4 + PARAMS_PROTO_HEADER_LEN;
+	out_msg->body_len    = payload_len - PARAMS_PROTO_HEADER_LEN;
+	*out_frame_len = 4 + payload_len;
+	return paramsys_proto_decode_e::OK;
+}
+
+bool paramsys_proto_next_value(const u8* body, u32 body_len, u32* pos, paramsys_proto_value_t* out_value) {
+	if (*pos > body_len)
+		return false;
+	u32 len;
+	u32 header_len = paramsys_read_value_entry_header(body + *pos, body_len - *pos, &out_value->param_index,
+	                                                  &out_value->type, &len);
+	if (!header_len)
+		return false;
+	out_value->len   = len;
+	out_value->value = body + *pos + header_len;
+	*pos += header_len + len;
+	return true;
+}
+
+bool paramsys_proto_parse_info(const u8* body, u32 body_len, paramsys_proto_info_t* out_info) {
+	// fixed part: index, type, component, security_level, has_minmax, max_len, name_len
+	if (body_len < PARAMS_ENTRY_INDEX_LEN + 6)
+		return false;
+	memcpy(&out_info->param_index, body, PARAMS_ENTRY_INDEX_LEN);
+	// the rest as if the index were 2 bytes
+	body += PARAMS_ENTRY_INDEX_LEN - 2;
+	body_len -= PARAMS_ENTRY_INDEX_LEN - 2;
+	out_info->type           = (params_type_e)body[2];
+	out_info->component      = body[3];
+	out_info->security_level = body[4];
+	out_info->has_minmax     = body[5];
+	bool arena = paramsys_type_is_arena(body[2]);
+	u32 pos = 7;
+	out_info->max_len = body[6];
+	if (arena) {
+		if (body_len < 9)
+			return false;
+		memcpy(&out_info->max_len, body + 6, 2);
+		out_info->has_minmax = false;
+		pos = 8;
+	}
+	out_info->name_len = body[pos++];
+	u32 len_bytes = arena ? 2 : 1;
+	if (pos + out_info->name_len + len_bytes > body_len)
+		return false;
+	out_info->name = (const char*)body + pos;
+	pos += out_info->name_len;
+	out_info->len = body[pos];
+	if (arena)
+		memcpy(&out_info->len, body + pos, 2);
+	pos += len_bytes;
+	u32 values = out_info->has_minmax ? 3 : 1;
+	if (pos + values * out_info->len > body_len)
+		return false;
+	out_info->default_val = body + pos;
+	out_info->min = out_info->has_minmax ? body + pos + out_info->len : nullptr;
+	out_info->max = out_info->has_minmax ? body + pos + 2 * out_info->len : nullptr;
+	return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// server
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+u32 paramsys_proto_handle(const paramsys_proto_msg_t* request, u8* out, u32 out_max, u8 security_level) {
+	params_caller_t caller = params_caller(security_level);
+	const u8* body = request->body;
+	u32 body_len = request->body_len;
+	u8 packet_type = request->packet_type | P_PARAMS_RESPONSE;
+	u32 pos = l_frame_begin(out, packet_type, request->request_id, param_error_t::SUCCESS);
+	param_error_t e = param_error_t::SUCCESS;
+	param_index_t param_index;
+
+	switch (request->packet_type) {
+	case P_PARAMS_GET: {
+		if (body_len != PARAMS_ENTRY_INDEX_LEN) { e = param_error_t::FAIL; break; }
+		memcpy(&param_index, body, PARAMS_ENTRY_INDEX_LEN);
+		if (!params_caller_can_read(&caller, param_index)) { e = param_error_t::NO_PARAM; break; }
+		u32 len = paramsys_write_value_entry(param_index, out + pos, out_max - pos);
+		if (!len) { e = param_error_t::NO_PARAM; break; }
+		pos += len;
+		break;
+	}
+	case P_PARAMS_SET: {
+		u32 p = 0;
+		paramsys_proto_value_t v;
+		if (!paramsys_proto_next_value(body, body_len, &p, &v) || p != body_len) { e = param_error_t::FAIL; break; }
+		if (!params_caller_can_read(&caller, v.param_index)) { e = param_error_t::NO_PARAM; break; }
+		if (!params_caller_can_write(&caller, v.param_index)) { e = param_error_t::DENIED; break; }
+		if (paramsys_type_is_arena((u8)v.type)) {
+			e = v.type == params_type_e::STR16 ? params_set_str16(v.param_index, (const char*)v.value, v.len)
+			                                   : params_set_buf(v.param_index, v.value, v.len);
+			if (e != param_error_t::SUCCESS)
+				break;
+			pos += paramsys_write_value_entry(v.param_index, out + pos, out_max - pos);
+			break;
+		}
+		// value bytes in the frame can be unaligned.
+		u8 value[256];
+		memcpy(value, v.value, v.len);
+		if (v.type == params_type_e::STR) {
+			e = params_set_str(v.param_index, (const char*)value, v.len);
+		} else if (v.len != paramsys_type_len(v.type)) {
+			e = param_error_t::NO_PARAM;
+		} else {
+			e = params_set(v.param_index, v.type, value);
+		}
+		if (e != param_error_t::SUCCESS)
+			break;
+		pos += paramsys_write_value_entry(v.param_index, out + pos, out_max - pos);
+		break;
+	}
+	case P_PARAMS_GET_INFO: {
+		if (body_len != PARAMS_ENTRY_INDEX_LEN) { e = param_error_t::FAIL; break; }
+		memcpy(&param_index, body, PARAMS_ENTRY_INDEX_LEN);
+		if (!params_caller_can_read(&caller, param_index)) { e = param_error_t::NO_PARAM; break; }
+		u32 len = paramsys_write_info_entry(param_index, out + pos, out_max - pos);
+		if (!len) { e = param_error_t::NO_PARAM; break; }
+		pos += len;
+		break;
+	}
+	case P_PARAMS_DUMP_RANGE: {
+		if (body_len != 2 * PARAMS_ENTRY_INDEX_LEN) { e = param_error_t::FAIL; break; }
+		param_index_t first, last;
+		memcpy(&first, body, PARAMS_ENTRY_INDEX_LEN);
+		memcpy(&last, body + PARAMS_ENTRY_INDEX_LEN, PARAMS_ENTRY_INDEX_LEN);
+		u32 next;
+		u32 len = paramsys_write_value_entries(first, last, out + pos + 4, out_max - pos - 4, &next, caller.readable);
+		memcpy(out + pos, &next, 4);
+		pos += 4 + len;
+		break;
+	}
+	case P_PARAMS_DUMP_CHANGED: {
+		if (body_len != 0) { e = param_error_t::FAIL; break; }
+		// fill the response by the actual entry lengths: take a few changed params at a time, and put back the first
+		// one that doesn't fit and the rest of its batch. only the changes the caller can see are taken, the others
+		// stay marked for a caller that can.
+		u32 more_pos = pos;
+		u32 more = 0;
+		pos += 4;
+		for (;;) {
+			param_index_t changed[32];
+			u32 count = params_caller_take_changed(&caller, changed, sizeof(changed) / sizeof(changed[0]));
+			u32 i = 0;
+			for (; i < count; i++) {
+				u32 len = paramsys_write_value_entry(changed[i], out + pos, out_max - pos);
+				if (!len)
+					break;
+				pos += len;
+			}
+			if (i < count) {
+				paramsys_put_back_changed(caller.ctx, &changed[i], count - i);
+				more = 1;
+				break;
+			}
+			if (count < sizeof(changed) / sizeof(changed[0]))
+				break;
+		}
+		memcpy(out + more_pos, &more, 4);
+		break;
+	}
+	default:
+		e = param_error_t::FAIL;
+		break;
+	}
+
+	if (e != param_error_t::SUCCESS)
+		pos = l_frame_begin(out, packet_type, request->request_id, e);
+	return l_frame_end(out, pos);
+}
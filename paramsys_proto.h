@@ -0,0 +1,139 @@
+// Licence: pick one - public domain / UNLICENCE (https://www.unlicense.org) / MIT (https://opensource.org/licenses/MIT).
+
+// Binary request/response protocol for remote get/set/dump.
+//
+// Framing: u32 payload_len, payload[payload_len]. payload_len <= PARAMS_PROTO_MAX_PAYLOAD. Host byte order everywhere,
+// same as the values memory.
+//
+// Payload: u8 component (COMPONENT_PARAMS, 0xFD), u8 packet_type, u8 request_id, u8 error, body. Requests have error 0.
+// A response has the packet_type of the request | P_PARAMS_RESPONSE, the same request_id and a param_error_t in error.
+//
+//   packet_type            request body              response body
+//   P_PARAMS_GET           index param_index         value entry
+//   P_PARAMS_SET           value entry               value entry, the value after clamping
+//   P_PARAMS_GET_INFO      index param_index         info entry
+//   P_PARAMS_DUMP_RANGE    index first, index last   u32 next_param_index, value entries..
+//   P_PARAMS_DUMP_CHANGED  -                         u32 more, value entries..
+//
+// index is a param_index_t: u16, u32 in builds with 32-bit param indices (PARAMS_INDEX_BITS). Both ends have to use
+// the same width.
+// value entry: index param_index, u8 type (params_type_e), u8 len, value[len]. Strings without the max_len/len header.
+//              STR16 and BUF have a u16 len.
+// info entry:  index param_index, u8 type, u8 component, u8 security_level, u8 has_minmax, u8 max_len (value len for
+//              fixed-size types), u8 name_len, name[name_len], u8 len, default[len], and if has_minmax: min[len], max[len].
+//              STR16 and BUF have a u16 max_len and a u16 len, and no limits.
+//
+// DUMP_RANGE returns as many entries as fit into one response, inclusive last. Ask again from next_param_index until it
+// is > last. DUMP_CHANGED returns params changed since the last DUMP_CHANGED (it consumes the params_take_changed
+// bitmap, so the server should be the only user of it). more is 1 if not all changed params fit into the response.
+// Only the changes of params the server's level can see are consumed, the others stay marked.
+// Disabled params are never returned, GET on them returns NO_PARAM.
+//
+// A server runs with a security level (params_caller_t). Params the level can't see are treated like disabled ones,
+// a SET of a param it can see but not change returns DENIED. The default level 255 can see and change everything.
+
+#pragma once
+
+#include "stdints.h"
+
+#include "paramsys.h"
+
+
+#define PARAMS_PROTO_MAX_PAYLOAD (64*1024)
+#define PARAMS_PROTO_MAX_FRAME   (4 + PARAMS_PROTO_MAX_PAYLOAD)
+#define PARAMS_PROTO_HEADER_LEN  4
+
+enum {
+	P_PARAMS_GET          = 0x10,
+	P_PARAMS_SET          = 0x11,
+	P_PARAMS_GET_INFO     = 0x12,
+	P_PARAMS_DUMP_RANGE   = 0x13,
+	P_PARAMS_DUMP_CHANGED = 0x14,
+	P_PARAMS_RESPONSE     = 0x80,
+};
+
+// One decoded message. body points into the decoded buffer.
+struct paramsys_proto_msg_t {
+	u8            packet_type;
+	u8            request_id;
+	param_error_t error;
+	const u8*     body;
+	u32           body_len;
+};
+
+struct paramsys_proto_value_t {
+	param_index_t param_index;
+	params_type_e type;
+	u16           len;
+	const u8*     value;
+};
+
+struct paramsys_proto_info_t {
+	param_index_t param_index;
+	params_type_e type;
+	u8            component;
+	u8            security_level;
+	bool          has_minmax;
+	u16           max_len;
+	u8            name_len;
+	const char*   name; // NOT zero-terminated
+	u16           len;
+	const u8*     default_val;
+	const u8*     min; // nullptr if !has_minmax
+	const u8*     max;
+};
+
+enum class paramsys_proto_decode_e : u8 {
+	OK,
+	INCOMPLETE, // need more bytes
+	INVALID,    // not a paramsys frame, or too long. the stream can't be trusted anymore.
+};
+
+
+// In-memory encoder/decoder. No io.
+//
+// Encoders write a whole frame (length prefix included) and return its length, 0 if it doesn't fit into out_max.
+u32 paramsys_proto_encode_get(u8* out, u32 out_max, u8 request_id, param_index_t param_index);
+u32 paramsys_proto_encode_set(u8* out, u32 out_max, u8 request_id, param_index_t param_index, params_type_e type,
+                              const void* value, u16 len);
+u32 paramsys_proto_encode_get_info(u8* out, u32 out_max, u8 request_id, param_index_t param_index);
+u32 paramsys_proto_encode_dump_range(u8* out, u32 out_max, u8 request_id, param_index_t first_param_index,
+                                     param_index_t last_param_index);
+u32 paramsys_proto_encode_dump_changed(u8* out, u32 out_max, u8 request_id);
+
+// Decode the frame at the start of in. On OK, *out_frame_len is the number of bytes the frame took.
+paramsys_proto_decode_e paramsys_proto_decode(const u8* in, u32 in_len, paramsys_proto_msg_t* out_msg,
+                                              u32* out_frame_len);
+// Parse the value entry at body[*pos] and advance *pos past it. false if there's no complete entry left.
+bool paramsys_proto_next_value(const u8* body, u32 body_len, u32* pos, paramsys_proto_value_t* out_value);
+bool paramsys_proto_parse_info(const u8* body, u32 body_len, paramsys_proto_info_t* out_info);
+
+// Server side. Execute the request against the local params with the rights of security_level and write the response
+// frame to out (at least PARAMS_PROTO_MAX_FRAME bytes). Return the response frame length.
+u32 paramsys_proto_handle(const paramsys_proto_msg_t* request, u8* out, u32 out_max, u8 security_level = 255);
+
+
+// Linux fd transport (paramsys_proto_fd.cpp).
+
+// Read request frames from in_fd, write responses to out_fd until EOF or an error. Use the same fd twice for a socket,
+// or two pipes. Returns SUCCESS on a clean EOF.
+param_error_t paramsys_proto_serve(int in_fd, int out_fd, u8 security_level = 255);
+// Listen on a Unix stream socket at path and serve one client at a time. Returns only on error.
+param_error_t paramsys_proto_serve_unix(const char* path, u8 security_level = 255);
+
+struct paramsys_proto_client_t {
+	int in_fd;
+	int out_fd;
+	u8  next_request_id;
+	u8  buf[PARAMS_PROTO_MAX_FRAME]; // frame being built / last response
+};
+
+void          paramsys_proto_client_init(paramsys_proto_client_t* client, int in_fd, int out_fd);
+param_error_t paramsys_proto_connect_unix(paramsys_proto_client_t* client, const char* path);
+void          paramsys_proto_client_close(paramsys_proto_client_t* client);
+// Send the frame in client->buf (built with paramsys_proto_encode_*) and wait for its response.
+// out_response body points into client->buf and is valid until the next call. Returns FAIL on io or protocol errors,
+// otherwise the error field of the response is in out_response->error.
+param_error_t paramsys_proto_call(paramsys_proto_client_t* client, u32 frame_len, paramsys_proto_msg_t* out_response);
+// Request id for the next encode_* call.
+inline u8     paramsys_proto_next_id(paramsys_proto_client_t* client) { return client->next_request_id++; }
@@ -0,0 +1,198 @@
+// Test client for the paramsys wire protocol.
+//
+//   paramsys_proto_client                 run a server thread over a socketpair and talk to it
+//   paramsys_proto_client <socket>        talk to a server listening on a Unix socket
+//   paramsys_proto_client --serve <socket>  be that server
+//
+// Runs a few get/set/get-info/dump requests, prints the responses, then measures dump-all throughput.
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "paramsys_generated.h"
+#include "paramsys_proto.h"
+
+
+static paramsys_proto_client_t l_client;
+
+
+static void l_print_value(const paramsys_proto_value_t* v) {
+	printf("    %3u type %3u len %3u:", v->param_index, (u8)v->type, v->len);
+	if (v->type == params_type_e::STR || v->type == params_type_e::STR16) {
+		printf(" \"%.*s\"\n", v->len, (const char*)v->value);
+		return;
+	}
+	u32 len = v->len < 16 ? v->len : 16; // a buf can be kilobytes
+	for (u32 i = 0; i < len; i++)
+		printf(" %02x", v->value[i]);
+	printf(len < v->len ? " ..\n" : "\n");
+}
+
+static bool l_call(u32 frame_len, paramsys_proto_msg_t* response, const char* what) {
+	if (!frame_len || paramsys_proto_call(&l_client, frame_len, response) != param_error_t::SUCCESS) {
+		printf("%s: io/protocol error\n", what);
+		return false;
+	}
+	printf("%s: error %u, %u body bytes\n", what, (u8)response->error, response->body_len);
+	return true;
+}
+
+static void l_print_values(const paramsys_proto_msg_t* response, u32 pos) {
+	paramsys_proto_value_t v;
+	while (paramsys_proto_next_value(response->body, response->body_len, &pos, &v))
+		l_print_value(&v);
+}
+
+static void l_smoke() {
+	paramsys_proto_msg_t r;
+	u8* b = l_client.buf;
+	const u32 m = sizeof(l_client.buf);
+
+	if (l_call(paramsys_proto_encode_get(b, m, paramsys_proto_next_id(&l_client), PARAM_p12_U16_index), &r, "get p12_U16"))
+		l_print_values(&r, 0);
+
+	u16 v16 = 0; // below min, has to come back clamped to 1
+	if (l_call(paramsys_proto_encode_set(b, m, paramsys_proto_next_id(&l_client), PARAM_p11_U16_minmax_index,
+	                                     params_type_e::U16, &v16, 2), &r, "set p11_U16_minmax 0"))
+		l_print_values(&r, 0);
+
+	if (l_call(paramsys_proto_encode_set(b, m, paramsys_proto_next_id(&l_client), PARAM_p25_test_8_STR_index,
+	                                     params_type_e::STR, "remote", 6), &r, "set p25_test_8_STR"))
+		l_print_values(&r, 0);
+
+	static const char endpoint[] = "https://example.com/a/path/that/is/longer/than/two/hundred/and/fifty/five/bytes/"
+	                               "......................................................................"
+	                               "......................................................................"
+	                               "......................................................................";
+	if (l_call(paramsys_proto_encode_set(b, m, paramsys_proto_next_id(&l_client), PARAM_p31_endpoint_index,
+	                                     params_type_e::STR16, endpoint, sizeof(endpoint) - 1), &r, "set p31_endpoint"))
+		l_print_values(&r, 0);
+
+	if (l_call(paramsys_proto_encode_set(b, m, paramsys_proto_next_id(&l_client), PARAM_p11_U16_minmax_index,
+	                                     params_type_e::U32, &v16, 2), &r, "set p11_U16_minmax with wrong type"))
+		l_print_values(&r, 0);
+
+	if (l_call(paramsys_proto_encode_get_info(b, m, paramsys_proto_next_id(&l_client), PARAM_p11_U16_minmax_index), &r, "get-info p11_U16_minmax")) {
+		paramsys_proto_info_t inf;
+		if (paramsys_proto_parse_info(r.body, r.body_len, &inf)) {
+			u16 d, lo = 0, hi = 0;
+			memcpy(&d, inf.default_val, 2);
+			if (inf.has_minmax) { memcpy(&lo, inf.min, 2); memcpy(&hi, inf.max, 2); }
+			printf("    %.*s type %u component %u security_level %u default %u min %u max %u\n",
+			       inf.name_len, inf.name, (u8)inf.type, inf.component, inf.security_level, d, lo, hi);
+		}
+	}
+
+	if (l_call(paramsys_proto_encode_dump_range(b, m, paramsys_proto_next_id(&l_client), 1, 5), &r, "dump-range 1..5")) {
+		u32 next;
+		memcpy(&next, r.body, 4);
+		printf("    next %u\n", next);
+		l_print_values(&r, 4);
+	}
+
+	if (l_call(paramsys_proto_encode_dump_changed(b, m, paramsys_proto_next_id(&l_client)), &r, "dump-changed")) {
+		u32 more;
+		memcpy(&more, r.body, 4);
+		printf("    more %u\n", more);
+		l_print_values(&r, 4);
+	}
+}
+
+// dump every param, as many requests as it takes, over and over for about a second.
+static void l_dump_throughput() {
+	u64 params = 0, bytes = 0, requests = 0;
+	auto start = std::chrono::steady_clock::now();
+	double seconds = 0;
+	while (seconds < 1.) {
+		u32 next = 1;
+		while (next < PARAMS_COUNT) {
+			paramsys_proto_msg_t r;
+			u32 len = paramsys_proto_encode_dump_range(l_client.buf, sizeof(l_client.buf), paramsys_proto_next_id(&l_client),
+			                                           (param_index_t)next, PARAMS_COUNT - 1);
+			if (paramsys_proto_call(&l_client, len, &r) != param_error_t::SUCCESS || r.error != param_error_t::SUCCESS) {
+				printf("dump failed\n");
+				return;
+			}
+			memcpy(&next, r.body, 4);
+			u32 pos = 4;
+			paramsys_proto_value_t v;
+			while (paramsys_proto_next_value(r.body, r.body_len, &pos, &v))
+				params++;
+			bytes += 4 + PARAMS_PROTO_HEADER_LEN + r.body_len;
+			requests++;
+		}
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	printf("dump-all: %.0f params/s, %.1f MB/s, %.0f requests/s, %.2f us per param\n",
+	       params / seconds, bytes / seconds / 1e6, requests / seconds, seconds * 1e6 / params);
+}
+
+// the same without the transport: just the server side paramsys_proto_handle serializing the values.
+static void l_dump_serialize_throughput() {
+	static u8 request[64];
+	static u8 response[PARAMS_PROTO_MAX_FRAME];
+	u32 request_len = paramsys_proto_encode_dump_range(request, sizeof(request), 0, 1, PARAMS_COUNT - 1);
+	paramsys_proto_msg_t msg;
+	u32 frame_len;
+	paramsys_proto_decode(request, request_len, &msg, &frame_len);
+
+	// all the params have to fit into one response for this to measure the whole dump.
+	u32 count = 0, pos = 4;
+	paramsys_proto_value_t v;
+	paramsys_proto_msg_t r;
+	u32 response_len = paramsys_proto_handle(&msg, response, sizeof(response));
+	paramsys_proto_decode(response, response_len, &r, &frame_len);
+	while (paramsys_proto_next_value(r.body, r.body_len, &pos, &v))
+		count++;
+
+	u64 params = 0, bytes = 0;
+	auto start = std::chrono::steady_clock::now();
+	double seconds = 0;
+	while (seconds < 1.) {
+		for (int i = 0; i < 1000; i++) {
+			u32 len = paramsys_proto_handle(&msg, response, sizeof(response));
+			bytes += len;
+			params += count;
+		}
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	printf("dump-all serialization only: %.0f params/s, %.1f MB/s, %.3f us per param\n",
+	       params / seconds, bytes / seconds / 1e6, seconds * 1e6 / params);
+}
+
+int main(int argc, char** argv) {
+	params_init();
+
+	if (argc == 3 && strcmp(argv[1], "--serve") == 0) {
+		paramsys_proto_serve_unix(argv[2]);
+		printf("can't serve on %s\n", argv[2]);
+		return 1;
+	}
+
+	std::thread server;
+	if (argc == 2) {
+		if (paramsys_proto_connect_unix(&l_client, argv[1]) != param_error_t::SUCCESS) {
+			printf("can't connect to %s\n", argv[1]);
+			return 1;
+		}
+	} else {
+		int fds[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+			return 1;
+		server = std::thread([fd = fds[1]]() { paramsys_proto_serve(fd, fd); close(fd); });
+		paramsys_proto_client_init(&l_client, fds[0], fds[0]);
+	}
+
+	l_smoke();
+	l_dump_throughput();
+	l_dump_serialize_throughput();
+
+	paramsys_proto_client_close(&l_client);
+	if (server.joinable())
+		server.join();
+	return 0;
+}
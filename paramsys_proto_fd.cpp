@@ -0,0 +1,154 @@
+// Licence: pick one - public domain / UNLICENCE (https://www.unlicense.org) / MIT (https://opensource.org/licenses/MIT).
+
+// paramsys wire protocol over Linux file descriptors: Unix sockets, pipes, anything with read/write.
+
+#include "paramsys_proto.h"
+
+#include <stdlib.h> // malloc
+#include <string.h> // memcpy
+#include <errno.h> // EINTR
+#include <unistd.h> // read, write, close, unlink
+#include <sys/socket.h> // socket
+#include <sys/un.h> // sockaddr_un
+
+
+// return false on error or eof. *out_eof is set if eof came before the first byte.
+static bool l_read_all(int fd, u8* buf, u32 len, bool* out_eof = nullptr) {
+	bool first = true;
+	while (len) {
+		ssize_t r = read(fd, buf, len);
+		if (r < 0 && errno == EINTR) continue;
+		if (r == 0 && first && out_eof) *out_eof = true;
+		if (r <= 0) return false;
+		first = false;
+		buf += r;
+		len -= r;
+	}
+	return true;
+}
+
+static bool l_write_all(int fd, const u8* buf, u32 len) {
+	while (len) {
+		ssize_t r = write(fd, buf, len);
+		if (r < 0 && errno == EINTR) continue;
+		if (r <= 0) return false;
+		buf += r;
+		len -= r;
+	}
+	return true;
+}
+
+// read one whole frame into buf (PARAMS_PROTO_MAX_FRAME bytes) and decode it.
+static param_error_t l_read_frame(int fd, u8* buf, paramsys_proto_msg_t* out_msg, bool* out_eof = nullptr) {
+	if (!l_read_all(fd, buf, 4, out_eof))
+		return param_error_t::FAIL;
+	u32 payload_len;
+	memcpy(&payload_len, buf, 4);
+	if (payload_len > PARAMS_PROTO_MAX_PAYLOAD || !l_read_all(fd, buf + 4, payload_len))
+		return param_error_t::FAIL;
+	u32 frame_len;
+	if (paramsys_proto_decode(buf, 4 + payload_len, out_msg, &frame_len) != paramsys_proto_decode_e::OK)
+		return param_error_t::FAIL;
+	return param_error_t::SUCCESS;
+}
+
+
+param_error_t paramsys_proto_serve(int in_fd, int out_fd, u8 security_level) {
+	u8* in_buf = (u8*)malloc(PARAMS_PROTO_MAX_FRAME);
+	u8* out_buf = (u8*)malloc(PARAMS_PROTO_MAX_FRAME);
+	param_error_t e = param_error_t::FAIL;
+
+	if (in_buf && out_buf) {
+		paramsys_proto_msg_t request;
+		while (true) {
+			bool eof = false;
+			if (l_read_frame(in_fd, in_buf, &request, &eof) != param_error_t::SUCCESS) {
+				if (eof) e = param_error_t::SUCCESS; // clean eof between frames
+				break;
+			}
+			u32 response_len = paramsys_proto_handle(&request, out_buf, PARAMS_PROTO_MAX_FRAME, security_level);
+			if (!l_write_all(out_fd, out_buf, response_len))
+				break;
+		}
+	}
+
+	free(in_buf);
+	free(out_buf);
+	return e;
+}
+
+param_error_t paramsys_proto_serve_unix(const char* path, u8 security_level) {
+	struct sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return param_error_t::FAIL;
+	strcpy(addr.sun_path, path);
+
+	int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listen_fd < 0)
+		return param_error_t::FAIL;
+	unlink(path);
+	if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd, 4) != 0) {
+		close(listen_fd);
+		return param_error_t::FAIL;
+	}
+
+	while (true) {
+		int fd = accept(listen_fd, nullptr, nullptr);
+		if (fd < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+		paramsys_proto_serve(fd, fd, security_level);
+		close(fd);
+	}
+	close(listen_fd);
+	return param_error_t::FAIL;
+}
+
+
+void paramsys_proto_client_init(paramsys_proto_client_t* client, int in_fd, int out_fd) {
+	client->in_fd = in_fd;
+	client->out_fd = out_fd;
+	client->next_request_id = 0;
+}
+
+param_error_t paramsys_proto_connect_unix(paramsys_proto_client_t* client, const char* path) {
+	struct sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return param_error_t::FAIL;
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return param_error_t::FAIL;
+	if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		close(fd);
+		return param_error_t::FAIL;
+	}
+	paramsys_proto_client_init(client, fd, fd);
+	return param_error_t::SUCCESS;
+}
+
+void paramsys_proto_client_close(paramsys_proto_client_t* client) {
+	if (client->in_fd >= 0)
+		close(client->in_fd);
+	if (client->out_fd >= 0 && client->out_fd != client->in_fd)
+		close(client->out_fd);
+	client->in_fd = client->out_fd = -1;
+}
+
+param_error_t paramsys_proto_call(paramsys_proto_client_t* client, u32 frame_len, paramsys_proto_msg_t* out_response) {
+	if (frame_len < 4 + PARAMS_PROTO_HEADER_LEN)
+		return param_error_t::FAIL;
+	u8 packet_type = client->buf[5];
+	u8 request_id = client->buf[6];
+	if (!l_write_all(client->out_fd, client->buf, frame_len))
+		return param_error_t::FAIL;
+	if (l_read_frame(client->in_fd, client->buf, out_response) != param_error_t::SUCCESS)
+		return param_error_t::FAIL;
+	if (out_response->packet_type != (packet_type | P_PARAMS_RESPONSE) || out_response->request_id != request_id)
+		return param_error_t::FAIL;
+	return param_error_t::SUCCESS;
+}
@@ -0,0 +1,83 @@
+// Licence: pick one - public domain / UNLICENCE (https://www.unlicense.org) / MIT (https://opensource.org/licenses/MIT).
+
+// Shared values memory for Linux. The whole paramsys_valuemem_t lives in a MAP_SHARED file mapping. One writer process
+// updates it, any number of reader processes map it read-only. See params_map_shared in paramsys.h.
+//
+// File layout: paramsys_valuemem_t, padding to 64 bytes, paramsys_seq_t[PARAMS_SIZE_CLASS_COUNT]. The seqlock
+// counters live in the mapping too, so that readers in other processes see the writer's write sections.
+
+#include "paramsys.h"
+#include "paramsys_internal.h"
+
+#include <string.h> // memcpy
+#include <fcntl.h> // open
+#include <unistd.h> // ftruncate, close
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+
+
+static paramsys_valuemem_t* l_mapping = nullptr;
+static paramsys_valuemem_t* l_local = nullptr; // process-local values memory, restored by params_unmap_shared
+
+static const size_t l_seq_offset = (sizeof(paramsys_valuemem_t) + 63) & ~(size_t)63;
+static const size_t l_mapping_size = l_seq_offset + sizeof(paramsys_seq_t) * PARAMS_SIZE_CLASS_COUNT;
+
+
+param_error_t params_map_shared(const char* path, bool writer) {
+	if (l_mapping)
+		return param_error_t::FAIL;
+
+	const size_t size = l_mapping_size;
+
+	int fd = open(path, writer ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+	if (fd < 0)
+		return param_error_t::FAIL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (!writer && (size_t)st.st_size < size) ||
+	    (writer && (size_t)st.st_size < size && ftruncate(fd, size) != 0)) {
+		close(fd);
+		return param_error_t::FAIL;
+	}
+
+	void* p = mmap(nullptr, size, writer ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return param_error_t::FAIL;
+	paramsys_valuemem_t* mem = (paramsys_valuemem_t*)p;
+
+	if (!paramsys_valuemem_header_valid(mem)) {
+		if (!writer) {
+			munmap(p, size);
+			return param_error_t::FAIL;
+		}
+		// fresh (or foreign) file. publish our current values. component is written last, so a reader that maps the
+		// file meanwhile doesn't trust a half-written image.
+		mem->component = 0;
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		memcpy((u8*)mem + 1, (u8*)params_valuemem + 1, offsetof(paramsys_valuemem_t, values) - 1 + params_valuemem->values_bytes_used);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		mem->component = params_valuemem->component;
+	}
+
+	// a previous writer could have died in the middle of a write section. readers would spin on an odd counter forever.
+	paramsys_seq_t* seq = (paramsys_seq_t*)((u8*)mem + l_seq_offset);
+	if (writer)
+		for (int i = 0; i < PARAMS_SIZE_CLASS_COUNT; i++)
+			if (seq[i].seq & 1)
+				__atomic_fetch_add(&seq[i].seq, 1, __ATOMIC_RELEASE);
+
+	l_local = params_valuemem;
+	l_mapping = mem;
+	paramsys_bind_valuemem(mem, seq, !writer);
+	return param_error_t::SUCCESS;
+}
+
+void params_unmap_shared() {
+	if (!l_mapping)
+		return;
+	memcpy(l_local->values, l_mapping->values, l_mapping->values_bytes_used);
+	paramsys_bind_valuemem(l_local, nullptr, false);
+	munmap(l_mapping, l_mapping_size);
+	l_mapping = nullptr;
+}
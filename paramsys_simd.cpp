@@ -0,0 +1,230 @@
+// Licence: pick one - public domain / UNLICENCE (https://www.unlicense.org) / MIT (https://opensource.org/licenses/MIT).
+
+// Vector kernels for params_validate_all. See paramsys_scan_limits in paramsys_internal.h.
+//
+// Every value of a size class is turned into a signed key that orders like the value itself:
+//     key = value ^ (kind & (sign_bit | value >> (bits - 1)))   (arithmetic shift)
+// with kind = sign_bit for unsigned types, 0 for signed types and ~sign_bit for floats. Then one signed compare
+// against min and one against max, both already keys (paramsys_generate.py limit_key). The 8 and 16 bit classes have
+// no floats, so there the key is just value ^ kind.
+//
+// SSE4.2 and AVX2 versions are picked at runtime, the scalar one is the fallback for everything else.
+
+#include "paramsys_internal.h"
+
+#include <string.h> // memset, memcpy
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define L_X86
+#include <immintrin.h>
+#endif
+
+
+static const char* const l_isa_names[] = {"scalar", "sse4.2", "avx2"};
+
+template <typename U, typename S>
+static void l_scan_scalar(const U* values, const U* min, const U* max, const U* kind, u32 begin, u32 count,
+                          u64* out_bitmap) {
+	const U sign = (U)1 << (sizeof(U) * 8 - 1);
+	for (u32 i = begin; i < count; i++) {
+		U x;
+		memcpy(&x, values + i, sizeof(U)); // the 64-bit values are aligned by 4 bytes only
+		U fill = (S)x < 0 ? (U)~(U)0 : 0;
+		S key = (S)(U)(x ^ (kind[i] & (sign | fill)));
+		if (key < (S)min[i] || key > (S)max[i])
+			out_bitmap[i / 64] |= (u64)1 << (i % 64);
+	}
+}
+
+// lane_mask has bits_per_lane bits for every lane, all set for a lane out of range. happens rarely, so no tricks.
+static inline void l_mark_lanes(u64* out_bitmap, u32 first, u32 lane_mask, u32 lanes, u32 bits_per_lane) {
+	for (u32 j = 0; j < lanes; j++)
+		if (lane_mask >> (j * bits_per_lane) & 1)
+			out_bitmap[(first + j) / 64] |= (u64)1 << ((first + j) % 64);
+}
+
+
+#ifdef L_X86
+
+// sse4.2
+
+__attribute__((target("sse4.2")))
+static void l_scan_8_sse42(const u8* values, const u8* min, const u8* max, const u8* kind, u32 count, u64* out) {
+	u32 i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i key = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(values + i)), _mm_loadu_si128((const __m128i*)(kind + i)));
+		__m128i bad = _mm_or_si128(_mm_cmpgt_epi8(_mm_loadu_si128((const __m128i*)(min + i)), key),
+		                           _mm_cmpgt_epi8(key, _mm_loadu_si128((const __m128i*)(max + i))));
+		if (u32 m = _mm_movemask_epi8(bad)) l_mark_lanes(out, i, m, 16, 1);
+	}
+	l_scan_scalar<u8, i8>(values, min, max, kind, i, count, out);
+}
+
+__attribute__((target("sse4.2")))
+static void l_scan_16_sse42(const u16* values, const u16* min, const u16* max, const u16* kind, u32 count, u64* out) {
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i key = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(values + i)), _mm_loadu_si128((const __m128i*)(kind + i)));
+		__m128i bad = _mm_or_si128(_mm_cmpgt_epi16(_mm_loadu_si128((const __m128i*)(min + i)), key),
+		                           _mm_cmpgt_epi16(key, _mm_loadu_si128((const __m128i*)(max + i))));
+		if (u32 m = _mm_movemask_epi8(bad)) l_mark_lanes(out, i, m, 8, 2);
+	}
+	l_scan_scalar<u16, i16>(values, min, max, kind, i, count, out);
+}
+
+__attribute__((target("sse4.2")))
+static void l_scan_32_sse42(const u32* values, const u32* min, const u32* max, const u32* kind, u32 count, u64* out) {
+	const __m128i sign = _mm_set1_epi32((int)0x80000000);
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(values + i));
+		__m128i fill = _mm_or_si128(sign, _mm_srai_epi32(x, 31));
+		__m128i key = _mm_xor_si128(x, _mm_and_si128(_mm_loadu_si128((const __m128i*)(kind + i)), fill));
+		__m128i bad = _mm_or_si128(_mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(min + i)), key),
+		                           _mm_cmpgt_epi32(key, _mm_loadu_si128((const __m128i*)(max + i))));
+		if (u32 m = _mm_movemask_ps(_mm_castsi128_ps(bad))) l_mark_lanes(out, i, m, 4, 1);
+	}
+	l_scan_scalar<u32, i32>(values, min, max, kind, i, count, out);
+}
+
+__attribute__((target("sse4.2")))
+static void l_scan_64_sse42(const u64* values, const u64* min, const u64* max, const u64* kind, u32 count, u64* out) {
+	const __m128i sign = _mm_set1_epi64x((long long)0x8000000000000000ull);
+	const __m128i zero = _mm_setzero_si128();
+	u32 i = 0;
+	for (; i + 2 <= count; i += 2) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(values + i));
+		__m128i fill = _mm_or_si128(sign, _mm_cmpgt_epi64(zero, x));
+		__m128i key = _mm_xor_si128(x, _mm_and_si128(_mm_loadu_si128((const __m128i*)(kind + i)), fill));
+		__m128i bad = _mm_or_si128(_mm_cmpgt_epi64(_mm_loadu_si128((const __m128i*)(min + i)), key),
+		                           _mm_cmpgt_epi64(key, _mm_loadu_si128((const __m128i*)(max + i))));
+		if (u32 m = _mm_movemask_pd(_mm_castsi128_pd(bad))) l_mark_lanes(out, i, m, 2, 1);
+	}
+	l_scan_scalar<u64, i64>(values, min, max, kind, i, count, out);
+}
+
+// avx2
+
+__attribute__((target("avx2")))
+static void l_scan_8_avx2(const u8* values, const u8* min, const u8* max, const u8* kind, u32 count, u64* out) {
+	u32 i = 0;
+	for (; i + 32 <= count; i += 32) {
+		__m256i key = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(values + i)), _mm256_loadu_si256((const __m256i*)(kind + i)));
+		__m256i bad = _mm256_or_si256(_mm256_cmpgt_epi8(_mm256_loadu_si256((const __m256i*)(min + i)), key),
+		                              _mm256_cmpgt_epi8(key, _mm256_loadu_si256((const __m256i*)(max + i))));
+		if (u32 m = _mm256_movemask_epi8(bad)) l_mark_lanes(out, i, m, 32, 1);
+	}
+	l_scan_scalar<u8, i8>(values, min, max, kind, i, count, out);
+}
+
+__attribute__((target("avx2")))
+static void l_scan_16_avx2(const u16* values, const u16* min, const u16* max, const u16* kind, u32 count, u64* out) {
+	u32 i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256i key = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(values + i)), _mm256_loadu_si256((const __m256i*)(kind + i)));
+		__m256i bad = _mm256_or_si256(_mm256_cmpgt_epi16(_mm256_loadu_si256((const __m256i*)(min + i)), key),
+		                              _mm256_cmpgt_epi16(key, _mm256_loadu_si256((const __m256i*)(max + i))));
+		if (u32 m = _mm256_movemask_epi8(bad)) l_mark_lanes(out, i, m, 16, 2);
+	}
+	l_scan_scalar<u16, i16>(values, min, max, kind, i, count, out);
+}
+
+__attribute__((target("avx2")))
+static void l_scan_32_avx2(const u32* values, const u32* min, const u32* max, const u32* kind, u32 count, u64* out) {
+	const __m256i sign = _mm256_set1_epi32((int)0x80000000);
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(values + i));
+		__m256i fill = _mm256_or_si256(sign, _mm256_srai_epi32(x, 31));
+		__m256i key = _mm256_xor_si256(x, _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(kind + i)), fill));
+		__m256i bad = _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(min + i)), key),
+		                              _mm256_cmpgt_epi32(key, _mm256_loadu_si256((const __m256i*)(max + i))));
+		if (u32 m = _mm256_movemask_ps(_mm256_castsi256_ps(bad))) l_mark_lanes(out, i, m, 8, 1);
+	}
+	l_scan_scalar<u32, i32>(values, min, max, kind, i, count, out);
+}
+
+__attribute__((target("avx2")))
+static void l_scan_64_avx2(const u64* values, const u64* min, const u64* max, const u64* kind, u32 count, u64* out) {
+	const __m256i sign = _mm256_set1_epi64x((long long)0x8000000000000000ull);
+	const __m256i zero = _mm256_setzero_si256();
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(values + i));
+		__m256i fill = _mm256_or_si256(sign, _mm256_cmpgt_epi64(zero, x));
+		__m256i key = _mm256_xor_si256(x, _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(kind + i)), fill));
+		__m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(_mm256_loadu_si256((const __m256i*)(min + i)), key),
+		                              _mm256_cmpgt_epi64(key, _mm256_loadu_si256((const __m256i*)(max + i))));
+		if (u32 m = _mm256_movemask_pd(_mm256_castsi256_pd(bad))) l_mark_lanes(out, i, m, 4, 1);
+	}
+	l_scan_scalar<u64, i64>(values, min, max, kind, i, count, out);
+}
+
+#endif // L_X86
+
+
+static paramsys_isa_e l_isa_best() {
+#ifdef L_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return paramsys_isa_e::AVX2;
+	if (__builtin_cpu_supports("sse4.2")) return paramsys_isa_e::SSE42;
+#endif
+	return paramsys_isa_e::SCALAR;
+}
+
+static paramsys_isa_e l_isa = l_isa_best();
+
+paramsys_isa_e paramsys_scan_limits_set_isa(paramsys_isa_e isa) {
+	paramsys_isa_e best = l_isa_best();
+	l_isa = (u8)isa < (u8)best ? isa : best;
+	return l_isa;
+}
+
+const char* paramsys_scan_limits_isa_name() {
+	return l_isa_names[(u8)l_isa];
+}
+
+void paramsys_scan_limits(u8 size_class, const void* values, const void* limits, u32 count, u64* out_bitmap) {
+	memset(out_bitmap, 0, (count + 63) / 64 * 8);
+
+	switch (size_class) {
+	case PARAMS_SIZE_CLASS_8: {
+		auto v = (const u8*)values; auto l = (const u8*)limits;
+#ifdef L_X86
+		if (l_isa == paramsys_isa_e::AVX2)  { l_scan_8_avx2(v, l, l + count, l + 2 * count, count, out_bitmap); break; }
+		if (l_isa == paramsys_isa_e::SSE42) { l_scan_8_sse42(v, l, l + count, l + 2 * count, count, out_bitmap); break; }
+#endif
+		l_scan_scalar<u8, i8>(v, l, l + count, l + 2 * count, 0, count, out_bitmap);
+		break;
+	}
+	case PARAMS_SIZE_CLASS_16: {
+		auto v = (const u16*)values; auto l = (const u16*)limits;
+#ifdef L_X86
+		if (l_isa == paramsys_isa_e::AVX2)  { l_scan_16_avx2(v, l, l + count, l + 2 * count, count, out_bitmap); break; }
+		if (l_isa == paramsys_isa_e::SSE42) { l_scan_16_sse42(v, l, l + count, l + 2 * count, count, out_bitmap); break; }
+#endif
+		l_scan_scalar<u16, i16>(v, l, l + count, l + 2 * count, 0, count, out_bitmap);
+		break;
+	}
+	case PARAMS_SIZE_CLASS_32: {
+		auto v = (const u32*)values; auto l = (const u32*)limits;
+#ifdef L_X86
+		if (l_isa == paramsys_isa_e::AVX2)  { l_scan_32_avx2(v, l, l + count, l + 2 * count, count, out_bitmap); break; }
+		if (l_isa == paramsys_isa_e::SSE42) { l_scan_32_sse42(v, l, l + count, l + 2 * count, count, out_bitmap); break; }
+#endif
+		l_scan_scalar<u32, i32>(v, l, l + count, l + 2 * count, 0, count, out_bitmap);
+		break;
+	}
+	case PARAMS_SIZE_CLASS_64: {
+		auto v = (const u64*)values; auto l = (const u64*)limits;
+#ifdef L_X86
+		if (l_isa == paramsys_isa_e::AVX2)  { l_scan_64_avx2(v, l, l + count, l + 2 * count, count, out_bitmap); break; }
+		if (l_isa == paramsys_isa_e::SSE42) { l_scan_64_sse42(v, l, l + count, l + 2 * count, count, out_bitmap); break; }
+#endif
+		l_scan_scalar<u64, i64>(v, l, l + count, l + 2 * count, 0, count, out_bitmap);
+		break;
+	}
+	default:
+		break;
+	}
+}
@@ -0,0 +1,63 @@
+// Licence: pick one - public domain / UNLICENCE (https://www.unlicense.org) / MIT (https://opensource.org/licenses/MIT).
+
+// Persistent backing store for the param values (paramsys_valuemem_t).
+//
+// The store keeps two things:
+//   * snapshot - full image of the values memory (header + values[0 .. values_bytes_used]), followed by the layout
+//                descriptor of the firmware that wrote it (u32 count + paramsys_layout_entry_t[count]). After a
+//                firmware update with new params or resized strings, params_init_from_store() moves the values to
+//                the new layout (paramsys_migrate) and re-applies the limits.
+//   * journal  - append-only list of (param_index, value) records written after the snapshot.
+//
+// Every value change is one small journal append. When the journal grows over compact_threshold_bytes, paramsys
+// writes a fresh snapshot and the journal is truncated. On startup params_init_from_store() loads the snapshot and
+// replays the journal on top of it, so restart cost is bounded by the compaction threshold.
+
+#pragma once
+
+#include "stdints.h"
+
+
+// Storage backend interface. Fill in the function pointers, or use paramsys_store_file_open() below.
+struct paramsys_store_t {
+	// Read the latest snapshot into image. Return number of bytes read, 0 if there's no valid snapshot.
+	u32  (*load_snapshot)(paramsys_store_t* store, u8* image, u32 image_max_len);
+	// Call apply for every valid journal record in the order they were written. Drop the invalid tail (torn write).
+	void (*replay_journal)(paramsys_store_t* store, void (*apply)(u32 param_index, const u8* value, u16 len));
+	// Append one record. For str params value is the string without the max_len/len header.
+	bool (*append)(paramsys_store_t* store, u32 param_index, const u8* value, u16 len);
+	// Atomically replace the snapshot with image and empty the journal.
+	bool (*compact)(paramsys_store_t* store, const u8* image, u32 image_len);
+	// Optional (can be nullptr). appends between batch_begin and batch_end belong to one params_set_many call and
+	// can be written out together.
+	void (*batch_begin)(paramsys_store_t* store);
+	bool (*batch_end)(paramsys_store_t* store);
+
+	u32 journal_bytes;           // journal size since last compaction. maintained by the backend.
+	u32 compact_threshold_bytes; // paramsys calls compact() after an append pushes journal_bytes over this.
+};
+
+
+// Linux file-backed store.
+//
+// Journal record: u32 param_index, u16 len, value[len], u32 crc32 of the preceding bytes. Host byte order.
+// Snapshot file: u32 magic, u32 image_len, u32 crc32 of image, image. Written to "<path>.tmp" and renamed over the
+// old one, so a crash leaves either the old or the new snapshot. A crash between the rename and the journal
+// truncation just replays records that are already in the snapshot, which is harmless.
+struct paramsys_store_file_t {
+	paramsys_store_t store; // has to be first
+	int  journal_fd;
+	bool fsync_every_append;  // survive power loss, not just process crash. costs an fsync per value change (per batch).
+	bool batching;            // between batch_begin and batch_end records are collected to batch_buf
+	bool journal_torn;        // the journal may end in a partial record. appends fail until it is cut back.
+	u8*  batch_buf;
+	u32  batch_len;
+	u32  batch_cap;
+	char snapshot_path[256];
+	char journal_path[256];
+};
+
+// Open (create if missing) the snapshot and journal files. Return false on error.
+bool paramsys_store_file_open(paramsys_store_file_t* s, const char* snapshot_path, const char* journal_path,
+                              u32 compact_threshold_bytes = 64*1024, bool fsync_every_append = false);
+void paramsys_store_file_close(paramsys_store_file_t* s);
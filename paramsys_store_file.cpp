@@ -0,0 +1,267 @@
+// Licence: pick one - public domain / UNLICENCE (https://www.unlicense.org) / MIT (https://opensource.org/licenses/MIT).
+
+// File-backed paramsys_store_t for Linux. See paramsys_store.h for the file formats.
+
+#include "paramsys_store.h"
+
+#include <stdio.h> // snprintf
+#include <stdlib.h> // malloc
+#include <string.h> // memcpy
+#include <fcntl.h> // open
+#include <unistd.h> // read, write, fsync, ftruncate
+#include <sys/stat.h> // fstat
+#include <sys/uio.h> // writev
+
+
+#define PARAMSYS_SNAPSHOT_MAGIC 0x53595350 // "PSYS"
+
+#pragma pack(push,1)
+struct l_record_header_t { u32 param_index; u16 len; };
+struct l_snapshot_header_t { u32 magic; u32 image_len; u32 crc; };
+#pragma pack(pop)
+
+
+// plain crc32 (ieee 802.3, reflected). table is built on first use.
+static u32 l_crc32(u32 crc, const u8* data, u32 len) {
+	static u32 table[256];
+	if (!table[1]) {
+		for (u32 i = 0; i < 256; i++) {
+			u32 c = i;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+	}
+	crc = ~crc;
+	while (len--)
+		crc = table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+// read the whole file into a malloc'd buffer. return nullptr if the file is empty or missing.
+static u8* l_read_file(int fd, u32* out_len) {
+	struct stat st;
+	*out_len = 0;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0)
+		return nullptr;
+	u8* buf = (u8*)malloc(st.st_size);
+	if (!buf) return nullptr;
+	u32 got = 0;
+	while (got < (u32)st.st_size) {
+		ssize_t r = pread(fd, buf + got, st.st_size - got, got);
+		if (r <= 0) break;
+		got += r;
+	}
+	*out_len = got;
+	return buf;
+}
+
+static u32 l_load_snapshot(paramsys_store_t* store, u8* image, u32 image_max_len) {
+	paramsys_store_file_t* s = (paramsys_store_file_t*)store;
+
+	int fd = open(s->snapshot_path, O_RDONLY);
+	if (fd < 0) return 0;
+	u32 len;
+	u8* buf = l_read_file(fd, &len);
+	close(fd);
+
+	u32 image_len = 0;
+	l_snapshot_header_t* h = (l_snapshot_header_t*)buf;
+	if (buf && len >= sizeof(*h) && h->magic == PARAMSYS_SNAPSHOT_MAGIC && h->image_len == len - sizeof(*h) &&
+	    h->image_len <= image_max_len && h->crc == l_crc32(0, buf + sizeof(*h), h->image_len)) {
+		image_len = h->image_len;
+		memcpy(image, buf + sizeof(*h), image_len);
+	}
+	free(buf);
+	return image_len;
+}
+
+// a write that fell short leaves part of a record at the end of the journal. replay stops at it, so everything
+// appended after it would be lost. the journal is cut back to the last whole record before anything else goes in.
+static bool l_journal_cut(paramsys_store_file_t* s) {
+	if (s->journal_torn)
+		s->journal_torn = ftruncate(s->journal_fd, s->store.journal_bytes) != 0;
+	return !s->journal_torn;
+}
+
+static void l_replay_journal(paramsys_store_t* store, void (*apply)(u32 param_index, const u8* value, u16 len)) {
+	paramsys_store_file_t* s = (paramsys_store_file_t*)store;
+
+	u32 len;
+	u8* buf = l_read_file(s->journal_fd, &len);
+	u32 pos = 0;
+
+	while (pos + sizeof(l_record_header_t) + 4 <= len) {
+		l_record_header_t h;
+		memcpy(&h, buf + pos, sizeof(h));
+		u32 record_len = sizeof(h) + h.len + 4;
+		if (pos + record_len > len)
+			break;
+		u32 crc;
+		memcpy(&crc, buf + pos + sizeof(h) + h.len, 4);
+		if (crc != l_crc32(0, buf + pos, sizeof(h) + h.len))
+			break;
+		apply(h.param_index, buf + pos + sizeof(h), h.len);
+		pos += record_len;
+	}
+
+	// cut off the torn tail, if any. new records have to follow the last valid one: if the cut fails here, appends
+	// retry it and fail until it works (see l_journal_cut).
+	s->store.journal_bytes = pos;
+	s->journal_torn = pos != len;
+	l_journal_cut(s);
+	free(buf);
+}
+
+static bool l_journal_written(paramsys_store_file_t* s, ssize_t written, ssize_t total) {
+	if (written == total)
+		return true;
+	s->journal_torn = true;
+	l_journal_cut(s);
+	return false;
+}
+
+static bool l_append(paramsys_store_t* store, u32 param_index, const u8* value, u16 len) {
+	paramsys_store_file_t* s = (paramsys_store_file_t*)store;
+
+	l_record_header_t h = {param_index, len};
+	u32 crc = l_crc32(l_crc32(0, (u8*)&h, sizeof(h)), value, len);
+
+	if (s->batching) {
+		u32 need = s->batch_len + sizeof(h) + len + 4;
+		if (need > s->batch_cap) {
+			u32 cap = s->batch_cap ? s->batch_cap : 1024;
+			while (cap < need) cap *= 2;
+			u8* buf = (u8*)realloc(s->batch_buf, cap);
+			if (!buf) return false;
+			s->batch_buf = buf;
+			s->batch_cap = cap;
+		}
+		u8* dst = s->batch_buf + s->batch_len;
+		memcpy(dst, &h, sizeof(h));
+		memcpy(dst + sizeof(h), value, len);
+		memcpy(dst + sizeof(h) + len, &crc, 4);
+		s->batch_len = need;
+		return true;
+	}
+
+	// one writev per record. journal is opened with O_APPEND, so the record lands in one piece at the end.
+	if (!l_journal_cut(s))
+		return false;
+	struct iovec iov[3] = {{&h, sizeof(h)}, {(void*)value, len}, {&crc, 4}};
+	ssize_t total = sizeof(h) + len + 4;
+	if (!l_journal_written(s, writev(s->journal_fd, iov, 3), total))
+		return false;
+	if (s->fsync_every_append)
+		fdatasync(s->journal_fd);
+	s->store.journal_bytes += total;
+	return true;
+}
+
+static void l_batch_begin(paramsys_store_t* store) {
+	paramsys_store_file_t* s = (paramsys_store_file_t*)store;
+	s->batching = true;
+	s->batch_len = 0;
+}
+
+// the whole batch goes out in one write (and one fsync). a torn batch loses its tail records on replay, same as
+// separate appends would.
+static bool l_batch_end(paramsys_store_t* store) {
+	paramsys_store_file_t* s = (paramsys_store_file_t*)store;
+	s->batching = false;
+	if (!s->batch_len)
+		return true;
+	bool ok = l_journal_cut(s) && l_journal_written(s, write(s->journal_fd, s->batch_buf, s->batch_len), s->batch_len);
+	if (ok && s->fsync_every_append)
+		fdatasync(s->journal_fd);
+	if (ok)
+		s->store.journal_bytes += s->batch_len;
+	s->batch_len = 0;
+	return ok;
+}
+
+// fsync the directory that holds path, so a rename into it is on disk.
+static bool l_fsync_dir_of(const char* path) {
+	char dir[sizeof(paramsys_store_file_t::snapshot_path)];
+	const char* slash = strrchr(path, '/');
+	if (!slash)
+		strcpy(dir, ".");
+	else if (slash == path)
+		strcpy(dir, "/");
+	else
+		snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+	int fd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		return false;
+	bool ok = fsync(fd) == 0;
+	close(fd);
+	return ok;
+}
+
+static bool l_compact(paramsys_store_t* store, const u8* image, u32 image_len) {
+	paramsys_store_file_t* s = (paramsys_store_file_t*)store;
+
+	char tmp_path[sizeof(s->snapshot_path) + 4];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", s->snapshot_path);
+
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return false;
+
+	l_snapshot_header_t h = {PARAMSYS_SNAPSHOT_MAGIC, image_len, l_crc32(0, image, image_len)};
+	struct iovec iov[2] = {{&h, sizeof(h)}, {(void*)image, image_len}};
+	bool ok = writev(fd, iov, 2) == (ssize_t)(sizeof(h) + image_len) && fsync(fd) == 0;
+	close(fd);
+
+	if (!ok || rename(tmp_path, s->snapshot_path) != 0) {
+		unlink(tmp_path);
+		return false;
+	}
+	// the rename has to be on disk before the journal goes. otherwise a power loss can keep the old snapshot and the
+	// empty journal. if it fails, the journal stays: replaying it over the new snapshot gives the same values.
+	if (!l_fsync_dir_of(s->snapshot_path))
+		return false;
+
+	if (ftruncate(s->journal_fd, 0) != 0)
+		return false;
+	s->store.journal_bytes = 0;
+	s->journal_torn = false;
+	return true;
+}
+
+
+bool paramsys_store_file_open(paramsys_store_file_t* s, const char* snapshot_path, const char* journal_path,
+                              u32 compact_threshold_bytes, bool fsync_every_append) {
+	memset(s, 0, sizeof(*s));
+	s->journal_fd = -1;
+	if (strlen(snapshot_path) >= sizeof(s->snapshot_path) || strlen(journal_path) >= sizeof(s->journal_path))
+		return false;
+	strcpy(s->snapshot_path, snapshot_path);
+	strcpy(s->journal_path, journal_path);
+
+	s->journal_fd = open(journal_path, O_RDWR | O_CREAT | O_APPEND, 0644);
+	if (s->journal_fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(s->journal_fd, &st) == 0)
+		s->store.journal_bytes = st.st_size;
+
+	s->fsync_every_append            = fsync_every_append;
+	s->store.load_snapshot           = l_load_snapshot;
+	s->store.replay_journal          = l_replay_journal;
+	s->store.append                  = l_append;
+	s->store.compact                 = l_compact;
+	s->store.batch_begin             = l_batch_begin;
+	s->store.batch_end               = l_batch_end;
+	s->store.compact_threshold_bytes = compact_threshold_bytes;
+	return true;
+}
+
+void paramsys_store_file_close(paramsys_store_file_t* s) {
+	if (s->journal_fd >= 0)
+		close(s->journal_fd);
+	s->journal_fd = -1;
+	free(s->batch_buf);
+	s->batch_buf = nullptr;
+	s->batch_cap = 0;
+}
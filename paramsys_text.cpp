@@ -0,0 +1,960 @@
+// Licence: pick one - public domain / UNLICENCE (https://www.unlicense.org) / MIT (https://opensource.org/licenses/MIT).
+
+// JSON/CSV export and import, see paramsys_text.h.
+
+#include "paramsys_text.h"
+#include "paramsys_internal.h"
+
+#include <string.h> // memcpy
+#include <stdlib.h> // malloc
+#include <errno.h> // EINTR
+#include <math.h> // isnan
+#include <unistd.h> // read, write
+#include <charconv> // to_chars, from_chars. shortest round-trip floats, no locale.
+
+
+// the longest record: name, a 255 byte string of control characters escaped as \u00xx, the rest. str16 and buf values
+// are longer, they are written in pieces of L_ARENA_CHUNK bytes.
+#define L_MAX_RECORD  (96 + 6 * 255)
+#define L_ARENA_CHUNK 255
+#define L_FD_BUF_LEN  (64 * 1024)
+// a record has to fit whole into the import buffer. 64k of buf takes 128k as hex.
+#define L_IMPORT_BUF_LEN (256 * 1024)
+
+// with the lengths, so that a record copies them without looking for the end.
+#define L_TYPE_NAME(s) {s, sizeof(s) - 1}
+static const struct {
+	const char* name;
+	u8          len;
+} l_type_names[] = {
+	L_TYPE_NAME("u8"), L_TYPE_NAME("u16"), L_TYPE_NAME("u32"), L_TYPE_NAME("u64"), L_TYPE_NAME("i8"), L_TYPE_NAME("i16"),
+	L_TYPE_NAME("i32"), L_TYPE_NAME("i64"), L_TYPE_NAME("f32"), L_TYPE_NAME("f64"), L_TYPE_NAME("flags8"),
+	L_TYPE_NAME("flags16"), L_TYPE_NAME("flags32"), L_TYPE_NAME("uuid128"), L_TYPE_NAME("time_unix_us64"),
+	L_TYPE_NAME("time_atomic_us64"), L_TYPE_NAME("str"), L_TYPE_NAME("str16"), L_TYPE_NAME("buf"),
+};
+#undef L_TYPE_NAME
+
+enum class l_status_e : u8 { OK, END, INCOMPLETE, ERROR };
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// formatting. every l_fmt_* writes at p and returns the end.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static char* l_fmt_str(char* p, const char* s) {
+	while (*s) *p++ = *s++;
+	return p;
+}
+
+// a string literal. the length is known, so it's a few stores instead of a loop over the characters.
+template <u32 N>
+static char* l_fmt_lit(char* p, const char (&s)[N]) {
+	memcpy(p, s, N - 1);
+	return p + N - 1;
+}
+
+// a param name. all 16 bytes are copied, the record has room for them, and only the characters are kept.
+static char* l_fmt_name(char* p, const char* name) {
+	memcpy(p, name, 16);
+	return p + strnlen(name, 16);
+}
+
+static char* l_fmt_u64(char* p, u64 v) {
+	static const char digit_pairs[] =
+		"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+		"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
+	char tmp[20];
+	char* t = tmp + sizeof(tmp);
+	while (v >= 100) {
+		t -= 2;
+		memcpy(t, &digit_pairs[(v % 100) * 2], 2);
+		v /= 100;
+	}
+	if (v >= 10) {
+		t -= 2;
+		memcpy(t, &digit_pairs[v * 2], 2);
+	} else {
+		*--t = '0' + (char)v;
+	}
+	u32 n = tmp + sizeof(tmp) - t;
+	memcpy(p, t, n);
+	return p + n;
+}
+
+static char* l_fmt_i64(char* p, i64 v) {
+	if (v < 0) {
+		*p++ = '-';
+		return l_fmt_u64(p, 0 - (u64)v);
+	}
+	return l_fmt_u64(p, (u64)v);
+}
+
+// digits of v, zero-padded to width.
+static char* l_fmt_u32_padded(char* p, u32 v, u32 width) {
+	for (u32 i = width; i > 0; i--) {
+		p[i - 1] = '0' + v % 10;
+		v /= 10;
+	}
+	return p + width;
+}
+
+// nan and inf are strings in json, there's no number for them.
+template <typename T>
+static char* l_fmt_float(char* p, T v, bool json) {
+	bool quote = json && !isfinite(v);
+	if (quote) *p++ = '"';
+	if (isnan(v))
+		p = l_fmt_str(p, "nan");
+	else
+		p = std::to_chars(p, p + 32, v).ptr;
+	if (quote) *p++ = '"';
+	return p;
+}
+
+static char* l_fmt_uuid(char* p, const u8* uuid) {
+	static const char hexes[] = "0123456789abcdef";
+	for (u32 i = 0; i < 16; i++) {
+		if (i == 4 || i == 6 || i == 8 || i == 10)
+			*p++ = '-';
+		*p++ = hexes[uuid[i] >> 4];
+		*p++ = hexes[uuid[i] & 0xf];
+	}
+	return p;
+}
+
+// http://howardhinnant.github.io/date_algorithms.html
+static void l_civil_from_days(i64 z, i64* out_year, u32* out_month, u32* out_day) {
+	z += 719468;
+	i64 era = (z >= 0 ? z : z - 146096) / 146097;
+	u32 doe = (u32)(z - era * 146097);
+	u32 yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	u32 doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	u32 mp = (5 * doy + 2) / 153;
+	*out_day = doy - (153 * mp + 2) / 5 + 1;
+	*out_month = mp < 10 ? mp + 3 : mp - 9;
+	*out_year = (i64)yoe + era * 400 + (*out_month <= 2);
+}
+
+static i64 l_days_from_civil(i64 year, u32 month, u32 day) {
+	year -= month <= 2;
+	i64 era = (year >= 0 ? year : year - 399) / 400;
+	u32 yoe = (u32)(year - era * 400);
+	u32 doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	u32 doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + (i64)doe - 719468;
+}
+
+// "2014-02-11T18:46:22.660000Z". times outside years 0..9999 as plain microseconds.
+static char* l_fmt_time(char* p, i64 timestamp_us, bool json) {
+	const i64 us_per_day = 86400ll * 1000000;
+	i64 days = timestamp_us / us_per_day;
+	i64 rem = timestamp_us % us_per_day;
+	if (rem < 0) {
+		rem += us_per_day;
+		days--;
+	}
+	i64 year;
+	u32 month, day;
+	l_civil_from_days(days, &year, &month, &day);
+	if (year < 0 || year > 9999)
+		return l_fmt_i64(p, timestamp_us);
+
+	if (json) *p++ = '"';
+	p = l_fmt_u32_padded(p, (u32)year, 4);
+	*p++ = '-';
+	p = l_fmt_u32_padded(p, month, 2);
+	*p++ = '-';
+	p = l_fmt_u32_padded(p, day, 2);
+	*p++ = 'T';
+	p = l_fmt_u32_padded(p, (u32)(rem / 3600000000ll), 2);
+	*p++ = ':';
+	p = l_fmt_u32_padded(p, (u32)(rem / 60000000 % 60), 2);
+	*p++ = ':';
+	p = l_fmt_u32_padded(p, (u32)(rem / 1000000 % 60), 2);
+	*p++ = '.';
+	p = l_fmt_u32_padded(p, (u32)(rem % 1000000), 6);
+	*p++ = 'Z';
+	if (json) *p++ = '"';
+	return p;
+}
+
+// the escaped characters, without the quotes.
+static char* l_fmt_json_chars(char* p, const u8* s, u32 len) {
+	static const char hexes[] = "0123456789abcdef";
+	for (u32 i = 0; i < len; i++) {
+		u8 c = s[i];
+		if (c == '"' || c == '\\') {
+			*p++ = '\\';
+			*p++ = c;
+		} else if (c >= 0x20) {
+			*p++ = c;
+		} else if (c == '\n') {
+			p = l_fmt_str(p, "\\n");
+		} else if (c == '\r') {
+			p = l_fmt_str(p, "\\r");
+		} else if (c == '\t') {
+			p = l_fmt_str(p, "\\t");
+		} else {
+			p = l_fmt_str(p, "\\u00");
+			*p++ = hexes[c >> 4];
+			*p++ = hexes[c & 0xf];
+		}
+	}
+	return p;
+}
+
+static char* l_fmt_csv_chars(char* p, const u8* s, u32 len) {
+	for (u32 i = 0; i < len; i++) {
+		if (s[i] == '"')
+			*p++ = '"';
+		*p++ = s[i];
+	}
+	return p;
+}
+
+static char* l_fmt_hex_chars(char* p, const u8* s, u32 len) {
+	static const char hexes[] = "0123456789abcdef";
+	for (u32 i = 0; i < len; i++) {
+		*p++ = hexes[s[i] >> 4];
+		*p++ = hexes[s[i] & 0xf];
+	}
+	return p;
+}
+
+static char* l_fmt_json_str(char* p, const u8* s, u32 len) {
+	*p++ = '"';
+	p = l_fmt_json_chars(p, s, len);
+	*p++ = '"';
+	return p;
+}
+
+static char* l_fmt_csv_str(char* p, const u8* s, u32 len) {
+	*p++ = '"';
+	p = l_fmt_csv_chars(p, s, len);
+	*p++ = '"';
+	return p;
+}
+
+// Piece of a str16 or buf value, between the quotes. bufs are hex, the first piece starts with 0x.
+static char* l_fmt_arena_chunk(char* p, params_type_e type, const u8* s, u32 len, bool first, bool json) {
+	if (type == params_type_e::BUF)
+		return l_fmt_hex_chars(first ? l_fmt_str(p, "0x") : p, s, len);
+	return json ? l_fmt_json_chars(p, s, len) : l_fmt_csv_chars(p, s, len);
+}
+
+// a value of type T from value entry bytes, unaligned. zero if len isn't the size of T.
+template <typename T>
+static T l_load(const u8* value, u32 len) {
+	T v = 0;
+	if (len == sizeof(T)) memcpy(&v, value, sizeof(T));
+	return v;
+}
+
+static char* l_fmt_value(char* p, params_type_e type, const u8* value, u8 len, bool json) {
+	if (type == params_type_e::STR)
+		return json ? l_fmt_json_str(p, value, len) : l_fmt_csv_str(p, value, len);
+
+	// every case copies a known size, the variable length memcpy of all of them was a call per value.
+	switch (type) {
+		case params_type_e::U8:
+		case params_type_e::FLAGS8:  return l_fmt_u64(p, l_load<u8>(value, len));
+		case params_type_e::U16:
+		case params_type_e::FLAGS16: return l_fmt_u64(p, l_load<u16>(value, len));
+		case params_type_e::U32:
+		case params_type_e::FLAGS32: return l_fmt_u64(p, l_load<u32>(value, len));
+		case params_type_e::U64:     return l_fmt_u64(p, l_load<u64>(value, len));
+		case params_type_e::I8:      return l_fmt_i64(p, l_load<i8>(value, len));
+		case params_type_e::I16:     return l_fmt_i64(p, l_load<i16>(value, len));
+		case params_type_e::I32:     return l_fmt_i64(p, l_load<i32>(value, len));
+		case params_type_e::I64:     return l_fmt_i64(p, l_load<i64>(value, len));
+		case params_type_e::F32:     return l_fmt_float(p, l_load<f32>(value, len), json);
+		case params_type_e::F64:     return l_fmt_float(p, l_load<f64>(value, len), json);
+		case params_type_e::UUID128: {
+			u8 uuid[16] = {};
+			if (len == sizeof(uuid)) memcpy(uuid, value, sizeof(uuid));
+			if (json) *p++ = '"';
+			p = l_fmt_uuid(p, uuid);
+			if (json) *p++ = '"';
+			return p;
+		}
+		case params_type_e::TIME_UNIX_US64:
+		case params_type_e::TIME_ATOMIC_US64: return l_fmt_time(p, l_load<i64>(value, len), json);
+		default: return p;
+	}
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// export
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct l_writer_t {
+	char* buf;
+	u32   cap;
+	u32   len;
+	int   fd;     // -1 if buf is all the room there is
+	bool  failed;
+};
+
+static bool l_write_all(int fd, const char* buf, u32 len) {
+	while (len) {
+		ssize_t r = write(fd, buf, len);
+		if (r < 0 && errno == EINTR) continue;
+		if (r <= 0) return false;
+		buf += r;
+		len -= r;
+	}
+	return true;
+}
+
+static void l_flush(l_writer_t* w) {
+	if (w->fd >= 0 && w->len && !w->failed) {
+		w->failed = !l_write_all(w->fd, w->buf, w->len);
+		w->len = 0;
+	}
+}
+
+// Where to format the next record: straight into buf if there's room for the longest one, into tmp (L_MAX_RECORD)
+// otherwise.
+static char* l_record_begin(l_writer_t* w, char* tmp) {
+	if (w->cap - w->len < L_MAX_RECORD)
+		l_flush(w);
+	return w->cap - w->len >= L_MAX_RECORD ? w->buf + w->len : tmp;
+}
+
+static void l_record_end(l_writer_t* w, char* tmp, char* start, char* end) {
+	u32 n = end - start;
+	if (start == tmp) {
+		if (w->cap - w->len < n) {
+			w->failed = true;
+			return;
+		}
+		memcpy(w->buf + w->len, tmp, n);
+	}
+	w->len += n;
+}
+
+// The value of a record at p. A str16 or buf value doesn't fit into one record: the part written so far is ended and
+// the rest continues in a new one at *start, the return is in the last part.
+static char* l_fmt_record_value(l_writer_t* w, char* tmp, char** start, char* p, params_type_e type, const u8* value,
+                                u32 len, bool json) {
+	if (!paramsys_type_is_arena((u8)type))
+		return l_fmt_value(p, type, value, len, json);
+	*p++ = '"';
+	for (u32 pos = 0;;) {
+		u32 n = len - pos < L_ARENA_CHUNK ? len - pos : L_ARENA_CHUNK;
+		p = l_fmt_arena_chunk(p, type, value + pos, n, pos == 0, json);
+		pos += n;
+		if (pos == len)
+			break;
+		l_record_end(w, tmp, *start, p);
+		p = *start = l_record_begin(w, tmp);
+	}
+	*p++ = '"';
+	return p;
+}
+
+static void l_export(params_text_format_e format, l_writer_t* w) {
+	bool json = format == params_text_format_e::JSON;
+	char tmp[L_MAX_RECORD];
+	char* start = l_record_begin(w, tmp);
+	l_record_end(w, tmp, start, l_fmt_str(start, json ? "{\"params\": [" : "index,name,type,value\n"));
+
+	// values come as value entries (param_index_t param_index, u8 type, u8 len, value), each read consistently. param 0 is
+	// internal and not exported. room for a few small entries and the longest one.
+	u32 entries_len = 4096 + paramsys_value_entry_max_len();
+	u8* entries = (u8*)malloc(entries_len);
+	w->failed = !entries;
+	u32 next = 1;
+	bool first = true;
+	while (next < PARAMS_MAX_COUNT && !w->failed) {
+		u32 len = paramsys_write_value_entries((param_index_t)next, PARAMS_MAX_COUNT - 1, entries, entries_len, &next);
+		u32 header_len;
+		for (u32 pos = 0; pos < len && !w->failed; pos += header_len) {
+			param_index_t param_index = 0;
+			params_type_e type = params_type_e::U8;
+			u32 value_len = 0;
+			header_len = paramsys_read_value_entry_header(&entries[pos], len - pos, &param_index, &type, &value_len);
+			// entries cut short. can't happen with what paramsys_write_value_entries writes, but don't loop on it.
+			if (!header_len) {
+				w->failed = true;
+				break;
+			}
+			const u8* value = &entries[pos + header_len];
+			header_len += value_len;
+			const char* name;
+			params_type_e param_type;
+			if (!paramsys_param_desc(param_index, &name, &param_type))
+				continue;
+
+			auto type_name = l_type_names[(u8)type & PARAMS_TYPE_INDEX_mask];
+			char* p = start = l_record_begin(w, tmp);
+			if (json) {
+				p = first ? l_fmt_lit(p, "\n\t{\"index\": ") : l_fmt_lit(p, ",\n\t{\"index\": ");
+				p = l_fmt_u64(p, param_index);
+				p = l_fmt_lit(p, ", \"name\": \"");
+				p = l_fmt_name(p, name);
+				p = l_fmt_lit(p, "\", \"type\": \"");
+				memcpy(p, type_name.name, type_name.len);
+				p = l_fmt_lit(p + type_name.len, "\", \"value\": ");
+				p = l_fmt_record_value(w, tmp, &start, p, type, value, value_len, true);
+				*p++ = '}';
+			} else {
+				p = l_fmt_u64(p, param_index);
+				*p++ = ',';
+				p = l_fmt_name(p, name);
+				*p++ = ',';
+				memcpy(p, type_name.name, type_name.len);
+				p += type_name.len;
+				*p++ = ',';
+				p = l_fmt_record_value(w, tmp, &start, p, type, value, value_len, false);
+				*p++ = '\n';
+			}
+			l_record_end(w, tmp, start, p);
+			first = false;
+		}
+		if (!len)
+			break;
+	}
+
+	if (json) {
+		start = l_record_begin(w, tmp);
+		l_record_end(w, tmp, start, l_fmt_str(start, "\n]}\n"));
+	}
+	l_flush(w);
+	free(entries);
+}
+
+u32 params_export(params_text_format_e format, char* out, u32 out_max) {
+	l_writer_t w = {out, out_max, 0, -1, false};
+	l_export(format, &w);
+	return w.failed ? 0 : w.len;
+}
+
+param_error_t params_export_fd(params_text_format_e format, int fd) {
+	char* buf = (char*)malloc(L_FD_BUF_LEN);
+	if (!buf)
+		return param_error_t::FAIL;
+	l_writer_t w = {buf, L_FD_BUF_LEN, 0, fd, false};
+	l_export(format, &w);
+	free(buf);
+	return w.failed ? param_error_t::FAIL : param_error_t::SUCCESS;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// import
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// One parsed record. Spans point into the text.
+struct l_record_t {
+	const char* index;
+	u32         index_len;
+	const char* name;
+	u32         name_len;
+	const char* value;  // without the quotes
+	u32         value_len;
+	bool        value_quoted;
+};
+
+struct l_cursor_t {
+	const char* p;
+	const char* end;
+	bool        final; // no more text after end
+};
+
+struct l_import_t {
+	params_text_format_e format;
+	bool                 started; // json header / csv header line done
+	u32                  count;
+	u32                  applied;
+	param_value_t        items[PARAMS_TEXT_BATCH];
+	char                 strs[PARAMS_TEXT_BATCH][255];
+	char                 arena_buf[0xffff]; // one str16/buf value per batch
+	bool                 arena_in_batch;
+};
+
+static bool l_is_ws(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+static void l_skip_ws(l_cursor_t* c) {
+	while (c->p < c->end && l_is_ws(*c->p)) c->p++;
+}
+
+static l_status_e l_expect(l_cursor_t* c, char ch) {
+	if (c->p == c->end) return l_status_e::INCOMPLETE;
+	if (*c->p != ch) return l_status_e::ERROR;
+	c->p++;
+	return l_status_e::OK;
+}
+
+// json string at c->p, the span without the quotes. escapes are left in.
+static l_status_e l_json_string(l_cursor_t* c, const char** out, u32* out_len) {
+	l_status_e e = l_expect(c, '"');
+	if (e != l_status_e::OK) return e;
+	const char* start = c->p;
+	while (c->p < c->end && *c->p != '"') {
+		if (*c->p == '\\' && ++c->p == c->end) break;
+		c->p++;
+	}
+	if (c->p == c->end) return l_status_e::INCOMPLETE;
+	*out = start;
+	*out_len = c->p++ - start;
+	return l_status_e::OK;
+}
+
+// number or literal up to the next delimiter.
+static l_status_e l_token(l_cursor_t* c, const char* delimiters, const char** out, u32* out_len) {
+	const char* start = c->p;
+	while (c->p < c->end && !strchr(delimiters, *c->p)) c->p++;
+	if (c->p == c->end && !c->final) return l_status_e::INCOMPLETE;
+	*out = start;
+	*out_len = c->p - start;
+	return l_status_e::OK;
+}
+
+static l_status_e l_json_record(l_import_t* st, l_cursor_t* c, l_record_t* r) {
+	l_status_e e;
+	#define L_TRY(x) if ((e = (x)) != l_status_e::OK) return e
+
+	l_skip_ws(c);
+	if (!st->started) {
+		// {"params": [
+		const char* key;
+		u32 key_len;
+		L_TRY(l_expect(c, '{'));
+		l_skip_ws(c);
+		L_TRY(l_json_string(c, &key, &key_len));
+		l_skip_ws(c);
+		L_TRY(l_expect(c, ':'));
+		l_skip_ws(c);
+		L_TRY(l_expect(c, '['));
+		st->started = true;
+		return l_status_e::OK;
+	}
+
+	if (c->p < c->end && *c->p == ',') {
+		c->p++;
+		l_skip_ws(c);
+	}
+	if (c->p == c->end) return c->final ? l_status_e::ERROR : l_status_e::INCOMPLETE;
+	if (*c->p == ']') return l_status_e::END; // the rest doesn't matter
+
+	L_TRY(l_expect(c, '{'));
+	while (true) {
+		l_skip_ws(c);
+		if (c->p == c->end) return c->final ? l_status_e::ERROR : l_status_e::INCOMPLETE;
+		if (*c->p == '}') {
+			c->p++;
+			return l_status_e::OK;
+		}
+		const char* key;
+		u32 key_len;
+		const char* value;
+		u32 value_len;
+		L_TRY(l_json_string(c, &key, &key_len));
+		l_skip_ws(c);
+		L_TRY(l_expect(c, ':'));
+		l_skip_ws(c);
+		if (c->p == c->end) return c->final ? l_status_e::ERROR : l_status_e::INCOMPLETE;
+		bool quoted = *c->p == '"';
+		if (quoted) {
+			L_TRY(l_json_string(c, &value, &value_len));
+		} else {
+			L_TRY(l_token(c, ",} \t\r\n", &value, &value_len));
+			if (!value_len) return l_status_e::ERROR;
+		}
+		if (key_len == 5 && memcmp(key, "index", 5) == 0) {
+			r->index = value;
+			r->index_len = value_len;
+		} else if (key_len == 4 && memcmp(key, "name", 4) == 0) {
+			r->name = value;
+			r->name_len = value_len;
+		} else if (key_len == 5 && memcmp(key, "value", 5) == 0) {
+			r->value = value;
+			r->value_len = value_len;
+			r->value_quoted = quoted;
+		}
+		l_skip_ws(c);
+		if (c->p == c->end) return c->final ? l_status_e::ERROR : l_status_e::INCOMPLETE;
+		if (*c->p == ',')
+			c->p++;
+		else if (*c->p != '}')
+			return l_status_e::ERROR;
+	}
+	#undef L_TRY
+}
+
+static l_status_e l_csv_record(l_import_t* st, l_cursor_t* c, l_record_t* r) {
+	// empty lines between records are fine.
+	while (c->p < c->end && (*c->p == '\n' || *c->p == '\r')) c->p++;
+	if (c->p == c->end) return c->final ? l_status_e::END : l_status_e::INCOMPLETE;
+
+	const char* fields[3];
+	u32 field_lens[3];
+	l_status_e e;
+	for (u32 i = 0; i < 3; i++) {
+		if ((e = l_token(c, ",\r\n", &fields[i], &field_lens[i])) != l_status_e::OK) return e;
+		if ((e = l_expect(c, ',')) != l_status_e::OK) return c->p == c->end && c->final ? l_status_e::ERROR : e;
+	}
+
+	if (c->p < c->end && *c->p == '"') {
+		// quoted, "" is a quote. the value span keeps the doubled quotes.
+		const char* start = ++c->p;
+		while (true) {
+			while (c->p < c->end && *c->p != '"') c->p++;
+			if (c->p == c->end) return c->final ? l_status_e::ERROR : l_status_e::INCOMPLETE;
+			// can't tell "" from the closing quote before the next char is there.
+			if (c->p + 1 == c->end && !c->final) return l_status_e::INCOMPLETE;
+			if (c->p + 1 < c->end && c->p[1] == '"') {
+				c->p += 2;
+				continue;
+			}
+			break;
+		}
+		r->value = start;
+		r->value_len = c->p++ - start;
+		r->value_quoted = true;
+	} else {
+		if ((e = l_token(c, "\r\n", &r->value, &r->value_len)) != l_status_e::OK) return e;
+	}
+	if (c->p < c->end && *c->p == '\r') c->p++;
+	if (c->p < c->end && *c->p != '\n') return l_status_e::ERROR;
+	if (c->p == c->end && !c->final) return l_status_e::INCOMPLETE;
+	if (c->p < c->end) c->p++;
+
+	if (!st->started) {
+		// the header line
+		st->started = true;
+		if (field_lens[0] != 5 || memcmp(fields[0], "index", 5) != 0)
+			return l_status_e::ERROR;
+		r->value = nullptr;
+		return l_status_e::OK;
+	}
+	r->index = fields[0];
+	r->index_len = field_lens[0];
+	r->name = fields[1];
+	r->name_len = field_lens[1];
+	return l_status_e::OK;
+}
+
+static bool l_parse_u64(const char* s, u32 len, u64* out) {
+	if (!len || len > 20) return false;
+	u64 v = 0;
+	for (u32 i = 0; i < len; i++) {
+		if (s[i] < '0' || s[i] > '9') return false;
+		u64 d = s[i] - '0';
+		if (v > (~(u64)0 - d) / 10) return false;
+		v = v * 10 + d;
+	}
+	*out = v;
+	return true;
+}
+
+static bool l_parse_i64(const char* s, u32 len, i64* out) {
+	bool negative = len && s[0] == '-';
+	u64 v;
+	if (!l_parse_u64(s + negative, len - negative, &v)) return false;
+	if (v > (u64)INT64_MAX + negative) return false;
+	*out = negative ? (i64)(0 - v) : (i64)v;
+	return true;
+}
+
+static bool l_parse_hex_byte(const char* s, u8* out) {
+	u8 v = 0;
+	for (u32 i = 0; i < 2; i++) {
+		char ch = s[i];
+		u8 d = ch >= '0' && ch <= '9' ? ch - '0' : ch >= 'a' && ch <= 'f' ? ch - 'a' + 10 :
+		       ch >= 'A' && ch <= 'F' ? ch - 'A' + 10 : 0xff;
+		if (d == 0xff) return false;
+		v = v << 4 | d;
+	}
+	*out = v;
+	return true;
+}
+
+// canonical 8-4-4-4-12, or 32 hex digits.
+static bool l_parse_uuid(const char* s, u32 len, u8* out) {
+	bool dashes = len == 36;
+	if (len != 32 && !dashes) return false;
+	for (u32 i = 0; i < 16; i++) {
+		if (dashes && (i == 4 || i == 6 || i == 8 || i == 10) && *s++ != '-') return false;
+		if (!l_parse_hex_byte(s, &out[i])) return false;
+		s += 2;
+	}
+	return true;
+}
+
+// "YYYY-MM-DDTHH:MM:SS[.f..]Z" or plain microseconds.
+static bool l_parse_time(const char* s, u32 len, i64* out) {
+	if (len < 20 || s[4] != '-')
+		return l_parse_i64(s, len, out);
+	u64 year, month, day, hour, minute, second, usec = 0;
+	if (!l_parse_u64(s, 4, &year) || !l_parse_u64(s + 5, 2, &month) || s[7] != '-' || !l_parse_u64(s + 8, 2, &day) ||
+	    s[10] != 'T' || !l_parse_u64(s + 11, 2, &hour) || s[13] != ':' || !l_parse_u64(s + 14, 2, &minute) ||
+	    s[16] != ':' || !l_parse_u64(s + 17, 2, &second) || s[len - 1] != 'Z')
+		return false;
+	if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+		return false;
+	u32 pos = 19;
+	if (s[pos] == '.') {
+		u32 digits = 0;
+		for (pos++; pos < len - 1; pos++, digits++) {
+			if (s[pos] < '0' || s[pos] > '9') return false;
+			if (digits < 6) usec = usec * 10 + (s[pos] - '0');
+		}
+		if (!digits) return false;
+		for (; digits < 6; digits++) usec *= 10;
+	}
+	if (pos != len - 1) return false;
+	i64 days = l_days_from_civil((i64)year, (u32)month, (u32)day);
+	*out = ((days * 24 + (i64)hour) * 60 + (i64)minute) * 60000000 + (i64)second * 1000000 + (i64)usec;
+	return true;
+}
+
+static void l_put_utf8(char* out, u32* len, u32 out_max, u32 cp) {
+	char buf[4];
+	u32 n;
+	if (cp < 0x80)         { buf[0] = cp; n = 1; }
+	else if (cp < 0x800)   { buf[0] = 0xc0 | cp >> 6; buf[1] = 0x80 | (cp & 0x3f); n = 2; }
+	else if (cp < 0x10000) { buf[0] = 0xe0 | cp >> 12; buf[1] = 0x80 | (cp >> 6 & 0x3f); buf[2] = 0x80 | (cp & 0x3f); n = 3; }
+	else                   { buf[0] = 0xf0 | cp >> 18; buf[1] = 0x80 | (cp >> 12 & 0x3f); buf[2] = 0x80 | (cp >> 6 & 0x3f);
+	                         buf[3] = 0x80 | (cp & 0x3f); n = 4; }
+	for (u32 i = 0; i < n && *len < out_max; i++) out[(*len)++] = buf[i];
+}
+
+static bool l_parse_hex_u16(const char* s, u32* out) {
+	u8 hi, lo;
+	if (!l_parse_hex_byte(s, &hi) || !l_parse_hex_byte(s + 2, &lo)) return false;
+	*out = hi << 8 | lo;
+	return true;
+}
+
+// Decode a string value into out. Strings longer than out_max are cut, params_set_many would cut them anyway.
+static bool l_decode_str(params_text_format_e format, const l_record_t* r, char* out, u32 out_max, u32* out_len) {
+	const char* s = r->value;
+	u32 len = 0;
+	for (u32 i = 0; i < r->value_len && len < out_max; i++) {
+		char ch = s[i];
+		if (format == params_text_format_e::CSV) {
+			if (ch == '"') i++; // "" -> "
+			out[len++] = ch;
+			continue;
+		}
+		if (ch != '\\') {
+			out[len++] = ch;
+			continue;
+		}
+		if (++i == r->value_len) return false;
+		switch (s[i]) {
+			case '"': case '\\': case '/': out[len++] = s[i]; break;
+			case 'b': out[len++] = '\b'; break;
+			case 'f': out[len++] = '\f'; break;
+			case 'n': out[len++] = '\n'; break;
+			case 'r': out[len++] = '\r'; break;
+			case 't': out[len++] = '\t'; break;
+			case 'u': {
+				u32 cp, low;
+				if (i + 4 >= r->value_len || !l_parse_hex_u16(s + i + 1, &cp)) return false;
+				i += 4;
+				if (cp >= 0xd800 && cp < 0xdc00 && i + 6 < r->value_len && s[i + 1] == '\\' && s[i + 2] == 'u' &&
+				    l_parse_hex_u16(s + i + 3, &low) && low >= 0xdc00 && low < 0xe000) {
+					cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+					i += 6;
+				}
+				l_put_utf8(out, &len, out_max, cp);
+				break;
+			}
+			default: return false;
+		}
+	}
+	*out_len = len;
+	return true;
+}
+
+// "0x" and hex digits, or "". More than out_max bytes are cut.
+static bool l_decode_hex(const char* s, u32 len, u8* out, u32 out_max, u32* out_len) {
+	if (len && (len < 2 || s[0] != '0' || (s[1] != 'x' && s[1] != 'X') || len % 2))
+		return false;
+	u32 n = len ? (len - 2) / 2 : 0;
+	if (n > out_max) n = out_max;
+	for (u32 i = 0; i < n; i++)
+		if (!l_parse_hex_byte(s + 2 + 2 * i, &out[i])) return false;
+	*out_len = n;
+	return true;
+}
+
+template <typename T>
+static bool l_parse_float(const char* s, u32 len, T* out) {
+	std::from_chars_result res = std::from_chars(s, s + len, *out);
+	return res.ec == std::errc() && res.ptr == s + len;
+}
+
+// Parse the value of the record as the type of the param into item.
+static bool l_parse_value(l_import_t* st, const l_record_t* r, params_type_e type, param_value_t* item, char* str_buf) {
+	const char* s = r->value;
+	u32 len = r->value_len;
+	u64 u;
+	i64 i;
+	switch (type) {
+		case params_type_e::U8:
+		case params_type_e::FLAGS8:  if (!l_parse_u64(s, len, &u) || u > 0xff) return false;       item->u8_val = u;  return true;
+		case params_type_e::U16:
+		case params_type_e::FLAGS16: if (!l_parse_u64(s, len, &u) || u > 0xffff) return false;     item->u16_val = u; return true;
+		case params_type_e::U32:
+		case params_type_e::FLAGS32: if (!l_parse_u64(s, len, &u) || u > 0xffffffff) return false; item->u32_val = u; return true;
+		case params_type_e::U64:     if (!l_parse_u64(s, len, &u)) return false; item->u64_val = u; return true;
+		case params_type_e::I8:  if (!l_parse_i64(s, len, &i) || i < INT8_MIN || i > INT8_MAX) return false;   item->i8_val = i;  return true;
+		case params_type_e::I16: if (!l_parse_i64(s, len, &i) || i < INT16_MIN || i > INT16_MAX) return false; item->i16_val = i; return true;
+		case params_type_e::I32: if (!l_parse_i64(s, len, &i) || i < INT32_MIN || i > INT32_MAX) return false; item->i32_val = i; return true;
+		case params_type_e::I64: if (!l_parse_i64(s, len, &i)) return false; item->i64_val = i; return true;
+		case params_type_e::F32: return l_parse_float(s, len, &item->f32_val);
+		case params_type_e::F64: return l_parse_float(s, len, &item->f64_val);
+		case params_type_e::UUID128: return l_parse_uuid(s, len, item->uuid128_val);
+		case params_type_e::TIME_UNIX_US64:
+		case params_type_e::TIME_ATOMIC_US64: return l_parse_time(s, len, &item->i64_val);
+		case params_type_e::STR: {
+			u32 str_len;
+			if (!r->value_quoted || !l_decode_str(st->format, r, str_buf, 255, &str_len)) return false;
+			item->str_val.ptr = str_buf;
+			item->str_val.len = str_len;
+			return true;
+		}
+		case params_type_e::STR16:
+		case params_type_e::BUF: {
+			u32 bytes_len;
+			if (!r->value_quoted) return false;
+			if (type == params_type_e::STR16 ? !l_decode_str(st->format, r, st->arena_buf, sizeof(st->arena_buf), &bytes_len)
+			                                 : !l_decode_hex(s, len, (u8*)st->arena_buf, sizeof(st->arena_buf), &bytes_len))
+				return false;
+			item->bytes_val.ptr = st->arena_buf;
+			item->bytes_val.len = bytes_len;
+			st->arena_in_batch = true;
+			return true;
+		}
+		default: return false;
+	}
+}
+
+static bool l_apply_batch(l_import_t* st) {
+	if (!st->count)
+		return true;
+	if (params_set_many(st->items, st->count) != param_error_t::SUCCESS)
+		return false;
+	st->applied += st->count;
+	st->count = 0;
+	st->arena_in_batch = false;
+	return true;
+}
+
+static bool l_import_record(l_import_t* st, const l_record_t* r) {
+	param_index_t param_index = 0;
+	if (r->name_len) {
+		if (r->name_len > 255) return true;
+		param_index = params_find(r->name, (u8)r->name_len);
+	} else if (r->index_len) {
+		u64 index;
+		if (!l_parse_u64(r->index, r->index_len, &index)) return false;
+		param_index = index < PARAMS_MAX_COUNT ? (param_index_t)index : 0;
+	}
+	const char* name;
+	params_type_e type;
+	if (!param_index || !paramsys_param_desc(param_index, &name, &type))
+		return true; // not in this build, skip
+	if (!r->value)
+		return false;
+
+	if ((st->count == PARAMS_TEXT_BATCH || (st->arena_in_batch && paramsys_type_is_arena((u8)type))) &&
+	    !l_apply_batch(st))
+		return false;
+	param_value_t* item = &st->items[st->count];
+	item->param_index = param_index;
+	item->param_type = type;
+	if (!l_parse_value(st, r, type, item, st->strs[st->count]))
+		return false;
+	st->count++;
+	return true;
+}
+
+// Parse and apply the records of text[*pos..len]. *pos moves past every complete record. INCOMPLETE if the text ends
+// in the middle of a record and more may come (final false).
+static l_status_e l_import_text(l_import_t* st, const char* text, u32 len, u32* pos, bool final) {
+	while (true) {
+		l_cursor_t c = {text + *pos, text + len, final};
+		l_record_t r = {};
+		l_status_e e = st->format == params_text_format_e::JSON ? l_json_record(st, &c, &r) : l_csv_record(st, &c, &r);
+		if (e != l_status_e::OK)
+			return e;
+		bool header = r.value == nullptr && r.index_len == 0 && r.name_len == 0;
+		if (!header && !l_import_record(st, &r))
+			return l_status_e::ERROR;
+		*pos = c.p - text;
+	}
+}
+
+static param_error_t l_import_end(l_import_t* st, l_status_e e, u32* out_applied) {
+	bool ok = e == l_status_e::END && l_apply_batch(st);
+	if (out_applied) *out_applied = st->applied;
+	free(st);
+	return ok ? param_error_t::SUCCESS : param_error_t::FAIL;
+}
+
+static l_import_t* l_import_begin(params_text_format_e format) {
+	l_import_t* st = (l_import_t*)malloc(sizeof(l_import_t));
+	if (st) {
+		st->format = format;
+		st->started = false;
+		st->count = 0;
+		st->applied = 0;
+		st->arena_in_batch = false;
+	}
+	return st;
+}
+
+param_error_t params_import(params_text_format_e format, const char* text, u32 len, u32* out_applied) {
+	if (out_applied) *out_applied = 0;
+	l_import_t* st = l_import_begin(format);
+	if (!st)
+		return param_error_t::FAIL;
+	u32 pos = 0;
+	return l_import_end(st, l_import_text(st, text, len, &pos, true), out_applied);
+}
+
+param_error_t params_import_fd(params_text_format_e format, int fd, u32* out_applied) {
+	if (out_applied) *out_applied = 0;
+	l_import_t* st = l_import_begin(format);
+	char* buf = (char*)malloc(L_IMPORT_BUF_LEN);
+	if (!st || !buf) {
+		free(st);
+		free(buf);
+		return param_error_t::FAIL;
+	}
+
+	u32 len = 0;
+	bool eof = false;
+	l_status_e e;
+	while (true) {
+		u32 pos = 0;
+		e = l_import_text(st, buf, len, &pos, eof);
+		if (e != l_status_e::INCOMPLETE || eof)
+			break;
+		// keep the unfinished record, read more after it.
+		memmove(buf, buf + pos, len - pos);
+		len -= pos;
+		if (len == L_IMPORT_BUF_LEN) {
+			e = l_status_e::ERROR; // a record longer than the buffer
+			break;
+		}
+		ssize_t r = read(fd, buf + len, L_IMPORT_BUF_LEN - len);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r < 0) {
+			e = l_status_e::ERROR;
+			break;
+		}
+		eof = r == 0;
+		len += r;
+	}
+	free(buf);
+	return l_import_end(st, e, out_applied);
+}
@@ -0,0 +1,46 @@
+// Licence: pick one - public domain / UNLICENCE (https://www.unlicense.org) / MIT (https://opensource.org/licenses/MIT).
+
+// Text export and import of the values of the default instance, JSON or CSV. One record per enabled param, in index
+// order:
+//
+//   JSON: {"params": [
+//         	{"index": 1, "name": "p11_U16_minmax", "type": "u16", "value": 90},
+//         	{"index": 25, "name": "p25_test_8_STR", "type": "str", "value": "hello"}
+//         ]}
+//   CSV:  index,name,type,value
+//         1,p11_U16_minmax,u16,90
+//         25,p25_test_8_STR,str,"hello"
+//
+// Values: integers and flags in decimal, floats in the shortest form that reads back to the same bits ("nan", "inf"
+// and "-inf" as JSON strings), uuid128 in the canonical 8-4-4-4-12 hex form, time_unix_us64/time_atomic_us64 as
+// ISO-8601 UTC with microseconds ("2014-02-11T18:46:22.660000Z"). JSON strings are escaped (\" \\ \n .. \u00xx),
+// CSV strings are always quoted with "" for a quote. str16 values are strings too, buf values are quoted hex strings
+// ("0x3082..."). No printf, the formatting is done here.
+//
+// The importer reads the same formats. Records are matched by name with params_find, by index if a record has no
+// name. Records of unknown or disabled params are skipped. The type field is ignored, values are parsed as the type
+// the param has in this build. Values go through params_set_many in batches of PARAMS_TEXT_BATCH, so they are clamped
+// and tracked like any other set. Exporting and importing back gives the same values, and exporting again gives the
+// same bytes.
+
+#pragma once
+
+#include "stdints.h"
+
+#include "paramsys.h"
+
+
+#define PARAMS_TEXT_BATCH 64
+
+enum class params_text_format_e : u8 { JSON, CSV };
+
+// Write the export to out. Return its length, 0 if it doesn't fit into out_max.
+u32           params_export(params_text_format_e format, char* out, u32 out_max);
+// Write the export to a file descriptor, through a buffer.
+param_error_t params_export_fd(params_text_format_e format, int fd);
+
+// Apply the records of text. FAIL on a syntax error or a value that doesn't fit the type of the param; the batches
+// before the broken record stay applied. *out_applied (can be nullptr) is the number of records applied.
+param_error_t params_import(params_text_format_e format, const char* text, u32 len, u32* out_applied);
+// Same, reading from a file descriptor until EOF. Records are parsed as they arrive.
+param_error_t params_import_fd(params_text_format_e format, int fd, u32* out_applied);